@@ -0,0 +1,624 @@
+const std = @import("std");
+const build_options = @import("build_options");
+const corpus = @import("corpus");
+const perf = @import("perf.zig");
+const c = @cImport({
+    @cInclude("Search.h");
+    @cInclude("ContentSearch.h");
+    @cInclude("Listing.h");
+    @cInclude("Sort.h");
+    @cInclude("Query.h");
+    @cInclude("TreeSearch.h");
+    @cInclude("Memory.h");
+});
+
+// Every corpus is derived from this seed, so two runs read the same bytes
+const seed: u64 = 0x5EED_C11E;
+
+// Longest pattern benchmarked; shorter ones are its prefixes
+const max_pattern_len = 1024;
+
+const Scale = enum { quick, default, full };
+
+const Config = struct {
+    scale: Scale = .default,
+    json_path: ?[]const u8 = null,
+    dir: []const u8 = ".zig-cache/bench",
+    iterations: u32 = 10,
+    /// Hardware counters around every measured region
+    perf: bool = false,
+};
+
+const Stats = struct {
+    p50_ns: u64,
+    p90_ns: u64,
+    p99_ns: u64,
+    max_ns: u64,
+    mean_ns: u64,
+};
+
+/// Bytes per memory tag: the most a region held at once beyond what was
+/// held when it started
+const MemoryGrowth = struct {
+    listing: u64 = 0,
+    icon_cache: u64 = 0,
+    search_buffers: u64 = 0,
+    indexes: u64 = 0,
+    results: u64 = 0,
+    /// The process's peak RSS during the region, 0 if unknown
+    peak_rss: u64 = 0,
+};
+
+/// Most growth a suite may show per tag, null for no limit
+const MemoryCeiling = struct {
+    listing: ?u64 = null,
+    icon_cache: ?u64 = null,
+    search_buffers: ?u64 = null,
+    indexes: ?u64 = null,
+    results: ?u64 = null,
+};
+
+const Result = struct {
+    suite: []const u8,
+    backend: []const u8,
+    files: u64,
+    bytes: u64,
+    pattern_len: u32,
+    hit_rate: f64,
+    iterations: u32,
+    stats: Stats,
+    gb_per_s: f64,
+    files_per_s: f64,
+    /// Per iteration, with --perf
+    perf: ?perf.Counts = null,
+    memory: MemoryGrowth = .{},
+};
+
+const Bench = struct {
+    allocator: std.mem.Allocator,
+    config: Config,
+    results: std.ArrayList(Result),
+    needle: [max_pattern_len]u8,
+    counters: ?perf.Counters = null,
+
+    fn record(self: *Bench, result: Result) !void {
+        try self.results.append(result);
+        const ms = @as(f64, @floatFromInt(result.stats.p50_ns)) / 1e6;
+        std.debug.print("{s:<16} {s:<8} files={d:<8} bytes={d:<11} pattern={d:<5} hits={d:<5.2} p50={d:>9.3}ms p99={d:>9.3}ms {d:>8.3} GB/s {d:>12.0} files/s", .{
+            result.suite,       result.backend,  result.files, result.bytes,
+            result.pattern_len, result.hit_rate, ms,           @as(f64, @floatFromInt(result.stats.p99_ns)) / 1e6,
+            result.gb_per_s,    result.files_per_s,
+        });
+        if (result.perf) |counts| {
+            if (counts.ipc) |ipc| std.debug.print(" IPC={d:.2}", .{ipc});
+            if (counts.bytes_per_cycle) |bpc| std.debug.print(" bytes/cycle={d:.3}", .{bpc});
+            if (counts.cycles_per_file) |cpf| std.debug.print(" cycles/file={d:.0}", .{cpf});
+            if (counts.llc_misses) |misses| std.debug.print(" llc_misses={d}", .{misses});
+            if (counts.branch_misses) |misses| std.debug.print(" branch_misses={d}", .{misses});
+            if (counts.page_faults) |faults| std.debug.print(" page_faults={d}", .{faults});
+        }
+        std.debug.print(" peak_rss={d}\n", .{result.memory.peak_rss});
+        try checkCeiling(result);
+    }
+
+    /// Counter reading at the start of a measured region, null without
+    /// --perf
+    fn perfStart(self: *const Bench) ?perf.Reading {
+        const counters = self.counters orelse return null;
+        return counters.read();
+    }
+
+    /// The region's counts per iteration since perfStart
+    fn perfStop(self: *const Bench, start: ?perf.Reading, files: u64, bytes: u64) ?perf.Counts {
+        const before = start orelse return null;
+        return perf.Counts.between(before, self.counters.?.read(), self.config.iterations, files, bytes);
+    }
+};
+
+/// Memory at the start of a measured region; peaks restart from here
+fn memoryStart() c.MemorySnapshot {
+    c.Memory_reset_peaks();
+    var snapshot: c.MemorySnapshot = undefined;
+    c.Memory_snapshot(&snapshot);
+    return snapshot;
+}
+
+/// How far each tag rose above its start during the region
+fn memoryStop(start: c.MemorySnapshot) MemoryGrowth {
+    var end: c.MemorySnapshot = undefined;
+    c.Memory_snapshot(&end);
+    return .{
+        .listing = growthOf(start, end, c.MEMORY_LISTING),
+        .icon_cache = growthOf(start, end, c.MEMORY_ICON_CACHE),
+        .search_buffers = growthOf(start, end, c.MEMORY_SEARCH_BUFFERS),
+        .indexes = growthOf(start, end, c.MEMORY_INDEXES),
+        .results = growthOf(start, end, c.MEMORY_RESULTS),
+        .peak_rss = @intCast(@max(end.peak_rss, 0)),
+    };
+}
+
+fn growthOf(start: c.MemorySnapshot, end: c.MemorySnapshot, tag: usize) u64 {
+    return @intCast(@max(end.peak[tag] - start.current[tag], 0));
+}
+
+// What each suite may hold at most. A path that keeps more than one file's
+// contents alive, leaks listings or queues results it should not have
+// fails the run here instead of only getting slower.
+fn memoryCeiling(result: Result) MemoryCeiling {
+    const suite = result.suite;
+    if (std.mem.eql(u8, suite, "content_memory")) {
+        // Contents are loaded by the bench, the engine reads nothing
+        return .{ .search_buffers = 0, .results = 0 };
+    } else if (std.mem.eql(u8, suite, "content_files")) {
+        // At most the whole directory, each file once with its NUL
+        return .{ .search_buffers = result.bytes + result.files, .results = 0 };
+    } else if (std.mem.eql(u8, suite, "listing")) {
+        // About 60 bytes an entry for names, types, inodes and pointers and
+        // 40 for collation keys and ranks; twice that leaves room for
+        // longer names and other locales
+        return .{
+            .listing = 128 * result.files + 64 * 1024,
+            .indexes = 128 * result.files + 4096,
+            .search_buffers = 0,
+        };
+    } else if (std.mem.eql(u8, suite, "name_filter")) {
+        // Scans a listing loaded before the region
+        return .{ .listing = 0, .indexes = 0, .search_buffers = 0 };
+    } else if (std.mem.eql(u8, suite, "tree_walk")) {
+        // Nothing matches and the walk reads no contents or listings
+        return .{ .listing = 0, .search_buffers = 0, .results = 0 };
+    }
+    return .{};
+}
+
+fn checkCeiling(result: Result) !void {
+    const ceiling = memoryCeiling(result);
+    inline for (@typeInfo(MemoryCeiling).@"struct".fields) |field| {
+        if (@field(ceiling, field.name)) |limit| {
+            const held = @field(result.memory, field.name);
+            if (held > limit) {
+                std.debug.print("{s}: {s} grew by {d} bytes, ceiling {d}\n", .{ result.suite, field.name, held, limit });
+                return error.MemoryCeilingExceeded;
+            }
+        }
+    }
+}
+
+fn summarize(samples: []u64) Stats {
+    std.mem.sort(u64, samples, {}, std.sort.asc(u64));
+    var total: u128 = 0;
+    for (samples) |sample| total += sample;
+    return .{
+        .p50_ns = percentile(samples, 50),
+        .p90_ns = percentile(samples, 90),
+        .p99_ns = percentile(samples, 99),
+        .max_ns = samples[samples.len - 1],
+        .mean_ns = @intCast(total / samples.len),
+    };
+}
+
+// Nearest rank on sorted samples
+fn percentile(sorted: []const u64, p: u64) u64 {
+    const rank = (p * sorted.len + 99) / 100;
+    return sorted[@max(rank, 1) - 1];
+}
+
+fn perSecond(amount: u64, ns: u64) f64 {
+    if (ns == 0) return 0;
+    return @as(f64, @floatFromInt(amount)) * 1e9 / @as(f64, @floatFromInt(ns));
+}
+
+// ==========================================
+// Corpora
+// ==========================================
+
+// count files of size bytes in one directory; a hit_rate share of them
+// hold the needle in the middle
+fn makeFlatCorpus(bench: *Bench, path: []const u8, count: usize, size: usize, hit_rate: f64) !corpus.Corpus {
+    const hits: usize = @intFromFloat(@round(@as(f64, @floatFromInt(count)) * hit_rate));
+    const needles = [_]corpus.Needle{.{ .text = bench.needle[0..@min(max_pattern_len, size)], .files = hits }};
+    return corpus.generate(bench.allocator, path, .{
+        .seed = seed ^ count ^ (size << 20),
+        .files = count,
+        .sizes = .{ .fixed = size },
+        .needles = if (hits > 0) &needles else &.{},
+    });
+}
+
+// Directories below the root of a fanout^depth tree
+fn treeDirs(fanout: usize, depth: usize) usize {
+    var total: usize = 0;
+    var level: usize = 1;
+    for (0..depth) |_| {
+        level *= fanout;
+        total += level;
+    }
+    return total;
+}
+
+// ==========================================
+// Suites
+// ==========================================
+
+const ContentShape = struct { count: usize, size: usize };
+
+fn contentShapes(scale: Scale) []const ContentShape {
+    return switch (scale) {
+        .quick => &.{
+            .{ .count = 100, .size = 1024 },
+            .{ .count = 100, .size = 64 * 1024 },
+        },
+        .default => &.{
+            .{ .count = 1000, .size = 1024 },
+            .{ .count = 1000, .size = 64 * 1024 },
+            .{ .count = 100, .size = 1024 * 1024 },
+            .{ .count = 2, .size = 64 * 1024 * 1024 },
+        },
+        .full => &.{
+            .{ .count = 1000, .size = 1024 },
+            .{ .count = 100_000, .size = 1024 },
+            .{ .count = 1000, .size = 64 * 1024 },
+            .{ .count = 1000, .size = 1024 * 1024 },
+            .{ .count = 1, .size = 1024 * 1024 * 1024 },
+        },
+    };
+}
+
+const pattern_lens = [_]u32{ 1, 16, 256, 1024 };
+const hit_rates = [_]f64{ 0, 0.01, 1 };
+
+// Content search two ways: counting over contents already in memory (the
+// scan itself), and the directory search path end to end (reads plus the
+// batch kernel, on the GPU or its host fallback)
+fn benchContent(bench: *Bench) !void {
+    const allocator = bench.allocator;
+    const samples = try allocator.alloc(u64, bench.config.iterations);
+    defer allocator.free(samples);
+
+    for (contentShapes(bench.config.scale)) |shape| {
+        for (hit_rates) |hit_rate| {
+            const path = try std.fmt.allocPrint(allocator, "{s}/content_{d}_{d}_{d}", .{ bench.config.dir, shape.count, shape.size, @as(u32, @intFromFloat(hit_rate * 100)) });
+            defer allocator.free(path);
+            var files = try makeFlatCorpus(bench, path, shape.count, shape.size, hit_rate);
+            defer files.deinit();
+            defer files.remove();
+
+            // Load once for the in-memory scan
+            var contents = std.ArrayList([]u8).init(allocator);
+            defer {
+                for (contents.items) |item| allocator.free(item);
+                contents.deinit();
+            }
+            var dir = try std.fs.cwd().openDir(path, .{});
+            defer dir.close();
+            for (files.files.items) |name| {
+                try contents.append(try dir.readFileAlloc(allocator, name, std.math.maxInt(usize)));
+            }
+
+            const total_bytes = files.bytes;
+            const path_z = try allocator.dupeZ(u8, path);
+            defer allocator.free(path_z);
+
+            for (pattern_lens) |pattern_len| {
+                if (pattern_len > shape.size) continue;
+                const pattern_z = try allocator.dupeZ(u8, bench.needle[0..pattern_len]);
+                defer allocator.free(pattern_z);
+
+                var memory = memoryStart();
+                var region = bench.perfStart();
+                for (samples) |*sample| {
+                    var timer = try std.time.Timer.start();
+                    var found: u64 = 0;
+                    for (contents.items) |item| {
+                        found += c.ContentSearch_count(item.ptr, item.len, pattern_z.ptr, pattern_len);
+                    }
+                    sample.* = timer.read();
+                    std.mem.doNotOptimizeAway(found);
+                }
+                var counts = bench.perfStop(region, shape.count, total_bytes);
+                var growth = memoryStop(memory);
+                var stats = summarize(samples);
+                try bench.record(.{
+                    .suite = "content_memory",
+                    .backend = "cpu",
+                    .files = shape.count,
+                    .bytes = total_bytes,
+                    .pattern_len = pattern_len,
+                    .hit_rate = hit_rate,
+                    .iterations = bench.config.iterations,
+                    .stats = stats,
+                    .gb_per_s = perSecond(total_bytes, stats.p50_ns) / 1e9,
+                    .files_per_s = perSecond(shape.count, stats.p50_ns),
+                    .perf = counts,
+                    .memory = growth,
+                });
+
+                memory = memoryStart();
+                region = bench.perfStart();
+                for (samples) |*sample| {
+                    var timer = try std.time.Timer.start();
+                    const found = c.cuda_search_files(pattern_z.ptr, path_z.ptr);
+                    sample.* = timer.read();
+                    std.mem.doNotOptimizeAway(found);
+                }
+                counts = bench.perfStop(region, shape.count, total_bytes);
+                growth = memoryStop(memory);
+                stats = summarize(samples);
+                try bench.record(.{
+                    .suite = "content_files",
+                    .backend = if (build_options.cuda) "cuda" else "cpu",
+                    .files = shape.count,
+                    .bytes = total_bytes,
+                    .pattern_len = pattern_len,
+                    .hit_rate = hit_rate,
+                    .iterations = bench.config.iterations,
+                    .stats = stats,
+                    .gb_per_s = perSecond(total_bytes, stats.p50_ns) / 1e9,
+                    .files_per_s = perSecond(shape.count, stats.p50_ns),
+                    .perf = counts,
+                    .memory = growth,
+                });
+            }
+        }
+    }
+}
+
+fn entryCounts(scale: Scale) []const usize {
+    return switch (scale) {
+        .quick => &.{ 100, 1000 },
+        .default => &.{ 100, 1000, 10_000, 100_000 },
+        .full => &.{ 100, 1000, 10_000, 100_000, 1_000_000 },
+    };
+}
+
+// What opening a folder costs the view: read, type, and sort by name;
+// then narrowing it down by name as the filter box does
+fn benchListing(bench: *Bench) !void {
+    const allocator = bench.allocator;
+    const samples = try allocator.alloc(u64, bench.config.iterations);
+    defer allocator.free(samples);
+
+    for (entryCounts(bench.config.scale)) |count| {
+        const path = try std.fmt.allocPrint(allocator, "{s}/listing_{d}", .{ bench.config.dir, count });
+        defer allocator.free(path);
+        // Empty files only: listing costs per entry, not per byte
+        var files = try corpus.generate(allocator, path, .{ .seed = seed ^ count, .files = count, .sizes = .{ .fixed = 0 } });
+        defer files.deinit();
+        defer files.remove();
+        const path_z = try allocator.dupeZ(u8, path);
+        defer allocator.free(path_z);
+
+        const spec = c.SortSpec{ .key = c.SORT_BY_NAME, .descending = 0, .directories_first = 1 };
+        var memory = memoryStart();
+        var region = bench.perfStart();
+        for (samples) |*sample| {
+            var timer = try std.time.Timer.start();
+            const listing = c.DirListing_load(path_z.ptr) orelse return error.ListingFailed;
+            const order = c.DirListing_sort(listing, &spec);
+            sample.* = timer.read();
+            c.g_free(order);
+            c.DirListing_unref(listing);
+        }
+        var counts = bench.perfStop(region, count, 0);
+        var growth = memoryStop(memory);
+        var stats = summarize(samples);
+        try bench.record(.{
+            .suite = "listing",
+            .backend = "cpu",
+            .files = count,
+            .bytes = 0,
+            .pattern_len = 0,
+            .hit_rate = 0,
+            .iterations = bench.config.iterations,
+            .stats = stats,
+            .gb_per_s = 0,
+            .files_per_s = perSecond(count, stats.p50_ns),
+            .perf = counts,
+            .memory = growth,
+        });
+
+        // "f9" matches about a tenth of the names
+        const listing = c.DirListing_load(path_z.ptr) orelse return error.ListingFailed;
+        defer c.DirListing_unref(listing);
+        const names = listing.*.names;
+        const name_count: usize = @intCast(listing.*.count);
+        memory = memoryStart();
+        region = bench.perfStart();
+        for (samples) |*sample| {
+            var timer = try std.time.Timer.start();
+            var matches: usize = 0;
+            for (0..name_count) |i| {
+                if (c.Query_text_contains(names[i], "f9", 1) != 0) matches += 1;
+            }
+            sample.* = timer.read();
+            std.mem.doNotOptimizeAway(matches);
+        }
+        counts = bench.perfStop(region, count, 0);
+        growth = memoryStop(memory);
+        stats = summarize(samples);
+        try bench.record(.{
+            .suite = "name_filter",
+            .backend = "cpu",
+            .files = count,
+            .bytes = 0,
+            .pattern_len = 2,
+            .hit_rate = 0.1,
+            .iterations = bench.config.iterations,
+            .stats = stats,
+            .gb_per_s = 0,
+            .files_per_s = perSecond(count, stats.p50_ns),
+            .perf = counts,
+            .memory = growth,
+        });
+    }
+}
+
+const TreeShape = struct { fanout: usize, depth: usize, files: usize };
+
+fn treeShapes(scale: Scale) []const TreeShape {
+    return switch (scale) {
+        .quick => &.{.{ .fanout = 4, .depth = 2, .files = 10 }},
+        .default => &.{
+            .{ .fanout = 8, .depth = 3, .files = 20 },
+            .{ .fanout = 2, .depth = 10, .files = 5 },
+        },
+        .full => &.{
+            .{ .fanout = 8, .depth = 3, .files = 20 },
+            .{ .fanout = 2, .depth = 10, .files = 5 },
+            .{ .fanout = 10, .depth = 4, .files = 100 },
+        },
+    };
+}
+
+fn onTreeMatches(matches: [*c]const c.TreeMatch, count: c.guint, finished: c.gboolean, user_data: ?*anyopaque) callconv(.C) void {
+    _ = matches;
+    _ = count;
+    const done: *bool = @ptrCast(@alignCast(user_data));
+    if (finished != 0) done.* = true;
+}
+
+// The recursive name search with a pattern nothing matches, so every
+// entry is walked and tested
+fn benchWalk(bench: *Bench) !void {
+    const allocator = bench.allocator;
+    const samples = try allocator.alloc(u64, bench.config.iterations);
+    defer allocator.free(samples);
+
+    for (treeShapes(bench.config.scale)) |shape| {
+        const path = try std.fmt.allocPrint(allocator, "{s}/tree_{d}_{d}_{d}", .{ bench.config.dir, shape.fanout, shape.depth, shape.files });
+        defer allocator.free(path);
+        // shape.files empty files in every directory, the root included
+        var files = try corpus.generate(allocator, path, .{
+            .seed = seed ^ shape.fanout ^ (shape.depth << 8),
+            .files = shape.files * (treeDirs(shape.fanout, shape.depth) + 1),
+            .layout = .{ .tree = .{ .fanout = shape.fanout, .depth = shape.depth } },
+            .sizes = .{ .fixed = 0 },
+        });
+        defer files.deinit();
+        defer files.remove();
+        const path_z = try allocator.dupeZ(u8, path);
+        defer allocator.free(path_z);
+        const entries: u64 = files.files.items.len + files.dirs.items.len;
+
+        const memory = memoryStart();
+        const region = bench.perfStart();
+        for (samples) |*sample| {
+            var done = false;
+            var timer = try std.time.Timer.start();
+            const search = c.TreeSearch_start(path_z.ptr, c.Query_parse("no-such-name", c.QUERY_DEFAULT), c.TREE_WALK_DEFAULT, "", 0, null, onTreeMatches, &done);
+            while (!done) _ = c.g_main_context_iteration(null, 1);
+            sample.* = timer.read();
+            c.TreeSearch_stop(search);
+        }
+        const counts = bench.perfStop(region, entries, 0);
+        const growth = memoryStop(memory);
+        const stats = summarize(samples);
+        try bench.record(.{
+            .suite = "tree_walk",
+            .backend = "cpu",
+            .files = entries,
+            .bytes = 0,
+            .pattern_len = 12,
+            .hit_rate = 0,
+            .iterations = bench.config.iterations,
+            .stats = stats,
+            .gb_per_s = 0,
+            .files_per_s = perSecond(entries, stats.p50_ns),
+            .perf = counts,
+            .memory = growth,
+        });
+    }
+}
+
+// ==========================================
+// Driver
+// ==========================================
+
+fn parseArgs(args: []const []const u8) !Config {
+    var config = Config{};
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "--quick")) {
+            config.scale = .quick;
+            config.iterations = 3;
+        } else if (std.mem.eql(u8, arg, "--full")) {
+            config.scale = .full;
+        } else if (std.mem.eql(u8, arg, "--perf")) {
+            config.perf = true;
+        } else if (std.mem.eql(u8, arg, "--json") and i + 1 < args.len) {
+            i += 1;
+            config.json_path = args[i];
+        } else if (std.mem.eql(u8, arg, "--dir") and i + 1 < args.len) {
+            i += 1;
+            config.dir = args[i];
+        } else if (std.mem.eql(u8, arg, "--iterations") and i + 1 < args.len) {
+            i += 1;
+            config.iterations = @max(1, try std.fmt.parseInt(u32, args[i], 10));
+        } else {
+            std.debug.print("Usage: bench [--quick|--full] [--iterations N] [--perf] [--dir SCRATCH] [--json OUT]\n", .{});
+            return error.InvalidArguments;
+        }
+    }
+    return config;
+}
+
+fn writeJson(bench: *Bench, writer: anytype) !void {
+    try std.json.stringify(.{
+        .seed = seed,
+        .scale = @tagName(bench.config.scale),
+        .cuda = build_options.cuda,
+        .cpus = std.Thread.getCpuCount() catch 0,
+        // Whether the perf counts include kernel mode, null without them
+        .perf_kernel = if (bench.counters) |counters| counters.kernel else null,
+        .results = bench.results.items,
+    }, .{ .whitespace = .indent_2 }, writer);
+    try writer.writeByte('\n');
+}
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    const config = try parseArgs(args);
+
+    var bench = Bench{
+        .allocator = allocator,
+        .config = config,
+        .results = std.ArrayList(Result).init(allocator),
+        .needle = undefined,
+    };
+    defer bench.results.deinit();
+
+    // Before any engine call: worker threads started later inherit them
+    if (config.perf) {
+        const counters = perf.Counters.open();
+        if (counters.available()) {
+            bench.counters = counters;
+        } else {
+            std.debug.print("perf counters unavailable, running without them\n", .{});
+        }
+    }
+    defer if (bench.counters) |*counters| counters.close();
+
+    // Uppercase, so it cannot occur in the lowercase filler by chance
+    var prng = std.Random.DefaultPrng.init(seed);
+    for (&bench.needle) |*byte| byte.* = prng.random().intRangeAtMost(u8, 'A', 'Z');
+
+    try std.fs.cwd().makePath(config.dir);
+    try benchContent(&bench);
+    try benchListing(&bench);
+    try benchWalk(&bench);
+
+    if (config.json_path) |path| {
+        const file = try std.fs.cwd().createFile(path, .{});
+        defer file.close();
+        try writeJson(&bench, file.writer());
+        std.debug.print("Results written to {s}\n", .{path});
+    } else {
+        try writeJson(&bench, std.io.getStdOut().writer());
+    }
+}
@@ -0,0 +1,155 @@
+//! Hardware performance counters around the benchmark regions, through
+//! perf_event_open. The counters are opened once, before the engine has
+//! started any worker thread, with inherit set: the pool threads it starts
+//! later count too. A region's counts are the difference of two readings.
+//!
+//! Where the kernel refuses (no PMU in a VM, perf_event_paranoid, seccomp)
+//! the affected counters are simply missing; the bench runs either way.
+
+const std = @import("std");
+const linux = std.os.linux;
+const PERF = linux.PERF;
+
+// read_format bits: how long the counter was enabled and actually on the
+// PMU, to scale counts that were multiplexed
+const format_total_time_enabled: u64 = 1 << 0;
+const format_total_time_running: u64 = 1 << 1;
+
+const Spec = struct { type: PERF.TYPE, config: u64 };
+
+// In Counts field order
+const specs = [_]Spec{
+    .{ .type = .HARDWARE, .config = @intFromEnum(PERF.COUNT.HW.CPU_CYCLES) },
+    .{ .type = .HARDWARE, .config = @intFromEnum(PERF.COUNT.HW.INSTRUCTIONS) },
+    // The generic cache miss event is the last level cache on x86 and Arm
+    .{ .type = .HARDWARE, .config = @intFromEnum(PERF.COUNT.HW.CACHE_MISSES) },
+    .{ .type = .HARDWARE, .config = @intFromEnum(PERF.COUNT.HW.BRANCH_MISSES) },
+    .{ .type = .SOFTWARE, .config = @intFromEnum(PERF.COUNT.SW.PAGE_FAULTS) },
+};
+
+/// Cumulative counts at one point in time, scaled for multiplexing
+pub const Reading = struct {
+    values: [specs.len]?u64,
+};
+
+/// A region's counts per iteration, and what they say together
+pub const Counts = struct {
+    cycles: ?u64 = null,
+    instructions: ?u64 = null,
+    llc_misses: ?u64 = null,
+    branch_misses: ?u64 = null,
+    page_faults: ?u64 = null,
+    /// Instructions per cycle
+    ipc: ?f64 = null,
+    /// Bytes searched per cycle, for regions that read bytes
+    bytes_per_cycle: ?f64 = null,
+    /// Cycles per file or entry
+    cycles_per_file: ?f64 = null,
+
+    /// Counts between two readings of a region that ran iterations times
+    /// over files files and bytes bytes
+    pub fn between(start: Reading, end: Reading, iterations: u32, files: u64, bytes: u64) Counts {
+        var per_iteration: [specs.len]?u64 = undefined;
+        for (&per_iteration, start.values, end.values) |*slot, before, after| {
+            slot.* = if (before != null and after != null)
+                (after.? -| before.?) / iterations
+            else
+                null;
+        }
+
+        var counts = Counts{
+            .cycles = per_iteration[0],
+            .instructions = per_iteration[1],
+            .llc_misses = per_iteration[2],
+            .branch_misses = per_iteration[3],
+            .page_faults = per_iteration[4],
+        };
+        if (counts.cycles) |cycles| {
+            if (cycles == 0) return counts;
+            const cycles_f: f64 = @floatFromInt(cycles);
+            if (counts.instructions) |instructions| {
+                counts.ipc = @as(f64, @floatFromInt(instructions)) / cycles_f;
+            }
+            if (bytes > 0) counts.bytes_per_cycle = @as(f64, @floatFromInt(bytes)) / cycles_f;
+            if (files > 0) counts.cycles_per_file = cycles_f / @as(f64, @floatFromInt(files));
+        }
+        return counts;
+    }
+};
+
+pub const Counters = struct {
+    fds: [specs.len]?std.posix.fd_t,
+    /// Kernel mode is counted too, so the read path's syscalls show up
+    kernel: bool,
+
+    /// Open every counter for this process and the threads it starts from
+    /// now on. Kernel mode is dropped if the kernel only allows user mode.
+    pub fn open() Counters {
+        var counters = openAll(true);
+        if (counters.fds[0] == null) {
+            counters.close();
+            counters = openAll(false);
+        }
+        return counters;
+    }
+
+    pub fn close(self: *Counters) void {
+        for (&self.fds) |*fd| {
+            if (fd.*) |open_fd| std.posix.close(open_fd);
+            fd.* = null;
+        }
+    }
+
+    /// Whether any counter could be opened
+    pub fn available(self: *const Counters) bool {
+        for (self.fds) |fd| {
+            if (fd != null) return true;
+        }
+        return false;
+    }
+
+    pub fn read(self: *const Counters) Reading {
+        var reading = Reading{ .values = undefined };
+        for (&reading.values, self.fds) |*value, fd| {
+            value.* = if (fd) |open_fd| readScaled(open_fd) else null;
+        }
+        return reading;
+    }
+
+    fn openAll(kernel: bool) Counters {
+        var counters = Counters{ .fds = undefined, .kernel = kernel };
+        for (&counters.fds, specs) |*fd, spec| {
+            fd.* = openEvent(spec, kernel) catch null;
+        }
+        return counters;
+    }
+};
+
+fn openEvent(spec: Spec, kernel: bool) !std.posix.fd_t {
+    var attr = linux.perf_event_attr{
+        .type = spec.type,
+        .config = spec.config,
+        .read_format = format_total_time_enabled | format_total_time_running,
+        .flags = .{
+            .inherit = true,
+            .exclude_kernel = !kernel,
+            .exclude_hv = true,
+        },
+    };
+    return std.posix.perf_event_open(&attr, 0, -1, -1, PERF.FLAG.FD_CLOEXEC);
+}
+
+// value * enabled / running: an estimate for the time the counter spent
+// waiting for a free PMU slot
+fn readScaled(fd: std.posix.fd_t) ?u64 {
+    var buf: [3]u64 = undefined;
+    const n = std.posix.read(fd, std.mem.asBytes(&buf)) catch return null;
+    if (n != @sizeOf(@TypeOf(buf))) return null;
+
+    const value = buf[0];
+    const enabled = buf[1];
+    const running = buf[2];
+    if (running == 0) return 0;
+    if (running >= enabled) return value;
+    return @intCast(@as(u128, value) * enabled / running);
+}
@@ -6,13 +6,22 @@ pub fn build(b: *std.Build) !void {
     const target = b.standardTargetOptions(.{});
     const optimize = b.standardOptimizeOption(.{});
 
+    // Trace spans are compiled in unless -Dtrace=false; even then they
+    // record only when CILE_TRACE or --trace asks for a trace file
+    const trace = b.option(bool, "trace", "Compile in trace spans (default: true)") orelse true;
+
     // Compiler flags
-    const cflags = &.{
+    const base_cflags = [_][]const u8{
         "-std=c99",    "-gen-cdb-fragment-path",   "compile_commands",    "-Wall",               "-W",              "-g",                              "-O2",
         "-ffast-math", "-fstack-protector-strong", "-D_FORTIFY_SOURCE=2", "-Wstrict-prototypes", "-Wwrite-strings", "-Wno-missing-field-initializers", "-fno-omit-frame-pointer",
     };
+    const cflags: []const []const u8 = if (trace) &base_cflags else &(base_cflags ++ [_][]const u8{"-DCILE_TRACE=0"});
     const gtkflags = try getPkgConfigFlags(b);
 
+    // Machines without a GPU build with -Dcuda=false: a host implementation
+    // of the search kernel replaces the nvcc object and CUDA is not linked
+    const cuda = b.option(bool, "cuda", "Build the CUDA search kernel (default: true)") orelse true;
+
     // Get CUDA paths from environment (set by Nix)
     const cuda_include = std.process.getEnvVarOwned(b.allocator, "NIX_CUDA_INCLUDE_PATH") catch blk: {
         std.debug.print("Warning: NIX_CUDA_INCLUDE_PATH not set, using fallback\n", .{});
@@ -74,13 +83,20 @@ pub fn build(b: *std.Build) !void {
     }
 
     // Add CUDA object file to library
-    cLib.step.dependOn(&cuda_step.step);
-    cLib.addObjectFile(.{ .cwd_relative = ".zig-cache/cuda/search_kernel.o" });
+    if (cuda) {
+        cLib.step.dependOn(&cuda_step.step);
+        cLib.addObjectFile(.{ .cwd_relative = ".zig-cache/cuda/search_kernel.o" });
+    } else {
+        cLib.addCSourceFile(.{
+            .file = .{ .cwd_relative = "src/SearchKernelCpu.c" },
+            .flags = cflags,
+        });
+    }
 
     // Add source files to library
     cLib.addCSourceFiles(.{
         .flags = cflags,
-        .files = &.{ "src/Search.c", "src/Pages/Sidebar.c", "src/Pages/MainPage.c", "src/Pages/Topbar.c" },
+        .files = &.{ "src/Search.c", "src/SearchStats.c", "src/DirReader.c", "src/Listing.c", "src/DirCache.c", "src/Prefetch.c", "src/Sort.c", "src/ResultStream.c", "src/ContentSearch.c", "src/IgnoreRules.c", "src/Query.c", "src/TreeWalk.c", "src/TreeSearch.c", "src/DiskUsage.c", "src/Hash64.c", "src/Duplicates.c", "src/Trace.c", "src/Metrics.c", "src/Memory.c", "src/Budget.c", "src/Cgroup.c", "src/Scheduler.c", "src/Cli.c", "src/Pages/Sidebar.c", "src/Pages/MainPage.c", "src/Pages/Topbar.c" },
     });
 
     // Create the executable
@@ -112,14 +128,7 @@ pub fn build(b: *std.Build) !void {
     Explorer.linkSystemLibrary("gtk+-3.0");
     
     // Add CUDA library path and link CUDA libraries
-    var it = std.mem.splitScalar(u8, cuda_lib, ':');
-    while (it.next()) |lib_path| {
-        if (lib_path.len > 0) {
-            Explorer.addLibraryPath(.{ .cwd_relative = lib_path });
-        }
-    }
-    Explorer.linkSystemLibrary("cudart");
-    Explorer.linkSystemLibrary("cuda");
+    if (cuda) linkCuda(Explorer, cuda_lib);
 
     // Install artifact
     b.installArtifact(Explorer);
@@ -129,12 +138,18 @@ pub fn build(b: *std.Build) !void {
     const run_exe = b.addRunArtifact(Explorer);
     run_step.dependOn(&run_exe.step);
 
+    // Seeded synthetic file trees, shared by the tests and the bench
+    const corpus = b.createModule(.{
+        .root_source_file = .{ .cwd_relative = "tests/corpus.zig" },
+    });
+
     // Test Step
     const test_step = b.step("test", "Run unit tests");
     const unit_tests = b.addTest(.{
         .root_source_file = .{ .cwd_relative = "tests/main_test.zig" },
         .target = target,
     });
+    unit_tests.root_module.addImport("corpus", corpus);
     
     unit_tests.linkLibC();
     unit_tests.addIncludePath(.{ .cwd_relative = "include" });
@@ -149,22 +164,59 @@ pub fn build(b: *std.Build) !void {
     unit_tests.linkSystemLibrary("gtk+-3.0");
     
     // Add CUDA to tests
-    it = std.mem.splitScalar(u8, cuda_lib, ':');
-    while (it.next()) |lib_path| {
-        if (lib_path.len > 0) {
-            unit_tests.addLibraryPath(.{ .cwd_relative = lib_path });
-        }
-    }
-    unit_tests.linkSystemLibrary("cudart");
-    unit_tests.linkSystemLibrary("cuda");
+    if (cuda) linkCuda(unit_tests, cuda_lib);
 
     const run_unit_tests = b.addRunArtifact(unit_tests);
     test_step.dependOn(&run_unit_tests.step);
 
+    // Bench Step: zig build bench [-Dcuda=false] [-- --full --json out.json]
+    const bench_step = b.step("bench", "Run the benchmark suite");
+    const bench = b.addExecutable(.{
+        .name = "bench",
+        .root_source_file = .{ .cwd_relative = "bench/bench.zig" },
+        .target = target,
+        // The harness itself must not be what gets measured
+        .optimize = .ReleaseFast,
+    });
+
+    const bench_options = b.addOptions();
+    bench_options.addOption(bool, "cuda", cuda);
+    bench.root_module.addOptions("build_options", bench_options);
+    bench.root_module.addImport("corpus", corpus);
+
+    bench.linkLibC();
+    bench.addIncludePath(.{ .cwd_relative = "include" });
+
+    for (gtkflags) |gtk| {
+        if (std.mem.startsWith(u8, gtk, "-I")) {
+            bench.addIncludePath(.{ .cwd_relative = gtk[2..] });
+        }
+    }
+
+    // Only the engine is benchmarked: GIO is enough, no GTK or display
+    bench.linkLibrary(cLib);
+    bench.linkSystemLibrary("gio-2.0");
+    if (cuda) linkCuda(bench, cuda_lib);
+
+    const run_bench = b.addRunArtifact(bench);
+    if (b.args) |args| run_bench.addArgs(args);
+    bench_step.dependOn(&run_bench.step);
+
     // Add compile commands generation
     AddCompileCommandStep(b, cLib);
 }
 
+fn linkCuda(compile: *std.Build.Step.Compile, cuda_lib: []const u8) void {
+    var it = std.mem.splitScalar(u8, cuda_lib, ':');
+    while (it.next()) |lib_path| {
+        if (lib_path.len > 0) {
+            compile.addLibraryPath(.{ .cwd_relative = lib_path });
+        }
+    }
+    compile.linkSystemLibrary("cudart");
+    compile.linkSystemLibrary("cuda");
+}
+
 fn AddCompileCommandStep(b: *std.Build, lib: *std.Build.Step.Compile) void {
     var targets_files = std.ArrayList(*std.Build.Step.Compile).init(b.allocator);
     defer targets_files.deinit();
@@ -0,0 +1,115 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Overrides the limit, in megabytes
+#define BUDGET_ENV "CILE_MEMORY_MB"
+
+// Without it the limit is 1/N of physical memory or of the cgroup's
+// memory limit, whichever is lower; the rest is left to GTK, the heap's
+// slack and other processes
+#define BUDGET_SHARE 4
+
+/**
+ * Asks a cache to give memory back; called on the main loop
+ * @param bytes Bytes wanted
+ * @param user_data Data given to Budget_add_reclaimer
+ * @return Bytes the cache released with Budget_charge_cache
+ */
+typedef gsize (*BudgetReclaimFunc)(gsize bytes, gpointer user_data);
+
+/**
+ * What the budget holds at one point in time
+ */
+typedef struct {
+  gsize limit;     // Bytes in-flight buffers and caches may hold together
+  gsize in_flight; // Held by buffers being read or searched
+  gsize cached;    // Held by caches
+  guint waiting;   // Readers waiting for memory
+} BudgetSnapshot;
+
+/**
+ * Take memory for a buffer, waiting until in-flight buffers and caches
+ * leave room for it (any thread). Waiters are served in arrival order and
+ * caches are asked to evict while one waits. When no other buffer is in
+ * flight the request is granted even beyond the limit, so a single file
+ * larger than the budget still gets read. A thread that already holds
+ * memory must use Budget_try_acquire instead, or it can wait on itself.
+ * @param bytes Bytes about to be allocated
+ */
+extern void Budget_acquire(gsize bytes);
+
+/**
+ * Take memory for a buffer if it fits now, without waiting (any thread).
+ * A refusal asks the caches to evict, as a wait would.
+ * @param bytes Bytes about to be allocated
+ * @return TRUE if granted; release it with Budget_release
+ */
+extern gboolean Budget_try_acquire(gsize bytes);
+
+/**
+ * Give back memory taken with Budget_acquire or Budget_try_acquire (any
+ * thread)
+ * @param bytes Bytes freed
+ */
+extern void Budget_release(gsize bytes);
+
+/**
+ * Account memory held by a cache (any thread). Caches never wait; when
+ * they push the total over the limit, reclaimers are asked to evict.
+ * @param bytes Bytes added, negative when evicted
+ */
+extern void Budget_charge_cache(gint64 bytes);
+
+/**
+ * Register a cache that can evict under pressure
+ * @param func Reclaim callback, called on the main loop
+ * @param user_data Data passed to func
+ */
+extern void Budget_add_reclaimer(BudgetReclaimFunc func, gpointer user_data);
+
+/**
+ * Unregister a cache (main thread)
+ * @param func Callback given to Budget_add_reclaimer
+ * @param user_data Data given with it
+ */
+extern void Budget_remove_reclaimer(BudgetReclaimFunc func,
+                                    gpointer user_data);
+
+/**
+ * Ask every cache to evict, in registration order, until bytes are freed
+ * (main thread)
+ * @param bytes Bytes wanted
+ * @return Bytes freed
+ */
+extern gsize Budget_reclaim(gsize bytes);
+
+/**
+ * Change the limit and wake readers that now fit (any thread)
+ * @param bytes New limit, or 0 for the default from BUDGET_ENV, the
+ * cgroup limit and physical memory
+ */
+extern void Budget_set_limit(gsize bytes);
+
+/**
+ * Read the budget
+ * @param snapshot Output
+ */
+extern void Budget_snapshot(BudgetSnapshot *snapshot);
+
+/**
+ * Follow GMemoryMonitor's low memory warnings (main thread, once): each
+ * one re-reads the cgroup limit, asks caches to evict a share of what
+ * they hold that grows with the warning level, and returns free heap
+ * pages to the system
+ */
+extern void Budget_watch_memory_monitor(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // BUDGET_H
@@ -0,0 +1,29 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Lowest memory limit on the way from the process's cgroup up to the root
+ * of its hierarchy: memory.max and memory.high on cgroup v2,
+ * memory.limit_in_bytes on v1. A parent's limit caps its children too.
+ * @return Bytes, or G_MAXUINT64 if there is no limit or no cgroup
+ */
+extern guint64 Cgroup_memory_limit(void);
+
+/**
+ * CPUs the process's cgroups let it use: the lowest quota over period on
+ * the way up, from cpu.max on cgroup v2, cpu.cfs_quota_us and
+ * cpu.cfs_period_us on v1. CPU affinity is not considered here;
+ * g_get_num_processors() already follows it.
+ * @return CPUs, possibly fractional, or 0 if there is no quota
+ */
+extern gdouble Cgroup_cpu_quota(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // CGROUP_H
@@ -0,0 +1,43 @@
+#ifndef CLI_H
+#define CLI_H
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Exit codes, as grep uses them
+#define CLI_EXIT_MATCH 0    // Something was found (or listed)
+#define CLI_EXIT_NO_MATCH 1 // The search ran and found nothing
+#define CLI_EXIT_ERROR 2    // Bad arguments or an unreadable directory
+
+/**
+ * Whether the command line asks for a headless run (-s, --search,
+ * --search=PATTERN, -l or --list), checked before any GTK initialization
+ * @param argc Argument count
+ * @param argv Arguments
+ * @return TRUE to run Cli_main instead of the window
+ */
+extern gboolean Cli_is_headless(int argc, char **argv);
+
+/**
+ * Run a headless search or listing on the engine the window uses and
+ * print the results to stdout, one per line or as NDJSON (--json):
+ *
+ *   CileExplorer --search PATTERN [--recursive] [--content] [--json]
+ *                [--stats] DIR
+ *   CileExplorer --list [--json] DIR
+ *
+ * PATTERN uses the search box's query syntax. Results stream out as the
+ * search finds them; --stats then prints the search's SearchStats to
+ * stderr, as text or (with --json) one JSON object.
+ * @param argc Argument count
+ * @param argv Arguments
+ * @return CLI_EXIT_* status
+ */
+extern int Cli_main(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // CLI_H
@@ -0,0 +1,103 @@
+#ifndef CONTENT_SEARCH_H
+#define CONTENT_SEARCH_H
+#include "Listing.h"
+#include "ResultStream.h"
+#include "Scheduler.h"
+#include "SearchStats.h"
+#include <gio/gio.h>
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Matches handed to the main loop per callback, so one batch of row
+// updates fits in a frame
+#define CONTENT_SEARCH_BATCH 128
+
+// Files one worker task reads before taking the next task
+#define CONTENT_SEARCH_TASK_FILES 32
+
+typedef struct {
+  guint32 index; // Entry index in the searched listing
+  guint hits;    // Occurrences of the pattern in the file
+} ContentMatch;
+
+/**
+ * Receives matches on the main loop, in batches of up to
+ * CONTENT_SEARCH_BATCH
+ * @param matches Files containing the pattern (valid during the call)
+ * @param count Number of matches, may be 0 on the final call
+ * @param finished TRUE on the last call: every file has been searched
+ * @param user_data Data given to ContentSearch_start
+ */
+typedef void (*ContentSearchFunc)(const ContentMatch *matches, guint count,
+                                  gboolean finished, gpointer user_data);
+
+/**
+ * Searches the contents of a listing's files for a literal pattern as
+ * interactive tasks of the shared Scheduler, ahead of any tree walk or
+ * prefetch. Matches stream back to the main loop through a ResultStream,
+ * so the main thread never waits on file I/O or on a worker.
+ */
+typedef struct {
+  DirListing *listing;       // Files searched (names only, shared)
+  int dirfd;                 // Listing's directory, -1 if it cannot open
+  gchar *pattern;            // Literal, case-sensitive
+  gsize pattern_len;         // Length of pattern
+  guint32 *files;            // Entry indices to search
+  guint file_count;          // Length of files
+  SchedulerGroup *group;     // Its tasks; their token stops them
+  gint ref_count;            // Main thread, queued tasks, a running callback
+  ResultStream *stream;      // Matches on their way to the main loop
+  ContentSearchFunc func;    // Result callback
+  gpointer user_data;        // Callback data
+  gint64 started_at;         // Monotonic time it started, for the metrics
+  SearchStats stats;         // Complete when the last callback runs, except
+                             // for that callback's own UI time
+} ContentSearch;
+
+/**
+ * Start searching file contents. Returns immediately; matches arrive
+ * through func on the default main context.
+ * @param listing Directory listing the files belong to
+ * @param files Entry indices to search, or NULL for every regular file
+ * (and symlink) of the listing
+ * @param file_count Length of files
+ * @param pattern Literal text to count
+ * @param cancellable Token of the query, which stops the search too, or
+ * NULL; ContentSearch_stop leaves it alone
+ * @param func Result callback
+ * @param user_data Data passed to func
+ * @return New ContentSearch, stop it with ContentSearch_stop
+ */
+extern ContentSearch *ContentSearch_start(DirListing *listing,
+                                          const guint32 *files,
+                                          guint file_count,
+                                          const char *pattern,
+                                          GCancellable *cancellable,
+                                          ContentSearchFunc func,
+                                          gpointer user_data);
+
+/**
+ * Cancel a search if it is still running and release it. The callback is
+ * not called again; workers still reading a file finish in the background.
+ * @param search Search to stop (from the main thread)
+ */
+extern void ContentSearch_stop(ContentSearch *search);
+
+/**
+ * Count non-overlapping occurrences of a pattern
+ * @param text Text to search
+ * @param text_len Length of text
+ * @param pattern Pattern to count
+ * @param pattern_len Length of pattern (> 0)
+ * @return Number of occurrences
+ */
+extern guint ContentSearch_count(const char *text, gsize text_len,
+                                 const char *pattern, gsize pattern_len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // CONTENT_SEARCH_H
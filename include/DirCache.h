@@ -0,0 +1,147 @@
+#ifndef DIR_CACHE_H
+#define DIR_CACHE_H
+#include "Listing.h"
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default memory budget, overridable with CILE_DIR_CACHE_MB
+#define DIR_CACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+// Prefetched (not yet visited) listings may use at most 1/N of the budget
+#define DIR_CACHE_SPECULATIVE_SHARE 4
+
+// Window over which inotify events are merged into one update
+#define DIR_CACHE_COALESCE_MS 100
+
+/**
+ * One coalesced batch of changes applied to a cached directory
+ */
+typedef struct {
+  const char *path;
+  DirListing *listing; // Patched listing, NULL if the directory is gone
+  GPtrArray *changed;  // Names touched by the batch, NULL after a full reload
+  int first_changed;   // Entries from this index on are the re-stat'ed names
+} DirCacheUpdate;
+
+typedef void (*DirCacheUpdateFunc)(const DirCacheUpdate *update,
+                                   gpointer user_data);
+
+/**
+ * LRU cache of recent directory listings. Every cached directory carries an
+ * inotify watch; events are merged over a short window and applied to the
+ * cached listing by re-stat'ing only the touched names, so a hit is always
+ * current and costs no syscalls. Paths reaching the same directory (e.g.
+ * through a symlink) are cached separately and share its watch. Main
+ * thread only.
+ */
+typedef struct {
+  GHashTable *entries;     // path -> DirCacheEntry*
+  GHashTable *watches;     // inotify wd -> GPtrArray of DirCacheEntry*
+  GQueue lru;              // Most recently used at the head
+  gsize budget_bytes;      // Memory budget for cached listings
+  gsize used_bytes;        // Sum of cached listings' memory_bytes
+  gsize speculative_bytes; // Part of used_bytes held by prefetched listings
+  int inotify_fd;          // -1 when inotify is unavailable
+  guint inotify_source;    // Main loop source watching inotify_fd
+  guint flush_source;      // Pending coalescing timer, 0 if none
+  gchar *pinned_path;      // Never evicted (the directory on screen)
+  DirCacheUpdateFunc update_func;
+  gpointer update_data;
+  guint hits;
+  guint misses;
+  guint prefetch_hits; // Hits served by a prefetched listing
+} DirCache;
+
+/**
+ * Create a listing cache
+ * @param budget_bytes Memory budget, or 0 for the default/environment value
+ * @return New DirCache instance
+ */
+extern DirCache *DirCache_new(gsize budget_bytes);
+
+/**
+ * Destroy the cache, dropping all listings and watches
+ * @param cache DirCache to destroy
+ */
+extern void DirCache_destroy(DirCache *cache);
+
+/**
+ * Look up a cached listing and mark it most recently used
+ * @param cache DirCache instance
+ * @param path Directory path
+ * @return New reference to the listing, or NULL on miss
+ */
+extern DirListing *DirCache_lookup(DirCache *cache, const char *path);
+
+/**
+ * Check whether a directory is cached, without touching LRU order
+ * @param cache DirCache instance
+ * @param path Directory path
+ * @return TRUE if a valid listing is cached
+ */
+extern gboolean DirCache_contains(DirCache *cache, const char *path);
+
+/**
+ * Insert a listing (the cache takes its own reference). Listings that
+ * cannot be watched are not cached since they could go stale silently. The
+ * watch only starts here: if the directory changed since the listing was
+ * read (see DirListing_is_current), it is read again at the next flush and
+ * the update callback sees a full reload.
+ * @param cache DirCache instance
+ * @param listing Listing to cache
+ */
+extern void DirCache_insert(DirCache *cache, DirListing *listing);
+
+/**
+ * Insert a prefetched listing. It goes to the cold end of the LRU, only
+ * displaces other prefetched listings and is refused once prefetched
+ * listings would exceed 1/DIR_CACHE_SPECULATIVE_SHARE of the budget, so
+ * speculation never pushes out directories the user actually visited. The
+ * first lookup promotes it to a regular entry. A listing whose directory
+ * changed since it was read is refused.
+ * @param cache DirCache instance
+ * @param listing Listing to cache
+ * @return TRUE if the listing was cached
+ */
+extern gboolean DirCache_insert_speculative(DirCache *cache,
+                                            DirListing *listing);
+
+/**
+ * Drop a cached listing
+ * @param cache DirCache instance
+ * @param path Directory path
+ */
+extern void DirCache_invalidate(DirCache *cache, const char *path);
+
+/**
+ * Pin a directory so it is never evicted and always watched, even when its
+ * listing exceeds the budget (only one directory is pinned at a time)
+ * @param cache DirCache instance
+ * @param path Directory path, or NULL to unpin
+ */
+extern void DirCache_pin(DirCache *cache, const char *path);
+
+/**
+ * Set the callback invoked after a batch of changes was applied to the
+ * pinned directory
+ * @param cache DirCache instance
+ * @param func Callback, or NULL to stop notifications
+ * @param user_data Data to pass to callback
+ */
+extern void DirCache_set_update_func(DirCache *cache, DirCacheUpdateFunc func,
+                                     gpointer user_data);
+
+/**
+ * Change the memory budget, evicting least recently used listings to fit
+ * @param cache DirCache instance
+ * @param budget_bytes New budget in bytes
+ */
+extern void DirCache_set_budget(DirCache *cache, gsize budget_bytes);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // DIR_CACHE_H
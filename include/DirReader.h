@@ -0,0 +1,127 @@
+#ifndef DIR_READER_H
+#define DIR_READER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size of the getdents64 buffer; large enough to drain most directories in a
+// handful of syscalls
+#define DIR_READER_BUFFER_SIZE (256 * 1024)
+
+// Entry types, matching the kernel's DT_* values
+enum {
+  DIR_TYPE_UNKNOWN = 0,
+  DIR_TYPE_FIFO = 1,
+  DIR_TYPE_CHR = 2,
+  DIR_TYPE_DIR = 4,
+  DIR_TYPE_BLK = 6,
+  DIR_TYPE_REG = 8,
+  DIR_TYPE_LNK = 10,
+  DIR_TYPE_SOCK = 12,
+};
+
+typedef struct {
+  int fd;       // Directory fd, usable with the *at() family
+  char *buffer; // getdents64 buffer
+  size_t buffer_len;
+  size_t buffer_pos;
+  bool eof;
+} DirReader;
+
+typedef struct {
+  const char *name; // Points into the reader's buffer, valid until next call
+  size_t name_len;
+  uint64_t inode;
+  unsigned char type; // DIR_TYPE_*, may be DIR_TYPE_UNKNOWN
+} DirReaderEntry;
+
+typedef struct {
+  uint32_t mode;
+  uint32_t nlink;
+  uint64_t inode;
+  uint64_t device;
+  uint64_t size;
+  uint64_t blocks; // 512-byte blocks actually allocated
+  int64_t mtime_sec;
+  uint32_t mtime_nsec;
+} DirReaderStat;
+
+/**
+ * Open a directory for raw reading
+ * @param reader Reader to initialize
+ * @param dirpath Directory path to open
+ * @return true on success, false on error (errno is set)
+ */
+extern bool DirReader_open(DirReader *reader, const char *dirpath);
+
+/**
+ * Open a directory relative to another directory fd
+ * @param reader Reader to initialize
+ * @param parent_fd Directory fd to resolve name against (or AT_FDCWD)
+ * @param name Directory name relative to parent_fd
+ * @return true on success, false on error (errno is set)
+ */
+extern bool DirReader_open_at(DirReader *reader, int parent_fd,
+                              const char *name);
+
+/**
+ * Read the next entry, skipping "." and ".."
+ * @param reader Open reader
+ * @param entry Output entry, valid until the next call
+ * @return true if an entry was produced, false at end of directory or error
+ */
+extern bool DirReader_next(DirReader *reader, DirReaderEntry *entry);
+
+/**
+ * Stat an entry relative to the reader's directory fd
+ * @param reader Open reader
+ * @param name Entry name
+ * @param follow_links Whether to follow a trailing symlink
+ * @param out Output metadata
+ * @return true on success, false on error
+ */
+extern bool DirReader_stat(const DirReader *reader, const char *name,
+                           bool follow_links, DirReaderStat *out);
+
+/**
+ * Stat an entry relative to any directory fd
+ * @param dirfd Directory fd to resolve name against (or AT_FDCWD)
+ * @param name Entry name
+ * @param follow_links Whether to follow a trailing symlink
+ * @param out Output metadata
+ * @return true on success, false on error
+ */
+extern bool DirReader_stat_at(int dirfd, const char *name, bool follow_links,
+                              DirReaderStat *out);
+
+/**
+ * Resolve an entry's type, following symlinks, only stat'ing when the
+ * filesystem did not report a usable d_type
+ * @param reader Open reader
+ * @param entry Entry returned by DirReader_next
+ * @return DIR_TYPE_* of the entry (or its symlink target)
+ */
+extern unsigned char DirReader_resolve_type(const DirReader *reader,
+                                            const DirReaderEntry *entry);
+
+/**
+ * Convert a st_mode value into a DIR_TYPE_* value
+ * @param mode File mode bits
+ * @return Matching DIR_TYPE_* value
+ */
+extern unsigned char DirReader_type_from_mode(uint32_t mode);
+
+/**
+ * Close the reader and release its buffer
+ * @param reader Reader to close
+ */
+extern void DirReader_close(DirReader *reader);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // DIR_READER_H
@@ -0,0 +1,100 @@
+#ifndef DISK_USAGE_H
+#define DISK_USAGE_H
+#include "ResultStream.h"
+#include "Scheduler.h"
+#include <gio/gio.h>
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sizes handed to the main loop per callback
+#define DISK_USAGE_BATCH 128
+
+// Largest files and largest folders kept for the summary
+#define DISK_USAGE_TOP_K 20
+
+// Directory scans remembered across runs; the cache is emptied when full
+#define DISK_USAGE_CACHE_MAX 65536
+
+typedef struct {
+  const char *name;   // Entry of the scanned directory
+  guint64 bytes;      // Disk usage, recursive for folders
+  unsigned char type; // DIR_TYPE_*
+} DiskUsageSize;
+
+typedef struct {
+  gchar *path;   // Relative to the scanned directory
+  guint64 bytes; // Disk usage, recursive for folders
+} DiskUsageItem;
+
+/**
+ * Receives entry sizes on the main loop as they become known: files of the
+ * scanned directory as soon as they are stat'ed, folders once everything
+ * below them is counted
+ * @param sizes Measured entries (valid during the call)
+ * @param count Number of sizes, may be 0 on the final call
+ * @param finished TRUE on the last call: the totals and the largest
+ * entries are final
+ * @param user_data Data given to DiskUsage_start
+ */
+typedef void (*DiskUsageFunc)(const DiskUsageSize *sizes, guint count,
+                              gboolean finished, gpointer user_data);
+
+/**
+ * du-style disk usage of a directory tree. Every directory is one
+ * user-initiated task of the shared Scheduler and is stat'ed relative to
+ * its own fd; a folder's total is rolled up into its parent when its last
+ * subfolder finishes. Files with several links are counted once per
+ * scan, by device and inode. What a directory holds is cached under its
+ * mtime, so rescanning an unchanged folder only stats its directories.
+ */
+typedef struct {
+  int root_fd;                  // Scanned directory
+  gchar *root;                  // Its path, the prefix of cache keys
+  SchedulerGroup *group;        // Its tasks; their token stops the scan
+  gint ref_count;               // Caller plus the running scan
+  ResultStream *stream;         // Sizes on their way to the main loop
+  GMutex lock;                  // Guards the fields below and node totals
+  GHashTable *seen_links;       // (device, inode) of multi-link files
+  DiskUsageItem *largest_files; // Min-heap, then sorted largest first
+  guint largest_file_count;     // Used entries of largest_files
+  DiskUsageItem *largest_dirs;  // Same, for folders
+  guint largest_dir_count;      // Used entries of largest_dirs
+  guint64 total;                // Whole tree, once finished
+  DiskUsageFunc func;           // Result callback
+  gpointer user_data;           // Callback data
+} DiskUsage;
+
+/**
+ * Start measuring a directory tree. Returns immediately.
+ * @param root Directory to measure
+ * @param func Result callback
+ * @param user_data Data passed to func
+ * @return New DiskUsage, stop it with DiskUsage_stop
+ */
+extern DiskUsage *DiskUsage_start(const char *root, DiskUsageFunc func,
+                                  gpointer user_data);
+
+/**
+ * Cancel a scan if it is still running and release it. The callback is
+ * not called again.
+ * @param usage Scan to stop (from the main thread)
+ */
+extern void DiskUsage_stop(DiskUsage *usage);
+
+/**
+ * The largest files or folders of a finished scan, largest first
+ * @param usage Scan whose callback reported finished
+ * @param dirs TRUE for folders, FALSE for files
+ * @param count Output: number of items (at most DISK_USAGE_TOP_K)
+ * @return Items owned by the scan
+ */
+extern const DiskUsageItem *DiskUsage_largest(const DiskUsage *usage,
+                                              gboolean dirs, guint *count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // DISK_USAGE_H
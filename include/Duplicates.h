@@ -0,0 +1,87 @@
+#ifndef DUPLICATES_H
+#define DUPLICATES_H
+#include "ResultStream.h"
+#include "TreeWalk.h"
+#include <gio/gio.h>
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Duplicate groups handed to the main loop per callback
+#define DUPLICATES_BATCH 64
+
+// Bytes fingerprinted at each end of a file before hashing all of it
+#define DUPLICATES_EDGE_SIZE 4096
+
+// Files read at once; more readers than this only make the disk seek
+#define DUPLICATES_IO_LIMIT 4
+
+// Read buffer of the full-content hash, per reader
+#define DUPLICATES_CHUNK_SIZE (1024 * 1024)
+
+typedef struct {
+  const char *const *paths; // Identical files, relative to the root, sorted
+  guint count;              // Number of paths, at least 2
+  guint64 size;             // Size of each file
+  guint64 reclaimable;      // Bytes freed by keeping a single copy
+} DuplicateGroup;
+
+/**
+ * Receives duplicate groups on the main loop as they are confirmed
+ * @param groups Groups found (valid during the call)
+ * @param count Number of groups, may be 0 on the final call
+ * @param finished TRUE on the last call
+ * @param user_data Data given to Duplicates_start
+ */
+typedef void (*DuplicatesFunc)(const DuplicateGroup *groups, guint count,
+                               gboolean finished, gpointer user_data);
+
+/**
+ * Duplicate file finder over a directory tree, in stages that each rule
+ * out most of what is left before the next, dearer one runs: a parallel
+ * TreeWalk groups regular files by size, then files sharing a size are
+ * told apart by a hash of their first and last DUPLICATES_EDGE_SIZE bytes,
+ * and only files still colliding are hashed whole. Hashing runs as at
+ * most DUPLICATES_IO_LIMIT user-initiated Scheduler tasks, each taking
+ * the next size group until none are left. Hard links of one file are a
+ * single copy: removing one frees nothing.
+ */
+typedef struct {
+  int root_fd;               // Searched directory, files are opened from it
+  TreeWalk *walk;            // Walk collecting the candidates
+  ResultStream *stream;      // Groups on their way to the main loop
+  SchedulerGroup *group;     // Hashing tasks; their token stops the walk too
+  gint ref_count;            // Caller, the walk and each hashing task
+  GMutex lock;               // Guards by_size
+  GHashTable *by_size;       // File size -> GPtrArray of candidates
+  GPtrArray *shared;         // Size groups to hash, largest first
+  gint next_shared;          // Index of the next one a hashing task takes
+  DuplicatesFunc func;       // Result callback
+  gpointer user_data;        // Callback data
+} Duplicates;
+
+/**
+ * Start looking for duplicate files. Returns immediately.
+ * @param root Directory to search
+ * @param ignore Colon-separated directory names to prune, or NULL for
+ * TREE_WALK_DEFAULT_IGNORE
+ * @param func Result callback
+ * @param user_data Data passed to func
+ * @return New Duplicates, stop it with Duplicates_stop
+ */
+extern Duplicates *Duplicates_start(const char *root, const char *ignore,
+                                    DuplicatesFunc func, gpointer user_data);
+
+/**
+ * Cancel a search if it is still running and release it. The callback is
+ * not called again.
+ * @param dups Search to stop (from the main thread)
+ */
+extern void Duplicates_stop(Duplicates *dups);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // DUPLICATES_H
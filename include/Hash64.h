@@ -0,0 +1,55 @@
+#ifndef HASH64_H
+#define HASH64_H
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Streaming XXH64 state. Four independent lanes consume 32 bytes per
+ * step, so the loop runs at memory speed and needs no tables.
+ */
+typedef struct {
+  guint64 total_len; // Bytes consumed so far
+  guint64 lanes[4];  // Accumulators, used once 32 bytes arrived
+  guint64 seed;      // Seed given to Hash64_init
+  guchar buffer[32]; // Bytes not yet making a full stripe
+  guint buffered;    // Used bytes of buffer
+} Hash64;
+
+/**
+ * Start a hash
+ * @param hash State to initialize
+ * @param seed Seed, 0 for the standard XXH64 values
+ */
+extern void Hash64_init(Hash64 *hash, guint64 seed);
+
+/**
+ * Add bytes to a hash
+ * @param hash State
+ * @param data Bytes
+ * @param len Number of bytes
+ */
+extern void Hash64_update(Hash64 *hash, const void *data, gsize len);
+
+/**
+ * Hash of everything added so far; the state stays usable
+ * @param hash State
+ * @return XXH64 of the bytes
+ */
+extern guint64 Hash64_digest(const Hash64 *hash);
+
+/**
+ * Hash a buffer in one call
+ * @param data Bytes
+ * @param len Number of bytes
+ * @param seed Seed, 0 for the standard XXH64 values
+ * @return XXH64 of the bytes
+ */
+extern guint64 Hash64_bytes(const void *data, gsize len, guint64 seed);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // HASH64_H
@@ -0,0 +1,108 @@
+#ifndef IGNORE_RULES_H
+#define IGNORE_RULES_H
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Per-directory ignore files, read in this order (later lines win)
+#define IGNORE_RULES_FILES ".gitignore", ".ignore"
+
+enum {
+  IGNORE_RULE_NEGATE = 1 << 0,   // "!pattern": re-include
+  IGNORE_RULE_DIR_ONLY = 1 << 1, // "pattern/": directories only
+  IGNORE_RULE_ANCHORED = 1 << 2, // Contains '/': relative to the file's dir
+};
+
+typedef struct {
+  gchar *glob;  // Pattern without '!', leading '/' and trailing '/'
+  guint flags;  // IGNORE_RULE_*
+} IgnoreRule;
+
+/**
+ * The compiled ignore rules of one directory level, chained to the levels
+ * above. Rules are sorted into tables by shape so that checking a name
+ * costs a few hash lookups over the name instead of one glob match per
+ * rule: plain names, plain anchored paths and "*.suffix" patterns are hash
+ * keys, and only the remaining globs are matched one by one. When several
+ * rules match, the last one in the file wins, as in git.
+ */
+typedef struct IgnoreRules {
+  struct IgnoreRules *parent; // Rules of the enclosing levels, or NULL
+  gchar *base;                // Directory of this level, relative to the
+                              // walk root ("" for the root)
+  gint ref_count;             // Shared by every walk task below this level
+  GArray *rules;              // IgnoreRule, in file order
+  GHashTable *names;          // Plain name -> last rule index + 1
+  GHashTable *dir_names;      // Same, for directory-only rules
+  GHashTable *paths;          // Plain anchored path -> last rule index + 1
+  GHashTable *dir_paths;      // Same, for directory-only rules
+  GHashTable *suffixes;       // ".suffix" of "*.suffix" -> index + 1
+  GArray *globs;              // guint rule indices matched one by one
+  gboolean anchored;          // Some rule matches relative paths
+} IgnoreRules;
+
+/**
+ * Read the ignore files of a directory and stack them on its parent's
+ * rules. Only regular files count: a FIFO or device named .gitignore,
+ * directly or through a symlink, is skipped without blocking the walk.
+ * @param dirfd Open directory
+ * @param base Directory path relative to the walk root ("" for the root)
+ * @param parent Rules of the enclosing directory, or NULL
+ * @return New level, a new reference to parent if the directory has no
+ * ignore file, or NULL if neither has rules
+ */
+extern IgnoreRules *IgnoreRules_load(int dirfd, const char *base,
+                                     IgnoreRules *parent);
+
+/**
+ * Compile ignore file contents into a level
+ * @param text Ignore file contents, gitignore syntax
+ * @param len Length of text
+ * @param base Directory path relative to the walk root
+ * @param parent Rules of the enclosing directory, or NULL
+ * @return New level holding a reference to parent
+ */
+extern IgnoreRules *IgnoreRules_parse(const char *text, gsize len,
+                                      const char *base, IgnoreRules *parent);
+
+/**
+ * Whether an entry is ignored. The deepest level with a matching rule
+ * decides.
+ * @param rules Rules of the entry's directory, or NULL
+ * @param dir_path Entry's directory relative to the walk root
+ * @param name Entry name
+ * @param is_dir Whether the entry is a directory
+ * @return TRUE if the entry should be skipped
+ */
+extern gboolean IgnoreRules_is_ignored(const IgnoreRules *rules,
+                                       const char *dir_path, const char *name,
+                                       gboolean is_dir);
+
+/**
+ * Match a gitignore glob: '*' and '?' stop at '/', "**" crosses
+ * directories, [...] classes and '\' escapes are supported
+ * @param glob Pattern
+ * @param text Name or relative path
+ * @return TRUE on a match
+ */
+extern gboolean IgnoreRules_glob_match(const char *glob, const char *text);
+
+/**
+ * Take a reference
+ * @param rules Rules, or NULL
+ * @return rules
+ */
+extern IgnoreRules *IgnoreRules_ref(IgnoreRules *rules);
+
+/**
+ * Drop a reference (any thread)
+ * @param rules Rules, or NULL
+ */
+extern void IgnoreRules_unref(IgnoreRules *rules);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // IGNORE_RULES_H
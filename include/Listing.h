@@ -0,0 +1,114 @@
+#ifndef LISTING_H
+#define LISTING_H
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Coarsest timestamp granularity assumed for directory ctimes (one jiffy
+// at HZ=100, with margin)
+#define DIR_LISTING_TIME_SLACK_NS (20 * 1000 * 1000)
+
+/**
+ * Columnar snapshot of one directory. Entry i is described by names[i],
+ * types[i], inodes[i], icons[i] and content_types[i]. Listings are immutable
+ * once loaded and reference counted so the view, the cache and background
+ * loaders can share them. The sort columns below are derived lazily (see
+ * Sort.h) by whoever owns the listing: the loading thread before it is
+ * shared, the main thread afterwards.
+ */
+typedef struct {
+  char *path;                 // Directory the listing was read from
+  char *parent_path;          // Canonical parent directory, NULL at "/"
+  int count;                  // Number of entries
+  char **names;               // Entry names (point into name_arena)
+  unsigned char *types;       // DIR_TYPE_* with symlinks resolved
+  uint64_t *inodes;           // Inode numbers from the directory entries
+  GIcon **icons;              // Icon per entry (shared, may be NULL)
+  const char **content_types; // Interned content type per entry
+  char *name_arena;           // Backing storage for names
+  char **collate_keys;        // Filename collation keys, or NULL
+  char *collate_arena;        // Backing storage for collate_keys
+  guint32 *name_ranks;        // Position of each entry in name order, or NULL
+  uint64_t *sizes;            // Apparent sizes, or NULL until stat'ed
+  int64_t *mtimes;            // Modification times (seconds), same
+  int64_t dir_ctime_ns;       // Directory's ctime when the read began, 0 if
+                              // unknown (patched listings)
+  int64_t read_at_ns;         // Wall clock when the read began
+  gsize memory_bytes;         // Approximate heap footprint
+  gsize index_bytes;          // Part of it in collate keys and name ranks
+  gint ref_count;
+} DirListing;
+
+/**
+ * Read a directory into a new listing
+ * @param dirpath Directory path to scan
+ * @return New listing with one reference, or NULL on error
+ */
+extern DirListing *DirListing_load(const char *dirpath);
+
+/**
+ * Build a new listing from an existing one by re-stat'ing only the names
+ * that changed, without re-reading the directory
+ * @param listing Listing to patch
+ * @param changed_names Set of entry names (keys) touched since the listing
+ * was read; names that no longer exist are dropped
+ * @param first_changed Output: index of the first re-stat'ed entry, all
+ * later entries come from changed_names
+ * Sort columns already derived for the source are carried over, so only
+ * the changed names are collated and merged into the name order.
+ * @return New listing with one reference, or NULL if the directory is gone
+ */
+extern DirListing *DirListing_apply_changes(const DirListing *listing,
+                                            GHashTable *changed_names,
+                                            int *first_changed);
+
+/**
+ * Whether the directory still is as it was read: its ctime, which every
+ * create, delete or rename inside moves, is the one seen when the read
+ * began. A ctime within DIR_LISTING_TIME_SLACK_NS of the read is not
+ * trusted, since a later change in the same timestamp tick would leave it
+ * as it was. Costs one stat.
+ * @param listing Listing to check
+ * @return TRUE if the listing is known to be current
+ */
+extern gboolean DirListing_is_current(const DirListing *listing);
+
+/**
+ * Take a reference on a listing
+ * @param listing Listing to reference
+ * @return The same listing
+ */
+extern DirListing *DirListing_ref(DirListing *listing);
+
+/**
+ * Drop a reference, freeing the listing when it reaches zero
+ * @param listing Listing to release (may be NULL)
+ */
+extern void DirListing_unref(DirListing *listing);
+
+/**
+ * Look up the (shared) icon for a content type
+ * @param name Entry name, used to guess regular file content types
+ * @param type DIR_TYPE_* of the entry
+ * @return Borrowed icon, or NULL
+ */
+extern GIcon *DirListing_icon_for_entry(const char *name, unsigned char type);
+
+/**
+ * Look up the (shared) icon and interned content type for an entry
+ * @param name Entry name, used to guess regular file content types
+ * @param type DIR_TYPE_* of the entry
+ * @param content_type Output: interned content type string
+ * @return Borrowed icon, or NULL
+ */
+extern GIcon *DirListing_type_for_entry(const char *name, unsigned char type,
+                                        const char **content_type);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // LISTING_H
@@ -0,0 +1,68 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// What the accounted bytes are held by
+typedef enum {
+  MEMORY_LISTING,        // Listing columns, name arenas and stat columns
+  MEMORY_ICON_CACHE,     // Content types and icons, kept for the process
+  MEMORY_SEARCH_BUFFERS, // File contents returned by ReadFileAt
+  MEMORY_INDEXES,        // Collation keys and name ranks of listings
+  MEMORY_RESULTS,        // Results queued in result streams
+  MEMORY_TAG_COUNT
+} MemoryTag;
+
+/**
+ * Accounted bytes per tag, and the process as the kernel sees it
+ */
+typedef struct {
+  gint64 current[MEMORY_TAG_COUNT]; // Held now
+  gint64 peak[MEMORY_TAG_COUNT];    // Most ever held since the last reset
+  gint64 rss;                       // Resident set size, 0 if unknown
+  gint64 peak_rss;                  // Its high-water mark, 0 if unknown
+} MemorySnapshot;
+
+/**
+ * Account an allocation or its release (any thread). Each tag is one
+ * atomic counter with an atomic high-water mark, so call it per buffer,
+ * not per byte.
+ * @param tag Holder of the memory
+ * @param bytes Bytes allocated, negative when freed
+ */
+extern void Memory_add(MemoryTag tag, gint64 bytes);
+
+/**
+ * Read every tag and the process's resident set
+ * @param snapshot Output
+ */
+extern void Memory_snapshot(MemorySnapshot *snapshot);
+
+/**
+ * Start a new measurement: every peak drops to what is held now, and the
+ * kernel's peak RSS to the current RSS where it allows that
+ */
+extern void Memory_reset_peaks(void);
+
+/**
+ * Name of a tag, as used in the JSON dump
+ * @param tag Tag
+ * @return Static string
+ */
+extern const char *Memory_tag_name(MemoryTag tag);
+
+/**
+ * A snapshot as JSON: current and peak bytes per tag, then rss and
+ * peak_rss
+ * @param snapshot Snapshot
+ * @return New string without a trailing newline, free with g_free
+ */
+extern gchar *Memory_to_json(const MemorySnapshot *snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // MEMORY_H
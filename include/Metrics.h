@@ -0,0 +1,124 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Histogram resolution: 16 buckets per power of two, about 6% error
+#define METRICS_SUB_BUCKET_BITS 4
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+
+// Buckets per histogram, covering values up to 2^48
+#define METRICS_BUCKETS                                                        \
+  ((48 - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS)
+
+// Where SIGUSR1 writes the metrics (default: the temp dir)
+#define METRICS_DUMP_ENV "CILE_METRICS_FILE"
+
+// Counters only grow; gauges rise and fall with the memory they track
+typedef enum {
+  METRIC_NAVIGATIONS,            // Directories shown
+  METRIC_DIR_CACHE_HITS,         // Listings served from the cache
+  METRIC_DIR_CACHE_MISSES,       // Listings read from disk
+  METRIC_ICON_CACHE_HITS,        // Icons found by content type
+  METRIC_ICON_CACHE_MISSES,      // Icons looked up in the theme
+  METRIC_USAGE_CACHE_HITS,       // Folder scans reused by disk usage
+  METRIC_USAGE_CACHE_MISSES,     // Folders re-read by disk usage
+  METRIC_FILES_SCANNED,          // Files whose contents were searched
+  METRIC_BYTES_SCANNED,          // Bytes of those files
+  METRIC_FILES_SKIPPED,          // Unreadable, empty or special files
+  METRIC_ENTRIES_IGNORED,        // Entries pruned by ignore rules
+  METRIC_BUDGET_WAITS,           // Reads that waited for the memory budget
+  METRIC_BUDGET_RECLAIMED_BYTES, // Evicted by caches for the budget
+  METRIC_TASKS_STOLEN,           // Tasks taken from another worker's deque
+  METRIC_TASKS_PREEMPTING,       // Tasks run inside Scheduler_yield
+  METRIC_DIR_CACHE_BYTES,        // Gauge: listings held by directory caches
+  METRIC_COUNTER_COUNT
+} MetricCounter;
+
+typedef enum {
+  METRIC_FIRST_ROW_US,        // Navigation until the first rows are painted
+  METRIC_NAVIGATION_US,       // Navigation until every row exists
+  METRIC_CONTENT_SEARCH_US,   // A content search, start to last match
+  METRIC_SCAN_MBPS,           // Content scan throughput, reads included, MB/s
+  METRIC_INTERACTIVE_WAIT_US, // Interactive task queued until it starts
+  METRIC_HISTOGRAM_COUNT
+} MetricHistogram;
+
+/**
+ * Every thread's counters and histograms summed at one point in time
+ */
+typedef struct {
+  gint64 counters[METRIC_COUNTER_COUNT];
+  guint64 buckets[METRIC_HISTOGRAM_COUNT][METRICS_BUCKETS];
+  guint64 totals[METRIC_HISTOGRAM_COUNT]; // Values recorded per histogram
+} MetricsSnapshot;
+
+/**
+ * Add to a counter or gauge (any thread). Each thread adds into its own
+ * shard without locks or read-modify-write atomics; shards are summed
+ * only when a snapshot is taken.
+ * @param counter Counter
+ * @param amount Amount, negative to lower a gauge
+ */
+extern void Metrics_add(MetricCounter counter, gint64 amount);
+
+/**
+ * Record a value in a histogram (any thread), in the same per-thread way
+ * @param histogram Histogram
+ * @param value Value, clamped to 0..2^48
+ */
+extern void Metrics_record(MetricHistogram histogram, gint64 value);
+
+/**
+ * Sum every thread's shard
+ * @param snapshot Output
+ */
+extern void Metrics_snapshot(MetricsSnapshot *snapshot);
+
+/**
+ * Value below which a share of a histogram's values fall
+ * @param snapshot Snapshot
+ * @param histogram Histogram
+ * @param percentile 0 to 100
+ * @return Upper bound of the bucket holding it, 0 if nothing was recorded
+ */
+extern gint64 Metrics_percentile(const MetricsSnapshot *snapshot,
+                                 MetricHistogram histogram,
+                                 double percentile);
+
+/**
+ * Name of a counter, as used in the JSON dump
+ * @param counter Counter
+ * @return Static string
+ */
+extern const char *Metrics_counter_name(MetricCounter counter);
+
+/**
+ * Name of a histogram, as used in the JSON dump
+ * @param histogram Histogram
+ * @return Static string
+ */
+extern const char *Metrics_histogram_name(MetricHistogram histogram);
+
+/**
+ * A snapshot as JSON: counters, then count and p50/p90/p99/max per
+ * histogram, then the memory accounting as it is now
+ * @param snapshot Snapshot
+ * @return New string, free with g_free
+ */
+extern gchar *Metrics_to_json(const MetricsSnapshot *snapshot);
+
+/**
+ * Write a snapshot as JSON on every SIGUSR1, to METRICS_DUMP_ENV or
+ * cile-metrics-PID.json in the temp dir. The file is written from the
+ * default main context, never from the signal handler.
+ */
+extern void Metrics_install_dump_signal(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // METRICS_H
@@ -3,16 +3,165 @@
 #ifdef __cplusplus
 extern "C" {
 #endif
+#include "ContentSearch.h"
+#include "DirCache.h"
+#include "DiskUsage.h"
+#include "Duplicates.h"
 #include "Pages/Sidebar.h"
+#include "Prefetch.h"
+#include "Sort.h"
+#include "TreeSearch.h"
 #include "Pages/Topbar.h"
 #include <gtk/gtk.h>
 
+/**
+ * Creates the rows of a big listing a slice at a time so no single main loop
+ * iteration blocks input or painting for long
+ */
+typedef struct {
+  DirListing *listing; // Listing being materialized, NULL when idle
+  guint32 *order;      // Entry indices in display order
+  int *positions;      // Display position per entry index
+  int next;            // Next index into order
+  guint source;        // Idle source creating the next slice, 0 if none
+  double rows_per_ms;  // Measured creation rate, sizes each slice
+} RowMaterializer;
+
+/**
+ * The search query being applied. Rows are filtered a slice at a time in
+ * display order, so the top of the list updates first; a newer query
+ * cancels the token and every engine working for this one stops. A query
+ * that refines the last finished one (its pattern contains the old one)
+ * only re-checks the rows the old one matched.
+ */
+typedef struct {
+  GCancellable *cancellable;      // Token of the running query, NULL if idle
+  DirListing *listing;            // Listing being filtered
+  gchar *pattern_lower;           // Lowercased pattern, NULL shows every row
+  guint32 *order;                 // Entry indices to filter, in display order
+  int count;                      // Length of order
+  int next;                       // Next index into order
+  guint source;                   // Idle source filtering the next slice
+  GArray *matches;                // guint32 entry indices matched so far
+  gboolean missed_rows;           // Some entries had no row to filter yet
+  DirListing *candidates_listing; // Listing of the last finished query
+  gchar *candidates_pattern;      // Its pattern
+  GArray *candidates;             // Its matches, all a refined query re-checks
+} SearchQuery;
+
+/**
+ * Content search mode: files of the current directory are searched for the
+ * pattern in the background and rows are shown, with their hit counts, as
+ * matches stream in. A query that refines the last finished one only
+ * re-reads the files it matched.
+ */
+typedef struct {
+  ContentSearch *search;          // Running search, NULL when idle
+  guint id;                       // Stamp of the current content query
+  DirListing *listing;            // Listing being searched
+  int *positions;                 // Display position per entry of listing
+  gchar *pattern;                 // Pattern being searched
+  GArray *hit_files;              // guint32 entry indices matched so far
+  DirListing *candidates_listing; // Listing of the last finished search
+  gchar *candidates_pattern;      // Its pattern
+  GArray *candidates;             // Its matching files
+} ContentQuery;
+
+/**
+ * Subtree mode: names are searched in every folder below the current one
+ * and matches are listed by relative path, in the order they are found
+ */
+typedef struct {
+  TreeSearch *search; // Running search, NULL when idle
+  GPtrArray *rows;    // Result rows, in arrival order
+  gboolean truncated; // Search stopped at TREE_SEARCH_MAX_RESULTS
+} TreeQuery;
+
+/**
+ * Sizes mode: a DiskUsage scan of the current directory fills in the size
+ * of every entry as it is measured, then offers the largest files and
+ * folders below it
+ */
+typedef struct {
+  DiskUsage *scan;    // Running scan, NULL when idle
+  GHashTable *sizes;  // Entry name -> guint64 bytes measured so far
+  guint64 measured;   // Sum of sizes
+  GtkWidget *button;  // "Largest" menu button, shown in sizes mode
+  GtkWidget *popover; // Its list of the largest entries
+} UsageQuery;
+
+/**
+ * Duplicates mode: files with identical contents below the current
+ * directory, listed by the space they waste
+ */
+typedef struct {
+  Duplicates *scan;    // Running search, NULL when idle
+  GPtrArray *groups;   // DuplicateRow, as found
+  guint64 reclaimable; // Sum over groups
+  GtkWidget *button;   // "Duplicates" menu button, shown in the mode
+  GtkWidget *popover;  // Its list of groups
+} DuplicateQuery;
+
+/**
+ * Debug panel with the runtime metrics, refreshed while it is open
+ */
+typedef struct {
+  GtkWidget *button;    // "Stats" menu button
+  GtkWidget *popover;   // The panel
+  GtkWidget *label;     // Metrics, one per line
+  guint refresh_source; // Timeout while open, 0 otherwise
+} StatsPanel;
+
+/**
+ * Timing of the last directory load, logged with g_debug
+ */
+typedef struct {
+  gint64 started_at;     // Monotonic time the load started
+  gint64 first_paint_us; // Until the first screenful was painted, or -1
+  gint64 total_us;       // Until every row existed, or -1
+  int rows;              // Rows created by the load
+  GdkFrameClock *clock;  // Clock watched for the first paint
+  gulong paint_handler;  // after-paint handler, 0 when not watching
+  gint64 trace_start;    // Trace_now() at the start, 0 when not tracing
+} LoadMetrics;
+
 typedef struct {
   GtkWidget *m_MainPage;
+  GtkWidget *scrolled_window;
   GtkWidget *list_box;
+  GtkWidget *back_row;      // ".. (Back)" row, NULL at "/"
+  GtkWidget *message_row;   // Status row shown when nothing is visible
+  GtkWidget *message_label;
+  GtkWidget *status_bar;    // Breakdown of the last finished search
   TopBarWidget *top_bar;
   SideBarWidget *side_bar;
   gchar *current_search_pattern; // Store current search pattern
+  DirCache *dir_cache;           // Recent listings for instant revisits
+  Prefetcher *prefetcher;        // Warms dir_cache with likely next folders
+  DirListing *listing;           // Listing currently on screen
+  GHashTable *rows;              // Entry name -> GtkListBoxRow
+  guint generation;              // Incremented on every row sync
+  int visible_count;             // Listing rows passing the filter
+  gchar *hover_path;             // Folder under the pointer, NULL if none
+  guint hover_source;            // Pending hover prefetch timer, 0 if none
+  SortSpec sort_spec;            // Current row order
+  SchedulerGroup *sort_stats;    // Stat pass a size or time sort waits on
+  DirListing *stats_listing;     // Listing it stats, NULL if none
+  GtkWidget *sort_buttons[SORT_KEY_COUNT];
+  RowMaterializer materializer;  // Pending row creation
+  SearchQuery search;            // Query still being applied
+  ContentQuery content;          // Content search state
+  gboolean content_mode;         // Search file contents, not names
+  TreeQuery tree;                // Subtree search state
+  gboolean tree_mode;            // Search names in subfolders too
+  gboolean query_mode;          // Pattern uses query syntax (ext:, size>)
+  UsageQuery usage;              // Disk usage of the current directory
+  gboolean sizes_mode;           // Show the disk usage of every entry
+  DuplicateQuery dups;           // Duplicate files below the directory
+  gboolean dups_mode;            // Look for duplicate files
+  GtkWidget *cancel_button;      // Stops a running background search
+  LoadMetrics load_metrics;      // Timing of the last load
+  StatsPanel stats;              // Runtime metrics panel
 } MainPageWidget;
 
 /**
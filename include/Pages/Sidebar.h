@@ -43,6 +43,15 @@ extern void SideBar_connect_navigation(SideBarWidget *side_bar,
 extern void SideBar_add_recent_directory(SideBarWidget *side_bar,
                                          const char *path);
 
+/**
+ * Rank recent directories by frecency (visit count weighted by recency)
+ * @param side_bar SideBarWidget instance
+ * @param max_count Maximum number of paths to return
+ * @return Array of paths, best first (free with g_ptr_array_free)
+ */
+extern GPtrArray *SideBar_get_frecent_directories(SideBarWidget *side_bar,
+                                                  int max_count);
+
 /**
  * Save recent directories to disk (call before closing program)
  * @param side_bar SideBarWidget instance
@@ -11,6 +11,8 @@ typedef struct {
   GtkWidget *address_entry;
   GtkWidget *search_entry;
   gchar *current_address;
+  gchar *current_search; // Last text sent with search-triggered
+  guint search_debounce; // Pending search-triggered timeout, 0 if none
 } TopBarWidget;
 
 /**
@@ -40,6 +42,14 @@ extern void TopBar_set_address(TopBarWidget *top_bar, const char *address);
  */
 extern const char *TopBar_get_address(const TopBarWidget *top_bar);
 
+/**
+ * Forget the last search text sent, e.g. once navigation has cleared the
+ * filter it asked for, so the next edit or Enter sends the entry's text
+ * even if it is the same
+ * @param top_bar TopBarWidget instance
+ */
+extern void TopBar_forget_search(TopBarWidget *top_bar);
+
 /**
  * Connect to address-changed signal
  * @param top_bar TopBarWidget instance
@@ -51,7 +61,9 @@ extern void TopBar_connect_address_changed(TopBarWidget *top_bar,
                                            gpointer user_data);
 
 /**
- * Connect to search-triggered signal
+ * Connect to search-triggered signal. It fires as the user types, once the
+ * input has been still for SEARCH_DEBOUNCE_MS, and right away on Enter; the
+ * same text is not sent twice in a row unless Enter is pressed.
  * @param top_bar TopBarWidget instance
  * @param callback Function to call when search is triggered
  * @param user_data Data to pass to callback
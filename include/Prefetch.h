@@ -0,0 +1,89 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+#include "DirCache.h"
+#include "Scheduler.h"
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Directory entries the prefetcher may read per second, overridable with
+// CILE_PREFETCH_ENTRIES_PER_SEC
+#define PREFETCH_DEFAULT_ENTRIES_PER_SEC 50000
+
+// Background I/O stays off the disk this long after a foreground load
+#define PREFETCH_QUIET_MS 250
+
+// Most requests kept queued; older low priority ones are dropped first
+#define PREFETCH_MAX_QUEUED 32
+
+typedef enum {
+  PREFETCH_PRIORITY_LOW,  // Frecent directories, whenever the disk is idle
+  PREFETCH_PRIORITY_HIGH, // Hovered or selected folder, likely next click
+} PrefetchPriority;
+
+/**
+ * Background loader that warms DirCache with listings the user is likely to
+ * open next. Directories are read one at a time as background tasks of the
+ * shared Scheduler, under the idle I/O class, throttled to a number of
+ * entries per second and held back while the foreground loads; each
+ * finished listing is inserted speculatively from the task's done hook on
+ * the main loop, within the cache's prefetch share. Main thread only.
+ */
+typedef struct {
+  DirCache *cache;          // Destination
+  SchedulerGroup *group;    // Background tasks, cancelled on destroy
+  GQueue requests;          // PrefetchRequest*, high priority at the head
+  gboolean loading;         // A request is being read
+  gint64 quiet_until;       // Monotonic time before which no I/O is issued
+  gint64 resume_at;         // End of the last listing's throttle
+  guint resume_source;      // Timeout until either passes, 0 if none
+  guint hover_generation;   // Bumped when the hovered/selected row changes
+  GHashTable *in_flight;    // Paths queued or loading
+  guint entries_per_second; // I/O throttle
+  guint loaded;             // Listings read
+  guint inserted;           // Listings accepted by the cache
+} Prefetcher;
+
+/**
+ * Start a prefetcher feeding a cache
+ * @param cache DirCache to warm (must outlive the prefetcher)
+ * @return New Prefetcher instance
+ */
+extern Prefetcher *Prefetcher_new(DirCache *cache);
+
+/**
+ * Cancel the read in progress and drop pending requests
+ * @param prefetcher Prefetcher to destroy
+ */
+extern void Prefetcher_destroy(Prefetcher *prefetcher);
+
+/**
+ * Ask for a directory to be warmed. Directories already cached or queued
+ * are ignored. A high priority request supersedes earlier high priority
+ * ones (only the latest hovered folder is worth reading).
+ * @param prefetcher Prefetcher instance
+ * @param path Directory path
+ * @param priority PREFETCH_PRIORITY_*
+ */
+extern void Prefetcher_request(Prefetcher *prefetcher, const char *path,
+                               PrefetchPriority priority);
+
+/**
+ * Drop queued high priority requests, e.g. when the pointer leaves a row
+ * @param prefetcher Prefetcher instance
+ */
+extern void Prefetcher_cancel_hover(Prefetcher *prefetcher);
+
+/**
+ * Tell the prefetcher the foreground is loading so it backs off the disk
+ * for PREFETCH_QUIET_MS
+ * @param prefetcher Prefetcher instance
+ */
+extern void Prefetcher_note_foreground_io(Prefetcher *prefetcher);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // PREFETCH_H
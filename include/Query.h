@@ -0,0 +1,143 @@
+#ifndef QUERY_H
+#define QUERY_H
+#include "DirReader.h"
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fields in evaluation cost order: the entry's d_type, its name, its
+// relative path, a stat, then reading the file
+typedef enum {
+  QUERY_TYPE,     // type:file|dir|link
+  QUERY_NAME,     // name:text or a bare word, any case
+  QUERY_EXT,      // ext:log or ext:c,h, any case
+  QUERY_PATH,     // path:text, relative to the searched root, any case
+  QUERY_SIZE,     // size>10M (B, K, M, G, T; powers of 1024)
+  QUERY_MODIFIED, // modified<2d: age (s, m, h, d, w, y)
+  QUERY_CONTENT,  // content:"text", literal and case-sensitive
+} QueryField;
+
+typedef enum {
+  QUERY_EQUAL,         // ':' or '='
+  QUERY_LESS,          // '<'
+  QUERY_LESS_EQUAL,    // '<='
+  QUERY_GREATER,       // '>'
+  QUERY_GREATER_EQUAL, // '>='
+} QueryCompare;
+
+typedef enum {
+  QUERY_DEFAULT = 0,
+  QUERY_WORDS_CONTENT = 1 << 0, // Bare words search contents, not names
+} QueryFlags;
+
+typedef struct {
+  QueryField field;     // What is tested
+  QueryCompare compare; // Size and age comparison
+  gboolean negate;      // "-term": entries failing the test match
+  gchar *text;          // Lowercased, except for content terms
+  gsize text_len;       // Length of text
+  gboolean ascii;       // text is ASCII: subjects need no lowercasing
+  gint64 value;         // Bytes, seconds of age, or a DIR_TYPE_*
+} QueryTerm;
+
+/**
+ * A parsed search query: terms that must all hold, such as
+ * `ext:log size>10M modified<2d content:"OOM killer"`. The terms are
+ * planned cheapest first, so an entry costs a stat or a file read only
+ * once everything cheaper has passed. Text without query syntax is one
+ * plain term, matched the way the search box always has.
+ */
+typedef struct {
+  QueryTerm *terms;    // Evaluation order
+  guint count;         // Length of terms
+  gboolean plain;      // No query syntax: one substring term
+  gboolean needs_stat; // Some term tests size or age
+  gint64 now;          // Real time at parse, seconds, for ages
+} Query;
+
+/**
+ * An entry being tested. The stat, path and contents are filled in only
+ * when a term needs them.
+ */
+typedef struct {
+  const char *dir_path; // Directory relative to the root ("" for the root)
+  const char *name;     // Entry name
+  unsigned char type;   // DIR_TYPE_*
+  int dirfd;            // Open fd of the directory
+  gboolean stat_done;   // st holds the result of a stat attempt
+  gboolean stat_ok;     // The stat succeeded
+  DirReaderStat st;     // Entry stat, symlinks not followed
+  gchar *path;          // Joined relative path, NULL until needed
+  gboolean read_done;   // contents holds the result of a read attempt
+  char *contents;       // File contents (from ReadFileAt), may be NULL
+  size_t size;          // Length of contents
+  guint hits;           // Occurrences of the first content term
+  gint64 io_us;         // Time spent in the stat and the read
+} QueryEntry;
+
+/**
+ * Parse and plan a query. Never fails: a malformed term is searched for
+ * as a bare word.
+ * @param text Query text
+ * @param flags QUERY_* options
+ * @return New Query, free with Query_free
+ */
+extern Query *Query_parse(const char *text, QueryFlags flags);
+
+/**
+ * Free a query
+ * @param query Query, or NULL
+ */
+extern void Query_free(Query *query);
+
+/**
+ * Whether the query tests file contents
+ * @param query Query
+ * @return TRUE if some term reads the files
+ */
+extern gboolean Query_has_content(const Query *query);
+
+/**
+ * Prepare an entry for Query_matches
+ * @param entry Entry to initialize
+ * @param dir_path Directory relative to the searched root
+ * @param name Entry name
+ * @param type DIR_TYPE_* of the entry
+ * @param dirfd Open fd of the directory
+ */
+extern void QueryEntry_init(QueryEntry *entry, const char *dir_path,
+                            const char *name, unsigned char type, int dirfd);
+
+/**
+ * Release what Query_matches loaded for an entry
+ * @param entry Entry to clear
+ */
+extern void QueryEntry_clear(QueryEntry *entry);
+
+/**
+ * Test an entry against every term, cheapest first, stopping at the first
+ * one that fails (any thread)
+ * @param query Query
+ * @param entry Entry, initialized with QueryEntry_init
+ * @return TRUE if all terms hold; entry->hits counts the content matches
+ */
+extern gboolean Query_matches(const Query *query, QueryEntry *entry);
+
+/**
+ * Whether a text contains a lowercased pattern, ignoring case
+ * @param text Text to search
+ * @param pattern_lower Pattern lowercased with g_utf8_strdown
+ * @param ascii Whether pattern_lower is plain ASCII (skips lowercasing the
+ * text)
+ * @return TRUE on a match
+ */
+extern gboolean Query_text_contains(const char *text,
+                                    const char *pattern_lower,
+                                    gboolean ascii);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // QUERY_H
@@ -0,0 +1,96 @@
+#ifndef RESULT_STREAM_H
+#define RESULT_STREAM_H
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Link embedded as the first member of every streamed result
+ */
+typedef struct ResultNode {
+  struct ResultNode *next;
+  gsize size; // Bytes accounted to MEMORY_RESULTS until delivered
+} ResultNode;
+
+/**
+ * Receives results on the main loop, oldest first
+ * @param items Results of this batch; the callback owns them
+ * @param count Number of results, may be 0 on the final call
+ * @param finished TRUE on the last call: all work is done
+ * @param user_data Data given to ResultStream_new
+ */
+typedef void (*ResultStreamFunc)(ResultNode **items, guint count,
+                                 gboolean finished, gpointer user_data);
+
+/**
+ * Hands results from worker threads to the main loop. Workers push onto a
+ * lock-free MPSC stack and wake a main loop source, which drains it and
+ * delivers the results in batches, so neither side ever waits on the other.
+ * Work is counted in units: the stream finishes once every unit is done.
+ */
+typedef struct {
+  ResultNode *head;      // MPSC stack, newest first, pushed by workers
+  gint pending;          // Work units not done yet
+  gint finished;         // Set once pending drops to zero
+  GSource *source;       // Main loop source draining the stack
+  GQueue ready;          // Drained, undelivered results (main thread)
+  guint batch;           // Most results per callback
+  gboolean done;         // Final callback delivered (main thread)
+  ResultStreamFunc func; // Result callback
+  gpointer user_data;    // Callback data
+} ResultStream;
+
+/**
+ * Create a stream delivering on the default main context. It starts with
+ * one unit of work held by the creator, so it cannot finish before every
+ * initial task has been counted; release it with ResultStream_work_done.
+ * @param batch Most results per callback, so each fits in a frame
+ * @param func Result callback
+ * @param user_data Data passed to func
+ * @return New ResultStream
+ */
+extern ResultStream *ResultStream_new(guint batch, ResultStreamFunc func,
+                                      gpointer user_data);
+
+/**
+ * Count more work units (any thread)
+ * @param stream Stream instance
+ * @param units Units about to be started
+ */
+extern void ResultStream_add_work(ResultStream *stream, guint units);
+
+/**
+ * Mark one unit of work done (any thread)
+ * @param stream Stream instance
+ */
+extern void ResultStream_work_done(ResultStream *stream);
+
+/**
+ * Queue a result and wake the main loop (any thread, never blocks). Its
+ * bytes count as MEMORY_RESULTS until it is delivered or freed.
+ * @param stream Stream instance
+ * @param node Result, freed with g_free if it is never delivered
+ * @param size Bytes allocated for the result
+ */
+extern void ResultStream_push(ResultStream *stream, ResultNode *node,
+                              gsize size);
+
+/**
+ * Stop delivering; the callback is not called again (main thread)
+ * @param stream Stream instance
+ */
+extern void ResultStream_close(ResultStream *stream);
+
+/**
+ * Free a closed stream and any results it still holds. Safe from any
+ * thread once no worker can push to it any more.
+ * @param stream Stream to free
+ */
+extern void ResultStream_free(ResultStream *stream);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // RESULT_STREAM_H
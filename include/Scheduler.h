@@ -0,0 +1,145 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include <gio/gio.h>
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Overrides the number of workers
+#define SCHEDULER_ENV "CILE_WORKERS"
+
+// How long a lower priority task keeps its worker while interactive work
+// waits, as long as it calls Scheduler_yield at least this often
+#define SCHEDULER_QUANTUM_US 1000
+
+// Done hooks run per main loop dispatch
+#define SCHEDULER_DONE_BATCH 64
+
+// Workers take the lowest value first
+typedef enum {
+  SCHEDULER_INTERACTIVE,    // Results for what is on screen
+  SCHEDULER_USER_INITIATED, // Asked for and awaited: tree searches, sizes
+  SCHEDULER_BACKGROUND,     // Speculative: prefetching, crawling; does
+                            // its I/O in the idle class
+  SCHEDULER_PRIORITY_COUNT
+} SchedulerPriority;
+
+/**
+ * A task, run on a worker thread
+ * @param data Data given with the task
+ */
+typedef void (*SchedulerFunc)(gpointer data);
+
+/**
+ * Completion hook of a task, run on the main loop after it
+ * @param data Data given with the task; the hook owns it
+ * @param cancelled TRUE if the group was cancelled by the time the hook
+ * runs, whether or not the task itself ran
+ */
+typedef void (*SchedulerDoneFunc)(gpointer data, gboolean cancelled);
+
+/**
+ * Tasks sharing a priority and a cancellation token, e.g. every directory
+ * of one walk. Cancelling the token cancels them all: those not started
+ * yet are skipped if they have a done hook to clean up after them, and
+ * run otherwise, so they should check the token first. A group may follow
+ * a parent token, such as the query it works for: cancelling the parent
+ * cancels the group, but not the other way round.
+ */
+typedef struct {
+  SchedulerPriority priority; // Class of every task in the group
+  GCancellable *cancellable;  // Cancels the group, owned
+  GCancellable *parent;       // Token that cancels it too, or NULL
+  gulong parent_handler;      // Handler on parent, 0 if none
+  gint ref_count;             // Owner plus one per task not finished
+} SchedulerGroup;
+
+/**
+ * The scheduler at one point in time
+ */
+typedef struct {
+  guint workers;                           // Threads in the pool
+  guint queued[SCHEDULER_PRIORITY_COUNT];  // Tasks waiting, per class
+  guint running[SCHEDULER_PRIORITY_COUNT]; // Tasks being run, per class
+} SchedulerSnapshot;
+
+/**
+ * Create a group
+ * @param priority SCHEDULER_* class of its tasks
+ * @param cancellable Parent token whose cancellation also cancels the
+ * group, e.g. the query's, or NULL
+ * @return New SchedulerGroup, free with SchedulerGroup_unref
+ */
+extern SchedulerGroup *SchedulerGroup_new(SchedulerPriority priority,
+                                          GCancellable *cancellable);
+
+/**
+ * Drop the owner's reference; queued tasks keep the group alive (any
+ * thread)
+ * @param group Group, or NULL
+ */
+extern void SchedulerGroup_unref(SchedulerGroup *group);
+
+/**
+ * Cancel every task of the group (any thread)
+ * @param group Group
+ */
+extern void SchedulerGroup_cancel(SchedulerGroup *group);
+
+/**
+ * Queue a task (any thread, never blocks). The shared pool has one worker
+ * per CPU of the cgroup's quota, capped by the CPUs the process may run
+ * on. Each worker keeps a deque per class: tasks pushed from a worker go
+ * to the front of its own, to be run next while their data is hot, and
+ * idle workers steal from the back of the others'. Tasks pushed from
+ * other threads are shared by all workers in arrival order. A worker
+ * always takes the highest class any queue holds.
+ * @param group Group of the task
+ * @param func Task
+ * @param data Data passed to func
+ */
+extern void Scheduler_push(SchedulerGroup *group, SchedulerFunc func,
+                           gpointer data);
+
+/**
+ * Queue a task with a completion hook that runs on the default main
+ * context, where GTK and main-thread-only caches are safe to touch. Done
+ * hooks run in the order their tasks finished, at idle priority, behind
+ * input and drawing.
+ * @param group Group of the task
+ * @param func Task, skipped if the group is cancelled before it starts
+ * @param done Completion hook
+ * @param data Data passed to both
+ */
+extern void Scheduler_push_full(SchedulerGroup *group, SchedulerFunc func,
+                                SchedulerDoneFunc done, gpointer data);
+
+/**
+ * Let higher class work waiting for a worker run here (from inside a
+ * task). Interactive tasks never yield. A user-initiated or background
+ * task that has run for SCHEDULER_QUANTUM_US since it started or last
+ * yielded runs every queued task of a higher class, then carries on.
+ * Call it between units of work, where the task holds no lock and no
+ * memory from the budget; it costs a few atomic loads when nothing waits.
+ * @return TRUE if other tasks ran
+ */
+extern gboolean Scheduler_yield(void);
+
+/**
+ * Number of worker threads, starting them if needed
+ * @return Workers in the pool
+ */
+extern guint Scheduler_workers(void);
+
+/**
+ * Read the queues
+ * @param snapshot Output
+ */
+extern void Scheduler_snapshot(SchedulerSnapshot *snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // SCHEDULER_H
@@ -1,5 +1,6 @@
 #ifndef SEARCH_H
 #define SEARCH_H
+#include "SearchStats.h"
 #include <gio/gio.h>
 #include <glib.h>
 #include <stdbool.h>
@@ -17,7 +18,7 @@ typedef struct {
 } FileBatch;
 
 /**
- * List all files in a directory
+ * List all files in a directory, in natural name order
  * @param dirpath Directory path to scan
  * @param file_count Output parameter for number of files found
  * @return Array of FileEntry pointers, or NULL on error
@@ -31,6 +32,67 @@ extern FileEntry **ListFilesInDir(const char *dirpath, int *file_count);
  */
 extern bool DoesFileExist(const char *filepath);
 
+/**
+ * Read a regular file relative to a directory fd. The buffer is drawn from
+ * the memory budget first, waiting while the budget is full, so a thread
+ * must not hold other contents while it calls this.
+ * @param dirfd Directory file descriptor
+ * @param name Entry name in that directory
+ * @param out_size Output parameter for the number of bytes read
+ * @return NUL-terminated contents (free with FreeFileContents), or NULL if
+ * the entry is not a non-empty regular file or cannot be read
+ */
+extern char *ReadFileAt(int dirfd, const char *name, size_t *out_size);
+
+/**
+ * Free contents returned by ReadFileAt; they are accounted as
+ * MEMORY_SEARCH_BUFFERS and held against the memory budget until then
+ * @param contents Contents, or NULL
+ * @param size Size ReadFileAt returned for them
+ */
+extern void FreeFileContents(char *contents, size_t size);
+
+/**
+ * Read both ends of a regular file relative to a directory fd, for a cheap
+ * fingerprint that does not touch the middle of large files
+ * @param dirfd Directory file descriptor
+ * @param name Entry name (or relative path) in that directory
+ * @param edge Bytes wanted from each end
+ * @param buf Buffer of at least 2 * edge bytes: the head then the tail, or
+ * the whole file when it is no longer than 2 * edge
+ * @param out_size Output parameter for the number of bytes placed in buf
+ * @param file_size Output parameter for the size of the file
+ * @return true on success, false if the entry is not a non-empty regular
+ * file or cannot be opened
+ */
+extern bool ReadFileEdgesAt(int dirfd, const char *name, size_t edge,
+                            char *buf, size_t *out_size, size_t *file_size);
+
+/**
+ * Receives a regular file piece by piece
+ * @param data Bytes read, valid during the call
+ * @param len Number of bytes
+ * @param user_data Data given to ReadFileChunksAt
+ * @return true to keep reading, false to stop
+ */
+typedef bool (*ReadChunkFunc)(const char *data, size_t len, void *user_data);
+
+/**
+ * Stream a regular file relative to a directory fd through a buffer, so
+ * files of any size are read in constant memory
+ * @param dirfd Directory file descriptor
+ * @param name Entry name (or relative path) in that directory
+ * @param buf Buffer the chunks are read into
+ * @param buf_size Size of buf
+ * @param func Chunk callback
+ * @param user_data Data passed to func
+ * @return true if the whole file was read, false on error or when func
+ * stopped the read
+ */
+extern bool ReadFileChunksAt(int dirfd, const char *name, char *buf,
+                             size_t buf_size, ReadChunkFunc func,
+                             void *user_data);
+
 /**
  * Free array of FileEntry structures
  * @param entries Array to free
@@ -46,4 +108,32 @@ extern void FreeFileEntries(FileEntry **entries, int file_count);
  */
 extern bool cuda_search_files(const char *pattern, const char *directory);
 
+/**
+ * Search files in directory using CUDA, giving up early once cancelled.
+ * The token is checked between files and before the GPU pass.
+ * @param pattern Search pattern
+ * @param directory Directory to search
+ * @param cancellable Token of the query this search serves, or NULL
+ * @return true if pattern found, false otherwise or if cancelled
+ */
+extern bool cuda_search_files_cancellable(const char *pattern,
+                                          const char *directory,
+                                          GCancellable *cancellable);
+
+/**
+ * Search files in directory using CUDA and report where the time went:
+ * the walk is reading the directory, I/O is opening and reading the
+ * files, the match is the GPU pass
+ * @param pattern Search pattern
+ * @param directory Directory to search
+ * @param cancellable Token of the query this search serves, or NULL
+ * @param stats Record the search adds its counts and stage times to, or
+ * NULL
+ * @return true if pattern found, false otherwise or if cancelled
+ */
+extern bool cuda_search_files_stats(const char *pattern,
+                                    const char *directory,
+                                    GCancellable *cancellable,
+                                    SearchStats *stats);
+
 #endif // SEARCH_H
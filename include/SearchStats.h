@@ -0,0 +1,81 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  SEARCH_STAGE_WALK,  // Enumerating directories and filtering entries
+  SEARCH_STAGE_IO,    // Opening, sizing and reading files
+  SEARCH_STAGE_MATCH, // Testing names and contents against the pattern
+  SEARCH_STAGE_UI,    // Result callbacks on the main loop
+  SEARCH_STAGE_COUNT
+} SearchStage;
+
+/**
+ * Where one search spent its work. Workers add into it as they go; read it
+ * once the search has finished. Stage times are summed over every thread,
+ * so with parallel workers they can add up to more than the wall time.
+ */
+typedef struct {
+  gint64 entries;            // Directory entries enumerated
+  gint64 stats;              // stat and open+fstat calls issued
+  gint64 files_read;         // Files whose contents were read
+  gint64 bytes_read;         // Bytes of those files
+  gint64 bytes_scanned;      // Bytes the matcher went through
+  gint64 skipped_special;    // Directories, devices and other non-files
+  gint64 skipped_unreadable; // Files that could not be read, or were empty
+  gint64 skipped_ignored;    // Entries pruned by ignore rules
+  gint64 skipped_cached;     // Files an earlier search already ruled out
+  gint64 stage_us[SEARCH_STAGE_COUNT]; // Microseconds per stage
+  gint64 total_us;           // Wall time, start to the last result
+} SearchStats;
+
+/**
+ * Add one worker's counts into a search's record (any thread). Fields are
+ * added one by one with relaxed atomics, so workers can merge while
+ * others are still running.
+ * @param into Search's record
+ * @param from Worker's counts
+ */
+extern void SearchStats_merge(SearchStats *into, const SearchStats *from);
+
+/**
+ * Add time to one stage (any thread)
+ * @param stats Search's record
+ * @param stage Stage
+ * @param us Microseconds
+ */
+extern void SearchStats_add_time(SearchStats *stats, SearchStage stage,
+                                 gint64 us);
+
+/**
+ * Name of a stage, as used in the text and JSON forms
+ * @param stage Stage
+ * @return Static string
+ */
+extern const char *SearchStats_stage_name(SearchStage stage);
+
+/**
+ * One line for a status bar, e.g. "1204 entries, 1180 stats, 12.3 MB
+ * read, 12.3 MB scanned, 24 skipped (20 special, 4 ignored); walk 3 ms,
+ * io 41 ms, match 9 ms, ui 1 ms; 18 ms total". Skip reasons with no
+ * files are left out.
+ * @param stats Record of a finished search
+ * @return New string, free with g_free
+ */
+extern gchar *SearchStats_format(const SearchStats *stats);
+
+/**
+ * The record as one JSON object, every field in plain units
+ * @param stats Record of a finished search
+ * @return New string without a trailing newline, free with g_free
+ */
+extern gchar *SearchStats_to_json(const SearchStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // SEARCH_STATS_H
@@ -0,0 +1,105 @@
+#ifndef SORT_H
+#define SORT_H
+#include "Listing.h"
+#include "Scheduler.h"
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  SORT_BY_NAME,      // Natural, locale-aware filename order
+  SORT_BY_SIZE,      // Apparent size
+  SORT_BY_MTIME,     // Modification time
+  SORT_BY_TYPE,      // Content type
+  SORT_BY_EXTENSION, // Text after the last '.'
+  SORT_KEY_COUNT,
+} SortKey;
+
+typedef struct {
+  SortKey key;
+  gboolean descending;
+  gboolean directories_first; // Group folders ahead of files
+} SortSpec;
+
+/**
+ * Sort a listing. Ties on the chosen key fall back to name order. The
+ * first call per listing collates every name once (three-way radix
+ * quicksort over the collation keys); every later sort is a stable LSD
+ * radix sort over fixed-width keys, linear in the entry count. Size and
+ * time keys stat the entries on first use; on the main thread, load them
+ * with DirListing_load_stats first.
+ * @param listing Listing to sort (derived sort columns are filled in)
+ * @param spec Sort order
+ * @return Entry indices in display order (listing->count of them), free
+ * with g_free
+ */
+extern guint32 *DirListing_sort(DirListing *listing, const SortSpec *spec);
+
+/**
+ * Compute collation keys and name ranks if not done yet
+ * @param listing Listing to prepare
+ */
+extern void DirListing_ensure_name_order(DirListing *listing);
+
+/**
+ * Stat every entry for sizes and times if not done yet (symlinks report
+ * their target)
+ * @param listing Listing to prepare
+ * @return TRUE if the columns are available
+ */
+extern gboolean DirListing_ensure_stats(DirListing *listing);
+
+/**
+ * Receives a listing once its stat pass is over
+ * @param listing Listing, with sizes and mtimes unless its directory could
+ * not be opened
+ * @param user_data Data given to DirListing_load_stats
+ */
+typedef void (*DirListingStatsFunc)(DirListing *listing, gpointer user_data);
+
+/**
+ * DirListing_ensure_stats off the main thread: the entries are stat'ed by
+ * a task of the shared Scheduler and the columns put in place on the main
+ * loop, right before func runs. A cold directory of 500k entries takes
+ * seconds to stat.
+ * @param listing Listing to prepare (held until func has run)
+ * @param source Stat'ed listing of the same directory, e.g. the one listing
+ * was patched from, whose values are reused for entries with the same name
+ * and inode; NULL to stat every entry
+ * @param group Group of the task; cancelling it stops the pass between
+ * entries and func is not called
+ * @param func Completion callback, on the main loop
+ * @param user_data Data passed to func
+ */
+extern void DirListing_load_stats(DirListing *listing, DirListing *source,
+                                  SchedulerGroup *group,
+                                  DirListingStatsFunc func,
+                                  gpointer user_data);
+
+/**
+ * Whether sorting by a key needs the stat columns
+ * @param key Sort key
+ * @return TRUE for sizes and times
+ */
+extern gboolean SortKey_needs_stats(SortKey key);
+
+/**
+ * Carry the name order of a listing over to a patched copy of it: kept
+ * entries reuse their collation keys and relative order, and only the new
+ * entries are collated and merged in
+ * @param patched Listing built by DirListing_apply_changes
+ * @param source Listing it was built from (must have name ranks)
+ * @param source_index Index in source of each of the first kept entries
+ * @param kept_count Number of kept entries at the start of patched
+ */
+extern void DirListing_inherit_name_order(DirListing *patched,
+                                          const DirListing *source,
+                                          const int *source_index,
+                                          int kept_count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // SORT_H
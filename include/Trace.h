@@ -0,0 +1,93 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Builds with -Dtrace=false define this to 0: every span compiles away
+#ifndef CILE_TRACE
+#define CILE_TRACE 1
+#endif
+
+// Spans kept per thread; older ones are overwritten (a power of two)
+#define TRACE_RING_EVENTS 65536
+
+// Environment variable naming the file written at exit
+#define TRACE_ENV "CILE_TRACE"
+
+/**
+ * Time a span on the current thread. Near free while not recording: one
+ * load and a branch. The name must be a string literal.
+ *
+ *   TRACE_BEGIN(span);
+ *   ...
+ *   TRACE_END(span, "DirListing_load");
+ */
+#if CILE_TRACE
+#define TRACE_BEGIN(span) gint64 span = Trace_now()
+#define TRACE_END(span, name) TRACE_END_COUNT(span, name, -1)
+#define TRACE_END_COUNT(span, name, count)                                     \
+  do {                                                                         \
+    if (span)                                                                  \
+      Trace_span(name, span, count);                                           \
+  } while (0)
+#else
+#define TRACE_BEGIN(span)
+#define TRACE_END(span, name)
+#define TRACE_END_COUNT(span, name, count)
+#endif
+
+// Set while spans are recorded; read through Trace_now
+extern gboolean Trace_recording;
+
+/**
+ * Monotonic clock of the trace
+ * @return Nanoseconds, never 0
+ */
+extern gint64 Trace_clock(void);
+
+/**
+ * Start of a span
+ * @return Trace_clock(), or 0 when not recording
+ */
+static inline gint64 Trace_now(void) {
+  return Trace_recording ? Trace_clock() : 0;
+}
+
+/**
+ * Record a finished span in the calling thread's ring (any thread)
+ * @param name Span name, a string literal
+ * @param start Trace_now() at the start of the span, not 0
+ * @param count Items the span handled, shown as an argument, or -1
+ */
+extern void Trace_span(const char *name, gint64 start, gint64 count);
+
+/**
+ * Start recording spans, to be written to a file by Trace_stop
+ * @param path Chrome trace JSON output, opened in Perfetto or
+ * chrome://tracing
+ */
+extern void Trace_start(const char *path);
+
+/**
+ * Start recording if TRACE_ENV is set or the command line has
+ * --trace=FILE (or --trace FILE); the option is removed from argv, the
+ * flag wins over the environment
+ * @param argc Argument count, updated
+ * @param argv Arguments, updated
+ */
+extern void Trace_setup(int *argc, char **argv);
+
+/**
+ * Stop recording and write every thread's spans, oldest first, as Chrome
+ * trace JSON. Does nothing if not recording.
+ * @return FALSE if the file could not be written
+ */
+extern gboolean Trace_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // TRACE_H
@@ -0,0 +1,92 @@
+#ifndef TREE_SEARCH_H
+#define TREE_SEARCH_H
+#include "Query.h"
+#include "ResultStream.h"
+#include "Scheduler.h"
+#include "TreeWalk.h"
+#include <gio/gio.h>
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Matches handed to the main loop per callback
+#define TREE_SEARCH_BATCH 128
+
+// Cap on the window's results; more rows than this would not be browsable
+// anyway
+#define TREE_SEARCH_MAX_RESULTS 10000
+
+typedef struct {
+  const char *path;   // Relative to the searched root
+  GIcon *icon;        // Shared icon (never freed), may be NULL
+  unsigned char type; // DIR_TYPE_*
+  guint hits;         // Occurrences of the query's content text, if any
+} TreeMatch;
+
+/**
+ * Receives matches on the main loop, in batches of up to TREE_SEARCH_BATCH
+ * @param matches Matching entries (valid during the call)
+ * @param count Number of matches, may be 0 on the final call
+ * @param finished TRUE on the last call
+ * @param user_data Data given to TreeSearch_start
+ */
+typedef void (*TreeSearchFunc)(const TreeMatch *matches, guint count,
+                               gboolean finished, gpointer user_data);
+
+/**
+ * Query search over a directory tree. A parallel TreeWalk visits the
+ * entries and tests each one against the query right there on the worker,
+ * with the directory still open, so only matches ever leave the walk; they
+ * stream back through a ResultStream as they are found, so the first ones
+ * show up while the walk is still far from done.
+ */
+typedef struct {
+  TreeWalk *walk;            // Walk feeding the search
+  ResultStream *stream;      // Matches on their way to the main loop
+  Query *query;              // Planned query, owned
+  SchedulerGroup *group;     // Stops the walk; follows the caller's token
+  gint ref_count;            // Caller, the running walk, a running callback
+  guint max_results;         // Matches before the walk stops, 0 for all
+  gint match_count;          // Matches found so far
+  gint truncated;            // Stopped at max_results
+  TreeSearchFunc func;       // Result callback
+  gpointer user_data;        // Callback data
+  gint64 started_at;         // Monotonic time it started
+  SearchStats stats;         // Complete when the last callback runs, except
+                             // for that callback's own UI time
+} TreeSearch;
+
+/**
+ * Start searching a tree for entries matching a query
+ * @param root Directory to search from
+ * @param query Parsed query; the search takes ownership
+ * @param flags TREE_WALK_* options of the walk
+ * @param ignore Colon-separated directory names to prune, or NULL for
+ * TREE_WALK_DEFAULT_IGNORE
+ * @param max_results Matches after which the walk stops and truncated is
+ * set, e.g. TREE_SEARCH_MAX_RESULTS, or 0 for no limit
+ * @param cancellable Token that stops the search too, e.g. the query's, or
+ * NULL; stopping the search early leaves it alone
+ * @param func Result callback
+ * @param user_data Data passed to func
+ * @return New TreeSearch, stop it with TreeSearch_stop
+ */
+extern TreeSearch *TreeSearch_start(const char *root, Query *query,
+                                    TreeWalkFlags flags, const char *ignore,
+                                    guint max_results,
+                                    GCancellable *cancellable,
+                                    TreeSearchFunc func, gpointer user_data);
+
+/**
+ * Cancel a search if it is still running and release it. The callback is
+ * not called again.
+ * @param search Search to stop (from the main thread)
+ */
+extern void TreeSearch_stop(TreeSearch *search);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // TREE_SEARCH_H
@@ -0,0 +1,114 @@
+#ifndef TREE_WALK_H
+#define TREE_WALK_H
+#include "IgnoreRules.h"
+#include "Scheduler.h"
+#include "SearchStats.h"
+#include <gio/gio.h>
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Directory names never descended into unless the caller passes its own
+// set; overridable in the UI with CILE_SEARCH_IGNORE (colon-separated)
+#define TREE_WALK_DEFAULT_IGNORE                                               \
+  ".git:.hg:.svn:node_modules:build:_build:zig-out:.zig-cache:zig-cache:"      \
+  "target:__pycache__"
+
+typedef enum {
+  TREE_WALK_DEFAULT = 0,
+  TREE_WALK_IGNORE_FILES = 1 << 0, // Skip what .gitignore/.ignore files list
+  TREE_WALK_ONE_LEVEL = 1 << 1,    // Visit the root's entries only
+} TreeWalkFlags;
+
+typedef struct {
+  const char *dir_path; // Containing directory, relative to the root ("" for
+                        // the root itself)
+  const char *name;     // Entry name
+  unsigned char type;   // DIR_TYPE_*, symlinks are not resolved
+  int dirfd;            // Open fd of the containing directory
+} TreeWalkEntry;
+
+/**
+ * Called on a worker thread for every entry that is not pruned
+ * @param entry Entry, valid during the call
+ * @param user_data Data given to TreeWalk_start
+ */
+typedef void (*TreeWalkVisitFunc)(const TreeWalkEntry *entry,
+                                  gpointer user_data);
+
+/**
+ * Called once, on whichever worker thread finishes the walk last (or on
+ * the caller's thread if nothing could be walked). A small walk can end
+ * before TreeWalk_start returns, so the counts come with the call.
+ * @param stats Every directory's counts
+ * @param user_data Data given to TreeWalk_start
+ */
+typedef void (*TreeWalkDoneFunc)(const SearchStats *stats,
+                                 gpointer user_data);
+
+/**
+ * Parallel directory tree walk. Every directory is one user-initiated
+ * task of the shared Scheduler, so siblings are read concurrently and the
+ * root's own entries are visited first; between entries the walk yields
+ * to waiting interactive work. Ignored directory names are pruned before
+ * they are opened; symlinks are visited but never followed. With
+ * TREE_WALK_IGNORE_FILES each directory's ignore files are compiled once
+ * and handed down to its subdirectories' tasks, so matching stays a few
+ * lookups per entry however deep the tree.
+ */
+typedef struct {
+  int root_fd;               // Root directory
+  GHashTable *ignore;        // Directory names to prune
+  TreeWalkFlags flags;       // TREE_WALK_*
+  SchedulerGroup *group;     // Its tasks; their token stops the walk
+  gint ref_count;            // Caller plus one per queued directory
+  gint pending;              // Directories not finished yet
+  TreeWalkVisitFunc visit;   // Entry callback
+  TreeWalkDoneFunc done;     // Completion callback
+  gpointer user_data;        // Callback data
+  SearchStats stats;         // Entries, stats and ignored entries so far;
+                             // time in visit counts as matching, the rest
+                             // of each directory as walking
+  gboolean root_failed;      // The root could not be opened; set before
+                             // done is called
+} TreeWalk;
+
+/**
+ * Start walking a tree. Returns immediately.
+ * @param root Directory to walk
+ * @param ignore Colon-separated directory names to prune, or NULL for
+ * TREE_WALK_DEFAULT_IGNORE
+ * @param flags TREE_WALK_* options
+ * @param cancellable Stops the walk early, or NULL
+ * @param visit Entry callback (worker threads)
+ * @param done Completion callback, also called after a cancelled walk
+ * @param user_data Data passed to the callbacks
+ * @return New TreeWalk, release with TreeWalk_unref
+ */
+extern TreeWalk *TreeWalk_start(const char *root, const char *ignore,
+                                TreeWalkFlags flags,
+                                GCancellable *cancellable,
+                                TreeWalkVisitFunc visit,
+                                TreeWalkDoneFunc done, gpointer user_data);
+
+/**
+ * Release the caller's reference. The walk keeps going until it finishes
+ * or its cancellable is cancelled.
+ * @param walk Walk to release
+ */
+extern void TreeWalk_unref(TreeWalk *walk);
+
+/**
+ * Join a directory path relative to the root and an entry name
+ * @param dir_path Relative directory path, "" for the root
+ * @param name Entry name
+ * @return Relative path of the entry, free with g_free
+ */
+extern gchar *TreeWalk_join(const char *dir_path, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // TREE_WALK_H
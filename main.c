@@ -1,6 +1,10 @@
+#include "Budget.h"
+#include "Cli.h"
+#include "Metrics.h"
 #include "Pages/MainPage.h"
 #include "Pages/Sidebar.h"
 #include "Pages/Topbar.h"
+#include "Trace.h"
 #include <gtk/gtk.h>
 
 typedef struct {
@@ -180,6 +184,22 @@ static void activate(GtkApplication *app, gpointer user_data) {
 }
 
 int main(int argc, char **argv) {
+  // CILE_TRACE=FILE or --trace=FILE records spans, written out at exit
+  Trace_setup(&argc, argv);
+
+  // kill -USR1 writes the runtime metrics as JSON
+  Metrics_install_dump_signal();
+
+  // Scripted runs never touch GTK, so they work without a display
+  if (Cli_is_headless(argc, argv)) {
+    int status = Cli_main(argc, argv);
+    Trace_stop();
+    return status;
+  }
+
+  // Caches shrink when the session reports memory pressure
+  Budget_watch_memory_monitor();
+
   GtkApplication *app =
       gtk_application_new("com.example.explorer",    // application_id
                           G_APPLICATION_FLAGS_NONE); // flags
@@ -194,6 +214,7 @@ int main(int argc, char **argv) {
                                  argv);              // argv
 
   g_object_unref(app);
+  Trace_stop();
 
   return status;
 }
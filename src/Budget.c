@@ -0,0 +1,298 @@
+#define _DEFAULT_SOURCE
+#include "Budget.h"
+#include "Cgroup.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+typedef struct {
+  BudgetReclaimFunc func;
+  gpointer user_data;
+} Reclaimer;
+
+static GMutex lock;
+static GCond room;             // Broadcast when memory is given back
+static gsize limit;            // 0 until first use
+static gboolean limit_fixed;   // Set by Budget_set_limit, not re-read
+static gsize in_flight;        // Buffers being read or searched
+static gint64 cached;          // Caches
+static guint64 next_ticket;    // Handed to readers in arrival order
+static guint64 serving;        // Ticket allowed to take memory next
+static guint waiting;          // Readers blocked in Budget_acquire
+static gsize reclaim_wanted;   // Largest request since the last reclaim
+static gboolean reclaim_queued;
+static GArray *reclaimers;     // Reclaimer, in registration order
+static GMemoryMonitor *monitor;
+
+static gsize default_limit(void);
+static gsize held(void);
+static gboolean fits(gsize bytes);
+static gsize shortfall(gsize bytes);
+static void request_reclaim(gsize bytes);
+static gboolean run_reclaim(gpointer user_data);
+static void on_low_memory(GMemoryMonitor *memory_monitor,
+                          GMemoryMonitorWarningLevel level,
+                          gpointer user_data);
+
+void Budget_acquire(gsize bytes) {
+  g_mutex_lock(&lock);
+  if (limit == 0) {
+    limit = default_limit();
+  }
+
+  guint64 ticket = next_ticket++;
+  if (ticket != serving || !fits(bytes)) {
+    TRACE_BEGIN(span);
+    Metrics_add(METRIC_BUDGET_WAITS, 1);
+    waiting++;
+    while (ticket != serving || !fits(bytes)) {
+      // Only the head of the line asks for room; the rest wait their turn
+      if (ticket == serving) {
+        request_reclaim(shortfall(bytes));
+      }
+      g_cond_wait(&room, &lock);
+    }
+    waiting--;
+    TRACE_END_COUNT(span, "budget_wait", bytes);
+  }
+
+  serving++;
+  in_flight += bytes;
+  // The next in line may fit as well
+  if (waiting > 0) {
+    g_cond_broadcast(&room);
+  }
+  g_mutex_unlock(&lock);
+}
+
+gboolean Budget_try_acquire(gsize bytes) {
+  g_mutex_lock(&lock);
+  if (limit == 0) {
+    limit = default_limit();
+  }
+
+  // Never overtake a waiting reader
+  gboolean granted = next_ticket == serving && fits(bytes);
+  if (granted) {
+    next_ticket++;
+    serving++;
+    in_flight += bytes;
+  } else {
+    request_reclaim(shortfall(bytes));
+  }
+  g_mutex_unlock(&lock);
+  return granted;
+}
+
+void Budget_release(gsize bytes) {
+  g_mutex_lock(&lock);
+  in_flight -= MIN(bytes, in_flight);
+  if (waiting > 0) {
+    g_cond_broadcast(&room);
+  }
+  g_mutex_unlock(&lock);
+}
+
+void Budget_charge_cache(gint64 bytes) {
+  if (bytes == 0)
+    return;
+
+  g_mutex_lock(&lock);
+  if (limit == 0) {
+    limit = default_limit();
+  }
+
+  cached += bytes;
+  if (bytes < 0 && waiting > 0) {
+    g_cond_broadcast(&room);
+  } else if (bytes > 0 && held() > limit) {
+    request_reclaim(held() - limit);
+  }
+  g_mutex_unlock(&lock);
+}
+
+void Budget_add_reclaimer(BudgetReclaimFunc func, gpointer user_data) {
+  Reclaimer reclaimer = {func, user_data};
+
+  g_mutex_lock(&lock);
+  if (!reclaimers) {
+    reclaimers = g_array_new(FALSE, FALSE, sizeof(Reclaimer));
+  }
+  g_array_append_val(reclaimers, reclaimer);
+  g_mutex_unlock(&lock);
+}
+
+void Budget_remove_reclaimer(BudgetReclaimFunc func, gpointer user_data) {
+  g_mutex_lock(&lock);
+  for (guint i = 0; reclaimers && i < reclaimers->len; i++) {
+    Reclaimer *reclaimer = &g_array_index(reclaimers, Reclaimer, i);
+    if (reclaimer->func == func && reclaimer->user_data == user_data) {
+      g_array_remove_index(reclaimers, i);
+      break;
+    }
+  }
+  g_mutex_unlock(&lock);
+}
+
+gsize Budget_reclaim(gsize bytes) {
+  if (bytes == 0)
+    return 0;
+
+  // Reclaimers charge their evictions back, which takes the lock
+  g_mutex_lock(&lock);
+  GArray *targets = NULL;
+  if (reclaimers && reclaimers->len > 0) {
+    targets = g_array_copy(reclaimers);
+  }
+  g_mutex_unlock(&lock);
+  if (!targets)
+    return 0;
+
+  TRACE_BEGIN(span);
+  gsize freed = 0;
+  for (guint i = 0; i < targets->len && freed < bytes; i++) {
+    Reclaimer *reclaimer = &g_array_index(targets, Reclaimer, i);
+    freed += reclaimer->func(bytes - freed, reclaimer->user_data);
+  }
+  g_array_unref(targets);
+  TRACE_END_COUNT(span, "budget_reclaim", freed);
+
+  Metrics_add(METRIC_BUDGET_RECLAIMED_BYTES, freed);
+  return freed;
+}
+
+void Budget_set_limit(gsize bytes) {
+  gsize new_limit = bytes ? bytes : default_limit();
+
+  g_mutex_lock(&lock);
+  limit = new_limit;
+  limit_fixed = bytes != 0;
+  if (waiting > 0) {
+    g_cond_broadcast(&room);
+  }
+  if (held() > limit) {
+    request_reclaim(held() - limit);
+  }
+  g_mutex_unlock(&lock);
+}
+
+void Budget_snapshot(BudgetSnapshot *snapshot) {
+  g_mutex_lock(&lock);
+  if (limit == 0) {
+    limit = default_limit();
+  }
+  snapshot->limit = limit;
+  snapshot->in_flight = in_flight;
+  snapshot->cached = (gsize)MAX(cached, 0);
+  snapshot->waiting = waiting;
+  g_mutex_unlock(&lock);
+}
+
+void Budget_watch_memory_monitor(void) {
+  if (monitor)
+    return;
+
+  monitor = g_memory_monitor_dup_default();
+  if (monitor) {
+    g_signal_connect(monitor, "low-memory-warning",
+                     G_CALLBACK(on_low_memory), NULL);
+  }
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static gsize default_limit(void) {
+  const char *env_limit = g_getenv(BUDGET_ENV);
+  if (env_limit && atol(env_limit) > 0)
+    return (gsize)atol(env_limit) * 1024 * 1024;
+
+  guint64 memory = (guint64)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+  if (memory == 0) {
+    memory = G_MAXUINT64;
+  }
+  guint64 available = MIN(memory, Cgroup_memory_limit());
+  if (available == G_MAXUINT64)
+    return G_MAXSIZE;
+  return (gsize)(available / BUDGET_SHARE);
+}
+
+// With the lock held
+static gsize held(void) {
+  return in_flight + (gsize)MAX(cached, 0);
+}
+
+// With the lock held. A lone reader always fits, so a file larger than
+// the whole budget still gets read, one at a time.
+static gboolean fits(gsize bytes) {
+  return in_flight == 0 || held() + bytes <= limit;
+}
+
+// With the lock held: what the caches would have to give back
+static gsize shortfall(gsize bytes) {
+  gsize wanted = held() + bytes;
+  return wanted > limit ? MIN(wanted - limit, (gsize)MAX(cached, 0)) : 0;
+}
+
+// With the lock held. Caches are main thread only, so reclaiming runs on
+// the main loop; requests that arrive before it runs are merged.
+static void request_reclaim(gsize bytes) {
+  if (bytes == 0 || !reclaimers || reclaimers->len == 0)
+    return;
+
+  reclaim_wanted = MAX(reclaim_wanted, bytes);
+  if (!reclaim_queued) {
+    reclaim_queued = TRUE;
+    g_idle_add_full(G_PRIORITY_HIGH, // priority
+                    run_reclaim,     // function
+                    NULL,            // data
+                    NULL);           // notify
+  }
+}
+
+static gboolean run_reclaim(gpointer user_data) {
+  g_mutex_lock(&lock);
+  gsize wanted = reclaim_wanted;
+  reclaim_wanted = 0;
+  reclaim_queued = FALSE;
+  g_mutex_unlock(&lock);
+
+  Budget_reclaim(wanted);
+  return G_SOURCE_REMOVE;
+}
+
+// The higher the level, the more the caches drop: a quarter of what they
+// hold on a low warning, half on a medium one, everything on a critical one
+static void on_low_memory(GMemoryMonitor *memory_monitor,
+                          GMemoryMonitorWarningLevel level,
+                          gpointer user_data) {
+  // The cgroup may have been shrunk since the limit was read
+  g_mutex_lock(&lock);
+  gboolean reread = !limit_fixed;
+  g_mutex_unlock(&lock);
+  if (reread) {
+    Budget_set_limit(0);
+  }
+
+  BudgetSnapshot snapshot;
+  Budget_snapshot(&snapshot);
+  gsize wanted = snapshot.cached / 4;
+  if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL) {
+    wanted = snapshot.cached;
+  } else if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM) {
+    wanted = snapshot.cached / 2;
+  }
+  Budget_reclaim(wanted);
+
+#ifdef __GLIBC__
+  // Evicted listings are freed to the heap; hand whole pages back
+  malloc_trim(0);
+#endif
+}
@@ -0,0 +1,152 @@
+#include "Cgroup.h"
+
+#include <stdlib.h>
+
+/**
+ * Reads the limits of one cgroup directory into the caller's result
+ * @param dir Directory of the cgroup under its hierarchy's mount
+ * @param user_data Result being folded
+ */
+typedef void (*CgroupDirFunc)(const char *dir, gpointer user_data);
+
+static void each_cgroup_dir(const char *controller, CgroupDirFunc v2_func,
+                            CgroupDirFunc v1_func, gpointer user_data);
+static guint64 read_limit_file(const char *dir, const char *file);
+static void memory_v2(const char *dir, gpointer user_data);
+static void memory_v1(const char *dir, gpointer user_data);
+static void cpu_v2(const char *dir, gpointer user_data);
+static void cpu_v1(const char *dir, gpointer user_data);
+
+guint64 Cgroup_memory_limit(void) {
+  guint64 lowest = G_MAXUINT64;
+  each_cgroup_dir("memory", memory_v2, memory_v1, &lowest);
+  return lowest;
+}
+
+gdouble Cgroup_cpu_quota(void) {
+  gdouble lowest = 0;
+  each_cgroup_dir("cpu", cpu_v2, cpu_v1, &lowest);
+  return lowest;
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+// Every directory from the process's cgroup up to the root, for the v2
+// hierarchy and for the v1 hierarchy holding controller. Inside a
+// container the namespace root is mounted at /sys/fs/cgroup, and
+// /proc/self/cgroup shows paths relative to it.
+static void each_cgroup_dir(const char *controller, CgroupDirFunc v2_func,
+                            CgroupDirFunc v1_func, gpointer user_data) {
+  gchar *text = NULL;
+  if (!g_file_get_contents("/proc/self/cgroup", &text, NULL, NULL))
+    return;
+
+  gchar **lines = g_strsplit(text, "\n", -1);
+  for (gchar **line = lines; *line; line++) {
+    // hierarchy-ID:controller-list:cgroup-path
+    gchar **fields = g_strsplit(*line, ":", 3);
+    if (g_strv_length(fields) != 3) {
+      g_strfreev(fields);
+      continue;
+    }
+
+    gchar **controllers = g_strsplit(fields[1], ",", -1);
+    gchar *mount = NULL;
+    CgroupDirFunc func = NULL;
+    if (fields[1][0] == '\0') {
+      mount = g_strdup("/sys/fs/cgroup");
+      func = v2_func;
+    } else if (g_strv_contains((const gchar *const *)controllers,
+                               controller)) {
+      // Co-mounted controllers share a directory, e.g. cpu,cpuacct
+      mount = g_build_filename("/sys/fs/cgroup", fields[1], NULL);
+      func = v1_func;
+    }
+
+    gchar *dir = g_strdup(fields[2]);
+    while (func) {
+      gchar *path = g_build_filename(mount, dir, NULL);
+      func(path, user_data);
+      g_free(path);
+      if (g_strcmp0(dir, "/") == 0 || g_strcmp0(dir, ".") == 0)
+        break;
+
+      gchar *parent = g_path_get_dirname(dir);
+      g_free(dir);
+      dir = parent;
+    }
+    g_free(dir);
+    g_free(mount);
+    g_strfreev(controllers);
+    g_strfreev(fields);
+  }
+  g_strfreev(lines);
+  g_free(text);
+}
+
+// A cgroup limit file: a number, or "max" for none. Missing files, zero
+// and negative values (v1's -1) read as no limit.
+static guint64 read_limit_file(const char *dir, const char *file) {
+  gchar *path = g_build_filename(dir, file, NULL);
+  gchar *text = NULL;
+  gboolean found = g_file_get_contents(path, &text, NULL, NULL);
+  g_free(path);
+  if (!found)
+    return G_MAXUINT64;
+
+  guint64 value = 0;
+  if (!g_str_has_prefix(text, "max") && text[0] != '-') {
+    value = g_ascii_strtoull(text, NULL, 10);
+  }
+  g_free(text);
+  return value ? value : G_MAXUINT64;
+}
+
+static void memory_v2(const char *dir, gpointer user_data) {
+  guint64 *lowest = (guint64 *)user_data;
+  *lowest = MIN(*lowest, read_limit_file(dir, "memory.max"));
+  *lowest = MIN(*lowest, read_limit_file(dir, "memory.high"));
+}
+
+static void memory_v1(const char *dir, gpointer user_data) {
+  guint64 *lowest = (guint64 *)user_data;
+  *lowest = MIN(*lowest, read_limit_file(dir, "memory.limit_in_bytes"));
+}
+
+static void fold_quota(gdouble *lowest, guint64 quota, guint64 period) {
+  if (quota == G_MAXUINT64 || period == G_MAXUINT64)
+    return;
+
+  gdouble cpus = (gdouble)quota / (gdouble)period;
+  if (*lowest == 0 || cpus < *lowest) {
+    *lowest = cpus;
+  }
+}
+
+// "quota period", where quota may be "max"
+static void cpu_v2(const char *dir, gpointer user_data) {
+  gchar *path = g_build_filename(dir, "cpu.max", NULL);
+  gchar *text = NULL;
+  gboolean found = g_file_get_contents(path, &text, NULL, NULL);
+  g_free(path);
+  if (!found)
+    return;
+
+  if (!g_str_has_prefix(text, "max")) {
+    gchar *end = NULL;
+    guint64 quota = g_ascii_strtoull(text, &end, 10);
+    guint64 period = g_ascii_strtoull(end, NULL, 10);
+    if (quota > 0 && period > 0) {
+      fold_quota((gdouble *)user_data, quota, period);
+    }
+  }
+  g_free(text);
+}
+
+static void cpu_v1(const char *dir, gpointer user_data) {
+  fold_quota((gdouble *)user_data,                     // lowest
+             read_limit_file(dir, "cpu.cfs_quota_us"),   // quota
+             read_limit_file(dir, "cpu.cfs_period_us")); // period
+}
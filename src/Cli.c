@@ -0,0 +1,238 @@
+#include "Cli.h"
+#include "DirReader.h"
+#include "Listing.h"
+#include "Query.h"
+#include "Sort.h"
+#include "TreeSearch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  gboolean json;     // NDJSON output
+  gboolean content;  // Bare words search contents
+  guint match_count; // Results printed
+  gboolean finished; // Final callback seen
+} CliSearch;
+
+static const char *type_name(unsigned char type);
+static void print_json_string(const char *text);
+static int run_search(const char *pattern, const char *dir,
+                      gboolean recursive, gboolean content, gboolean json,
+                      gboolean stats);
+static int run_list(const char *dir, gboolean json);
+
+// The spellings of --search and --list that Cli_main's options accept;
+// anything after "--" is a file name
+gboolean Cli_is_headless(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--") == 0)
+      break;
+    if (strcmp(arg, "-s") == 0 || strcmp(arg, "--search") == 0 ||
+        g_str_has_prefix(arg, "--search=") || strcmp(arg, "-l") == 0 ||
+        strcmp(arg, "--list") == 0)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+int Cli_main(int argc, char **argv) {
+  gchar *pattern = NULL;
+  gboolean list = FALSE;
+  gboolean recursive = FALSE;
+  gboolean content = FALSE;
+  gboolean json = FALSE;
+  gboolean stats = FALSE;
+  GOptionEntry entries[] = {
+      {"search", 's', 0, G_OPTION_ARG_STRING, &pattern,
+       "Print entries matching a query", "PATTERN"},
+      {"recursive", 'r', 0, G_OPTION_ARG_NONE, &recursive,
+       "Search subfolders too, honouring ignore files", NULL},
+      {"content", 'c', 0, G_OPTION_ARG_NONE, &content,
+       "Match bare words against file contents", NULL},
+      {"list", 'l', 0, G_OPTION_ARG_NONE, &list, "List a directory", NULL},
+      {"json", 'j', 0, G_OPTION_ARG_NONE, &json,
+       "One JSON object per line", NULL},
+      {"stats", 0, 0, G_OPTION_ARG_NONE, &stats,
+       "Print where the search spent its time to stderr", NULL},
+      {NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL},
+  };
+
+  GOptionContext *context = g_option_context_new("DIR");
+  g_option_context_add_main_entries(context, entries, NULL);
+  GError *error = NULL;
+  gboolean parsed = g_option_context_parse(context, &argc, &argv, &error);
+  g_option_context_free(context);
+
+  int status = CLI_EXIT_ERROR;
+  if (!parsed) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+  } else if (argc != 2 || list == (pattern != NULL)) {
+    g_printerr("Usage: %s --search PATTERN [--recursive] [--content] "
+               "[--json] [--stats] DIR\n"
+               "       %s --list [--json] DIR\n",
+               g_get_prgname(), g_get_prgname());
+  } else if (!g_file_test(argv[1], G_FILE_TEST_IS_DIR)) {
+    g_printerr("%s: not a directory\n", argv[1]);
+  } else if (list) {
+    status = run_list(argv[1], json);
+  } else {
+    status = run_search(pattern, argv[1], recursive, content, json, stats);
+  }
+
+  g_free(pattern);
+  return status;
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static const char *type_name(unsigned char type) {
+  switch (type) {
+  case DIR_TYPE_REG:
+    return "file";
+  case DIR_TYPE_DIR:
+    return "dir";
+  case DIR_TYPE_LNK:
+    return "link";
+  case DIR_TYPE_FIFO:
+    return "fifo";
+  case DIR_TYPE_SOCK:
+    return "socket";
+  case DIR_TYPE_CHR:
+    return "char";
+  case DIR_TYPE_BLK:
+    return "block";
+  default:
+    return "unknown";
+  }
+}
+
+// Quoted and escaped; bytes that are not UTF-8 become U+FFFD so every
+// line stays valid JSON
+static void print_json_string(const char *text) {
+  gchar *valid = NULL;
+  if (!g_utf8_validate(text, -1, NULL)) {
+    valid = g_utf8_make_valid(text, -1);
+    text = valid;
+  }
+
+  putchar('"');
+  for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+    if (*p == '"' || *p == '\\') {
+      putchar('\\');
+      putchar(*p);
+    } else if (*p < 0x20) {
+      printf("\\u%04x", *p);
+    } else {
+      putchar(*p);
+    }
+  }
+  putchar('"');
+  g_free(valid);
+}
+
+static void on_matches(const TreeMatch *matches, guint count,
+                       gboolean finished, gpointer user_data) {
+  CliSearch *search = (CliSearch *)user_data;
+
+  for (guint i = 0; i < count; i++) {
+    if (!search->json) {
+      puts(matches[i].path);
+      continue;
+    }
+    fputs("{\"path\":", stdout);
+    print_json_string(matches[i].path);
+    printf(",\"type\":\"%s\"", type_name(matches[i].type));
+    if (search->content) {
+      printf(",\"hits\":%u", matches[i].hits);
+    }
+    fputs("}\n", stdout);
+  }
+  search->match_count += count;
+
+  // Each batch goes out as it arrives, even into a pipe
+  fflush(stdout);
+  if (finished) {
+    search->finished = TRUE;
+  }
+}
+
+// The search the window runs: a query over the folder, or over the tree
+// below it with ignore files honoured. Its breakdown goes to stderr so the
+// results stay pipeable.
+static int run_search(const char *pattern, const char *dir,
+                      gboolean recursive, gboolean content, gboolean json,
+                      gboolean stats) {
+  Query *query =
+      Query_parse(pattern, content ? QUERY_WORDS_CONTENT : QUERY_DEFAULT);
+  CliSearch search = {json, Query_has_content(query), 0, FALSE};
+  TreeWalkFlags flags =
+      recursive ? TREE_WALK_IGNORE_FILES : TREE_WALK_ONE_LEVEL;
+  const char *ignore = recursive ? g_getenv("CILE_SEARCH_IGNORE") : "";
+
+  TreeSearch *tree = TreeSearch_start(dir,        // root
+                                      query,      // query
+                                      flags,      // flags
+                                      ignore,     // ignore
+                                      0,          // max_results
+                                      NULL,       // cancellable
+                                      on_matches, // func
+                                      &search);   // user_data
+  while (!search.finished) {
+    g_main_context_iteration(NULL, TRUE);
+  }
+
+  if (stats) {
+    gchar *text = json ? SearchStats_to_json(&tree->stats)
+                       : SearchStats_format(&tree->stats);
+    g_printerr(json ? "{\"stats\":%s}\n" : "%s\n", text);
+    g_free(text);
+  }
+
+  // A root that passed the directory test but cannot be read is an error,
+  // not an empty result
+  int status = search.match_count ? CLI_EXIT_MATCH : CLI_EXIT_NO_MATCH;
+  if (tree->walk->root_failed) {
+    g_printerr("%s: cannot read directory\n", dir);
+    status = CLI_EXIT_ERROR;
+  }
+  TreeSearch_stop(tree);
+  return status;
+}
+
+static int run_list(const char *dir, gboolean json) {
+  DirListing *listing = DirListing_load(dir);
+  if (!listing) {
+    g_printerr("%s: cannot read directory\n", dir);
+    return CLI_EXIT_ERROR;
+  }
+
+  SortSpec spec = {SORT_BY_NAME, FALSE, TRUE};
+  guint32 *order = DirListing_sort(listing, &spec);
+  gboolean stats = json && DirListing_ensure_stats(listing);
+
+  for (int i = 0; i < listing->count; i++) {
+    guint32 index = order[i];
+    if (!json) {
+      puts(listing->names[index]);
+      continue;
+    }
+    fputs("{\"name\":", stdout);
+    print_json_string(listing->names[index]);
+    printf(",\"type\":\"%s\"", type_name(listing->types[index]));
+    if (stats) {
+      printf(",\"size\":%" G_GUINT64_FORMAT ",\"mtime\":%" G_GINT64_FORMAT,
+             (guint64)listing->sizes[index], (gint64)listing->mtimes[index]);
+    }
+    fputs("}\n", stdout);
+  }
+
+  int status = listing->count ? CLI_EXIT_MATCH : CLI_EXIT_NO_MATCH;
+  g_free(order);
+  DirListing_unref(listing);
+  return status;
+}
@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+#include "ContentSearch.h"
+#include "DirReader.h"
+#include "Metrics.h"
+#include "Search.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+  ResultNode node;
+  ContentMatch match;
+} ContentResult;
+
+typedef struct {
+  ContentSearch *search; // Holds a reference
+  guint first;           // First index into search->files
+  guint count;           // Files in this task
+} ContentTask;
+
+static void search_task(gpointer data);
+static void deliver_matches(ResultNode **items, guint count,
+                            gboolean finished, gpointer user_data);
+static void unref_search(ContentSearch *search);
+
+ContentSearch *ContentSearch_start(DirListing *listing, const guint32 *files,
+                                   guint file_count, const char *pattern,
+                                   GCancellable *cancellable,
+                                   ContentSearchFunc func,
+                                   gpointer user_data) {
+  ContentSearch *search = g_new0(ContentSearch, 1);
+  search->listing = DirListing_ref(listing);
+  search->dirfd = open(listing->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  search->pattern = g_strdup(pattern);
+  search->pattern_len = strlen(pattern);
+  search->started_at = g_get_monotonic_time();
+  search->group = SchedulerGroup_new(SCHEDULER_INTERACTIVE, cancellable);
+  search->ref_count = 1;
+  search->func = func;
+  search->user_data = user_data;
+
+  // Symlinks may point at regular files; ReadFileAt checks the target
+  guint searchable = 0;
+  if (!files) {
+    search->files = g_new(guint32, listing->count + 1);
+  }
+  for (int i = 0; i < listing->count; i++) {
+    if (listing->types[i] == DIR_TYPE_REG ||
+        listing->types[i] == DIR_TYPE_LNK) {
+      if (!files) {
+        search->files[searchable] = (guint32)i;
+      }
+      searchable++;
+    }
+  }
+  if (files) {
+    search->files = g_memdup2(files, file_count * sizeof(guint32));
+    search->file_count = file_count;
+  } else {
+    search->file_count = searchable;
+  }
+
+  // The listing was read before the search: its walk is picking the files
+  search->stats.entries = listing->count;
+  search->stats.skipped_special = listing->count - searchable;
+  search->stats.skipped_cached =
+      MAX((gint64)searchable - (gint64)search->file_count, 0);
+  search->stats.stage_us[SEARCH_STAGE_WALK] =
+      g_get_monotonic_time() - search->started_at;
+
+  search->stream =
+      ResultStream_new(CONTENT_SEARCH_BATCH, deliver_matches, search);
+
+  guint tasks = (search->file_count + CONTENT_SEARCH_TASK_FILES - 1) /
+                CONTENT_SEARCH_TASK_FILES;
+  if (search->dirfd < 0 || search->pattern_len == 0) {
+    tasks = 0;
+  }
+
+  ResultStream_add_work(search->stream, tasks);
+  for (guint t = 0; t < tasks; t++) {
+    ContentTask *task = g_new(ContentTask, 1);
+    task->search = search;
+    task->first = t * CONTENT_SEARCH_TASK_FILES;
+    task->count = MIN(CONTENT_SEARCH_TASK_FILES,
+                      search->file_count - task->first);
+    g_atomic_int_inc(&search->ref_count);
+    Scheduler_push(search->group, search_task, task);
+  }
+
+  // Every task is counted: the stream may finish from here on
+  ResultStream_work_done(search->stream);
+  return search;
+}
+
+void ContentSearch_stop(ContentSearch *search) {
+  if (!search)
+    return;
+
+  // Only the search's own group: the query's token may still be serving
+  // other work
+  if (!search->stream->done) {
+    SchedulerGroup_cancel(search->group);
+  }
+
+  ResultStream_close(search->stream);
+  unref_search(search);
+}
+
+guint ContentSearch_count(const char *text, gsize text_len,
+                          const char *pattern, gsize pattern_len) {
+  guint hits = 0;
+  const char *end = text + text_len;
+
+  while ((gsize)(end - text) >= pattern_len) {
+    const char *found = memmem(text, end - text, pattern, pattern_len);
+    if (!found)
+      break;
+    hits++;
+    text = found + pattern_len;
+  }
+  return hits;
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+// Last reference may be dropped by a worker; every step here is safe off
+// the main thread
+static void unref_search(ContentSearch *search) {
+  if (!g_atomic_int_dec_and_test(&search->ref_count))
+    return;
+
+  ResultStream_free(search->stream);
+  if (search->dirfd >= 0) {
+    close(search->dirfd);
+  }
+  SchedulerGroup_unref(search->group);
+  DirListing_unref(search->listing);
+  g_free(search->files);
+  g_free(search->pattern);
+  g_free(search);
+}
+
+static void search_task(gpointer data) {
+  ContentTask *task = (ContentTask *)data;
+  ContentSearch *search = task->search;
+  gint64 start = g_get_monotonic_time();
+  SearchStats local = {0};
+
+  for (guint i = task->first; i < task->first + task->count; i++) {
+    if (g_cancellable_is_cancelled(search->group->cancellable))
+      break;
+
+    guint32 index = search->files[i];
+    size_t size = 0;
+    gint64 read_start = g_get_monotonic_time();
+    char *contents =
+        ReadFileAt(search->dirfd, search->listing->names[index], &size);
+    gint64 read_end = g_get_monotonic_time();
+    local.stage_us[SEARCH_STAGE_IO] += read_end - read_start;
+    local.stats++;
+    if (!contents) {
+      Metrics_add(METRIC_FILES_SKIPPED, 1);
+      local.skipped_unreadable++;
+      continue;
+    }
+    Metrics_add(METRIC_FILES_SCANNED, 1);
+    local.files_read++;
+    local.bytes_read += size;
+
+    guint hits = ContentSearch_count(contents,             // text
+                                     size,                 // text_len
+                                     search->pattern,      // pattern
+                                     search->pattern_len); // pattern_len
+    FreeFileContents(contents, size);
+    local.bytes_scanned += size;
+    local.stage_us[SEARCH_STAGE_MATCH] += g_get_monotonic_time() - read_end;
+
+    if (hits > 0) {
+      ContentResult *result = g_new(ContentResult, 1);
+      result->match.index = index;
+      result->match.hits = hits;
+      ResultStream_push(search->stream, &result->node,
+                        sizeof(ContentResult));
+    }
+  }
+
+  // Bytes per microsecond: MB/s
+  gint64 elapsed = g_get_monotonic_time() - start;
+  Metrics_add(METRIC_BYTES_SCANNED, local.bytes_scanned);
+  if (local.bytes_scanned > 0) {
+    Metrics_record(METRIC_SCAN_MBPS, local.bytes_scanned / MAX(elapsed, 1));
+  }
+
+  // Before the work is done: the last callback sees every task's counts
+  SearchStats_merge(&search->stats, &local);
+  ResultStream_work_done(search->stream);
+  unref_search(search);
+  g_free(task);
+}
+
+static void deliver_matches(ResultNode **items, guint count,
+                            gboolean finished, gpointer user_data) {
+  ContentSearch *search = (ContentSearch *)user_data;
+  ContentMatch matches[CONTENT_SEARCH_BATCH];
+
+  for (guint i = 0; i < count; i++) {
+    matches[i] = ((ContentResult *)items[i])->match;
+    g_free(items[i]);
+  }
+  gint64 ui_start = g_get_monotonic_time();
+  if (finished) {
+    search->stats.total_us = ui_start - search->started_at;
+    Metrics_record(METRIC_CONTENT_SEARCH_US, search->stats.total_us);
+  }
+
+  // The callback may stop the search: hold it until the time is added
+  g_atomic_int_inc(&search->ref_count);
+  search->func(matches, count, finished, search->user_data);
+  SearchStats_add_time(&search->stats, SEARCH_STAGE_UI,
+                       g_get_monotonic_time() - ui_start);
+  unref_search(search);
+}
@@ -0,0 +1,522 @@
+#define _DEFAULT_SOURCE
+#define INOTIFY_BUFFER_SIZE (64 * 1024)
+#define DIR_CACHE_WATCH_MASK                                                   \
+  (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY |           \
+   IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK)
+
+#include "DirCache.h"
+#include "Budget.h"
+#include "Metrics.h"
+
+#include <errno.h>
+#include <glib-unix.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+typedef struct {
+  DirListing *listing;
+  int wd;
+  GList *lru_link;       // Node in DirCache.lru, data points back to this entry
+  GHashTable *pending;   // Names touched since the last flush, NULL if none
+  gboolean reload;       // Changed before it was watched: read it again
+  gboolean speculative;  // Prefetched and not looked up yet
+  gsize accounted_bytes; // Share of used_bytes charged to this entry
+} DirCacheEntry;
+
+static void remove_entry(DirCache *cache, DirCacheEntry *entry,
+                         gboolean remove_watch);
+static void reload_entry(DirCache *cache, DirCacheEntry *entry);
+static void schedule_flush(DirCache *cache);
+static gboolean on_inotify_readable(gint fd, GIOCondition condition,
+                                    gpointer user_data);
+static gsize reclaim_listings(gsize bytes, gpointer user_data);
+
+DirCache *DirCache_new(gsize budget_bytes) {
+  DirCache *cache = g_new0(DirCache, 1);
+
+  if (budget_bytes == 0) {
+    const char *env_budget = g_getenv("CILE_DIR_CACHE_MB");
+    budget_bytes = env_budget ? (gsize)atol(env_budget) * 1024 * 1024
+                              : DIR_CACHE_DEFAULT_BUDGET;
+  }
+
+  cache->budget_bytes = budget_bytes;
+  cache->entries = g_hash_table_new(g_str_hash, g_str_equal);
+  cache->watches = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                         (GDestroyNotify)g_ptr_array_unref);
+  g_queue_init(&cache->lru);
+
+  cache->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (cache->inotify_fd >= 0) {
+    cache->inotify_source = g_unix_fd_add(cache->inotify_fd,   // fd
+                                          G_IO_IN,             // condition
+                                          on_inotify_readable, // function
+                                          cache);              // user_data
+  } else {
+    g_warning("inotify unavailable, directory cache disabled: %s",
+              g_strerror(errno));
+  }
+  Budget_add_reclaimer(reclaim_listings, cache);
+
+  return cache;
+}
+
+void DirCache_destroy(DirCache *cache) {
+  if (!cache)
+    return;
+
+  Budget_remove_reclaimer(reclaim_listings, cache);
+  while (!g_queue_is_empty(&cache->lru)) {
+    remove_entry(cache, g_queue_peek_tail_link(&cache->lru)->data, FALSE);
+  }
+
+  if (cache->flush_source) {
+    g_source_remove(cache->flush_source);
+  }
+  if (cache->inotify_source) {
+    g_source_remove(cache->inotify_source);
+  }
+  if (cache->inotify_fd >= 0) {
+    close(cache->inotify_fd); // Drops every remaining watch
+  }
+
+  g_hash_table_destroy(cache->entries);
+  g_hash_table_destroy(cache->watches);
+  g_free(cache->pinned_path);
+  g_free(cache);
+}
+
+DirListing *DirCache_lookup(DirCache *cache, const char *path) {
+  if (!cache || !path)
+    return NULL;
+
+  DirCacheEntry *entry = g_hash_table_lookup(cache->entries, path);
+  if (!entry) {
+    cache->misses++;
+    Metrics_add(METRIC_DIR_CACHE_MISSES, 1);
+    return NULL;
+  }
+
+  // Move to the front of the LRU
+  g_queue_unlink(&cache->lru, entry->lru_link);
+  g_queue_push_head_link(&cache->lru, entry->lru_link);
+
+  // The prefetch paid off: from now on it is an ordinary entry
+  if (entry->speculative) {
+    entry->speculative = FALSE;
+    cache->speculative_bytes -= entry->accounted_bytes;
+    cache->prefetch_hits++;
+  }
+
+  cache->hits++;
+  Metrics_add(METRIC_DIR_CACHE_HITS, 1);
+  return DirListing_ref(entry->listing);
+}
+
+gboolean DirCache_contains(DirCache *cache, const char *path) {
+  return cache && path && g_hash_table_contains(cache->entries, path);
+}
+
+static gboolean is_pinned(DirCache *cache, const char *path) {
+  return cache->pinned_path && g_strcmp0(cache->pinned_path, path) == 0;
+}
+
+// Charge an entry for its listing's current size; listings grow when sort
+// columns are derived after they were cached
+static void account_entry(DirCache *cache, DirCacheEntry *entry,
+                          gsize bytes) {
+  if (bytes == entry->accounted_bytes)
+    return;
+
+  gint64 delta = (gint64)bytes - (gint64)entry->accounted_bytes;
+  cache->used_bytes = cache->used_bytes - entry->accounted_bytes + bytes;
+  Metrics_add(METRIC_DIR_CACHE_BYTES, delta);
+  Budget_charge_cache(delta);
+  if (entry->speculative) {
+    cache->speculative_bytes =
+        cache->speculative_bytes - entry->accounted_bytes + bytes;
+  }
+  entry->accounted_bytes = bytes;
+}
+
+static void evict_to_budget(DirCache *cache) {
+  for (GList *l = g_queue_peek_head_link(&cache->lru); l; l = l->next) {
+    DirCacheEntry *entry = l->data;
+    account_entry(cache, entry, entry->listing->memory_bytes);
+  }
+
+  GList *link = g_queue_peek_tail_link(&cache->lru);
+
+  while (cache->used_bytes > cache->budget_bytes && link) {
+    GList *prev = link->prev;
+    DirCacheEntry *entry = link->data;
+
+    if (!is_pinned(cache, entry->listing->path)) {
+      remove_entry(cache, entry, TRUE);
+    }
+    link = prev;
+  }
+}
+
+// Watch a listing's directory and track it; NULL if it cannot be watched,
+// or if a prefetched listing may have missed changes
+static DirCacheEntry *add_entry(DirCache *cache, DirListing *listing,
+                                gboolean speculative) {
+  DirCache_invalidate(cache, listing->path);
+
+  // Another path (e.g. through a symlink) may be watching the inode
+  // already: the kernel hands back its wd, and the entries share it
+  int wd = inotify_add_watch(cache->inotify_fd,     // fd
+                             listing->path,         // pathname
+                             DIR_CACHE_WATCH_MASK); // mask
+  if (wd < 0)
+    return NULL;
+  GPtrArray *sharing =
+      g_hash_table_lookup(cache->watches, GINT_TO_POINTER(wd));
+
+  // Changes between the read and the watch produced no event
+  gboolean current = DirListing_is_current(listing);
+  if (!current && speculative) {
+    if (!sharing) {
+      inotify_rm_watch(cache->inotify_fd, wd);
+    }
+    return NULL;
+  }
+
+  if (!sharing) {
+    sharing = g_ptr_array_new();
+    g_hash_table_insert(cache->watches, GINT_TO_POINTER(wd), sharing);
+  }
+
+  DirCacheEntry *entry = g_new0(DirCacheEntry, 1);
+  entry->listing = DirListing_ref(listing);
+  entry->wd = wd;
+  entry->speculative = speculative;
+  entry->lru_link = g_list_alloc();
+  entry->lru_link->data = entry;
+
+  // Prefetched entries start cold so they are the first to go
+  if (speculative) {
+    g_queue_push_tail_link(&cache->lru, entry->lru_link);
+  } else {
+    g_queue_push_head_link(&cache->lru, entry->lru_link);
+  }
+  g_hash_table_insert(cache->entries, listing->path, entry);
+  g_ptr_array_add(sharing, entry);
+  account_entry(cache, entry, listing->memory_bytes);
+
+  // The watch is in place now, so a second read misses nothing
+  if (!current) {
+    entry->reload = TRUE;
+    schedule_flush(cache);
+  }
+  return entry;
+}
+
+void DirCache_insert(DirCache *cache, DirListing *listing) {
+  if (!cache || !listing || cache->inotify_fd < 0)
+    return;
+
+  if (listing->memory_bytes > cache->budget_bytes &&
+      !is_pinned(cache, listing->path))
+    return;
+
+  if (add_entry(cache, listing, FALSE)) {
+    evict_to_budget(cache);
+  }
+}
+
+gboolean DirCache_insert_speculative(DirCache *cache, DirListing *listing) {
+  if (!cache || !listing || cache->inotify_fd < 0)
+    return FALSE;
+
+  // A real visit got there first; its entry is at least as fresh
+  if (g_hash_table_contains(cache->entries, listing->path))
+    return FALSE;
+
+  gsize share = cache->budget_bytes / DIR_CACHE_SPECULATIVE_SHARE;
+  if (cache->speculative_bytes + listing->memory_bytes > share)
+    return FALSE;
+
+  // Make room only by dropping older prefetches from the cold end
+  GList *link = g_queue_peek_tail_link(&cache->lru);
+  while (cache->used_bytes + listing->memory_bytes > cache->budget_bytes &&
+         link) {
+    GList *prev = link->prev;
+    DirCacheEntry *entry = link->data;
+
+    if (entry->speculative) {
+      remove_entry(cache, entry, TRUE);
+    }
+    link = prev;
+  }
+
+  if (cache->used_bytes + listing->memory_bytes > cache->budget_bytes)
+    return FALSE;
+
+  return add_entry(cache, listing, TRUE) != NULL;
+}
+
+void DirCache_invalidate(DirCache *cache, const char *path) {
+  if (!cache || !path)
+    return;
+
+  DirCacheEntry *entry = g_hash_table_lookup(cache->entries, path);
+  if (entry) {
+    remove_entry(cache, entry, TRUE);
+  }
+}
+
+void DirCache_pin(DirCache *cache, const char *path) {
+  if (!cache)
+    return;
+
+  g_free(cache->pinned_path);
+  cache->pinned_path = g_strdup(path);
+  evict_to_budget(cache);
+}
+
+void DirCache_set_update_func(DirCache *cache, DirCacheUpdateFunc func,
+                              gpointer user_data) {
+  if (!cache)
+    return;
+
+  cache->update_func = func;
+  cache->update_data = user_data;
+}
+
+void DirCache_set_budget(DirCache *cache, gsize budget_bytes) {
+  if (!cache)
+    return;
+
+  cache->budget_bytes = budget_bytes;
+  evict_to_budget(cache);
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+// The watch goes with the last entry sharing it
+static void remove_entry(DirCache *cache, DirCacheEntry *entry,
+                         gboolean remove_watch) {
+  g_hash_table_remove(cache->entries, entry->listing->path);
+  g_queue_unlink(&cache->lru, entry->lru_link);
+  g_list_free_1(entry->lru_link);
+
+  GPtrArray *sharing =
+      g_hash_table_lookup(cache->watches, GINT_TO_POINTER(entry->wd));
+  g_ptr_array_remove_fast(sharing, entry);
+  if (sharing->len == 0) {
+    g_hash_table_remove(cache->watches, GINT_TO_POINTER(entry->wd));
+    if (remove_watch) {
+      inotify_rm_watch(cache->inotify_fd, entry->wd);
+    }
+  }
+
+  if (entry->pending) {
+    g_hash_table_destroy(entry->pending);
+  }
+
+  account_entry(cache, entry, 0);
+  DirListing_unref(entry->listing);
+  g_free(entry);
+}
+
+static void notify_update(DirCache *cache, const DirCacheUpdate *update) {
+  if (cache->update_func && is_pinned(cache, update->path)) {
+    cache->update_func(update, cache->update_data);
+  }
+}
+
+// The directory itself went away: drop it and tell the view if it was on
+// screen
+static void remove_vanished_entry(DirCache *cache, DirCacheEntry *entry,
+                                  gboolean remove_watch) {
+  gchar *path = g_strdup(entry->listing->path);
+  remove_entry(cache, entry, remove_watch);
+
+  DirCacheUpdate update = {path, NULL, NULL, 0};
+  notify_update(cache, &update);
+  g_free(path);
+}
+
+// Swap an entry's listing for a newer one and notify the view
+static void replace_listing(DirCache *cache, DirCacheEntry *entry,
+                            DirListing *listing, GPtrArray *changed,
+                            int first_changed) {
+  account_entry(cache, entry, listing->memory_bytes);
+
+  // Re-key: the table borrows the path string from the listing
+  g_hash_table_steal(cache->entries, entry->listing->path);
+  DirListing_unref(entry->listing);
+  entry->listing = listing;
+  g_hash_table_insert(cache->entries, listing->path, entry);
+
+  DirCacheUpdate update = {listing->path, listing, changed, first_changed};
+  notify_update(cache, &update);
+}
+
+// Apply every entry's pending names in one pass; runs at most once per
+// coalescing window no matter how many events arrived
+static gboolean flush_pending(gpointer user_data) {
+  DirCache *cache = (DirCache *)user_data;
+  cache->flush_source = 0;
+
+  GList *link = g_queue_peek_head_link(&cache->lru);
+  while (link) {
+    GList *next = link->next;
+    DirCacheEntry *entry = link->data;
+
+    if (entry->reload) {
+      reload_entry(cache, entry);
+    } else if (entry->pending) {
+      GHashTable *pending = entry->pending;
+      entry->pending = NULL;
+
+      int first_changed = 0;
+      DirListing *patched =
+          DirListing_apply_changes(entry->listing, pending, &first_changed);
+
+      if (patched) {
+        GPtrArray *changed =
+            g_ptr_array_sized_new(g_hash_table_size(pending));
+        GHashTableIter iter;
+        gpointer key;
+        g_hash_table_iter_init(&iter, pending);
+        while (g_hash_table_iter_next(&iter, &key, NULL)) {
+          g_ptr_array_add(changed, key);
+        }
+
+        replace_listing(cache, entry, patched, changed, first_changed);
+        g_ptr_array_free(changed, TRUE);
+      } else {
+        remove_vanished_entry(cache, entry, TRUE);
+      }
+
+      g_hash_table_destroy(pending);
+    }
+    link = next;
+  }
+
+  evict_to_budget(cache);
+  return G_SOURCE_REMOVE;
+}
+
+// Events were lost: reload the pinned directory from scratch, drop the rest
+static void recover_from_overflow(DirCache *cache) {
+  GList *link = g_queue_peek_head_link(&cache->lru);
+  while (link) {
+    GList *next = link->next;
+    DirCacheEntry *entry = link->data;
+
+    if (!is_pinned(cache, entry->listing->path)) {
+      remove_entry(cache, entry, TRUE);
+    } else {
+      reload_entry(cache, entry);
+    }
+    link = next;
+  }
+}
+
+// Read a directory from scratch; names queued meanwhile are covered
+static void reload_entry(DirCache *cache, DirCacheEntry *entry) {
+  DirListing *reloaded = DirListing_load(entry->listing->path);
+  if (!reloaded) {
+    remove_vanished_entry(cache, entry, TRUE);
+    return;
+  }
+
+  entry->reload = FALSE;
+  if (entry->pending) {
+    g_hash_table_destroy(entry->pending);
+    entry->pending = NULL;
+  }
+  replace_listing(cache, entry, reloaded, NULL, 0);
+}
+
+// The window opens with the first event and is not extended by later ones,
+// so a constant stream still flushes every DIR_CACHE_COALESCE_MS
+static void schedule_flush(DirCache *cache) {
+  if (!cache->flush_source) {
+    cache->flush_source =
+        g_timeout_add(DIR_CACHE_COALESCE_MS, flush_pending, cache);
+  }
+}
+
+static void queue_change(DirCache *cache, DirCacheEntry *entry,
+                         const char *name) {
+  if (!entry->pending) {
+    entry->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           NULL);
+  }
+  if (!g_hash_table_contains(entry->pending, name)) {
+    g_hash_table_add(entry->pending, g_strdup(name));
+  }
+  schedule_flush(cache);
+}
+
+static gboolean on_inotify_readable(gint fd, GIOCondition condition,
+                                    gpointer user_data) {
+  DirCache *cache = (DirCache *)user_data;
+  char buffer[INOTIFY_BUFFER_SIZE]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  for (;;) {
+    ssize_t len = read(fd, buffer, sizeof(buffer));
+    if (len <= 0)
+      break; // EAGAIN: drained
+
+    for (char *ptr = buffer; ptr < buffer + len;) {
+      const struct inotify_event *event = (const struct inotify_event *)ptr;
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        recover_from_overflow(cache);
+        continue;
+      }
+
+      gpointer wd = GINT_TO_POINTER(event->wd);
+      GPtrArray *sharing = g_hash_table_lookup(cache->watches, wd);
+      if (!sharing)
+        continue;
+
+      if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+        // IN_IGNORED means the kernel already dropped the watch. The view
+        // may act on each removal, so the array is looked up every time.
+        while ((sharing = g_hash_table_lookup(cache->watches, wd))) {
+          remove_vanished_entry(cache, g_ptr_array_index(sharing, 0),
+                                !(event->mask & IN_IGNORED));
+        }
+      } else if (event->len > 0) {
+        for (guint i = 0; i < sharing->len; i++) {
+          queue_change(cache, g_ptr_array_index(sharing, i), event->name);
+        }
+      }
+    }
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+// The process is short of memory: give listings back from the cold end,
+// prefetched ones first since they start there. The pinned directory
+// stays.
+static gsize reclaim_listings(gsize bytes, gpointer user_data) {
+  DirCache *cache = (DirCache *)user_data;
+  gsize freed = 0;
+  GList *link = g_queue_peek_tail_link(&cache->lru);
+
+  while (freed < bytes && link) {
+    GList *prev = link->prev;
+    DirCacheEntry *entry = link->data;
+
+    if (!is_pinned(cache, entry->listing->path)) {
+      freed += entry->accounted_bytes;
+      remove_entry(cache, entry, TRUE);
+    }
+    link = prev;
+  }
+  return freed;
+}
@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+
+#include "DirReader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Kernel layout of the records returned by getdents64
+struct linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+static bool reader_init(DirReader *reader, int fd) {
+  if (fd < 0)
+    return false;
+
+  reader->buffer = malloc(DIR_READER_BUFFER_SIZE);
+  if (!reader->buffer) {
+    close(fd);
+    errno = ENOMEM;
+    return false;
+  }
+
+  reader->fd = fd;
+  reader->buffer_len = 0;
+  reader->buffer_pos = 0;
+  reader->eof = false;
+  return true;
+}
+
+bool DirReader_open(DirReader *reader, const char *dirpath) {
+  return DirReader_open_at(reader, AT_FDCWD, dirpath);
+}
+
+bool DirReader_open_at(DirReader *reader, int parent_fd, const char *name) {
+  if (!reader || !name)
+    return false;
+
+  reader->fd = -1;
+  reader->buffer = NULL;
+
+  int fd = openat(parent_fd, // dirfd
+                  name,      // pathname
+                  O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOCTTY); // flags
+  return reader_init(reader, fd);
+}
+
+bool DirReader_next(DirReader *reader, DirReaderEntry *entry) {
+  if (!reader || reader->fd < 0)
+    return false;
+
+  for (;;) {
+    // Refill the buffer once the previous batch is consumed
+    if (reader->buffer_pos >= reader->buffer_len) {
+      if (reader->eof)
+        return false;
+
+      long nread = syscall(SYS_getdents64,          // number
+                           reader->fd,              // fd
+                           reader->buffer,          // dirp
+                           DIR_READER_BUFFER_SIZE); // count
+      if (nread <= 0) {
+        reader->eof = true;
+        return false;
+      }
+
+      reader->buffer_len = (size_t)nread;
+      reader->buffer_pos = 0;
+    }
+
+    struct linux_dirent64 *dirent =
+        (struct linux_dirent64 *)(reader->buffer + reader->buffer_pos);
+    reader->buffer_pos += dirent->d_reclen;
+
+    const char *name = dirent->d_name;
+    if (name[0] == '.' &&
+        (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+      continue;
+    }
+
+    entry->name = name;
+    entry->name_len = strlen(name);
+    entry->inode = dirent->d_ino;
+    entry->type = dirent->d_type;
+    return true;
+  }
+}
+
+bool DirReader_stat(const DirReader *reader, const char *name,
+                    bool follow_links, DirReaderStat *out) {
+  if (!reader || reader->fd < 0)
+    return false;
+
+  return DirReader_stat_at(reader->fd, name, follow_links, out);
+}
+
+bool DirReader_stat_at(int dirfd, const char *name, bool follow_links,
+                       DirReaderStat *out) {
+  if (!name || !out)
+    return false;
+
+  int flags = follow_links ? 0 : AT_SYMLINK_NOFOLLOW;
+
+#ifdef STATX_BASIC_STATS
+  // statx lets us ask only for the fields we use and skip remote syncs
+  struct statx stx;
+  if (statx(dirfd,                                       // dirfd
+            name,                                        // pathname
+            flags | AT_STATX_DONT_SYNC,                  // flags
+            STATX_TYPE | STATX_MODE | STATX_NLINK |      // mask
+                STATX_INO | STATX_SIZE | STATX_BLOCKS |  // ...
+                STATX_MTIME,                             // ...
+            &stx) == 0) {
+    out->mode = stx.stx_mode;
+    out->nlink = stx.stx_nlink;
+    out->inode = stx.stx_ino;
+    out->device = ((uint64_t)stx.stx_dev_major << 32) | stx.stx_dev_minor;
+    out->size = stx.stx_size;
+    out->blocks = stx.stx_blocks;
+    out->mtime_sec = stx.stx_mtime.tv_sec;
+    out->mtime_nsec = stx.stx_mtime.tv_nsec;
+    return true;
+  }
+  if (errno != ENOSYS)
+    return false;
+#endif
+
+  struct stat st;
+  if (fstatat(dirfd, name, &st, flags) != 0)
+    return false;
+
+  out->mode = st.st_mode;
+  out->nlink = st.st_nlink;
+  out->inode = st.st_ino;
+  out->device = st.st_dev;
+  out->size = st.st_size;
+  out->blocks = st.st_blocks;
+  out->mtime_sec = st.st_mtim.tv_sec;
+  out->mtime_nsec = st.st_mtim.tv_nsec;
+  return true;
+}
+
+unsigned char DirReader_type_from_mode(uint32_t mode) {
+  switch (mode & S_IFMT) {
+  case S_IFREG:
+    return DIR_TYPE_REG;
+  case S_IFDIR:
+    return DIR_TYPE_DIR;
+  case S_IFLNK:
+    return DIR_TYPE_LNK;
+  case S_IFCHR:
+    return DIR_TYPE_CHR;
+  case S_IFBLK:
+    return DIR_TYPE_BLK;
+  case S_IFIFO:
+    return DIR_TYPE_FIFO;
+  case S_IFSOCK:
+    return DIR_TYPE_SOCK;
+  default:
+    return DIR_TYPE_UNKNOWN;
+  }
+}
+
+unsigned char DirReader_resolve_type(const DirReader *reader,
+                                     const DirReaderEntry *entry) {
+  // Fast path: the filesystem told us and it isn't a link to chase
+  if (entry->type != DIR_TYPE_UNKNOWN && entry->type != DIR_TYPE_LNK)
+    return entry->type;
+
+  DirReaderStat st;
+  if (!DirReader_stat(reader, entry->name, true, &st)) {
+    // Dangling symlinks stay links; anything else is unknown
+    return entry->type;
+  }
+  return DirReader_type_from_mode(st.mode);
+}
+
+void DirReader_close(DirReader *reader) {
+  if (!reader)
+    return;
+
+  if (reader->fd >= 0) {
+    close(reader->fd);
+    reader->fd = -1;
+  }
+  free(reader->buffer);
+  reader->buffer = NULL;
+}
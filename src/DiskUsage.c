@@ -0,0 +1,520 @@
+#define _GNU_SOURCE
+#include "DiskUsage.h"
+#include "Budget.h"
+#include "DirReader.h"
+#include "Metrics.h"
+#include "TreeWalk.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+  guint64 device;
+  guint64 inode;
+  guint64 bytes;
+} LinkedFile;
+
+typedef struct {
+  gchar *name;
+  guint64 bytes;
+} SizedFile;
+
+// What one directory holds, reusable while its mtime stays the same
+typedef struct {
+  gint ref_count;     // Cache plus the tasks using it
+  gint64 mtime_sec;   // Directory mtime when read
+  guint32 mtime_nsec;
+  guint64 inode;      // Directory identity, so a replaced folder misses
+  guint64 device;
+  guint64 own_bytes;  // The directory itself and its single-link files
+  GPtrArray *subdirs; // Subdirectory names
+  GArray *links;      // LinkedFile: files with several links
+  GArray *files;      // SizedFile: its DISK_USAGE_TOP_K largest files
+  gsize cached_bytes; // Charged to the memory budget while cached
+} DirScan;
+
+typedef struct DiskUsageNode {
+  struct DiskUsageNode *parent; // Folder the total rolls up into
+  DiskUsage *usage;             // Scan this folder belongs to
+  gchar *path;                  // Relative to the root, "" for the root
+  guint depth;                  // 0 for the root
+  guint64 bytes;                // Counted so far, under usage->lock
+  gint pending;                 // Own scan plus unfinished subfolders
+} DiskUsageNode;
+
+typedef struct {
+  ResultNode node;
+  guint64 bytes;
+  unsigned char type;
+  char name[]; // NUL-terminated
+} SizeResult;
+
+static GMutex cache_lock;
+static GHashTable *scan_cache; // Absolute path -> DirScan
+static gsize scan_cache_bytes; // Charged to the budget by cached scans
+
+static void scan_task(gpointer data);
+static void queue_node(DiskUsage *usage, DiskUsageNode *parent,
+                       const char *name);
+static void finish_node(DiskUsageNode *node);
+static void deliver_sizes(ResultNode **items, guint count, gboolean finished,
+                          gpointer user_data);
+static void unref_usage(DiskUsage *usage);
+
+static guint link_hash(gconstpointer key) {
+  const LinkedFile *file = key;
+  return (guint)(file->inode ^ (file->inode >> 32) ^ file->device);
+}
+
+static gboolean link_equal(gconstpointer a, gconstpointer b) {
+  const LinkedFile *x = a, *y = b;
+  return x->inode == y->inode && x->device == y->device;
+}
+
+DiskUsage *DiskUsage_start(const char *root, DiskUsageFunc func,
+                           gpointer user_data) {
+  DiskUsage *usage = g_new0(DiskUsage, 1);
+  usage->root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  usage->root = g_strdup(root);
+  usage->group = SchedulerGroup_new(SCHEDULER_USER_INITIATED, NULL);
+  usage->func = func;
+  usage->user_data = user_data;
+  usage->seen_links = g_hash_table_new_full(link_hash, link_equal, g_free,
+                                            NULL);
+  usage->largest_files = g_new0(DiskUsageItem, DISK_USAGE_TOP_K);
+  usage->largest_dirs = g_new0(DiskUsageItem, DISK_USAGE_TOP_K);
+  g_mutex_init(&usage->lock);
+
+  // The stream's initial unit of work is the root folder's total; the
+  // running scan holds a reference until it is known
+  usage->ref_count = 2;
+  usage->stream = ResultStream_new(DISK_USAGE_BATCH, deliver_sizes, usage);
+  if (usage->root_fd < 0) {
+    ResultStream_work_done(usage->stream);
+    unref_usage(usage);
+    return usage;
+  }
+
+  queue_node(usage, NULL, "");
+  return usage;
+}
+
+void DiskUsage_stop(DiskUsage *usage) {
+  if (!usage)
+    return;
+
+  if (!usage->stream->done) {
+    SchedulerGroup_cancel(usage->group);
+  }
+  ResultStream_close(usage->stream);
+  unref_usage(usage);
+}
+
+const DiskUsageItem *DiskUsage_largest(const DiskUsage *usage, gboolean dirs,
+                                       guint *count) {
+  *count = dirs ? usage->largest_dir_count : usage->largest_file_count;
+  return dirs ? usage->largest_dirs : usage->largest_files;
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static void free_items(DiskUsageItem *items, guint count) {
+  for (guint i = 0; i < count; i++) {
+    g_free(items[i].path);
+  }
+  g_free(items);
+}
+
+static void unref_usage(DiskUsage *usage) {
+  if (!g_atomic_int_dec_and_test(&usage->ref_count))
+    return;
+
+  if (usage->root_fd >= 0) {
+    close(usage->root_fd);
+  }
+  ResultStream_free(usage->stream);
+  SchedulerGroup_unref(usage->group);
+  g_hash_table_destroy(usage->seen_links);
+  free_items(usage->largest_files, usage->largest_file_count);
+  free_items(usage->largest_dirs, usage->largest_dir_count);
+  g_mutex_clear(&usage->lock);
+  g_free(usage->root);
+  g_free(usage);
+}
+
+static void unref_scan(DirScan *scan) {
+  if (!scan || !g_atomic_int_dec_and_test(&scan->ref_count))
+    return;
+
+  for (guint i = 0; i < scan->files->len; i++) {
+    g_free(g_array_index(scan->files, SizedFile, i).name);
+  }
+  g_array_free(scan->files, TRUE);
+  g_array_free(scan->links, TRUE);
+  g_ptr_array_free(scan->subdirs, TRUE);
+  g_free(scan);
+}
+
+// Roughly what a scan holds: the struct, its arrays and their strings
+static gsize scan_bytes(const DirScan *scan) {
+  gsize bytes = sizeof(DirScan) + scan->links->len * sizeof(LinkedFile) +
+                scan->files->len * sizeof(SizedFile) +
+                scan->subdirs->len * sizeof(gpointer);
+  for (guint i = 0; i < scan->subdirs->len; i++) {
+    bytes += strlen(g_ptr_array_index(scan->subdirs, i)) + 1;
+  }
+  for (guint i = 0; i < scan->files->len; i++) {
+    bytes += strlen(g_array_index(scan->files, SizedFile, i).name) + 1;
+  }
+  return bytes;
+}
+
+// Value destructor of the cache, under cache_lock: the budget charge goes
+// with the entry
+static void drop_cached_scan(DirScan *scan) {
+  scan_cache_bytes -= scan->cached_bytes;
+  Budget_charge_cache(-(gint64)scan->cached_bytes);
+  unref_scan(scan);
+}
+
+// Scans are cheap to redo and the cache keeps no order to evict by, so
+// pressure empties it, as filling it up does
+static gsize reclaim_scans(gsize bytes, gpointer user_data) {
+  g_mutex_lock(&cache_lock);
+  gsize freed = scan_cache_bytes;
+  g_hash_table_remove_all(scan_cache);
+  g_mutex_unlock(&cache_lock);
+  return freed;
+}
+
+// Bounded min-heap: the smallest kept entry is at the top, so a candidate
+// that does not beat it costs one comparison
+static void heap_sift_down(DiskUsageItem *heap, guint count, guint i) {
+  for (;;) {
+    guint smallest = i;
+    guint left = 2 * i + 1, right = 2 * i + 2;
+    if (left < count && heap[left].bytes < heap[smallest].bytes)
+      smallest = left;
+    if (right < count && heap[right].bytes < heap[smallest].bytes)
+      smallest = right;
+    if (smallest == i)
+      return;
+
+    DiskUsageItem swap = heap[i];
+    heap[i] = heap[smallest];
+    heap[smallest] = swap;
+    i = smallest;
+  }
+}
+
+static gboolean heap_accepts(const DiskUsageItem *heap, guint count,
+                             guint capacity, guint64 bytes) {
+  return count < capacity || bytes > heap[0].bytes;
+}
+
+// Takes ownership of path
+static void heap_offer(DiskUsageItem *heap, guint *count, guint capacity,
+                       gchar *path, guint64 bytes) {
+  if (!heap_accepts(heap, *count, capacity, bytes)) {
+    g_free(path);
+    return;
+  }
+
+  if (*count < capacity) {
+    guint i = (*count)++;
+    heap[i].path = path;
+    heap[i].bytes = bytes;
+    while (i > 0 && heap[(i - 1) / 2].bytes > heap[i].bytes) {
+      DiskUsageItem swap = heap[i];
+      heap[i] = heap[(i - 1) / 2];
+      heap[(i - 1) / 2] = swap;
+      i = (i - 1) / 2;
+    }
+    return;
+  }
+
+  g_free(heap[0].path);
+  heap[0].path = path;
+  heap[0].bytes = bytes;
+  heap_sift_down(heap, *count, 0);
+}
+
+static int compare_largest_first(const void *a, const void *b) {
+  const DiskUsageItem *x = a, *y = b;
+  return x->bytes < y->bytes ? 1 : x->bytes > y->bytes ? -1 : 0;
+}
+
+// A directory's own largest files, so a cached scan still feeds the
+// overall top files
+static void keep_largest_file(GArray *files, const char *name,
+                              guint64 bytes) {
+  guint smallest = 0;
+  if (files->len == DISK_USAGE_TOP_K) {
+    for (guint i = 1; i < files->len; i++) {
+      if (g_array_index(files, SizedFile, i).bytes <
+          g_array_index(files, SizedFile, smallest).bytes) {
+        smallest = i;
+      }
+    }
+    SizedFile *victim = &g_array_index(files, SizedFile, smallest);
+    if (victim->bytes >= bytes)
+      return;
+    g_free(victim->name);
+    victim->name = g_strdup(name);
+    victim->bytes = bytes;
+    return;
+  }
+
+  SizedFile file = {g_strdup(name), bytes};
+  g_array_append_val(files, file);
+}
+
+static void push_size(DiskUsage *usage, const char *name, guint64 bytes,
+                      unsigned char type) {
+  gsize name_len = strlen(name);
+  SizeResult *result = g_malloc(sizeof(SizeResult) + name_len + 1);
+  result->bytes = bytes;
+  result->type = type;
+  memcpy(result->name, name, name_len + 1);
+  ResultStream_push(usage->stream, &result->node,
+                    sizeof(SizeResult) + name_len + 1);
+}
+
+// Read a directory fresh. Files of the root are reported as they are
+// stat'ed. Returns NULL if the scan was cancelled part way.
+static DirScan *read_scan(DiskUsageNode *node, DirReader *reader,
+                          const struct stat *dir_stat) {
+  DiskUsage *usage = node->usage;
+  DirScan *scan = g_new0(DirScan, 1);
+  scan->ref_count = 1;
+  scan->mtime_sec = dir_stat->st_mtim.tv_sec;
+  scan->mtime_nsec = dir_stat->st_mtim.tv_nsec;
+  scan->inode = dir_stat->st_ino;
+  scan->device = dir_stat->st_dev;
+  scan->own_bytes = (guint64)dir_stat->st_blocks * 512;
+  scan->subdirs = g_ptr_array_new_with_free_func(g_free);
+  scan->links = g_array_new(FALSE, FALSE, sizeof(LinkedFile));
+  scan->files = g_array_new(FALSE, FALSE, sizeof(SizedFile));
+
+  DirReaderEntry entry;
+  while (DirReader_next(reader, &entry)) {
+    if (g_cancellable_is_cancelled(usage->group->cancellable)) {
+      unref_scan(scan);
+      return NULL;
+    }
+    Scheduler_yield();
+
+    // A d_type of directory needs no stat here: its own task fstat's it
+    if (entry.type == DIR_TYPE_DIR) {
+      g_ptr_array_add(scan->subdirs, g_strdup(entry.name));
+      continue;
+    }
+
+    DirReaderStat st;
+    if (!DirReader_stat(reader, entry.name, false, &st))
+      continue;
+
+    unsigned char type = DirReader_type_from_mode(st.mode);
+    if (type == DIR_TYPE_DIR) {
+      g_ptr_array_add(scan->subdirs, g_strdup(entry.name));
+      continue;
+    }
+
+    guint64 bytes = st.blocks * 512;
+    if (st.nlink > 1) {
+      LinkedFile link = {st.device, st.inode, bytes};
+      g_array_append_val(scan->links, link);
+    } else {
+      scan->own_bytes += bytes;
+    }
+    keep_largest_file(scan->files, entry.name, bytes);
+
+    if (node->depth == 0) {
+      push_size(usage, entry.name, bytes, type);
+    }
+  }
+  return scan;
+}
+
+// The directory's scan, from the cache when its mtime still matches.
+// The root is always read, so each of its files gets reported.
+static DirScan *load_scan(DiskUsageNode *node) {
+  DiskUsage *usage = node->usage;
+  DirReader reader;
+
+  if (!DirReader_open_at(&reader, usage->root_fd,
+                         *node->path ? node->path : "."))
+    return NULL;
+
+  struct stat dir_stat;
+  if (fstat(reader.fd, &dir_stat) != 0) {
+    DirReader_close(&reader);
+    return NULL;
+  }
+
+  gchar *key = g_build_filename(usage->root, node->path, NULL);
+  DirScan *scan = NULL;
+  if (node->depth > 0) {
+    g_mutex_lock(&cache_lock);
+    DirScan *cached = scan_cache ? g_hash_table_lookup(scan_cache, key) : NULL;
+    if (cached && cached->mtime_sec == dir_stat.st_mtim.tv_sec &&
+        cached->mtime_nsec == (guint32)dir_stat.st_mtim.tv_nsec &&
+        cached->inode == dir_stat.st_ino &&
+        cached->device == dir_stat.st_dev) {
+      scan = cached;
+      g_atomic_int_inc(&scan->ref_count);
+    }
+    g_mutex_unlock(&cache_lock);
+    Metrics_add(scan ? METRIC_USAGE_CACHE_HITS : METRIC_USAGE_CACHE_MISSES, 1);
+  }
+
+  gboolean fresh = !scan;
+  if (fresh) {
+    scan = read_scan(node, &reader, &dir_stat);
+  }
+  DirReader_close(&reader);
+
+  if (fresh && scan) {
+    g_mutex_lock(&cache_lock);
+    if (!scan_cache) {
+      scan_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify)drop_cached_scan);
+      Budget_add_reclaimer(reclaim_scans, NULL);
+    }
+    if (g_hash_table_size(scan_cache) >= DISK_USAGE_CACHE_MAX) {
+      g_hash_table_remove_all(scan_cache);
+    }
+    g_atomic_int_inc(&scan->ref_count);
+    scan->cached_bytes = scan_bytes(scan);
+    scan_cache_bytes += scan->cached_bytes;
+    Budget_charge_cache(scan->cached_bytes);
+    g_hash_table_replace(scan_cache, key, scan);
+    key = NULL;
+    g_mutex_unlock(&cache_lock);
+  }
+  g_free(key);
+  return scan;
+}
+
+static void apply_scan(DiskUsageNode *node, DirScan *scan) {
+  DiskUsage *usage = node->usage;
+  guint64 bytes = scan->own_bytes;
+
+  g_mutex_lock(&usage->lock);
+  for (guint i = 0; i < scan->links->len; i++) {
+    LinkedFile *link = &g_array_index(scan->links, LinkedFile, i);
+    if (!g_hash_table_contains(usage->seen_links, link)) {
+      g_hash_table_add(usage->seen_links, g_memdup2(link, sizeof(*link)));
+      bytes += link->bytes;
+    }
+  }
+  for (guint i = 0; i < scan->files->len; i++) {
+    SizedFile *file = &g_array_index(scan->files, SizedFile, i);
+    if (heap_accepts(usage->largest_files, usage->largest_file_count,
+                     DISK_USAGE_TOP_K, file->bytes)) {
+      heap_offer(usage->largest_files, &usage->largest_file_count,
+                 DISK_USAGE_TOP_K, TreeWalk_join(node->path, file->name),
+                 file->bytes);
+    }
+  }
+  node->bytes += bytes;
+  g_mutex_unlock(&usage->lock);
+
+  for (guint i = 0; i < scan->subdirs->len; i++) {
+    queue_node(usage, node, g_ptr_array_index(scan->subdirs, i));
+  }
+}
+
+static void queue_node(DiskUsage *usage, DiskUsageNode *parent,
+                       const char *name) {
+  DiskUsageNode *node = g_new0(DiskUsageNode, 1);
+  node->parent = parent;
+  node->usage = usage;
+  node->path = parent ? TreeWalk_join(parent->path, name) : g_strdup(name);
+  node->depth = parent ? parent->depth + 1 : 0;
+  node->pending = 1;
+
+  if (parent) {
+    g_atomic_int_inc(&parent->pending);
+  }
+  Scheduler_push(usage->group, scan_task, node);
+}
+
+static void scan_task(gpointer data) {
+  DiskUsageNode *node = (DiskUsageNode *)data;
+
+  // A cancelled scan still finishes every node, so the walk winds down
+  if (!g_cancellable_is_cancelled(node->usage->group->cancellable)) {
+    DirScan *scan = load_scan(node);
+    if (scan) {
+      apply_scan(node, scan);
+      unref_scan(scan);
+    }
+  }
+  finish_node(node);
+}
+
+// Roll finished folders up into their parents, as far as they complete
+static void finish_node(DiskUsageNode *node) {
+  DiskUsage *usage = node->usage;
+
+  while (node && g_atomic_int_dec_and_test(&node->pending)) {
+    DiskUsageNode *parent = node->parent;
+
+    g_mutex_lock(&usage->lock);
+    guint64 total = node->bytes;
+    if (parent) {
+      parent->bytes += total;
+      if (heap_accepts(usage->largest_dirs, usage->largest_dir_count,
+                       DISK_USAGE_TOP_K, total)) {
+        heap_offer(usage->largest_dirs, &usage->largest_dir_count,
+                   DISK_USAGE_TOP_K, g_strdup(node->path), total);
+      }
+    } else {
+      usage->total = total;
+      qsort(usage->largest_files, usage->largest_file_count,
+            sizeof(DiskUsageItem), compare_largest_first);
+      qsort(usage->largest_dirs, usage->largest_dir_count,
+            sizeof(DiskUsageItem), compare_largest_first);
+    }
+    g_mutex_unlock(&usage->lock);
+
+    // Folders of the root fill in as soon as their subtree is counted
+    if (node->depth == 1) {
+      push_size(usage, node->path, total, DIR_TYPE_DIR);
+    }
+
+    g_free(node->path);
+    g_free(node);
+    node = parent;
+  }
+
+  if (!node) {
+    ResultStream_work_done(usage->stream);
+    unref_usage(usage);
+  }
+}
+
+static void deliver_sizes(ResultNode **items, guint count, gboolean finished,
+                          gpointer user_data) {
+  DiskUsage *usage = (DiskUsage *)user_data;
+  DiskUsageSize sizes[DISK_USAGE_BATCH];
+
+  for (guint i = 0; i < count; i++) {
+    SizeResult *result = (SizeResult *)items[i];
+    sizes[i].name = result->name;
+    sizes[i].bytes = result->bytes;
+    sizes[i].type = result->type;
+  }
+
+  // The callback may stop the scan; the results are ours to free
+  usage->func(sizes, count, finished, usage->user_data);
+  for (guint i = 0; i < count; i++) {
+    g_free(items[i]);
+  }
+}
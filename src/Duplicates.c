@@ -0,0 +1,408 @@
+#define _GNU_SOURCE
+#include "Duplicates.h"
+#include "DirReader.h"
+#include "Hash64.h"
+#include "Search.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+  gchar *path;    // Relative to the root
+  guint64 device; // Identity, so hard links count once
+  guint64 inode;
+  guint64 hash;   // Edge hash, then full-content hash
+} Candidate;
+
+// Regular files of one size: the unit of hashing work
+typedef struct {
+  guint64 size;     // Hash table key
+  Duplicates *dups; // Search the files belong to
+  GPtrArray *files; // Candidate
+} SizeGroup;
+
+typedef struct {
+  ResultNode node;
+  guint64 size;
+  guint count;
+  char paths[]; // count NUL-terminated paths, back to back
+} GroupResult;
+
+typedef struct {
+  Hash64 hash;
+  GCancellable *cancellable;
+} ChunkHash;
+
+static void visit_entry(const TreeWalkEntry *entry, gpointer user_data);
+static void walk_done(const SearchStats *stats, gpointer user_data);
+static void hash_task(gpointer data);
+static void deliver_groups(ResultNode **items, guint count,
+                           gboolean finished, gpointer user_data);
+static void unref_dups(Duplicates *dups);
+
+static void free_candidate(gpointer data) {
+  Candidate *candidate = (Candidate *)data;
+  g_free(candidate->path);
+  g_free(candidate);
+}
+
+static void free_group(gpointer data) {
+  SizeGroup *group = (SizeGroup *)data;
+  g_ptr_array_free(group->files, TRUE);
+  g_free(group);
+}
+
+Duplicates *Duplicates_start(const char *root, const char *ignore,
+                             DuplicatesFunc func, gpointer user_data) {
+  Duplicates *dups = g_new0(Duplicates, 1);
+  dups->root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  dups->group = SchedulerGroup_new(SCHEDULER_USER_INITIATED, NULL);
+  dups->by_size = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL,
+                                        free_group);
+  dups->func = func;
+  dups->user_data = user_data;
+  g_mutex_init(&dups->lock);
+
+  // The stream's initial unit of work is the walk; the walk holds a
+  // reference until it is done
+  dups->ref_count = 2;
+  dups->stream = ResultStream_new(DUPLICATES_BATCH, deliver_groups, dups);
+  dups->walk = TreeWalk_start(root,                     // root
+                              ignore,                   // ignore
+                              TREE_WALK_DEFAULT,        // flags
+                              dups->group->cancellable, // cancellable
+                              visit_entry,              // visit
+                              walk_done,                // done
+                              dups);                    // user_data
+  return dups;
+}
+
+void Duplicates_stop(Duplicates *dups) {
+  if (!dups)
+    return;
+
+  if (!dups->stream->done) {
+    SchedulerGroup_cancel(dups->group);
+  }
+  ResultStream_close(dups->stream);
+  unref_dups(dups);
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static void unref_dups(Duplicates *dups) {
+  if (!g_atomic_int_dec_and_test(&dups->ref_count))
+    return;
+
+  if (dups->root_fd >= 0) {
+    close(dups->root_fd);
+  }
+  TreeWalk_unref(dups->walk);
+  ResultStream_free(dups->stream);
+  SchedulerGroup_unref(dups->group);
+  if (dups->shared) {
+    g_ptr_array_free(dups->shared, TRUE);
+  }
+  g_hash_table_destroy(dups->by_size);
+  g_mutex_clear(&dups->lock);
+  g_free(dups);
+}
+
+// Stage 1, on the walk's workers: bucket regular files by size
+static void visit_entry(const TreeWalkEntry *entry, gpointer user_data) {
+  Duplicates *dups = (Duplicates *)user_data;
+
+  if (entry->type != DIR_TYPE_REG && entry->type != DIR_TYPE_UNKNOWN)
+    return;
+
+  DirReaderStat st;
+  if (!DirReader_stat_at(entry->dirfd, entry->name, false, &st) ||
+      DirReader_type_from_mode(st.mode) != DIR_TYPE_REG || st.size == 0)
+    return;
+
+  Candidate *candidate = g_new(Candidate, 1);
+  candidate->path = TreeWalk_join(entry->dir_path, entry->name);
+  candidate->device = st.device;
+  candidate->inode = st.inode;
+  candidate->hash = 0;
+
+  g_mutex_lock(&dups->lock);
+  SizeGroup *group = g_hash_table_lookup(dups->by_size, &st.size);
+  if (!group) {
+    group = g_new(SizeGroup, 1);
+    group->size = st.size;
+    group->dups = dups;
+    group->files = g_ptr_array_new_with_free_func(free_candidate);
+    g_hash_table_insert(dups->by_size, &group->size, group);
+  }
+  g_ptr_array_add(group->files, candidate);
+  g_mutex_unlock(&dups->lock);
+}
+
+static int compare_largest_group(const void *a, const void *b) {
+  const SizeGroup *x = *(SizeGroup *const *)a;
+  const SizeGroup *y = *(SizeGroup *const *)b;
+  return x->size < y->size ? 1 : x->size > y->size ? -1 : 0;
+}
+
+// Every size is known: hand the shared sizes to the hashing tasks,
+// largest first, so the groups worth the most show up first. Bounded on
+// purpose: the stages are I/O, and a few sequential readers beat many
+// competing ones.
+static void walk_done(const SearchStats *stats, gpointer user_data) {
+  Duplicates *dups = (Duplicates *)user_data;
+  GPtrArray *shared = g_ptr_array_new();
+
+  g_mutex_lock(&dups->lock);
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, dups->by_size);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    SizeGroup *group = (SizeGroup *)value;
+    if (group->files->len >= 2) {
+      g_hash_table_iter_steal(&iter);
+      g_ptr_array_add(shared, group);
+    }
+  }
+  g_hash_table_remove_all(dups->by_size);
+  g_mutex_unlock(&dups->lock);
+
+  if (!g_cancellable_is_cancelled(dups->group->cancellable)) {
+    g_ptr_array_sort(shared, compare_largest_group);
+    guint readers = MIN(shared->len, DUPLICATES_IO_LIMIT);
+    dups->shared = shared;
+    ResultStream_add_work(dups->stream, shared->len);
+    g_atomic_int_add(&dups->ref_count, readers);
+    for (guint i = 0; i < readers; i++) {
+      Scheduler_push(dups->group, hash_task, dups);
+    }
+  } else {
+    for (guint i = 0; i < shared->len; i++) {
+      free_group(g_ptr_array_index(shared, i));
+    }
+    g_ptr_array_free(shared, TRUE);
+  }
+
+  ResultStream_work_done(dups->stream);
+  unref_dups(dups);
+}
+
+static int compare_identity(const void *a, const void *b) {
+  const Candidate *x = *(Candidate *const *)a;
+  const Candidate *y = *(Candidate *const *)b;
+  if (x->device != y->device)
+    return x->device < y->device ? -1 : 1;
+  if (x->inode != y->inode)
+    return x->inode < y->inode ? -1 : 1;
+  return strcmp(x->path, y->path);
+}
+
+static int compare_hash(const void *a, const void *b) {
+  const Candidate *x = *(Candidate *const *)a;
+  const Candidate *y = *(Candidate *const *)b;
+  if (x->hash != y->hash)
+    return x->hash < y->hash ? -1 : 1;
+  return strcmp(x->path, y->path);
+}
+
+static int compare_path(const void *a, const void *b) {
+  const Candidate *x = *(Candidate *const *)a;
+  const Candidate *y = *(Candidate *const *)b;
+  return strcmp(x->path, y->path);
+}
+
+// Keep one name per (device, inode): the first in path order
+static void drop_hard_links(GPtrArray *files) {
+  g_ptr_array_sort(files, compare_identity);
+  for (guint i = files->len; i > 1; i--) {
+    const Candidate *a = g_ptr_array_index(files, i - 2);
+    const Candidate *b = g_ptr_array_index(files, i - 1);
+    if (a->device == b->device && a->inode == b->inode) {
+      g_ptr_array_remove_index(files, i - 1);
+    }
+  }
+}
+
+// End of the run of equal hashes starting at start
+static guint run_end(Candidate **files, guint len, guint start) {
+  guint end = start + 1;
+  while (end < len && files[end]->hash == files[start]->hash) {
+    end++;
+  }
+  return end;
+}
+
+// Keep only files whose hash some other file shares, sorted by hash
+static void keep_colliding(GPtrArray *files) {
+  g_ptr_array_sort(files, compare_hash);
+
+  gsize len;
+  Candidate **all = (Candidate **)g_ptr_array_steal(files, &len);
+  for (guint start = 0; start < len;) {
+    guint end = run_end(all, len, start);
+    for (guint i = start; i < end; i++) {
+      if (end - start >= 2) {
+        g_ptr_array_add(files, all[i]);
+      } else {
+        free_candidate(all[i]);
+      }
+    }
+    start = end;
+  }
+  g_free(all);
+}
+
+// Stage 2: a hash of both ends tells most same-size files apart for the
+// price of two small reads. Files that changed size since the walk drop.
+static void hash_edges(SizeGroup *group, GCancellable *cancellable) {
+  char edges[2 * DUPLICATES_EDGE_SIZE];
+  int root_fd = group->dups->root_fd;
+
+  for (guint i = 0; i < group->files->len;) {
+    Candidate *candidate = g_ptr_array_index(group->files, i);
+    size_t len, file_size;
+    if (g_cancellable_is_cancelled(cancellable) ||
+        !ReadFileEdgesAt(root_fd, candidate->path, DUPLICATES_EDGE_SIZE,
+                         edges, &len, &file_size) ||
+        file_size != group->size) {
+      g_ptr_array_remove_index_fast(group->files, i);
+      continue;
+    }
+    candidate->hash = Hash64_bytes(edges, len, 0);
+    i++;
+  }
+  keep_colliding(group->files);
+}
+
+// Between chunks only the file and its read buffer are held, neither
+// from the memory budget, so waiting interactive work may run
+static bool hash_chunk(const char *data, size_t len, void *user_data) {
+  ChunkHash *chunk = (ChunkHash *)user_data;
+  Hash64_update(&chunk->hash, data, len);
+  Scheduler_yield();
+  return !g_cancellable_is_cancelled(chunk->cancellable);
+}
+
+// Stage 3: files still colliding are hashed whole, streamed through one
+// buffer so a large file costs no more memory than a small one
+static void hash_contents(SizeGroup *group, GCancellable *cancellable) {
+  char *buffer = g_malloc(DUPLICATES_CHUNK_SIZE);
+  int root_fd = group->dups->root_fd;
+
+  for (guint i = 0; i < group->files->len;) {
+    Candidate *candidate = g_ptr_array_index(group->files, i);
+    ChunkHash chunk;
+    Hash64_init(&chunk.hash, 0);
+    chunk.cancellable = cancellable;
+
+    if (!ReadFileChunksAt(root_fd,               // dirfd
+                          candidate->path,       // name
+                          buffer,                // buf
+                          DUPLICATES_CHUNK_SIZE, // buf_size
+                          hash_chunk,            // func
+                          &chunk) ||             // user_data
+        chunk.hash.total_len != group->size) {
+      g_ptr_array_remove_index_fast(group->files, i);
+      continue;
+    }
+    candidate->hash = Hash64_digest(&chunk.hash);
+    i++;
+  }
+  g_free(buffer);
+  keep_colliding(group->files);
+}
+
+static void push_group(Duplicates *dups, guint64 size, Candidate **files,
+                       guint count) {
+  qsort(files, count, sizeof(Candidate *), compare_path);
+
+  gsize total = 0;
+  for (guint i = 0; i < count; i++) {
+    total += strlen(files[i]->path) + 1;
+  }
+
+  GroupResult *result = g_malloc(sizeof(GroupResult) + total);
+  result->size = size;
+  result->count = count;
+  char *out = result->paths;
+  for (guint i = 0; i < count; i++) {
+    gsize len = strlen(files[i]->path) + 1;
+    memcpy(out, files[i]->path, len);
+    out += len;
+  }
+  ResultStream_push(dups->stream, &result->node,
+                    sizeof(GroupResult) + total);
+}
+
+static void hash_group(SizeGroup *group) {
+  Duplicates *dups = group->dups;
+  GCancellable *cancellable = dups->group->cancellable;
+
+  drop_hard_links(group->files);
+  if (group->files->len >= 2) {
+    hash_edges(group, cancellable);
+  }
+  // Edges covering the whole file already hashed all of it
+  if (group->files->len >= 2 && group->size > 2 * DUPLICATES_EDGE_SIZE) {
+    hash_contents(group, cancellable);
+  }
+
+  // Survivors are sorted by hash: each run is one group of copies
+  Candidate **files = (Candidate **)group->files->pdata;
+  guint len = group->files->len;
+  for (guint start = 0; start < len;) {
+    if (g_cancellable_is_cancelled(cancellable))
+      break;
+    guint end = run_end(files, len, start);
+    push_group(dups, group->size, files + start, end - start);
+    start = end;
+  }
+
+  free_group(group);
+  ResultStream_work_done(dups->stream);
+}
+
+// One reader: size groups one after the other until none are left. A
+// cancelled search still takes each of them, to free it.
+static void hash_task(gpointer data) {
+  Duplicates *dups = (Duplicates *)data;
+  guint next;
+
+  while ((next = (guint)g_atomic_int_add(&dups->next_shared, 1)) <
+         dups->shared->len) {
+    hash_group(g_ptr_array_index(dups->shared, next));
+    Scheduler_yield();
+  }
+  unref_dups(dups);
+}
+
+static void deliver_groups(ResultNode **items, guint count,
+                           gboolean finished, gpointer user_data) {
+  Duplicates *dups = (Duplicates *)user_data;
+  DuplicateGroup groups[DUPLICATES_BATCH];
+
+  for (guint i = 0; i < count; i++) {
+    GroupResult *result = (GroupResult *)items[i];
+    const char **paths = g_new(const char *, result->count);
+    const char *path = result->paths;
+    for (guint j = 0; j < result->count; j++) {
+      paths[j] = path;
+      path += strlen(path) + 1;
+    }
+    groups[i].paths = paths;
+    groups[i].count = result->count;
+    groups[i].size = result->size;
+    groups[i].reclaimable = result->size * (result->count - 1);
+  }
+
+  // The callback may stop the search; the results are ours to free
+  dups->func(groups, count, finished, dups->user_data);
+  for (guint i = 0; i < count; i++) {
+    g_free((gpointer)groups[i].paths);
+    g_free(items[i]);
+  }
+}
@@ -0,0 +1,125 @@
+#include "Hash64.h"
+
+#include <string.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline guint64 rotl64(guint64 x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline guint64 read64(const guchar *p) {
+  guint64 v;
+  memcpy(&v, p, sizeof(v));
+  return GUINT64_FROM_LE(v);
+}
+
+static inline guint32 read32(const guchar *p) {
+  guint32 v;
+  memcpy(&v, p, sizeof(v));
+  return GUINT32_FROM_LE(v);
+}
+
+static inline guint64 round64(guint64 acc, guint64 input) {
+  acc += input * PRIME64_2;
+  acc = rotl64(acc, 31);
+  return acc * PRIME64_1;
+}
+
+static inline guint64 merge_round(guint64 acc, guint64 lane) {
+  acc ^= round64(0, lane);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+// One 32-byte stripe into the four lanes
+static inline void consume_stripe(guint64 *lanes, const guchar *p) {
+  lanes[0] = round64(lanes[0], read64(p));
+  lanes[1] = round64(lanes[1], read64(p + 8));
+  lanes[2] = round64(lanes[2], read64(p + 16));
+  lanes[3] = round64(lanes[3], read64(p + 24));
+}
+
+void Hash64_init(Hash64 *hash, guint64 seed) {
+  memset(hash, 0, sizeof(*hash));
+  hash->seed = seed;
+  hash->lanes[0] = seed + PRIME64_1 + PRIME64_2;
+  hash->lanes[1] = seed + PRIME64_2;
+  hash->lanes[2] = seed;
+  hash->lanes[3] = seed - PRIME64_1;
+}
+
+void Hash64_update(Hash64 *hash, const void *data, gsize len) {
+  const guchar *p = data;
+  const guchar *end = p + len;
+  hash->total_len += len;
+
+  // Top up a partial stripe first
+  if (hash->buffered) {
+    gsize fill = MIN(len, sizeof(hash->buffer) - hash->buffered);
+    memcpy(hash->buffer + hash->buffered, p, fill);
+    hash->buffered += fill;
+    p += fill;
+    if (hash->buffered < sizeof(hash->buffer))
+      return;
+    consume_stripe(hash->lanes, hash->buffer);
+    hash->buffered = 0;
+  }
+
+  while (end - p >= 32) {
+    consume_stripe(hash->lanes, p);
+    p += 32;
+  }
+
+  memcpy(hash->buffer, p, end - p);
+  hash->buffered = end - p;
+}
+
+guint64 Hash64_digest(const Hash64 *hash) {
+  guint64 h;
+  if (hash->total_len >= 32) {
+    const guint64 *v = hash->lanes;
+    h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) +
+        rotl64(v[3], 18);
+    for (int i = 0; i < 4; i++) {
+      h = merge_round(h, v[i]);
+    }
+  } else {
+    h = hash->seed + PRIME64_5;
+  }
+  h += hash->total_len;
+
+  // The tail: whatever did not fill a stripe
+  const guchar *p = hash->buffer;
+  const guchar *end = p + hash->buffered;
+  for (; end - p >= 8; p += 8) {
+    h ^= round64(0, read64(p));
+    h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (end - p >= 4) {
+    h ^= (guint64)read32(p) * PRIME64_1;
+    h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= *p * PRIME64_5;
+    h = rotl64(h, 11) * PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+guint64 Hash64_bytes(const void *data, gsize len, guint64 seed) {
+  Hash64 hash;
+  Hash64_init(&hash, seed);
+  Hash64_update(&hash, data, len);
+  return Hash64_digest(&hash);
+}
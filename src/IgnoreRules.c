@@ -0,0 +1,384 @@
+#include "IgnoreRules.h"
+#include "Search.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Relative paths up to this long are built on the stack
+#define RELATIVE_PATH_MAX 1024
+
+static void add_rules(IgnoreRules *level, const char *text, gsize len);
+static void add_rule(IgnoreRules *level, gchar *line);
+static guint lookup(GHashTable *table, const char *key);
+static guint match_level(const IgnoreRules *level, const char *dir_path,
+                         const char *name, gboolean is_dir);
+static const char *match_class(const char *glob, unsigned char c,
+                               gboolean *matched);
+
+IgnoreRules *IgnoreRules_load(int dirfd, const char *base,
+                              IgnoreRules *parent) {
+  static const char *const files[] = {IGNORE_RULES_FILES};
+  IgnoreRules *level = NULL;
+
+  for (gsize i = 0; i < G_N_ELEMENTS(files); i++) {
+    size_t size = 0;
+    char *text = ReadFileAt(dirfd, files[i], &size);
+    if (!text)
+      continue;
+
+    if (!level) {
+      level = IgnoreRules_parse("", 0, base, parent);
+    }
+    add_rules(level, text, size);
+    FreeFileContents(text, size);
+  }
+
+  // Nothing but comments: the directory shares its parent's rules
+  if (level && level->rules->len == 0) {
+    IgnoreRules_unref(level);
+    level = NULL;
+  }
+  return level ? level : IgnoreRules_ref(parent);
+}
+
+IgnoreRules *IgnoreRules_parse(const char *text, gsize len, const char *base,
+                               IgnoreRules *parent) {
+  IgnoreRules *level = g_new0(IgnoreRules, 1);
+  level->parent = IgnoreRules_ref(parent);
+  level->base = g_strdup(base);
+  level->ref_count = 1;
+  level->rules = g_array_new(FALSE, FALSE, sizeof(IgnoreRule));
+  level->globs = g_array_new(FALSE, FALSE, sizeof(guint));
+
+  add_rules(level, text, len);
+  return level;
+}
+
+gboolean IgnoreRules_is_ignored(const IgnoreRules *rules,
+                                const char *dir_path, const char *name,
+                                gboolean is_dir) {
+  // A deeper ignore file overrides the ones above it
+  for (const IgnoreRules *level = rules; level; level = level->parent) {
+    guint index = match_level(level, dir_path, name, is_dir);
+    if (index) {
+      const IgnoreRule *rule =
+          &g_array_index(level->rules, IgnoreRule, index - 1);
+      return !(rule->flags & IGNORE_RULE_NEGATE);
+    }
+  }
+  return FALSE;
+}
+
+gboolean IgnoreRules_glob_match(const char *glob, const char *text) {
+  const char *p = glob;
+  const char *t = text;
+
+  while (*p) {
+    if (p[0] == '*' && p[1] == '*' && p[2] == '/') {
+      // "**/": zero or more whole directories
+      for (;;) {
+        if (IgnoreRules_glob_match(p + 3, t))
+          return TRUE;
+        t = strchr(t, '/');
+        if (!t)
+          return FALSE;
+        t++;
+      }
+    }
+
+    if (p[0] == '*') {
+      // Any other "**" crosses directories, a single '*' does not
+      gboolean any_depth = p[1] == '*';
+      while (*p == '*') {
+        p++;
+      }
+      if (!*p)
+        return any_depth || !strchr(t, '/');
+
+      for (;; t++) {
+        if (IgnoreRules_glob_match(p, t))
+          return TRUE;
+        if (!*t || (*t == '/' && !any_depth))
+          return FALSE;
+      }
+    }
+
+    if (p[0] == '/' && p[1] == '*' && p[2] == '*' && !p[3]) {
+      // Trailing "/**": everything inside the directory
+      return t[0] == '/' && t[1];
+    }
+
+    if (!*t)
+      return FALSE;
+
+    if (*p == '?') {
+      if (*t == '/')
+        return FALSE;
+      p++;
+      t++;
+      continue;
+    }
+
+    if (*p == '[' && *t != '/') {
+      gboolean matched;
+      const char *next = match_class(p + 1, (unsigned char)*t, &matched);
+      if (next) {
+        if (!matched)
+          return FALSE;
+        p = next;
+        t++;
+        continue;
+      }
+      // Unterminated class: a literal '['
+    }
+
+    if (*p == '\\' && p[1]) {
+      p++;
+    }
+    if (*p != *t)
+      return FALSE;
+    p++;
+    t++;
+  }
+  return !*t;
+}
+
+IgnoreRules *IgnoreRules_ref(IgnoreRules *rules) {
+  if (rules) {
+    g_atomic_int_inc(&rules->ref_count);
+  }
+  return rules;
+}
+
+void IgnoreRules_unref(IgnoreRules *rules) {
+  while (rules && g_atomic_int_dec_and_test(&rules->ref_count)) {
+    IgnoreRules *parent = rules->parent;
+
+    for (guint i = 0; i < rules->rules->len; i++) {
+      g_free(g_array_index(rules->rules, IgnoreRule, i).glob);
+    }
+    g_array_free(rules->rules, TRUE);
+    g_array_free(rules->globs, TRUE);
+    g_clear_pointer(&rules->names, g_hash_table_destroy);
+    g_clear_pointer(&rules->dir_names, g_hash_table_destroy);
+    g_clear_pointer(&rules->paths, g_hash_table_destroy);
+    g_clear_pointer(&rules->dir_paths, g_hash_table_destroy);
+    g_clear_pointer(&rules->suffixes, g_hash_table_destroy);
+    g_free(rules->base);
+    g_free(rules);
+
+    // Iterative, so a deep chain cannot overflow the stack
+    rules = parent;
+  }
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static void add_rules(IgnoreRules *level, const char *text, gsize len) {
+  const char *end = text + len;
+
+  while (text < end) {
+    const char *eol = memchr(text, '\n', end - text);
+    if (!eol) {
+      eol = end;
+    }
+    add_rule(level, g_strndup(text, eol - text));
+    text = eol + 1;
+  }
+}
+
+// Keys point into the rule's glob, which lives as long as the level
+static void index_rule(GHashTable **table, const char *key, guint index) {
+  if (!*table) {
+    *table = g_hash_table_new(g_str_hash, g_str_equal);
+  }
+  // A later rule for the same key replaces the earlier one, as it would win
+  g_hash_table_insert(*table, (gpointer)key, GUINT_TO_POINTER(index + 1));
+}
+
+// Takes ownership of line
+static void add_rule(IgnoreRules *level, gchar *line) {
+  IgnoreRule rule = {NULL, 0};
+  gchar *glob = line;
+  gsize len = strlen(glob);
+
+  // Trailing blanks are dropped unless escaped
+  while (len > 0 && (glob[len - 1] == '\r' || glob[len - 1] == ' ') &&
+         !(len > 1 && glob[len - 2] == '\\' && glob[len - 1] == ' ')) {
+    glob[--len] = '\0';
+  }
+
+  if (len == 0 || glob[0] == '#') {
+    g_free(line);
+    return;
+  }
+
+  if (glob[0] == '!') {
+    rule.flags |= IGNORE_RULE_NEGATE;
+    glob++;
+    len--;
+  }
+  while (len > 0 && glob[len - 1] == '/') {
+    rule.flags |= IGNORE_RULE_DIR_ONLY;
+    glob[--len] = '\0';
+  }
+  if (glob[0] == '/') {
+    rule.flags |= IGNORE_RULE_ANCHORED;
+    glob++;
+  } else {
+    // "**/name" is a plain name at any depth
+    while (g_str_has_prefix(glob, "**/") && !strchr(glob + 3, '/')) {
+      glob += 3;
+    }
+    if (strchr(glob, '/')) {
+      rule.flags |= IGNORE_RULE_ANCHORED;
+    }
+  }
+
+  if (!*glob) {
+    g_free(line);
+    return;
+  }
+
+  rule.glob = g_strdup(glob);
+  g_free(line);
+
+  guint index = level->rules->len;
+  g_array_append_val(level->rules, rule);
+
+  gboolean dir_only = (rule.flags & IGNORE_RULE_DIR_ONLY) != 0;
+  if (rule.flags & IGNORE_RULE_ANCHORED) {
+    level->anchored = TRUE;
+  }
+  if (!strpbrk(rule.glob, "*?[\\")) {
+    if (rule.flags & IGNORE_RULE_ANCHORED) {
+      index_rule(dir_only ? &level->dir_paths : &level->paths, rule.glob,
+                 index);
+    } else {
+      index_rule(dir_only ? &level->dir_names : &level->names, rule.glob,
+                 index);
+    }
+  } else if (!dir_only && !(rule.flags & IGNORE_RULE_ANCHORED) &&
+             rule.glob[0] == '*' && rule.glob[1] == '.' &&
+             !strpbrk(rule.glob + 1, "*?[\\")) {
+    // "*.o", "*.tar.gz": keyed by everything from the first dot on
+    index_rule(&level->suffixes, rule.glob + 1, index);
+  } else {
+    g_array_append_val(level->globs, index);
+  }
+}
+
+static guint lookup(GHashTable *table, const char *key) {
+  return table ? GPOINTER_TO_UINT(g_hash_table_lookup(table, key)) : 0;
+}
+
+// Path of dir_path/name relative to the level's directory
+static const char *relative_path(const IgnoreRules *level,
+                                 const char *dir_path, const char *name,
+                                 char *buf, gchar **heap) {
+  gsize base_len = strlen(level->base);
+  const char *rel_dir = dir_path + base_len;
+  if (*rel_dir == '/') {
+    rel_dir++;
+  }
+  if (!*rel_dir)
+    return name;
+
+  gsize dir_len = strlen(rel_dir);
+  gsize name_len = strlen(name);
+  if (dir_len + name_len + 2 > RELATIVE_PATH_MAX) {
+    *heap = g_strconcat(rel_dir, "/", name, NULL);
+    return *heap;
+  }
+  memcpy(buf, rel_dir, dir_len);
+  buf[dir_len] = '/';
+  memcpy(buf + dir_len + 1, name, name_len + 1);
+  return buf;
+}
+
+// Index + 1 of the last rule of this level matching the entry, 0 if none
+static guint match_level(const IgnoreRules *level, const char *dir_path,
+                         const char *name, gboolean is_dir) {
+  guint best = lookup(level->names, name);
+  if (is_dir) {
+    best = MAX(best, lookup(level->dir_names, name));
+  }
+
+  // One lookup per dot in the name
+  if (level->suffixes) {
+    for (const char *dot = strchr(name, '.'); dot; dot = strchr(dot + 1, '.')) {
+      best = MAX(best, lookup(level->suffixes, dot));
+    }
+  }
+
+  gboolean anchored = level->anchored;
+  char buf[RELATIVE_PATH_MAX];
+  gchar *heap = NULL;
+  const char *rel =
+      anchored ? relative_path(level, dir_path, name, buf, &heap) : name;
+
+  if (anchored) {
+    best = MAX(best, lookup(level->paths, rel));
+    if (is_dir) {
+      best = MAX(best, lookup(level->dir_paths, rel));
+    }
+  }
+
+  // Newest first: an older glob cannot beat a match already found
+  for (guint i = level->globs->len; i > 0; i--) {
+    guint index = g_array_index(level->globs, guint, i - 1);
+    if (index < best)
+      break;
+
+    const IgnoreRule *rule = &g_array_index(level->rules, IgnoreRule, index);
+    if ((rule->flags & IGNORE_RULE_DIR_ONLY) && !is_dir)
+      continue;
+
+    const char *text = (rule->flags & IGNORE_RULE_ANCHORED) ? rel : name;
+    if (IgnoreRules_glob_match(rule->glob, text)) {
+      best = index + 1;
+      break;
+    }
+  }
+
+  g_free(heap);
+  return best;
+}
+
+// Match c against the class after a '['; returns the glob past the ']', or
+// NULL if the class is not terminated
+static const char *match_class(const char *glob, unsigned char c,
+                               gboolean *matched) {
+  gboolean negate = *glob == '!' || *glob == '^';
+  gboolean hit = FALSE;
+
+  if (negate) {
+    glob++;
+  }
+  // A ']' right after the '[' is a member
+  for (gboolean first = TRUE; *glob && (*glob != ']' || first);
+       first = FALSE) {
+    unsigned char lo = (unsigned char)*glob++;
+    if (lo == '\\' && *glob) {
+      lo = (unsigned char)*glob++;
+    }
+    unsigned char hi = lo;
+    if (glob[0] == '-' && glob[1] && glob[1] != ']') {
+      glob++;
+      hi = (unsigned char)*glob++;
+      if (hi == '\\' && *glob) {
+        hi = (unsigned char)*glob++;
+      }
+    }
+    if (c >= lo && c <= hi) {
+      hit = TRUE;
+    }
+  }
+
+  if (*glob != ']')
+    return NULL;
+  *matched = hit != negate;
+  return glob + 1;
+}
@@ -0,0 +1,387 @@
+#define _DEFAULT_SOURCE
+#define INITIAL_CAPACITY 64
+#define INITIAL_ARENA_SIZE 4096
+
+#include "Listing.h"
+#include "DirReader.h"
+#include "Memory.h"
+#include "Metrics.h"
+#include "Scheduler.h"
+#include "Sort.h"
+#include "Trace.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Icons are shared per content type across every listing; loaders may run
+// off the main thread so the table is guarded
+static GHashTable *icon_cache = NULL;
+static GMutex icon_cache_lock;
+
+// Accounted per cached content type besides its name: the hash node and a
+// themed icon with its fallback names, roughly
+#define ICON_CACHE_ENTRY_BYTES 256
+
+// Content type for an entry whose type is already resolved, without touching
+// the file itself (regular files are guessed from their name)
+static gchar *content_type_for_entry(const char *name, unsigned char type) {
+  switch (type) {
+  case DIR_TYPE_DIR:
+    return g_strdup("inode/directory");
+  case DIR_TYPE_REG:
+    return g_content_type_guess(name,  // filename
+                                NULL,  // data
+                                0,     // data_size
+                                NULL); // result_uncertain
+  case DIR_TYPE_LNK:
+    return g_strdup("inode/symlink"); // Dangling link
+  case DIR_TYPE_CHR:
+    return g_strdup("inode/chardevice");
+  case DIR_TYPE_BLK:
+    return g_strdup("inode/blockdevice");
+  case DIR_TYPE_FIFO:
+    return g_strdup("inode/fifo");
+  case DIR_TYPE_SOCK:
+    return g_strdup("inode/socket");
+  default:
+    return g_strdup("application/octet-stream");
+  }
+}
+
+GIcon *DirListing_type_for_entry(const char *name, unsigned char type,
+                                 const char **content_type) {
+  gchar *guessed = content_type_for_entry(name, type);
+
+  g_mutex_lock(&icon_cache_lock);
+  if (!icon_cache) {
+    // Keys are interned so listings can keep them as plain pointers
+    icon_cache = g_hash_table_new_full(g_str_hash,      // hash_func
+                                       g_str_equal,     // key_equal_func
+                                       NULL,            // key_destroy_func
+                                       g_object_unref); // value_destroy_func
+  }
+
+  gpointer key, value;
+  GIcon *icon;
+  if (g_hash_table_lookup_extended(icon_cache, guessed, &key, &value)) {
+    *content_type = key;
+    icon = value;
+    Metrics_add(METRIC_ICON_CACHE_HITS, 1);
+  } else {
+    Metrics_add(METRIC_ICON_CACHE_MISSES, 1);
+    *content_type = g_intern_string(guessed);
+    icon = g_content_type_get_icon(guessed);
+    g_hash_table_insert(icon_cache, (gpointer)*content_type, icon);
+    Memory_add(MEMORY_ICON_CACHE, strlen(guessed) + 1 + ICON_CACHE_ENTRY_BYTES);
+  }
+  g_mutex_unlock(&icon_cache_lock);
+
+  g_free(guessed);
+  return icon;
+}
+
+GIcon *DirListing_icon_for_entry(const char *name, unsigned char type) {
+  const char *content_type;
+  return DirListing_type_for_entry(name, type, &content_type);
+}
+
+typedef struct {
+  size_t *name_offsets;
+  unsigned char *types;
+  uint64_t *inodes;
+  GIcon **icons; // Known icons (referenced), NULL entries resolved at finish
+  const char **content_types; // Known alongside icons
+  int count;
+  int capacity;
+  char *arena;
+  size_t arena_len;
+  size_t arena_capacity;
+} ListingBuilder;
+
+static void builder_init(ListingBuilder *builder, int initial_capacity,
+                         size_t initial_arena_size) {
+  builder->capacity = MAX(initial_capacity, INITIAL_CAPACITY);
+  builder->name_offsets = malloc(builder->capacity * sizeof(size_t));
+  builder->types = malloc(builder->capacity * sizeof(unsigned char));
+  builder->inodes = malloc(builder->capacity * sizeof(uint64_t));
+  builder->icons = malloc(builder->capacity * sizeof(GIcon *));
+  builder->content_types = malloc(builder->capacity * sizeof(char *));
+  builder->count = 0;
+  builder->arena_capacity = MAX(initial_arena_size, INITIAL_ARENA_SIZE);
+  builder->arena = malloc(builder->arena_capacity);
+  builder->arena_len = 0;
+}
+
+static void builder_append(ListingBuilder *builder, const char *name,
+                           size_t name_len, unsigned char type, uint64_t inode,
+                           GIcon *icon, const char *content_type) {
+  if (builder->count >= builder->capacity) {
+    builder->capacity *= 2;
+    builder->name_offsets =
+        realloc(builder->name_offsets,               // ptr
+                builder->capacity * sizeof(size_t)); // size
+    builder->types = realloc(builder->types,                             // ptr
+                             builder->capacity * sizeof(unsigned char)); // size
+    builder->inodes = realloc(builder->inodes,                        // ptr
+                              builder->capacity * sizeof(uint64_t)); // size
+    builder->icons = realloc(builder->icons,                       // ptr
+                             builder->capacity * sizeof(GIcon *)); // size
+    builder->content_types =
+        realloc(builder->content_types,             // ptr
+                builder->capacity * sizeof(char *)); // size
+  }
+
+  while (builder->arena_len + name_len + 1 > builder->arena_capacity) {
+    builder->arena_capacity *= 2;
+    builder->arena = realloc(builder->arena, builder->arena_capacity);
+  }
+
+  memcpy(builder->arena + builder->arena_len, name, name_len + 1);
+  builder->name_offsets[builder->count] = builder->arena_len;
+  builder->types[builder->count] = type;
+  builder->inodes[builder->count] = inode;
+  builder->icons[builder->count] = icon ? g_object_ref(icon) : NULL;
+  builder->content_types[builder->count] = content_type;
+  builder->arena_len += name_len + 1;
+  builder->count++;
+}
+
+// Hand the builder's columns over to a new listing
+static DirListing *builder_finish(ListingBuilder *builder, const char *dirpath,
+                                  const char *parent_path) {
+  DirListing *listing = g_new0(DirListing, 1);
+  listing->ref_count = 1;
+  listing->path = g_strdup(dirpath);
+  listing->parent_path = g_strdup(parent_path);
+  listing->count = builder->count;
+  listing->name_arena = builder->arena;
+  listing->types = builder->types;
+  listing->inodes = builder->inodes;
+  listing->icons = builder->icons;
+  listing->content_types = builder->content_types;
+  listing->names = malloc(builder->count * sizeof(char *));
+
+  // Offsets become pointers only now that the arena has stopped moving
+  TRACE_BEGIN(icon_span);
+  for (int i = 0; i < builder->count; i++) {
+    listing->names[i] = builder->arena + builder->name_offsets[i];
+    if (!listing->content_types[i]) {
+      GIcon *icon = DirListing_type_for_entry(listing->names[i],  // name
+                                              builder->types[i],  // type
+                                              &listing->content_types[i]);
+      listing->icons[i] = icon ? g_object_ref(icon) : NULL;
+    }
+  }
+  TRACE_END_COUNT(icon_span, "icon_lookup", builder->count);
+  free(builder->name_offsets);
+
+  listing->memory_bytes =
+      sizeof(DirListing) + builder->arena_capacity +
+      builder->capacity *
+          (sizeof(unsigned char) + sizeof(uint64_t) + sizeof(GIcon *) +
+           sizeof(char *)) +
+      builder->count * sizeof(char *) + strlen(dirpath) +
+      (parent_path ? strlen(parent_path) : 0);
+  Memory_add(MEMORY_LISTING, listing->memory_bytes);
+
+  return listing;
+}
+
+static int64_t timespec_ns(const struct timespec *ts) {
+  return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+DirListing *DirListing_load(const char *dirpath) {
+  DirReader reader;
+  if (!DirReader_open(&reader, dirpath)) {
+    perror("Error opening directory");
+    return NULL;
+  }
+
+  // Taken before the first entry: a change during the read moves the ctime
+  // past it, so a cache can tell the listing may be missing it
+  struct stat dir_stat;
+  struct timespec read_at;
+  clock_gettime(CLOCK_REALTIME, &read_at);
+  int64_t dir_ctime_ns =
+      fstat(reader.fd, &dir_stat) == 0 ? timespec_ns(&dir_stat.st_ctim) : 0;
+
+  // Hot loop: one getdents64 per buffer-full, stat only when d_type is
+  // missing or the entry is a symlink
+  TRACE_BEGIN(span);
+  ListingBuilder builder;
+  builder_init(&builder, INITIAL_CAPACITY, INITIAL_ARENA_SIZE);
+
+  // Loaded from a user-initiated or background task, interactive work
+  // waiting for a worker runs in between
+  DirReaderEntry entry;
+  while (DirReader_next(&reader, &entry)) {
+    Scheduler_yield();
+    builder_append(&builder,                                // builder
+                   entry.name,                              // name
+                   entry.name_len,                          // name_len
+                   DirReader_resolve_type(&reader, &entry), // type
+                   entry.inode,                             // inode
+                   NULL,                                    // icon
+                   NULL);                                   // content_type
+  }
+  DirReader_close(&reader);
+  TRACE_END_COUNT(span, "enumerate", builder.count);
+
+  // Resolve the parent once so revisits never need realpath
+  char resolved[PATH_MAX];
+  gchar *parent_path = NULL;
+  if (realpath(dirpath, resolved) && strcmp(resolved, "/") != 0) {
+    parent_path = g_path_get_dirname(resolved);
+  }
+
+  DirListing *listing = builder_finish(&builder, dirpath, parent_path);
+  listing->dir_ctime_ns = dir_ctime_ns;
+  listing->read_at_ns = timespec_ns(&read_at);
+  g_free(parent_path);
+  return listing;
+}
+
+gboolean DirListing_is_current(const DirListing *listing) {
+  struct stat dir_stat;
+  if (listing->dir_ctime_ns == 0 || stat(listing->path, &dir_stat) != 0)
+    return FALSE;
+
+  return timespec_ns(&dir_stat.st_ctim) == listing->dir_ctime_ns &&
+         listing->dir_ctime_ns + DIR_LISTING_TIME_SLACK_NS <
+             listing->read_at_ns;
+}
+
+DirListing *DirListing_apply_changes(const DirListing *listing,
+                                     GHashTable *changed_names,
+                                     int *first_changed) {
+  int dirfd = open(listing->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirfd < 0)
+    return NULL;
+
+  int capacity = listing->count + g_hash_table_size(changed_names);
+  ListingBuilder builder;
+  builder_init(&builder, capacity, listing->memory_bytes / 2);
+
+  // Where each kept entry came from, and the stats of the re-stat'ed ones,
+  // so derived sort columns can be carried over
+  int *source_index = malloc(capacity * sizeof(int));
+  DirReaderStat *changed_stats =
+      malloc(g_hash_table_size(changed_names) * sizeof(DirReaderStat) + 1);
+
+  // Untouched entries are copied as-is, icons included
+  for (int i = 0; i < listing->count; i++) {
+    if (g_hash_table_contains(changed_names, listing->names[i]))
+      continue;
+
+    source_index[builder.count] = i;
+    builder_append(&builder,                   // builder
+                   listing->names[i],          // name
+                   strlen(listing->names[i]),  // name_len
+                   listing->types[i],          // type
+                   listing->inodes[i],         // inode
+                   listing->icons[i],          // icon
+                   listing->content_types[i]); // content_type
+  }
+  *first_changed = builder.count;
+
+  // Touched names are re-stat'ed; the ones that no longer exist drop out
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, changed_names);
+  while (g_hash_table_iter_next(&iter, &key, NULL)) {
+    const char *name = (const char *)key;
+    DirReaderStat st;
+    if (!DirReader_stat_at(dirfd, name, false, &st))
+      continue;
+
+    unsigned char type = DirReader_type_from_mode(st.mode);
+    DirReaderStat target;
+    if (type == DIR_TYPE_LNK && DirReader_stat_at(dirfd, name, true, &target)) {
+      type = DirReader_type_from_mode(target.mode);
+      st.size = target.size;
+      st.mtime_sec = target.mtime_sec;
+    }
+
+    changed_stats[builder.count - *first_changed] = st;
+    builder_append(&builder,     // builder
+                   name,         // name
+                   strlen(name), // name_len
+                   type,         // type
+                   st.inode,     // inode
+                   NULL,         // icon
+                   NULL);        // content_type
+  }
+  close(dirfd);
+
+  DirListing *patched =
+      builder_finish(&builder, listing->path, listing->parent_path);
+
+  if (listing->sizes) {
+    patched->sizes = malloc(patched->count * sizeof(uint64_t));
+    patched->mtimes = malloc(patched->count * sizeof(int64_t));
+    for (int i = 0; i < patched->count; i++) {
+      if (i < *first_changed) {
+        patched->sizes[i] = listing->sizes[source_index[i]];
+        patched->mtimes[i] = listing->mtimes[source_index[i]];
+      } else {
+        patched->sizes[i] = changed_stats[i - *first_changed].size;
+        patched->mtimes[i] = changed_stats[i - *first_changed].mtime_sec;
+      }
+    }
+    gsize column_bytes =
+        patched->count * (sizeof(uint64_t) + sizeof(int64_t));
+    patched->memory_bytes += column_bytes;
+    Memory_add(MEMORY_LISTING, column_bytes);
+  }
+
+  if (listing->name_ranks) {
+    DirListing_inherit_name_order(patched, listing, source_index,
+                                  *first_changed);
+  }
+
+  free(changed_stats);
+  free(source_index);
+  return patched;
+}
+
+DirListing *DirListing_ref(DirListing *listing) {
+  g_return_val_if_fail(listing != NULL, NULL);
+  g_atomic_int_inc(&listing->ref_count);
+  return listing;
+}
+
+void DirListing_unref(DirListing *listing) {
+  if (!listing || !g_atomic_int_dec_and_test(&listing->ref_count))
+    return;
+
+  for (int i = 0; i < listing->count; i++) {
+    if (listing->icons[i]) {
+      g_object_unref(listing->icons[i]);
+    }
+  }
+
+  free(listing->names);
+  free(listing->icons);
+  free(listing->content_types);
+  free(listing->collate_keys);
+  free(listing->collate_arena);
+  free(listing->name_ranks);
+  free(listing->sizes);
+  free(listing->mtimes);
+  free(listing->types);
+  free(listing->inodes);
+  free(listing->name_arena);
+  Memory_add(MEMORY_LISTING,
+             -(gint64)(listing->memory_bytes - listing->index_bytes));
+  Memory_add(MEMORY_INDEXES, -(gint64)listing->index_bytes);
+  g_free(listing->parent_path);
+  g_free(listing->path);
+  g_free(listing);
+}
@@ -0,0 +1,100 @@
+#include "Memory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char *tag_names[MEMORY_TAG_COUNT] = {
+    "listing",
+    "icon_cache",
+    "search_buffers",
+    "indexes",
+    "results",
+};
+
+static gint64 current[MEMORY_TAG_COUNT];
+static gint64 peak[MEMORY_TAG_COUNT];
+
+static gint64 status_kb(const char *field);
+
+void Memory_add(MemoryTag tag, gint64 bytes) {
+  gint64 now = __atomic_add_fetch(&current[tag], bytes, __ATOMIC_RELAXED);
+  if (bytes <= 0)
+    return;
+
+  // Raise the high-water mark unless another thread raised it further
+  gint64 seen = __atomic_load_n(&peak[tag], __ATOMIC_RELAXED);
+  while (now > seen &&
+         !__atomic_compare_exchange_n(&peak[tag], &seen, now, TRUE,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+void Memory_snapshot(MemorySnapshot *snapshot) {
+  for (int t = 0; t < MEMORY_TAG_COUNT; t++) {
+    snapshot->current[t] = __atomic_load_n(&current[t], __ATOMIC_RELAXED);
+    snapshot->peak[t] = __atomic_load_n(&peak[t], __ATOMIC_RELAXED);
+  }
+  snapshot->rss = status_kb("VmRSS:") * 1024;
+  snapshot->peak_rss = status_kb("VmHWM:") * 1024;
+}
+
+void Memory_reset_peaks(void) {
+  for (int t = 0; t < MEMORY_TAG_COUNT; t++) {
+    __atomic_store_n(&peak[t], __atomic_load_n(&current[t], __ATOMIC_RELAXED),
+                     __ATOMIC_RELAXED);
+  }
+
+  // "5" resets VmHWM (Linux 4.0 and later); older kernels keep the
+  // process-lifetime peak
+  FILE *clear_refs = fopen("/proc/self/clear_refs", "w");
+  if (clear_refs) {
+    fputs("5", clear_refs);
+    fclose(clear_refs);
+  }
+}
+
+const char *Memory_tag_name(MemoryTag tag) {
+  return tag_names[tag];
+}
+
+gchar *Memory_to_json(const MemorySnapshot *snapshot) {
+  GString *json = g_string_new("{");
+
+  for (int t = 0; t < MEMORY_TAG_COUNT; t++) {
+    g_string_append_printf(json,
+                           "\"%s\":{\"current\":%" G_GINT64_FORMAT
+                           ",\"peak\":%" G_GINT64_FORMAT "},",
+                           tag_names[t],         // name
+                           snapshot->current[t], // current
+                           snapshot->peak[t]);   // peak
+  }
+  g_string_append_printf(json,
+                         "\"rss\":%" G_GINT64_FORMAT
+                         ",\"peak_rss\":%" G_GINT64_FORMAT "}",
+                         snapshot->rss, snapshot->peak_rss);
+
+  return g_string_free(json, FALSE);
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+// A "Field:  123 kB" line of /proc/self/status, 0 if it is missing
+static gint64 status_kb(const char *field) {
+  FILE *status = fopen("/proc/self/status", "r");
+  if (!status)
+    return 0;
+
+  char line[256];
+  gint64 kb = 0;
+  gsize field_len = strlen(field);
+  while (fgets(line, sizeof(line), status)) {
+    if (strncmp(line, field, field_len) == 0) {
+      kb = g_ascii_strtoll(line + field_len, NULL, 10);
+      break;
+    }
+  }
+  fclose(status);
+  return kb;
+}
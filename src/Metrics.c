@@ -0,0 +1,218 @@
+#include "Metrics.h"
+#include "Memory.h"
+
+#include <glib-unix.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// One thread's metrics. Only that thread writes, with relaxed stores, so
+// a snapshot may miss the latest increments but never sees torn values.
+typedef struct {
+  gint64 counters[METRIC_COUNTER_COUNT];
+  guint64 buckets[METRIC_HISTOGRAM_COUNT][METRICS_BUCKETS];
+} MetricShard;
+
+static const char *counter_names[METRIC_COUNTER_COUNT] = {
+    "navigations",
+    "dir_cache_hits",
+    "dir_cache_misses",
+    "icon_cache_hits",
+    "icon_cache_misses",
+    "usage_cache_hits",
+    "usage_cache_misses",
+    "files_scanned",
+    "bytes_scanned",
+    "files_skipped",
+    "entries_ignored",
+    "budget_waits",
+    "budget_reclaimed_bytes",
+    "tasks_stolen",
+    "tasks_preempting",
+    "dir_cache_bytes",
+};
+
+static const char *histogram_names[METRIC_HISTOGRAM_COUNT] = {
+    "first_row_us",
+    "navigation_us",
+    "content_search_us",
+    "scan_mbps",
+    "interactive_wait_us",
+};
+
+static GMutex shards_lock;
+static GPtrArray *shards;  // Every thread's shard, kept for the process
+static GPrivate shard_key; // Calling thread's shard
+
+static MetricShard *thread_shard(void);
+static guint bucket_index(guint64 value);
+static guint64 bucket_upper_bound(guint index);
+static gboolean on_dump_signal(gpointer user_data);
+
+void Metrics_add(MetricCounter counter, gint64 amount) {
+  MetricShard *shard = thread_shard();
+  gint64 *slot = &shard->counters[counter];
+  __atomic_store_n(slot, *slot + amount, __ATOMIC_RELAXED);
+}
+
+void Metrics_record(MetricHistogram histogram, gint64 value) {
+  MetricShard *shard = thread_shard();
+  guint64 *slot =
+      &shard->buckets[histogram][bucket_index(MAX(value, (gint64)0))];
+  __atomic_store_n(slot, *slot + 1, __ATOMIC_RELAXED);
+}
+
+void Metrics_snapshot(MetricsSnapshot *snapshot) {
+  memset(snapshot, 0, sizeof(MetricsSnapshot));
+
+  g_mutex_lock(&shards_lock);
+  for (guint s = 0; shards && s < shards->len; s++) {
+    MetricShard *shard = g_ptr_array_index(shards, s);
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+      snapshot->counters[c] +=
+          __atomic_load_n(&shard->counters[c], __ATOMIC_RELAXED);
+    }
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+      for (int b = 0; b < METRICS_BUCKETS; b++) {
+        guint64 count =
+            __atomic_load_n(&shard->buckets[h][b], __ATOMIC_RELAXED);
+        snapshot->buckets[h][b] += count;
+        snapshot->totals[h] += count;
+      }
+    }
+  }
+  g_mutex_unlock(&shards_lock);
+}
+
+gint64 Metrics_percentile(const MetricsSnapshot *snapshot,
+                          MetricHistogram histogram, double percentile) {
+  guint64 total = snapshot->totals[histogram];
+  if (total == 0)
+    return 0;
+
+  guint64 rank = (guint64)ceil(percentile / 100.0 * total);
+  rank = CLAMP(rank, 1, total);
+
+  guint64 seen = 0;
+  for (guint b = 0; b < METRICS_BUCKETS; b++) {
+    seen += snapshot->buckets[histogram][b];
+    if (seen >= rank)
+      return (gint64)bucket_upper_bound(b);
+  }
+  return (gint64)bucket_upper_bound(METRICS_BUCKETS - 1);
+}
+
+const char *Metrics_counter_name(MetricCounter counter) {
+  return counter_names[counter];
+}
+
+const char *Metrics_histogram_name(MetricHistogram histogram) {
+  return histogram_names[histogram];
+}
+
+gchar *Metrics_to_json(const MetricsSnapshot *snapshot) {
+  GString *json = g_string_new("{\"counters\":{");
+
+  for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+    g_string_append_printf(json, "%s\"%s\":%" G_GINT64_FORMAT,
+                           c ? "," : "",           // separator
+                           counter_names[c],       // name
+                           snapshot->counters[c]); // value
+  }
+
+  g_string_append(json, "},\"histograms\":{");
+  for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+    g_string_append_printf(
+        json,
+        "%s\"%s\":{\"count\":%" G_GUINT64_FORMAT ",\"p50\":%" G_GINT64_FORMAT
+        ",\"p90\":%" G_GINT64_FORMAT ",\"p99\":%" G_GINT64_FORMAT
+        ",\"max\":%" G_GINT64_FORMAT "}",
+        h ? "," : "", histogram_names[h], snapshot->totals[h], // name, count
+        Metrics_percentile(snapshot, h, 50),                   // p50
+        Metrics_percentile(snapshot, h, 90),                   // p90
+        Metrics_percentile(snapshot, h, 99),                   // p99
+        Metrics_percentile(snapshot, h, 100));                 // max
+  }
+  MemorySnapshot memory;
+  Memory_snapshot(&memory);
+  gchar *memory_json = Memory_to_json(&memory);
+  g_string_append_printf(json, "},\"memory\":%s}\n", memory_json);
+  g_free(memory_json);
+
+  return g_string_free(json, FALSE);
+}
+
+void Metrics_install_dump_signal(void) {
+  g_unix_signal_add(SIGUSR1, on_dump_signal, NULL);
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+// The calling thread's shard, registered on first use
+static MetricShard *thread_shard(void) {
+  MetricShard *shard = g_private_get(&shard_key);
+  if (shard)
+    return shard;
+
+  shard = g_new0(MetricShard, 1);
+  g_private_set(&shard_key, shard);
+
+  g_mutex_lock(&shards_lock);
+  if (!shards) {
+    shards = g_ptr_array_new();
+  }
+  g_ptr_array_add(shards, shard);
+  g_mutex_unlock(&shards_lock);
+  return shard;
+}
+
+// Values below METRICS_SUB_BUCKETS get a bucket each; above, every power
+// of two is split into METRICS_SUB_BUCKETS equal buckets
+static guint bucket_index(guint64 value) {
+  value = MIN(value, (G_GUINT64_CONSTANT(1) << 48) - 1);
+  if (value < METRICS_SUB_BUCKETS)
+    return (guint)value;
+
+  guint exponent = (guint)g_bit_nth_msf((gulong)value, -1);
+  guint shift = exponent - METRICS_SUB_BUCKET_BITS;
+  guint sub_bucket = (guint)(value >> shift); // 16..31
+  return (shift + 1) * METRICS_SUB_BUCKETS + sub_bucket -
+         METRICS_SUB_BUCKETS;
+}
+
+static guint64 bucket_upper_bound(guint index) {
+  if (index < METRICS_SUB_BUCKETS)
+    return index;
+
+  guint shift = index / METRICS_SUB_BUCKETS - 1;
+  guint64 sub_bucket = index % METRICS_SUB_BUCKETS + METRICS_SUB_BUCKETS;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+static gboolean on_dump_signal(gpointer user_data) {
+  const char *env_path = g_getenv(METRICS_DUMP_ENV);
+  gchar *path = env_path ? g_strdup(env_path)
+                         : g_strdup_printf("%s/cile-metrics-%d.json",
+                                           g_get_tmp_dir(), (int)getpid());
+
+  MetricsSnapshot *snapshot = g_new(MetricsSnapshot, 1);
+  Metrics_snapshot(snapshot);
+  gchar *json = Metrics_to_json(snapshot);
+
+  GError *error = NULL;
+  if (g_file_set_contents(path, json, -1, &error)) {
+    g_printerr("Metrics written to %s\n", path);
+  } else {
+    g_printerr("Cannot write metrics: %s\n", error->message);
+    g_error_free(error);
+  }
+
+  g_free(json);
+  g_free(snapshot);
+  g_free(path);
+  return G_SOURCE_CONTINUE;
+}
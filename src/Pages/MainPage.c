@@ -1,10 +1,24 @@
 #include "Pages/MainPage.h"
-#include "Search.h"
-#include <libgen.h>
+#include "Budget.h"
+#include "DirReader.h"
+#include "Listing.h"
+#include "Memory.h"
+#include "Metrics.h"
+#include "Scheduler.h"
+#include "Sort.h"
+#include "Trace.h"
 #include <stdlib.h>
 #include <string.h>
 
-#define MAX_PATH_LENGTH 4096
+#define HOVER_PREFETCH_DELAY_MS 80 // Pointer must rest this long on a folder
+#define FRECENT_PREFETCH_COUNT 8   // Top sidebar directories kept warm
+#define FRAME_BUDGET_MS 8          // Row creation time allowed per idle slice
+#define ROW_HEIGHT_ESTIMATE 40     // Pixels, sizes the first screenful
+#define MIN_FIRST_SCREEN_ROWS 32   // When the view has no size yet
+#define MIN_CHUNK_ROWS 16          // Progress even if rows are slow
+#define INITIAL_ROWS_PER_MS 20.0   // Rate guess until one is measured
+#define DUPLICATE_GROUPS_SHOWN 100 // Groups listed, most wasteful first
+#define STATS_REFRESH_SECONDS 1    // Stats panel refresh while open
 
 // Forward declarations
 static GtkWidget *create_file_row(const char *filename, const char *full_path,
@@ -13,24 +27,154 @@ static void on_navigation_event(GtkWidget *widget, const char *path,
                                 gpointer user_data);
 static void on_search_triggered(GtkWidget *widget, const char *search_text,
                                 gpointer user_data);
-static gboolean filename_matches_pattern(const char *filename,
-                                         const char *pattern);
 static gboolean on_list_motion(GtkWidget *widget, GdkEventMotion *event,
                                gpointer user_data);
+static gboolean on_list_leave(GtkWidget *widget, GdkEventCrossing *event,
+                              gpointer user_data);
+static void on_row_selected(GtkListBox *list_box, GtkListBoxRow *row,
+                            gpointer user_data);
+static void prefetch_frecent_directories(MainPageWidget *mp);
+static GtkWidget *create_sort_header(MainPageWidget *mp);
+static gint compare_row_positions(GtkListBoxRow *a, GtkListBoxRow *b,
+                                  gpointer user_data);
+static void clear_hover(MainPageWidget *mp);
+static void start_materializer(MainPageWidget *mp, DirListing *listing,
+                               guint32 *order, int *positions);
+static void cancel_materializer(MainPageWidget *mp);
+static void begin_load_metrics(MainPageWidget *mp);
+static SortSpec current_sort(MainPageWidget *mp, DirListing *listing);
+static void start_sort_stats(MainPageWidget *mp, DirListing *listing,
+                             DirListing *source);
+static void cancel_sort_stats(MainPageWidget *mp);
+static void start_search(MainPageWidget *mp);
+static void cancel_search(MainPageWidget *mp);
+static void release_search(SearchQuery *query);
+static void drop_candidates(SearchQuery *query);
+static void start_content_search(MainPageWidget *mp);
+static void stop_content_search(MainPageWidget *mp);
+static void drop_content_candidates(ContentQuery *content);
+static void start_tree_search(MainPageWidget *mp);
+static void stop_tree_search(MainPageWidget *mp);
+static void clear_tree_rows(MainPageWidget *mp);
+static void start_usage_scan(MainPageWidget *mp);
+static void stop_usage_scan(MainPageWidget *mp);
+static void clear_usage(MainPageWidget *mp);
+static void start_duplicate_scan(MainPageWidget *mp);
+static void stop_duplicate_scan(MainPageWidget *mp);
+static void create_stats_panel(MainPageWidget *mp, GtkWidget *header);
+static void show_search_stats(MainPageWidget *mp, const char *kind,
+                              guint matches, const SearchStats *stats);
+static void sync_rows_with_listing(MainPageWidget *mp, DirListing *listing);
+static void on_directory_updated(const DirCacheUpdate *update,
+                                 gpointer user_data);
+static void apply_filter(MainPageWidget *mp);
+static gchar *current_pattern_lower(MainPageWidget *mp);
+static gboolean update_row_visibility(MainPageWidget *mp, GtkWidget *row,
+                                      const char *pattern_lower);
+static void update_status_message(MainPageWidget *mp);
+static void clear_rows(MainPageWidget *mp);
+static void show_message(MainPageWidget *mp, const char *message);
+
+// Per-row bookkeeping for rows backed by a listing entry, keyed by name
+typedef struct {
+  char *name;            // Key in MainPageWidget.rows
+  gchar *match_key;      // Lowercased name, computed once for filtering
+  uint64_t inode;
+  unsigned char type;
+  guint generation;      // Last sync that saw this entry
+  int position;          // Display position under the current sort
+  guint content_id;      // Content query content_hits belongs to
+  guint content_hits;    // Pattern occurrences in the file
+  GtkWidget *hits_label; // Shows content_hits, created on first match
+  GtkWidget *size_label; // Measured disk usage, created on first size
+} FileRowInfo;
+
+static void apply_row_size(MainPageWidget *mp, GtkWidget *row,
+                           FileRowInfo *info);
+
+// One group of identical files, formatted for the duplicates list
+typedef struct {
+  guint64 reclaimable;
+  gchar *text;
+} DuplicateRow;
+
+static void free_duplicate_row(gpointer data);
+
+static void free_row_info(gpointer data) {
+  FileRowInfo *info = (FileRowInfo *)data;
+  g_free(info->name);
+  g_free(info->match_key);
+  g_free(info);
+}
 
 MainPageWidget *MainPage_new(TopBarWidget *top_bar, SideBarWidget *side_bar) {
   // Allocate the struct
   MainPageWidget *mp = g_new0(MainPageWidget, 1);
 
-  // Create the list box
+  // Create the list box inside a scrolled window
   mp->list_box = gtk_list_box_new();
-  mp->m_MainPage = mp->list_box;
+  mp->scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+  gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(mp->scrolled_window),
+                                 GTK_POLICY_NEVER,      // hscrollbar_policy
+                                 GTK_POLICY_AUTOMATIC); // vscrollbar_policy
+  gtk_container_add(GTK_CONTAINER(mp->scrolled_window), mp->list_box);
+
+  // Sort controls above the list
+  mp->sort_spec.key = SORT_BY_NAME;
+  mp->sort_spec.descending = FALSE;
+  mp->sort_spec.directories_first = TRUE;
+  mp->m_MainPage = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+  gtk_box_pack_start(GTK_BOX(mp->m_MainPage), // box
+                     create_sort_header(mp),  // child
+                     FALSE,                   // expand
+                     FALSE,                   // fill
+                     0);                      // padding
+  gtk_box_pack_start(GTK_BOX(mp->m_MainPage), // box
+                     mp->scrolled_window,     // child
+                     TRUE,                    // expand
+                     TRUE,                    // fill
+                     0);                      // padding
+
+  // Breakdown of the last search below the list, hidden until one finishes
+  mp->status_bar = gtk_label_new(NULL);
+  gtk_label_set_xalign(GTK_LABEL(mp->status_bar), 0);
+  gtk_label_set_ellipsize(GTK_LABEL(mp->status_bar), PANGO_ELLIPSIZE_END);
+  gtk_widget_set_no_show_all(mp->status_bar, TRUE);
+  gtk_box_pack_start(GTK_BOX(mp->m_MainPage), // box
+                     mp->status_bar,          // child
+                     FALSE,                   // expand
+                     FALSE,                   // fill
+                     2);                      // padding
   mp->top_bar = top_bar;
   mp->side_bar = side_bar;
   mp->current_search_pattern = NULL;
+  mp->dir_cache = DirCache_new(0);
+  mp->rows = g_hash_table_new(g_str_hash, g_str_equal);
+  mp->tree.rows = g_ptr_array_new();
+  mp->usage.sizes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                          g_free);
+  mp->dups.groups = g_ptr_array_new_with_free_func(free_duplicate_row);
+
+  // Apply live changes to the directory on screen
+  DirCache_set_update_func(mp->dir_cache, on_directory_updated, mp);
+
+  // Warm likely next directories in the background
+  mp->prefetcher = Prefetcher_new(mp->dir_cache);
+
+  // Status row shown when nothing else is visible
+  mp->message_label = gtk_label_new(NULL);
+  mp->message_row = gtk_list_box_row_new();
+  gtk_container_add(GTK_CONTAINER(mp->message_row), mp->message_label);
+  gtk_widget_set_no_show_all(mp->message_row, TRUE);
+  gtk_widget_show(mp->message_label);
+  gtk_list_box_insert(GTK_LIST_BOX(mp->list_box), mp->message_row, -1);
 
   gtk_list_box_set_selection_mode(GTK_LIST_BOX(mp->list_box),
                                   GTK_SELECTION_SINGLE);
+  gtk_list_box_set_sort_func(GTK_LIST_BOX(mp->list_box), // box
+                             compare_row_positions,      // sort_func
+                             mp,                         // user_data
+                             NULL);                      // destroy
   gtk_widget_set_can_focus(mp->list_box, FALSE);
   gtk_widget_add_events(mp->list_box,
                         GDK_POINTER_MOTION_MASK | GDK_LEAVE_NOTIFY_MASK);
@@ -50,6 +194,10 @@ MainPageWidget *MainPage_new(TopBarWidget *top_bar, SideBarWidget *side_bar) {
 
   g_signal_connect(mp->list_box, "motion-notify-event",
                    G_CALLBACK(on_list_motion), mp);
+  g_signal_connect(mp->list_box, "leave-notify-event",
+                   G_CALLBACK(on_list_leave), mp);
+  g_signal_connect(mp->list_box, "row-selected", G_CALLBACK(on_row_selected),
+                   mp);
 
   // Initial population
   const char *home_dir = g_get_home_dir();
@@ -61,7 +209,30 @@ MainPageWidget *MainPage_new(TopBarWidget *top_bar, SideBarWidget *side_bar) {
 
 void MainPage_destroy(MainPageWidget *mp) {
   if (mp) {
+    // Rows are destroyed after us and may still emit selection changes
+    g_signal_handlers_disconnect_by_data(mp->list_box, mp);
+    clear_hover(mp);
+    cancel_materializer(mp);
+    cancel_sort_stats(mp);
+    cancel_search(mp);
+    drop_candidates(&mp->search);
+    drop_content_candidates(&mp->content);
+    g_ptr_array_free(mp->tree.rows, TRUE);
+    stop_usage_scan(mp);
+    g_hash_table_destroy(mp->usage.sizes);
+    stop_duplicate_scan(mp);
+    g_ptr_array_free(mp->dups.groups, TRUE);
+    g_clear_handle_id(&mp->stats.refresh_source, g_source_remove);
+    if (mp->load_metrics.paint_handler) {
+      g_signal_handler_disconnect(mp->load_metrics.clock,
+                                  mp->load_metrics.paint_handler);
+    }
+
     g_free(mp->current_search_pattern);
+    g_hash_table_destroy(mp->rows);
+    DirListing_unref(mp->listing);
+    Prefetcher_destroy(mp->prefetcher);
+    DirCache_destroy(mp->dir_cache);
     // Widget will be destroyed by GTK when parent is destroyed
     g_free(mp);
   }
@@ -71,6 +242,8 @@ void MainPage_update_state(MainPageWidget *mp, const char *directory) {
   if (!mp || !directory)
     return;
 
+  TRACE_BEGIN(span);
+
   // TopBar holds the canonical current directory
   // Update it if we're navigating from row activation
   const char *current = TopBar_get_address(mp->top_bar);
@@ -78,73 +251,69 @@ void MainPage_update_state(MainPageWidget *mp, const char *directory) {
     TopBar_set_address(mp->top_bar, directory);
   }
 
-  // Clear existing children
-  GList *children = gtk_container_get_children(GTK_CONTAINER(mp->list_box));
-  for (GList *child = children; child != NULL; child = child->next) {
-    gtk_widget_destroy(GTK_WIDGET(child->data));
+  // Revisits render straight from the cache; misses are listed and cached.
+  // The directory on screen stays pinned so its watch keeps it live.
+  begin_load_metrics(mp);
+  DirCache_pin(mp->dir_cache, directory);
+  DirListing *listing = DirCache_lookup(mp->dir_cache, directory);
+  if (!listing) {
+    TRACE_BEGIN(load_span);
+    Prefetcher_note_foreground_io(mp->prefetcher);
+    listing = DirListing_load(directory);
+    TRACE_END(load_span, "DirListing_load");
+    if (listing) {
+      DirCache_insert(mp->dir_cache, listing);
+    }
   }
-  g_list_free(children);
 
-  // Add "Back" button if not at root directory (always show, no filtering)
-  char parent_directory[MAX_PATH_LENGTH];
-  if (g_strcmp0(directory, "/") != 0) {
-    if (realpath(directory, parent_directory)) {
-      char *parent = dirname(parent_directory);
-      GtkWidget *back_row = create_file_row(".. (Back)", parent, NULL);
-      gtk_list_box_insert(GTK_LIST_BOX(mp->list_box), back_row, -1);
-    } else {
-      g_printerr("Failed to get parent directory of: %s\n", directory);
-    }
+  if (!listing) {
+    clear_rows(mp);
+    DirListing_unref(mp->listing);
+    mp->listing = NULL;
+    show_message(mp, "Failed to load files.");
+    TRACE_END(span, "MainPage_update_state");
+    return;
   }
 
-  // Populate with files
-  int file_count = 0;
-  FileEntry **files = ListFilesInDir(directory, &file_count);
+  // Start at the top when entering a different directory; refreshes of the
+  // same one keep their scroll position and selection
+  gboolean directory_changed =
+      !mp->listing || g_strcmp0(mp->listing->path, listing->path) != 0;
 
-  if (!files) {
-    gtk_list_box_insert(GTK_LIST_BOX(mp->list_box),
-                        gtk_label_new("Failed to load files."), -1);
-    return;
+  // Sizes belong to the folder they were measured in
+  if (directory_changed) {
+    clear_usage(mp);
   }
 
-  if (file_count == 0) {
-    gtk_list_box_insert(GTK_LIST_BOX(mp->list_box),
-                        gtk_label_new("No files found."), -1);
+  // Apply only the differences, then let the filter decide visibility
+  if (mp->listing != listing) {
+    TRACE_BEGIN(sync_span);
+    sync_rows_with_listing(mp, listing);
+    TRACE_END_COUNT(sync_span, "sync_rows", listing->count);
+    DirListing_unref(mp->listing);
+    mp->listing = listing;
   } else {
-    int visible_count = 0;
-
-    for (int i = 0; i < file_count; i++) {
-      // Apply search filter if pattern exists
-      if (mp->current_search_pattern &&
-          strlen(mp->current_search_pattern) > 0) {
-        if (!filename_matches_pattern(files[i]->filename,
-                                      mp->current_search_pattern)) {
-          continue; // Skip this file
-        }
-      }
-
-      char full_path[MAX_PATH_LENGTH];
-      snprintf(full_path, MAX_PATH_LENGTH, "%s/%s", directory,
-               files[i]->filename);
+    DirListing_unref(listing);
+  }
+  TRACE_BEGIN(filter_span);
+  apply_filter(mp);
+  TRACE_END(filter_span, "apply_filter");
 
-      GtkWidget *row = create_file_row(files[i]->filename, full_path,
-                                       (GIcon *)files[i]->icon_data);
-      gtk_list_box_insert(GTK_LIST_BOX(mp->list_box), row, -1);
-      visible_count++;
-    }
+  if (directory_changed) {
+    Metrics_add(METRIC_NAVIGATIONS, 1);
+    GtkAdjustment *vadjustment = gtk_scrolled_window_get_vadjustment(
+        GTK_SCROLLED_WINDOW(mp->scrolled_window));
+    gtk_adjustment_set_value(vadjustment, 0);
 
-    // Show message if search filtered everything out
-    if (visible_count == 0 && mp->current_search_pattern &&
-        strlen(mp->current_search_pattern) > 0) {
-      gchar *msg =
-          g_strdup_printf("No files match '%s'", mp->current_search_pattern);
-      gtk_list_box_insert(GTK_LIST_BOX(mp->list_box), gtk_label_new(msg), -1);
-      g_free(msg);
-    }
+    // Subtree results belong to the folder they were searched from
+    clear_tree_rows(mp);
+    gtk_widget_hide(mp->status_bar);
+    start_usage_scan(mp);
+    start_duplicate_scan(mp);
+    clear_hover(mp);
+    prefetch_frecent_directories(mp);
   }
-
-  FreeFileEntries(files, file_count);
-  // gtk_widget_show_all(mp->m_MainPage);
+  TRACE_END(span, "MainPage_update_state");
 }
 
 static void on_navigation_event(GtkWidget *widget, const char *path,
@@ -170,11 +339,16 @@ static void on_navigation_event(GtkWidget *widget, const char *path,
   if (!target_path)
     return;
 
-  // Validate and navigate
-  if (g_file_test(target_path, G_FILE_TEST_IS_DIR)) {
-    // Clear search when navigating to a new directory
+  // Validate and navigate (a cached listing is already known to be a valid
+  // directory, so revisits skip the stat)
+  if (DirCache_contains(mp->dir_cache, target_path) ||
+      g_file_test(target_path, G_FILE_TEST_IS_DIR)) {
+    // Clear search when navigating to a new directory; typing the same
+    // text again searches the new one
     g_free(mp->current_search_pattern);
     mp->current_search_pattern = NULL;
+    mp->query_mode = FALSE;
+    TopBar_forget_search(mp->top_bar);
 
     SideBar_add_recent_directory(mp->side_bar, target_path);
 
@@ -201,38 +375,18 @@ static void on_search_triggered(GtkWidget *widget, const char *search_text,
 
   if (search_text && strlen(search_text) > 0) {
     mp->current_search_pattern = g_strdup(search_text);
-    g_print("Search triggered: '%s'\n", search_text);
   } else {
     mp->current_search_pattern = NULL;
-    g_print("Search cleared\n");
-  }
-
-  // Refresh the current directory with the new filter
-  const char *current_dir = TopBar_get_address(mp->top_bar);
-  if (current_dir) {
-    MainPage_update_state(mp, current_dir);
   }
-}
-
-// Simple case-insensitive substring match
-static gboolean filename_matches_pattern(const char *filename,
-                                         const char *pattern) {
-  if (!filename || !pattern)
-    return TRUE;
-
-  if (strlen(pattern) == 0)
-    return TRUE;
-
-  // Convert both to lowercase for case-insensitive comparison
-  gchar *filename_lower = g_utf8_strdown(filename, -1);
-  gchar *pattern_lower = g_utf8_strdown(pattern, -1);
-
-  gboolean matches = (strstr(filename_lower, pattern_lower) != NULL);
 
-  g_free(filename_lower);
-  g_free(pattern_lower);
+  // Query syntax is answered by walking the folder, not by the row filter
+  Query *query = Query_parse(search_text ? search_text : "", QUERY_DEFAULT);
+  mp->query_mode = !query->plain;
+  Query_free(query);
 
-  return matches;
+  // Only visibility changes; no rows are created or destroyed. Whatever the
+  // previous query was still doing is abandoned.
+  start_search(mp);
 }
 
 // ==========================================
@@ -241,6 +395,7 @@ static gboolean filename_matches_pattern(const char *filename,
 
 static GtkWidget *create_file_row(const char *filename, const char *full_path,
                                   GIcon *icon) {
+  TRACE_BEGIN(span);
   GtkWidget *row = gtk_list_box_row_new();
   GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
 
@@ -261,17 +416,1686 @@ static GtkWidget *create_file_row(const char *filename, const char *full_path,
   gtk_box_pack_start(GTK_BOX(box), label, TRUE, TRUE, 5);
 
   gtk_container_add(GTK_CONTAINER(row), box);
+  g_object_set_data(G_OBJECT(row), "icon-image", icon_widget);
 
   // Store the full path in the row for later use
   g_object_set_data_full(G_OBJECT(row), "full-path", g_strdup(full_path),
                          g_free);
   gtk_widget_show_all(row);
 
+  TRACE_END(span, "create_row");
+  return row;
+}
+
+static void set_row_path(GtkWidget *row, const char *directory,
+                         const char *name) {
+  gchar *full_path = g_build_filename(directory, name, NULL);
+  g_object_set_data_full(G_OBJECT(row), "full-path", full_path, g_free);
+}
+
+static GtkWidget *create_listing_row(const DirListing *listing, int index) {
+  gchar *full_path =
+      g_build_filename(listing->path, listing->names[index], NULL);
+  GtkWidget *row = create_file_row(listing->names[index], full_path,
+                                   listing->icons[index]);
+  g_free(full_path);
+
+  FileRowInfo *info = g_new0(FileRowInfo, 1);
+  info->name = g_strdup(listing->names[index]);
+  info->match_key = g_utf8_strdown(listing->names[index], -1);
+  info->inode = listing->inodes[index];
+  info->type = listing->types[index];
+  g_object_set_data_full(G_OBJECT(row), "row-info", info, free_row_info);
+
+  return row;
+}
+
+// Display order of the listing under the current sort, and the inverse:
+// the display position of every entry
+static guint32 *listing_order(MainPageWidget *mp, DirListing *listing,
+                              int **positions) {
+  SortSpec spec = current_sort(mp, listing);
+  guint32 *order = DirListing_sort(listing, &spec);
+  *positions = g_new(int, listing->count + 1);
+
+  for (int k = 0; k < listing->count; k++) {
+    (*positions)[order[k]] = k;
+  }
+  return order;
+}
+
+static int *listing_positions(MainPageWidget *mp, DirListing *listing) {
+  int *positions;
+  g_free(listing_order(mp, listing, &positions));
+  return positions;
+}
+
+// Make sure listing entry `index` has an up-to-date row stamped with
+// `generation` at `position`: create it if the name is new, patch it if the
+// inode, type or directory changed
+static GtkWidget *sync_row(MainPageWidget *mp, const DirListing *listing,
+                           int index, int position, guint generation,
+                           gboolean same_directory) {
+  GtkWidget *row = g_hash_table_lookup(mp->rows, listing->names[index]);
+
+  if (!row) {
+    row = create_listing_row(listing, index);
+    FileRowInfo *info = g_object_get_data(G_OBJECT(row), "row-info");
+    info->generation = generation;
+    info->position = position;
+    g_hash_table_insert(mp->rows, info->name, row);
+    gtk_list_box_insert(GTK_LIST_BOX(mp->list_box), row, -1);
+    apply_row_size(mp, row, info);
+    return row;
+  }
+
+  FileRowInfo *info = g_object_get_data(G_OBJECT(row), "row-info");
+  info->generation = generation;
+  info->position = position;
+
+  if (!same_directory) {
+    set_row_path(row, listing->path, listing->names[index]);
+    apply_row_size(mp, row, info);
+  }
+
+  // Same name but a different file: refresh what the row shows
+  if (!same_directory || info->inode != listing->inodes[index] ||
+      info->type != listing->types[index]) {
+    info->inode = listing->inodes[index];
+    info->type = listing->types[index];
+
+    GtkWidget *image = g_object_get_data(G_OBJECT(row), "icon-image");
+    if (listing->icons[index]) {
+      gtk_image_set_from_gicon(GTK_IMAGE(image), listing->icons[index],
+                               GTK_ICON_SIZE_LARGE_TOOLBAR);
+    } else {
+      gtk_image_set_from_icon_name(GTK_IMAGE(image), "text-x-generic",
+                                   GTK_ICON_SIZE_LARGE_TOOLBAR);
+    }
+  }
+
   return row;
 }
 
+// Keyed diff between the rows on screen and a listing: rows whose name
+// survives are kept (and patched if needed), vanished names lose theirs, and
+// new names get rows from the materializer
+static void sync_rows_with_listing(MainPageWidget *mp, DirListing *listing) {
+  gboolean same_directory =
+      mp->listing && g_strcmp0(mp->listing->path, listing->path) == 0;
+  guint generation = ++mp->generation;
+  int *positions;
+  guint32 *order = listing_order(mp, listing, &positions);
+
+  cancel_materializer(mp);
+  for (int i = 0; i < listing->count; i++) {
+    if (g_hash_table_contains(mp->rows, listing->names[i])) {
+      sync_row(mp, listing, i, positions[i], generation, same_directory);
+    }
+  }
+
+  // Drop rows whose entries are gone
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, mp->rows);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    FileRowInfo *info = g_object_get_data(G_OBJECT(value), "row-info");
+    if (info->generation != generation) {
+      g_hash_table_iter_remove(&iter);
+      gtk_widget_destroy(GTK_WIDGET(value));
+    }
+  }
+
+  // Keep the "Back" row pointing at this directory's parent
+  if (listing->parent_path && !mp->back_row) {
+    mp->back_row = create_file_row(".. (Back)", listing->parent_path, NULL);
+    gtk_list_box_insert(GTK_LIST_BOX(mp->list_box), mp->back_row, 0);
+  } else if (listing->parent_path) {
+    g_object_set_data_full(G_OBJECT(mp->back_row), "full-path",
+                           g_strdup(listing->parent_path), g_free);
+  } else if (mp->back_row) {
+    gtk_widget_destroy(mp->back_row);
+    mp->back_row = NULL;
+  }
+
+  // Kept rows may have moved relative to each other
+  gtk_list_box_invalidate_sort(GTK_LIST_BOX(mp->list_box));
+
+  start_materializer(mp, listing, order, positions);
+}
+
+// Apply one coalesced batch to the rows: only the touched names are looked
+// at, so a directory churning thousands of files stays cheap to follow
+static void patch_rows(MainPageWidget *mp, const DirCacheUpdate *update) {
+  DirListing *listing = update->listing;
+  guint generation = ++mp->generation;
+  gchar *pattern_lower = current_pattern_lower(mp);
+  int *positions = listing_positions(mp, listing);
+
+  // Untouched rows only shift; their relative order is unchanged, so the
+  // list box does not need a full re-sort
+  for (int i = 0; i < update->first_changed; i++) {
+    GtkWidget *row = g_hash_table_lookup(mp->rows, listing->names[i]);
+    if (row) {
+      FileRowInfo *info = g_object_get_data(G_OBJECT(row), "row-info");
+      info->position = positions[i];
+    }
+  }
+
+  // Present (re-stat'ed) names come last in the patched listing
+  for (int i = update->first_changed; i < listing->count; i++) {
+    GtkWidget *row = g_hash_table_lookup(mp->rows, listing->names[i]);
+    gboolean existed = row != NULL;
+    gboolean was_visible = row && gtk_widget_get_visible(row);
+
+    row = sync_row(mp, listing, i, positions[i], generation, TRUE);
+    if (existed) {
+      gtk_list_box_row_changed(GTK_LIST_BOX_ROW(row)); // Re-place this row
+    }
+    mp->visible_count +=
+        update_row_visibility(mp, row, pattern_lower) - was_visible;
+  }
+  g_free(positions);
+
+  // Touched names that did not come back were deleted or renamed away
+  for (guint i = 0; i < update->changed->len; i++) {
+    const char *name = g_ptr_array_index(update->changed, i);
+    GtkWidget *row = g_hash_table_lookup(mp->rows, name);
+    if (!row)
+      continue;
+
+    FileRowInfo *info = g_object_get_data(G_OBJECT(row), "row-info");
+    if (info->generation != generation) {
+      mp->visible_count -= gtk_widget_get_visible(row);
+      g_hash_table_remove(mp->rows, name);
+      gtk_widget_destroy(row);
+    }
+  }
+
+  g_free(pattern_lower);
+  update_status_message(mp);
+}
+
+static void on_directory_updated(const DirCacheUpdate *update,
+                                 gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+
+  if (!mp->listing || g_strcmp0(update->path, mp->listing->path) != 0)
+    return;
+
+  if (!update->listing) {
+    clear_rows(mp);
+    DirListing_unref(mp->listing);
+    mp->listing = NULL;
+    show_message(mp, "This directory no longer exists.");
+    return;
+  }
+
+  if (update->changed) {
+    // Rows still waiting to be created come from the patched listing now
+    gboolean materializing = mp->materializer.listing != NULL;
+    cancel_materializer(mp);
+    patch_rows(mp, update);
+    if (materializing) {
+      int *positions;
+      guint32 *order = listing_order(mp, update->listing, &positions);
+      start_materializer(mp, update->listing, order, positions);
+    }
+  } else {
+    begin_load_metrics(mp);
+    sync_rows_with_listing(mp, update->listing);
+    apply_filter(mp);
+  }
+
+  DirListing_unref(mp->listing);
+  mp->listing = DirListing_ref(update->listing);
+}
+
+// Lowercased search pattern, or NULL when not filtering
+static gchar *current_pattern_lower(MainPageWidget *mp) {
+  const char *pattern = mp->current_search_pattern;
+  return (pattern && strlen(pattern) > 0) ? g_utf8_strdown(pattern, -1)
+                                          : NULL;
+}
+
+// Show or hide one listing row, returning whether it is visible. In
+// content mode only rows the current content query matched are shown, in
+// subtree and query modes none (the results have rows of their own).
+static gboolean update_row_visibility(MainPageWidget *mp, GtkWidget *row,
+                                      const char *pattern_lower) {
+  FileRowInfo *info = g_object_get_data(G_OBJECT(row), "row-info");
+  gboolean by_tree = (mp->tree_mode || mp->query_mode) && pattern_lower;
+  gboolean by_content = mp->content_mode && !by_tree && pattern_lower;
+  gboolean hit = by_content && info->content_id == mp->content.id &&
+                 info->content_hits > 0;
+  gboolean visible = by_content ? hit
+                                : !pattern_lower ||
+                                      strstr(info->match_key, pattern_lower);
+
+  // Subtree results replace the listing; direct children matching the
+  // pattern are among them
+  if (by_tree) {
+    visible = FALSE;
+  }
+
+  if (info->hits_label && gtk_widget_get_visible(info->hits_label) != hit) {
+    gtk_widget_set_visible(info->hits_label, hit);
+  }
+
+  if (gtk_widget_get_visible(row) != visible) {
+    gtk_widget_set_visible(row, visible);
+  }
+  return visible;
+}
+
+// Show the status row only when no listing row is visible
+static void update_status_message(MainPageWidget *mp) {
+  const char *pattern = mp->current_search_pattern;
+
+  // Matches may still be on their way
+  if (mp->tree.truncated) {
+    gchar *msg = g_strdup_printf("Showing the first %u matches",
+                                 mp->tree.rows->len);
+    show_message(mp, msg);
+    g_free(msg);
+  } else if (mp->visible_count > 0 || mp->tree.rows->len > 0) {
+    show_message(mp, NULL);
+  } else if (mp->tree.search) {
+    gchar *msg = g_strdup_printf(mp->tree_mode
+                                     ? "Searching subfolders for '%s'..."
+                                     : "Searching for '%s'...",
+                                 pattern);
+    show_message(mp, msg);
+    g_free(msg);
+  } else if (mp->content.search) {
+    gchar *msg = g_strdup_printf("Searching contents for '%s'...",
+                                 mp->content.pattern);
+    show_message(mp, msg);
+    g_free(msg);
+  } else if (mp->materializer.listing || mp->search.cancellable) {
+    show_message(mp, NULL);
+  } else if (pattern && strlen(pattern) > 0) {
+    gchar *msg = g_strdup_printf(mp->content_mode ? "No files contain '%s'"
+                                                  : "No files match '%s'",
+                                 pattern);
+    show_message(mp, msg);
+    g_free(msg);
+  } else {
+    show_message(mp, "No files found.");
+  }
+}
+
+// Show or hide rows for the current search pattern and update the status row
+static void apply_filter(MainPageWidget *mp) {
+  cancel_search(mp);
+  drop_candidates(&mp->search);
+
+  gchar *pattern_lower = current_pattern_lower(mp);
+  int visible_count = 0;
+
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, mp->rows);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    visible_count +=
+        update_row_visibility(mp, GTK_WIDGET(value), pattern_lower);
+  }
+  g_free(pattern_lower);
+
+  mp->visible_count = visible_count;
+  update_status_message(mp);
+}
+
+static void clear_rows(MainPageWidget *mp) {
+  cancel_materializer(mp);
+  clear_tree_rows(mp);
+
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, mp->rows);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    g_hash_table_iter_remove(&iter);
+    gtk_widget_destroy(GTK_WIDGET(value));
+  }
+
+  if (mp->back_row) {
+    gtk_widget_destroy(mp->back_row);
+    mp->back_row = NULL;
+  }
+  mp->visible_count = 0;
+}
+
+// Show a status message in place of the listing, or hide it when NULL
+static void show_message(MainPageWidget *mp, const char *message) {
+  if (message) {
+    gtk_label_set_text(GTK_LABEL(mp->message_label), message);
+  }
+  gtk_widget_set_visible(mp->message_row, message != NULL);
+}
+
+// Path of the folder a row opens, or NULL if it is not a folder row
+static const char *row_directory_path(MainPageWidget *mp, GtkWidget *row) {
+  if (!row || row == mp->message_row)
+    return NULL;
+
+  FileRowInfo *info = g_object_get_data(G_OBJECT(row), "row-info");
+  if (row != mp->back_row && (!info || info->type != DIR_TYPE_DIR))
+    return NULL;
+
+  return g_object_get_data(G_OBJECT(row), "full-path");
+}
+
+static void clear_hover(MainPageWidget *mp) {
+  g_clear_handle_id(&mp->hover_source, g_source_remove);
+  g_free(mp->hover_path);
+  mp->hover_path = NULL;
+}
+
+static gboolean on_hover_settled(gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  mp->hover_source = 0;
+
+  Prefetcher_request(mp->prefetcher, mp->hover_path, PREFETCH_PRIORITY_HIGH);
+  return G_SOURCE_REMOVE;
+}
+
 static gboolean on_list_motion(GtkWidget *widget, GdkEventMotion *event,
                                gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
   gtk_widget_queue_draw(widget);
+
+  GtkListBoxRow *row =
+      gtk_list_box_get_row_at_y(GTK_LIST_BOX(widget), (gint)event->y);
+  const char *path = row_directory_path(mp, GTK_WIDGET(row));
+  if (g_strcmp0(path, mp->hover_path) == 0)
+    return FALSE;
+
+  // A folder only counts as a hint once the pointer rests on it, so sweeping
+  // across the list does not queue every folder it passes
+  clear_hover(mp);
+  Prefetcher_cancel_hover(mp->prefetcher);
+  if (path) {
+    mp->hover_path = g_strdup(path);
+    mp->hover_source =
+        g_timeout_add(HOVER_PREFETCH_DELAY_MS, on_hover_settled, mp);
+  }
+  return FALSE;
+}
+
+static gboolean on_list_leave(GtkWidget *widget, GdkEventCrossing *event,
+                              gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+
+  clear_hover(mp);
+  Prefetcher_cancel_hover(mp->prefetcher);
+  return FALSE;
+}
+
+static void on_row_selected(GtkListBox *list_box, GtkListBoxRow *row,
+                            gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+
+  // Keyboard selection is as strong a hint as a resting pointer
+  const char *path = row_directory_path(mp, GTK_WIDGET(row));
+  if (path) {
+    Prefetcher_request(mp->prefetcher, path, PREFETCH_PRIORITY_HIGH);
+  }
+}
+
+// Keep the sidebar's most frecent directories warm; already cached ones are
+// skipped by the prefetcher
+static void prefetch_frecent_directories(MainPageWidget *mp) {
+  GPtrArray *paths =
+      SideBar_get_frecent_directories(mp->side_bar, FRECENT_PREFETCH_COUNT);
+
+  for (guint i = 0; i < paths->len; i++) {
+    const char *path = g_ptr_array_index(paths, i);
+    if (mp->listing && g_strcmp0(path, mp->listing->path) == 0)
+      continue;
+    Prefetcher_request(mp->prefetcher, path, PREFETCH_PRIORITY_LOW);
+  }
+
+  g_ptr_array_free(paths, TRUE);
+}
+
+static gint row_position(MainPageWidget *mp, GtkListBoxRow *row) {
+  if (GTK_WIDGET(row) == mp->back_row)
+    return -1;
+
+  // The status row has no info and goes last
+  FileRowInfo *info = g_object_get_data(G_OBJECT(row), "row-info");
+  return info ? info->position : G_MAXINT;
+}
+
+static gint compare_row_positions(GtkListBoxRow *a, GtkListBoxRow *b,
+                                  gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  gint position_a = row_position(mp, a);
+  gint position_b = row_position(mp, b);
+  return (position_a > position_b) - (position_a < position_b);
+}
+
+static const char *const sort_labels[SORT_KEY_COUNT] = {
+    "Name", "Size", "Modified", "Type", "Extension"};
+
+// Mark the active sort column with its direction
+static void update_sort_labels(MainPageWidget *mp) {
+  for (int key = 0; key < SORT_KEY_COUNT; key++) {
+    if ((SortKey)key == mp->sort_spec.key) {
+      gchar *label = g_strdup_printf(
+          "%s %s", sort_labels[key],
+          mp->sort_spec.descending ? "\u25BC" : "\u25B2");
+      gtk_button_set_label(GTK_BUTTON(mp->sort_buttons[key]), label);
+      g_free(label);
+    } else {
+      gtk_button_set_label(GTK_BUTTON(mp->sort_buttons[key]),
+                           sort_labels[key]);
+    }
+  }
+}
+
+// Re-sort the rows on screen; the listing's sort columns make this a linear
+// radix pass plus one list box re-sort
+static void resort_rows(MainPageWidget *mp) {
+  update_sort_labels(mp);
+  if (!mp->listing)
+    return;
+
+  int *positions;
+  guint32 *order = listing_order(mp, mp->listing, &positions);
+  for (int i = 0; i < mp->listing->count; i++) {
+    GtkWidget *row = g_hash_table_lookup(mp->rows, mp->listing->names[i]);
+    if (row) {
+      FileRowInfo *info = g_object_get_data(G_OBJECT(row), "row-info");
+      info->position = positions[i];
+    }
+  }
+
+  gtk_list_box_invalidate_sort(GTK_LIST_BOX(mp->list_box));
+
+  // Rows not created yet follow the new order, top of the list first
+  if (mp->materializer.listing) {
+    start_materializer(mp, mp->listing, order, positions);
+  } else {
+    g_free(order);
+    g_free(positions);
+  }
+}
+
+static void on_sort_stats_loaded(DirListing *listing, gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+
+  SchedulerGroup_unref(mp->sort_stats);
+  mp->sort_stats = NULL;
+  mp->stats_listing = NULL;
+
+  // A directory that could not be opened keeps name order
+  if (!listing->sizes || !mp->listing)
+    return;
+  if (listing == mp->listing) {
+    resort_rows(mp);
+  } else if (!mp->listing->sizes && SortKey_needs_stats(mp->sort_spec.key) &&
+             g_strcmp0(listing->path, mp->listing->path) == 0) {
+    // Patched while the pass ran: only the new entries are left to stat
+    start_sort_stats(mp, mp->listing, listing);
+  }
+}
+
+// The order to show now. Size and time keys need every entry stat'ed, which
+// for a big cold directory takes seconds: the first time, that runs on a
+// worker and the rows keep name order until it is done. Changes patched in
+// meanwhile don't restart it; its columns carry over once it lands.
+static SortSpec current_sort(MainPageWidget *mp, DirListing *listing) {
+  SortSpec spec = mp->sort_spec;
+  if (!SortKey_needs_stats(spec.key) || listing->sizes)
+    return spec;
+
+  if (!mp->stats_listing ||
+      g_strcmp0(mp->stats_listing->path, listing->path) != 0) {
+    start_sort_stats(mp, listing, NULL);
+  }
+  spec.key = SORT_BY_NAME;
+  spec.descending = FALSE;
+  return spec;
+}
+
+// The pending pass, if any, is replaced
+static void start_sort_stats(MainPageWidget *mp, DirListing *listing,
+                             DirListing *source) {
+  cancel_sort_stats(mp);
+  mp->sort_stats = SchedulerGroup_new(SCHEDULER_INTERACTIVE, NULL);
+  mp->stats_listing = listing;
+  DirListing_load_stats(listing,              // listing
+                        source,               // source
+                        mp->sort_stats,       // group
+                        on_sort_stats_loaded, // func
+                        mp);                  // user_data
+}
+
+// Abandon a pending stat pass; the rows keep the order they have
+static void cancel_sort_stats(MainPageWidget *mp) {
+  if (mp->sort_stats) {
+    SchedulerGroup_cancel(mp->sort_stats);
+    SchedulerGroup_unref(mp->sort_stats);
+    mp->sort_stats = NULL;
+  }
+  mp->stats_listing = NULL;
+}
+
+// Clicking the active column flips its direction, another one selects it
+static void on_sort_clicked(GtkButton *button, gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  SortKey key =
+      (SortKey)GPOINTER_TO_INT(g_object_get_data(G_OBJECT(button), "sort-key"));
+
+  if (key == mp->sort_spec.key) {
+    mp->sort_spec.descending = !mp->sort_spec.descending;
+  } else {
+    mp->sort_spec.key = key;
+    mp->sort_spec.descending = FALSE;
+  }
+  resort_rows(mp);
+}
+
+static void on_folders_first_toggled(GtkToggleButton *toggle,
+                                     gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  mp->sort_spec.directories_first = gtk_toggle_button_get_active(toggle);
+  resort_rows(mp);
+}
+
+// Switching between name and content search re-runs the query
+static void on_content_mode_toggled(GtkToggleButton *toggle,
+                                    gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  mp->content_mode = gtk_toggle_button_get_active(toggle);
+  drop_candidates(&mp->search);
+  start_search(mp);
+}
+
+static void on_sizes_mode_toggled(GtkToggleButton *toggle,
+                                  gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  mp->sizes_mode = gtk_toggle_button_get_active(toggle);
+  clear_usage(mp);
+  start_usage_scan(mp);
+}
+
+static void on_dups_mode_toggled(GtkToggleButton *toggle,
+                                 gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  mp->dups_mode = gtk_toggle_button_get_active(toggle);
+  start_duplicate_scan(mp);
+}
+
+static void on_tree_mode_toggled(GtkToggleButton *toggle,
+                                 gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  mp->tree_mode = gtk_toggle_button_get_active(toggle);
+  drop_candidates(&mp->search);
+  start_search(mp);
+}
+
+// Keep the matches found so far, stop looking for more
+static void on_cancel_clicked(GtkButton *button, gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  stop_content_search(mp);
+  stop_tree_search(mp);
+  update_status_message(mp);
+}
+
+static GtkWidget *create_sort_header(MainPageWidget *mp) {
+  GtkWidget *header = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+
+  for (int key = 0; key < SORT_KEY_COUNT; key++) {
+    GtkWidget *button = gtk_button_new_with_label(sort_labels[key]);
+    gtk_button_set_relief(GTK_BUTTON(button), GTK_RELIEF_NONE);
+    g_object_set_data(G_OBJECT(button), "sort-key", GINT_TO_POINTER(key));
+    g_signal_connect(button, "clicked", G_CALLBACK(on_sort_clicked), mp);
+    gtk_box_pack_start(GTK_BOX(header), button, FALSE, FALSE, 0);
+    mp->sort_buttons[key] = button;
+  }
+
+  GtkWidget *folders_first = gtk_check_button_new_with_label("Folders first");
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(folders_first),
+                               mp->sort_spec.directories_first);
+  g_signal_connect(folders_first, "toggled",
+                   G_CALLBACK(on_folders_first_toggled), mp);
+  gtk_box_pack_end(GTK_BOX(header), folders_first, FALSE, FALSE, 5);
+
+  GtkWidget *contents = gtk_check_button_new_with_label("Search contents");
+  g_signal_connect(contents, "toggled", G_CALLBACK(on_content_mode_toggled),
+                   mp);
+  gtk_box_pack_end(GTK_BOX(header), contents, FALSE, FALSE, 5);
+
+  GtkWidget *dups = gtk_check_button_new_with_label("Duplicates");
+  g_signal_connect(dups, "toggled", G_CALLBACK(on_dups_mode_toggled), mp);
+  gtk_box_pack_end(GTK_BOX(header), dups, FALSE, FALSE, 5);
+
+  // Shown only in duplicates mode
+  mp->dups.button = gtk_menu_button_new();
+  mp->dups.popover = gtk_popover_new(mp->dups.button);
+  gtk_menu_button_set_popover(GTK_MENU_BUTTON(mp->dups.button),
+                              mp->dups.popover);
+  gtk_widget_set_no_show_all(mp->dups.button, TRUE);
+  gtk_box_pack_end(GTK_BOX(header), mp->dups.button, FALSE, FALSE, 5);
+
+  GtkWidget *sizes = gtk_check_button_new_with_label("Sizes");
+  g_signal_connect(sizes, "toggled", G_CALLBACK(on_sizes_mode_toggled), mp);
+  gtk_box_pack_end(GTK_BOX(header), sizes, FALSE, FALSE, 5);
+
+  // Shown only in sizes mode
+  mp->usage.button = gtk_menu_button_new();
+  mp->usage.popover = gtk_popover_new(mp->usage.button);
+  gtk_menu_button_set_popover(GTK_MENU_BUTTON(mp->usage.button),
+                              mp->usage.popover);
+  gtk_widget_set_no_show_all(mp->usage.button, TRUE);
+  gtk_box_pack_end(GTK_BOX(header), mp->usage.button, FALSE, FALSE, 5);
+
+  GtkWidget *subfolders = gtk_check_button_new_with_label("Subfolders");
+  g_signal_connect(subfolders, "toggled", G_CALLBACK(on_tree_mode_toggled),
+                   mp);
+  gtk_box_pack_end(GTK_BOX(header), subfolders, FALSE, FALSE, 5);
+
+  // Shown only while a content search runs
+  mp->cancel_button = gtk_button_new_with_label("Cancel");
+  gtk_widget_set_no_show_all(mp->cancel_button, TRUE);
+  g_signal_connect(mp->cancel_button, "clicked",
+                   G_CALLBACK(on_cancel_clicked), mp);
+  gtk_box_pack_end(GTK_BOX(header), mp->cancel_button, FALSE, FALSE, 5);
+
+  create_stats_panel(mp, header);
+  update_sort_labels(mp);
+  return header;
+}
+
+// ==========================================
+// Row Materializer
+// ==========================================
+
+static void report_load_metrics(MainPageWidget *mp) {
+  LoadMetrics *metrics = &mp->load_metrics;
+  if (metrics->first_paint_us < 0 || metrics->total_us < 0)
+    return;
+
+  g_debug("Loaded %s: first paint %.1f ms, %d rows in %.1f ms",
+          mp->listing ? mp->listing->path : "", // directory
+          metrics->first_paint_us / 1000.0,     // first paint
+          metrics->rows,                        // rows
+          metrics->total_us / 1000.0);          // total
+}
+
+static void on_after_paint(GdkFrameClock *clock, gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  LoadMetrics *metrics = &mp->load_metrics;
+
+  metrics->first_paint_us = g_get_monotonic_time() - metrics->started_at;
+  TRACE_END_COUNT(metrics->trace_start, "first_paint", metrics->rows);
+  Metrics_record(METRIC_FIRST_ROW_US, metrics->first_paint_us);
+  g_signal_handler_disconnect(clock, metrics->paint_handler);
+  metrics->paint_handler = 0;
+  report_load_metrics(mp);
+}
+
+// Start timing a load: from here to the first painted frame, and to the
+// last row created
+static void begin_load_metrics(MainPageWidget *mp) {
+  LoadMetrics *metrics = &mp->load_metrics;
+
+  if (metrics->paint_handler) {
+    g_signal_handler_disconnect(metrics->clock, metrics->paint_handler);
+    metrics->paint_handler = 0;
+  }
+  metrics->started_at = g_get_monotonic_time();
+  metrics->trace_start = Trace_now();
+  metrics->first_paint_us = -1;
+  metrics->total_us = -1;
+  metrics->rows = 0;
+}
+
+// Watch for the frame that shows the first screenful; before the window is
+// realized there is no clock and the first idle slice stands in for it
+static void watch_first_paint(MainPageWidget *mp) {
+  LoadMetrics *metrics = &mp->load_metrics;
+  if (metrics->first_paint_us >= 0 || metrics->paint_handler)
+    return;
+
+  GdkFrameClock *clock = gtk_widget_get_frame_clock(mp->list_box);
+  if (clock) {
+    metrics->clock = clock;
+    metrics->paint_handler = g_signal_connect(
+        clock, "after-paint", G_CALLBACK(on_after_paint), mp);
+  }
+}
+
+// Create up to max_rows missing rows in display order; returns how many
+static int materialize_rows(MainPageWidget *mp, int max_rows) {
+  RowMaterializer *m = &mp->materializer;
+  gchar *pattern_lower = current_pattern_lower(mp);
+  int created = 0;
+
+  while (m->next < m->listing->count && created < max_rows) {
+    guint32 index = m->order[m->next++];
+
+    // Live updates may have created it meanwhile
+    if (g_hash_table_contains(mp->rows, m->listing->names[index]))
+      continue;
+
+    GtkWidget *row = sync_row(mp, m->listing, index, m->positions[index],
+                              mp->generation, TRUE);
+    mp->visible_count += update_row_visibility(mp, row, pattern_lower);
+    created++;
+  }
+
+  g_free(pattern_lower);
+  mp->load_metrics.rows += created;
+  return created;
+}
+
+static void finish_materializer(MainPageWidget *mp) {
+  LoadMetrics *metrics = &mp->load_metrics;
+
+  cancel_materializer(mp);
+  if (metrics->total_us < 0) {
+    metrics->total_us = g_get_monotonic_time() - metrics->started_at;
+    TRACE_END_COUNT(metrics->trace_start, "all_rows", metrics->rows);
+    Metrics_record(METRIC_NAVIGATION_US, metrics->total_us);
+    report_load_metrics(mp);
+  }
+  update_status_message(mp);
+}
+
+// One idle slice: create as many rows as the measured rate says fit in the
+// frame budget, then yield so input and painting keep up
+static gboolean on_materialize_idle(gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  RowMaterializer *m = &mp->materializer;
+  LoadMetrics *metrics = &mp->load_metrics;
+
+  // Idle runs after the redraw, so the first screenful is on screen by now
+  if (metrics->first_paint_us < 0 && !metrics->paint_handler) {
+    metrics->first_paint_us = g_get_monotonic_time() - metrics->started_at;
+    TRACE_END_COUNT(metrics->trace_start, "first_paint", metrics->rows);
+    Metrics_record(METRIC_FIRST_ROW_US, metrics->first_paint_us);
+  }
+
+  int chunk = MAX(MIN_CHUNK_ROWS, (int)(m->rows_per_ms * FRAME_BUDGET_MS));
+  TRACE_BEGIN(span);
+  gint64 start = g_get_monotonic_time();
+  int created = materialize_rows(mp, chunk);
+  gint64 elapsed = g_get_monotonic_time() - start;
+  TRACE_END_COUNT(span, "materialize", created);
+
+  // Smooth the rate so one slow row (a theme icon load) does not collapse
+  // the next chunk
+  if (created > 0 && elapsed > 0) {
+    double rate = created * 1000.0 / elapsed;
+    m->rows_per_ms = 0.5 * m->rows_per_ms + 0.5 * rate;
+  }
+
+  if (m->next >= m->listing->count) {
+    m->source = 0;
+    finish_materializer(mp);
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// Create rows for every entry that has none yet, in display order: the
+// first screenful right away so the view is never blank, the rest in idle
+// slices of about FRAME_BUDGET_MS. Takes ownership of order and positions.
+static void start_materializer(MainPageWidget *mp, DirListing *listing,
+                               guint32 *order, int *positions) {
+  RowMaterializer *m = &mp->materializer;
+  double rows_per_ms = m->rows_per_ms > 0 ? m->rows_per_ms
+                                          : INITIAL_ROWS_PER_MS;
+
+  cancel_materializer(mp);
+
+  // New rows are filtered as they are created, outside any candidate set
+  drop_candidates(&mp->search);
+  m->listing = DirListing_ref(listing);
+  m->order = order;
+  m->positions = positions;
+  m->next = 0;
+  m->rows_per_ms = rows_per_ms;
+
+  int first_screen = gtk_widget_get_allocated_height(mp->scrolled_window) /
+                     ROW_HEIGHT_ESTIMATE;
+  materialize_rows(mp, MAX(first_screen + 1, MIN_FIRST_SCREEN_ROWS));
+  watch_first_paint(mp);
+
+  if (m->next >= listing->count) {
+    finish_materializer(mp);
+  } else {
+    m->source = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, // priority
+                                on_materialize_idle,     // function
+                                mp,                      // data
+                                NULL);                   // notify
+  }
+}
+
+static void cancel_materializer(MainPageWidget *mp) {
+  RowMaterializer *m = &mp->materializer;
+
+  g_clear_handle_id(&m->source, g_source_remove);
+  DirListing_unref(m->listing);
+  m->listing = NULL;
+  g_free(m->order);
+  m->order = NULL;
+  g_free(m->positions);
+  m->positions = NULL;
+}
+
+// ==========================================
+// Search Query
+// ==========================================
+
+static void drop_candidates(SearchQuery *query) {
+  DirListing_unref(query->candidates_listing);
+  query->candidates_listing = NULL;
+  g_free(query->candidates_pattern);
+  query->candidates_pattern = NULL;
+  if (query->candidates) {
+    g_array_free(query->candidates, TRUE);
+    query->candidates = NULL;
+  }
+}
+
+// Rows outside the last query's matches are hidden and stay hidden if the
+// new pattern contains the old one, so only the matches need re-checking
+static gboolean refines_candidates(MainPageWidget *mp,
+                                   const char *pattern_lower) {
+  SearchQuery *query = &mp->search;
+
+  return query->candidates && query->candidates_listing == mp->listing &&
+         query->candidates_pattern && pattern_lower &&
+         strstr(pattern_lower, query->candidates_pattern) != NULL;
+}
+
+// Filter rows until the deadline; returns FALSE once the query is done
+static gboolean filter_rows(MainPageWidget *mp, gint64 deadline) {
+  SearchQuery *query = &mp->search;
+  DirListing *listing = query->listing;
+
+  while (query->next < query->count) {
+    if (g_cancellable_is_cancelled(query->cancellable))
+      return FALSE;
+
+    // Reading the clock per row would cost more than the row
+    for (int n = 0; n < 64 && query->next < query->count; n++) {
+      guint32 index = query->order[query->next++];
+      GtkWidget *row = g_hash_table_lookup(mp->rows, listing->names[index]);
+
+      // Rows created later are filtered by the materializer
+      if (!row) {
+        query->missed_rows = TRUE;
+        continue;
+      }
+
+      gboolean was_visible = gtk_widget_get_visible(row);
+      gboolean visible =
+          update_row_visibility(mp, row, query->pattern_lower);
+      mp->visible_count += visible - was_visible;
+      if (visible) {
+        g_array_append_val(query->matches, index);
+      }
+    }
+
+    if (g_get_monotonic_time() >= deadline)
+      return TRUE;
+  }
   return FALSE;
 }
+
+// Keep the matches of a query that ran to completion over every entry, as
+// the candidates for the next one
+static void finish_search(MainPageWidget *mp) {
+  SearchQuery *query = &mp->search;
+
+  if (!query->missed_rows && query->pattern_lower && !mp->content_mode &&
+      !mp->tree_mode && !mp->query_mode && query->listing == mp->listing) {
+    drop_candidates(query);
+    query->candidates_listing = DirListing_ref(query->listing);
+    query->candidates_pattern = g_strdup(query->pattern_lower);
+    query->candidates = query->matches;
+    query->matches = NULL;
+  }
+
+  release_search(query);
+  update_status_message(mp);
+}
+
+static gboolean on_search_idle(gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  gint64 deadline =
+      g_get_monotonic_time() + FRAME_BUDGET_MS * (G_USEC_PER_SEC / 1000);
+
+  if (filter_rows(mp, deadline))
+    return G_SOURCE_CONTINUE;
+
+  mp->search.source = 0;
+  finish_search(mp);
+  return G_SOURCE_REMOVE;
+}
+
+// Apply the current search pattern: the first slice right away, the rest
+// in idle slices of about FRAME_BUDGET_MS so typing stays responsive and
+// the visible part of the list updates first
+static void start_search(MainPageWidget *mp) {
+  SearchQuery *query = &mp->search;
+
+  cancel_search(mp);
+  if (!mp->listing) {
+    apply_filter(mp);
+    return;
+  }
+
+  query->cancellable = g_cancellable_new();
+  query->listing = DirListing_ref(mp->listing);
+  query->pattern_lower = current_pattern_lower(mp);
+  query->matches = g_array_new(FALSE, FALSE, sizeof(guint32));
+  query->missed_rows = FALSE;
+  query->next = 0;
+
+  // Content and subtree modes: the filter pass hides the listing rows
+  // while the background search shows matches as they arrive
+  gboolean by_tree =
+      (mp->tree_mode || mp->query_mode) && query->pattern_lower;
+  gboolean by_content = mp->content_mode && !by_tree && query->pattern_lower;
+  clear_tree_rows(mp);
+  if (by_content) {
+    start_content_search(mp);
+  } else if (by_tree) {
+    start_tree_search(mp);
+  }
+
+  if (!by_content && !by_tree &&
+      refines_candidates(mp, query->pattern_lower)) {
+    // Narrowing "conf" to "config": the candidates are all that can match
+    query->count = query->candidates->len;
+    query->order = g_new(guint32, query->count + 1);
+    memcpy(query->order, query->candidates->data,
+           query->count * sizeof(guint32));
+  } else {
+    // A broader or different query may show rows the candidates' query
+    // hid, after which they no longer describe what is on screen
+    drop_candidates(query);
+    SortSpec spec = current_sort(mp, mp->listing);
+    query->count = mp->listing->count;
+    query->order = DirListing_sort(mp->listing, &spec);
+  }
+
+  gint64 deadline =
+      g_get_monotonic_time() + FRAME_BUDGET_MS * (G_USEC_PER_SEC / 1000);
+  if (filter_rows(mp, deadline)) {
+    query->source = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, // priority
+                                    on_search_idle,          // function
+                                    mp,                      // data
+                                    NULL);                   // notify
+  } else {
+    finish_search(mp);
+  }
+}
+
+// Abandon the running query, telling every engine working for it to stop
+static void cancel_search(MainPageWidget *mp) {
+  g_cancellable_cancel(mp->search.cancellable);
+  stop_content_search(mp);
+  stop_tree_search(mp);
+  release_search(&mp->search);
+}
+
+// Free the filter pass state; a content search it started keeps running
+static void release_search(SearchQuery *query) {
+  g_clear_object(&query->cancellable);
+  g_clear_handle_id(&query->source, g_source_remove);
+  DirListing_unref(query->listing);
+  query->listing = NULL;
+  g_free(query->pattern_lower);
+  query->pattern_lower = NULL;
+  g_free(query->order);
+  query->order = NULL;
+  if (query->matches) {
+    g_array_free(query->matches, TRUE);
+    query->matches = NULL;
+  }
+}
+
+// ==========================================
+// Content Search
+// ==========================================
+
+static void drop_content_candidates(ContentQuery *content) {
+  DirListing_unref(content->candidates_listing);
+  content->candidates_listing = NULL;
+  g_free(content->candidates_pattern);
+  content->candidates_pattern = NULL;
+  if (content->candidates) {
+    g_array_free(content->candidates, TRUE);
+    content->candidates = NULL;
+  }
+}
+
+static void set_row_hits(GtkWidget *row, FileRowInfo *info, guint hits) {
+  if (!info->hits_label) {
+    info->hits_label = gtk_label_new(NULL);
+    gtk_box_pack_end(GTK_BOX(gtk_bin_get_child(GTK_BIN(row))), // box
+                     info->hits_label,                         // child
+                     FALSE,                                    // expand
+                     FALSE,                                    // fill
+                     5);                                       // padding
+  }
+
+  gchar *text = g_strdup_printf(hits == 1 ? "%u match" : "%u matches", hits);
+  gtk_label_set_text(GTK_LABEL(info->hits_label), text);
+  g_free(text);
+  info->content_hits = hits;
+}
+
+// A batch of matches from the workers: stamp the rows (creating any the
+// materializer has not reached yet) and show them
+static void on_content_matches(const ContentMatch *matches, guint count,
+                               gboolean finished, gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  ContentQuery *content = &mp->content;
+  gchar *pattern_lower = current_pattern_lower(mp);
+
+  for (guint i = 0; i < count; i++) {
+    guint32 index = matches[i].index;
+    g_array_append_val(content->hit_files, index);
+
+    GtkWidget *row =
+        g_hash_table_lookup(mp->rows, content->listing->names[index]);
+    gboolean was_visible = row && gtk_widget_get_visible(row);
+    if (!row) {
+      // Only rows of the listing on screen can be created here
+      if (content->listing != mp->listing)
+        continue;
+      row = sync_row(mp, content->listing, index, content->positions[index],
+                     mp->generation, TRUE);
+    }
+
+    FileRowInfo *info = g_object_get_data(G_OBJECT(row), "row-info");
+    info->content_id = content->id;
+    set_row_hits(row, info, matches[i].hits);
+    mp->visible_count +=
+        update_row_visibility(mp, row, pattern_lower) - was_visible;
+  }
+  g_free(pattern_lower);
+
+  if (finished) {
+    // Every file was read: a longer pattern can only match these
+    drop_content_candidates(content);
+    content->candidates_listing = DirListing_ref(content->listing);
+    content->candidates_pattern = g_strdup(content->pattern);
+    content->candidates = content->hit_files;
+    content->hit_files = NULL;
+
+    show_search_stats(mp, "Contents", content->candidates->len,
+                      &content->search->stats);
+    stop_content_search(mp);
+    update_status_message(mp);
+  }
+}
+
+// Search the contents of the listing on screen for the current pattern.
+// Rows stamped by earlier content queries no longer count as matches.
+static void start_content_search(MainPageWidget *mp) {
+  ContentQuery *content = &mp->content;
+  const char *pattern = mp->current_search_pattern;
+
+  stop_content_search(mp);
+  content->id++;
+  content->listing = DirListing_ref(mp->listing);
+  content->positions = listing_positions(mp, mp->listing);
+  content->pattern = g_strdup(pattern);
+  content->hit_files = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+  // Refining the last finished search: only files it matched can match
+  const guint32 *files = NULL;
+  guint file_count = 0;
+  if (content->candidates && content->candidates_listing == mp->listing &&
+      strstr(pattern, content->candidates_pattern)) {
+    files = (const guint32 *)content->candidates->data;
+    file_count = content->candidates->len;
+  } else {
+    drop_content_candidates(content);
+  }
+
+  content->search = ContentSearch_start(mp->listing,            // listing
+                                        files,                  // files
+                                        file_count,             // file_count
+                                        pattern,                // pattern
+                                        mp->search.cancellable, // cancellable
+                                        on_content_matches,     // func
+                                        mp);                    // user_data
+  gtk_widget_show(mp->cancel_button);
+}
+
+// Stop the running content search, if any; rows it already matched stay
+static void stop_content_search(MainPageWidget *mp) {
+  ContentQuery *content = &mp->content;
+
+  if (content->search) {
+    ContentSearch_stop(content->search);
+    content->search = NULL;
+  }
+  DirListing_unref(content->listing);
+  content->listing = NULL;
+  g_free(content->positions);
+  content->positions = NULL;
+  g_free(content->pattern);
+  content->pattern = NULL;
+  if (content->hit_files) {
+    g_array_free(content->hit_files, TRUE);
+    content->hit_files = NULL;
+  }
+  gtk_widget_set_visible(mp->cancel_button, mp->tree.search != NULL);
+}
+
+// ==========================================
+// Subtree Search
+// ==========================================
+
+// Rows of subtree matches, listed after every listing row in arrival order
+static void on_tree_matches(const TreeMatch *matches, guint count,
+                            gboolean finished, gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  const char *root = mp->listing->path;
+
+  for (guint i = 0; i < count; i++) {
+    gchar *full_path = g_build_filename(root, matches[i].path, NULL);
+    GtkWidget *row =
+        create_file_row(matches[i].path, full_path, matches[i].icon);
+    g_free(full_path);
+
+    FileRowInfo *info = g_new0(FileRowInfo, 1);
+    info->name = g_strdup(matches[i].path);
+    info->type = matches[i].type;
+    info->position = mp->listing->count + (int)mp->tree.rows->len;
+    g_object_set_data_full(G_OBJECT(row), "row-info", info, free_row_info);
+    if (matches[i].hits > 0) {
+      set_row_hits(row, info, matches[i].hits);
+      gtk_widget_show(info->hits_label);
+    }
+
+    gtk_list_box_insert(GTK_LIST_BOX(mp->list_box), row, -1);
+    g_ptr_array_add(mp->tree.rows, row);
+  }
+
+  if (finished) {
+    mp->tree.truncated = g_atomic_int_get(&mp->tree.search->truncated);
+    show_search_stats(mp, mp->tree_mode ? "Subfolders" : "Query",
+                      mp->tree.rows->len, &mp->tree.search->stats);
+    stop_tree_search(mp);
+  }
+  update_status_message(mp);
+}
+
+// Search every folder below the one on screen for the current pattern, or
+// with query syntax only the folder itself unless "Subfolders" is on. Bare
+// words search names or, with "Search contents" on, the files themselves.
+static void start_tree_search(MainPageWidget *mp) {
+  Query *query = Query_parse(mp->current_search_pattern,
+                             mp->content_mode ? QUERY_WORDS_CONTENT
+                                              : QUERY_DEFAULT);
+  // One level lists what the folder holds, ignored or not
+  TreeWalkFlags flags =
+      mp->tree_mode ? TREE_WALK_IGNORE_FILES : TREE_WALK_ONE_LEVEL;
+  const char *ignore = mp->tree_mode ? g_getenv("CILE_SEARCH_IGNORE") : "";
+
+  stop_tree_search(mp);
+  mp->tree.search = TreeSearch_start(mp->listing->path,       // root
+                                     query,                   // query
+                                     flags,                   // flags
+                                     ignore,                  // ignore
+                                     TREE_SEARCH_MAX_RESULTS, // max_results
+                                     mp->search.cancellable,  // cancellable
+                                     on_tree_matches,         // func
+                                     mp);                     // data
+  gtk_widget_show(mp->cancel_button);
+}
+
+// Stop the running subtree search, if any; rows it already found stay
+static void stop_tree_search(MainPageWidget *mp) {
+  if (mp->tree.search) {
+    TreeSearch_stop(mp->tree.search);
+    mp->tree.search = NULL;
+  }
+  gtk_widget_set_visible(mp->cancel_button, mp->content.search != NULL);
+}
+
+static void clear_tree_rows(MainPageWidget *mp) {
+  stop_tree_search(mp);
+  for (guint i = 0; i < mp->tree.rows->len; i++) {
+    gtk_widget_destroy(g_ptr_array_index(mp->tree.rows, i));
+  }
+  g_ptr_array_set_size(mp->tree.rows, 0);
+  mp->tree.truncated = FALSE;
+}
+
+// ==========================================
+// Disk Usage
+// ==========================================
+
+static void set_row_size(GtkWidget *row, FileRowInfo *info, guint64 bytes) {
+  if (!info->size_label) {
+    info->size_label = gtk_label_new(NULL);
+    gtk_box_pack_end(GTK_BOX(gtk_bin_get_child(GTK_BIN(row))), // box
+                     info->size_label,                         // child
+                     FALSE,                                    // expand
+                     FALSE,                                    // fill
+                     5);                                       // padding
+  }
+
+  gchar *text = g_format_size(bytes);
+  gtk_label_set_text(GTK_LABEL(info->size_label), text);
+  g_free(text);
+  gtk_widget_show(info->size_label);
+}
+
+// Show the size measured for a row's entry, if any, on new or moved rows
+static void apply_row_size(MainPageWidget *mp, GtkWidget *row,
+                           FileRowInfo *info) {
+  guint64 *bytes = g_hash_table_lookup(mp->usage.sizes, info->name);
+  if (bytes) {
+    set_row_size(row, info, *bytes);
+  } else if (info->size_label) {
+    gtk_widget_hide(info->size_label);
+  }
+}
+
+static void set_usage_label(MainPageWidget *mp, const char *format,
+                            guint64 bytes) {
+  gchar *size = g_format_size(bytes);
+  gchar *text = g_strdup_printf(format, size);
+  gtk_button_set_label(GTK_BUTTON(mp->usage.button), text);
+  g_free(text);
+  g_free(size);
+}
+
+static void add_largest_section(GtkWidget *box, const char *title,
+                                const DiskUsageItem *items, guint count) {
+  GtkWidget *heading = gtk_label_new(title);
+  gtk_label_set_xalign(GTK_LABEL(heading), 0);
+  gtk_box_pack_start(GTK_BOX(box), heading, FALSE, FALSE, 5);
+
+  for (guint i = 0; i < count; i++) {
+    gchar *size = g_format_size(items[i].bytes);
+    gchar *text = g_strdup_printf("%s\t%s", size, items[i].path);
+    GtkWidget *label = gtk_label_new(text);
+    gtk_label_set_xalign(GTK_LABEL(label), 0);
+    gtk_box_pack_start(GTK_BOX(box), label, FALSE, FALSE, 0);
+    g_free(text);
+    g_free(size);
+  }
+}
+
+// Replace the popover's list with the largest entries of a finished scan
+static void fill_largest(MainPageWidget *mp, const DiskUsage *scan) {
+  GtkWidget *old = gtk_bin_get_child(GTK_BIN(mp->usage.popover));
+  if (old) {
+    gtk_widget_destroy(old);
+  }
+
+  GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+  guint count;
+  const DiskUsageItem *items = DiskUsage_largest(scan, TRUE, &count);
+  add_largest_section(box, "Largest folders", items, count);
+  items = DiskUsage_largest(scan, FALSE, &count);
+  add_largest_section(box, "Largest files", items, count);
+
+  gtk_container_add(GTK_CONTAINER(mp->usage.popover), box);
+  gtk_widget_show_all(box);
+}
+
+// A batch of measured entries: remember them and size their rows
+static void on_usage_sizes(const DiskUsageSize *sizes, guint count,
+                           gboolean finished, gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  UsageQuery *usage = &mp->usage;
+
+  for (guint i = 0; i < count; i++) {
+    g_hash_table_replace(usage->sizes, g_strdup(sizes[i].name),
+                         g_memdup2(&sizes[i].bytes, sizeof(guint64)));
+    usage->measured += sizes[i].bytes;
+
+    GtkWidget *row = g_hash_table_lookup(mp->rows, sizes[i].name);
+    if (row) {
+      FileRowInfo *info = g_object_get_data(G_OBJECT(row), "row-info");
+      set_row_size(row, info, sizes[i].bytes);
+    }
+  }
+
+  if (finished) {
+    set_usage_label(mp, "Largest (%s)", usage->scan->total);
+    fill_largest(mp, usage->scan);
+    stop_usage_scan(mp);
+  } else {
+    set_usage_label(mp, "Measuring... %s", usage->measured);
+  }
+}
+
+// Measure the folder on screen, in sizes mode
+static void start_usage_scan(MainPageWidget *mp) {
+  stop_usage_scan(mp);
+  if (!mp->sizes_mode || !mp->listing)
+    return;
+
+  mp->usage.scan = DiskUsage_start(mp->listing->path, // root
+                                   on_usage_sizes,    // func
+                                   mp);               // data
+  set_usage_label(mp, "Measuring... %s", mp->usage.measured);
+  gtk_widget_show(mp->usage.button);
+}
+
+// Stop measuring; sizes already shown stay
+static void stop_usage_scan(MainPageWidget *mp) {
+  if (mp->usage.scan) {
+    DiskUsage_stop(mp->usage.scan);
+    mp->usage.scan = NULL;
+  }
+}
+
+// Forget every size, hiding them from the rows
+static void clear_usage(MainPageWidget *mp) {
+  stop_usage_scan(mp);
+  g_hash_table_remove_all(mp->usage.sizes);
+  mp->usage.measured = 0;
+
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, mp->rows);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    FileRowInfo *info = g_object_get_data(G_OBJECT(value), "row-info");
+    if (info->size_label) {
+      gtk_widget_hide(info->size_label);
+    }
+  }
+  gtk_widget_set_visible(mp->usage.button, mp->sizes_mode);
+}
+
+// ==========================================
+// Duplicates
+// ==========================================
+
+static void free_duplicate_row(gpointer data) {
+  DuplicateRow *row = (DuplicateRow *)data;
+  g_free(row->text);
+  g_free(row);
+}
+
+static gint compare_most_wasteful(gconstpointer a, gconstpointer b) {
+  const DuplicateRow *x = *(DuplicateRow *const *)a;
+  const DuplicateRow *y = *(DuplicateRow *const *)b;
+  return x->reclaimable < y->reclaimable   ? 1
+         : x->reclaimable > y->reclaimable ? -1
+                                           : 0;
+}
+
+static void set_duplicates_label(MainPageWidget *mp, gboolean finished) {
+  gchar *size = g_format_size(mp->dups.reclaimable);
+  gchar *text = g_strdup_printf(finished ? "%u duplicates (%s)"
+                                         : "Hashing... %u (%s)",
+                                mp->dups.groups->len, size);
+  gtk_button_set_label(GTK_BUTTON(mp->dups.button), text);
+  g_free(text);
+  g_free(size);
+}
+
+// Replace the popover's list with the groups found, most wasteful first
+static void fill_duplicates(MainPageWidget *mp) {
+  GtkWidget *old = gtk_bin_get_child(GTK_BIN(mp->dups.popover));
+  if (old) {
+    gtk_widget_destroy(old);
+  }
+
+  g_ptr_array_sort(mp->dups.groups, compare_most_wasteful);
+  GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+  guint shown = MIN(mp->dups.groups->len, DUPLICATE_GROUPS_SHOWN);
+  for (guint i = 0; i < shown; i++) {
+    DuplicateRow *row = g_ptr_array_index(mp->dups.groups, i);
+    GtkWidget *label = gtk_label_new(row->text);
+    gtk_label_set_xalign(GTK_LABEL(label), 0);
+    gtk_box_pack_start(GTK_BOX(box), label, FALSE, FALSE, 5);
+  }
+
+  GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+  gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                 GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+  gtk_scrolled_window_set_propagate_natural_height(
+      GTK_SCROLLED_WINDOW(scroll), TRUE);
+  gtk_scrolled_window_set_max_content_height(GTK_SCROLLED_WINDOW(scroll),
+                                             400);
+  gtk_container_add(GTK_CONTAINER(scroll), box);
+  gtk_container_add(GTK_CONTAINER(mp->dups.popover), scroll);
+  gtk_widget_show_all(scroll);
+}
+
+// Confirmed groups: remember them as text, ready for the list
+static void on_duplicates(const DuplicateGroup *groups, guint count,
+                          gboolean finished, gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+
+  for (guint i = 0; i < count; i++) {
+    gchar *size = g_format_size(groups[i].size);
+    gchar *waste = g_format_size(groups[i].reclaimable);
+    GString *text = g_string_new(NULL);
+    g_string_printf(text, "%u copies of %s, %s reclaimable", groups[i].count,
+                    size, waste);
+    for (guint j = 0; j < groups[i].count; j++) {
+      g_string_append_printf(text, "\n    %s", groups[i].paths[j]);
+    }
+    g_free(waste);
+    g_free(size);
+
+    DuplicateRow *row = g_new(DuplicateRow, 1);
+    row->reclaimable = groups[i].reclaimable;
+    row->text = g_string_free(text, FALSE);
+    g_ptr_array_add(mp->dups.groups, row);
+    mp->dups.reclaimable += groups[i].reclaimable;
+  }
+
+  set_duplicates_label(mp, finished);
+  if (finished) {
+    fill_duplicates(mp);
+    stop_duplicate_scan(mp);
+  }
+}
+
+// Look for duplicates below the folder on screen, in duplicates mode
+static void start_duplicate_scan(MainPageWidget *mp) {
+  stop_duplicate_scan(mp);
+  g_ptr_array_set_size(mp->dups.groups, 0);
+  mp->dups.reclaimable = 0;
+  fill_duplicates(mp);
+  gtk_widget_set_visible(mp->dups.button, mp->dups_mode);
+  if (!mp->dups_mode || !mp->listing)
+    return;
+
+  // Pruned like subfolder searches: build output and VCS data duplicate
+  // by design
+  mp->dups.scan = Duplicates_start(mp->listing->path,               // root
+                                   g_getenv("CILE_SEARCH_IGNORE"), // ignore
+                                   on_duplicates,                   // func
+                                   mp);                             // data
+  set_duplicates_label(mp, FALSE);
+}
+
+// Stop hashing; groups already found stay listed
+static void stop_duplicate_scan(MainPageWidget *mp) {
+  if (mp->dups.scan) {
+    Duplicates_stop(mp->dups.scan);
+    mp->dups.scan = NULL;
+  }
+}
+
+// ==========================================
+// Stats Panel
+// ==========================================
+
+static void append_hit_rate(GString *text, const char *name, gint64 hits,
+                            gint64 misses) {
+  gint64 total = hits + misses;
+  g_string_append_printf(text, "%-20s %5.1f%%  (%" G_GINT64_FORMAT
+                               " of %" G_GINT64_FORMAT ")\n",
+                         name,                                  // name
+                         total ? 100.0 * hits / total : 0.0,    // rate
+                         hits, total);                          // counts
+}
+
+static void append_histogram(GString *text, const MetricsSnapshot *snapshot,
+                             MetricHistogram histogram) {
+  g_string_append_printf(
+      text,
+      "%-20s n=%-6" G_GUINT64_FORMAT " p50 %-8" G_GINT64_FORMAT
+      " p90 %-8" G_GINT64_FORMAT " p99 %-8" G_GINT64_FORMAT
+      " max %" G_GINT64_FORMAT "\n",
+      Metrics_histogram_name(histogram),             // name
+      snapshot->totals[histogram],                   // count
+      Metrics_percentile(snapshot, histogram, 50),   // p50
+      Metrics_percentile(snapshot, histogram, 90),   // p90
+      Metrics_percentile(snapshot, histogram, 99),   // p99
+      Metrics_percentile(snapshot, histogram, 100)); // max
+}
+
+static void append_memory(GString *text, const char *name, gint64 current,
+                          gint64 peak) {
+  gchar *now = g_format_size(MAX(current, 0));
+  gchar *most = g_format_size(MAX(peak, 0));
+  g_string_append_printf(text, "%-20s %-10s peak %s\n", name, now, most);
+  g_free(now);
+  g_free(most);
+}
+
+static void refresh_stats(MainPageWidget *mp) {
+  MetricsSnapshot *snapshot = g_new(MetricsSnapshot, 1);
+  Metrics_snapshot(snapshot);
+  const gint64 *counters = snapshot->counters;
+  GString *text = g_string_new(NULL);
+
+  for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+    append_histogram(text, snapshot, h);
+  }
+  g_string_append(text, "\n");
+
+  append_hit_rate(text, "dir_cache",                    // name
+                  counters[METRIC_DIR_CACHE_HITS],      // hits
+                  counters[METRIC_DIR_CACHE_MISSES]);   // misses
+  append_hit_rate(text, "icon_cache",                   // name
+                  counters[METRIC_ICON_CACHE_HITS],     // hits
+                  counters[METRIC_ICON_CACHE_MISSES]);  // misses
+  append_hit_rate(text, "usage_cache",                  // name
+                  counters[METRIC_USAGE_CACHE_HITS],    // hits
+                  counters[METRIC_USAGE_CACHE_MISSES]); // misses
+  g_string_append(text, "\n");
+
+  for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+    const char *name = Metrics_counter_name(c);
+    if (g_str_has_suffix(name, "_bytes")) {
+      gchar *size = g_format_size(MAX(counters[c], 0));
+      g_string_append_printf(text, "%-20s %s\n", name, size);
+      g_free(size);
+    } else {
+      g_string_append_printf(text, "%-20s %" G_GINT64_FORMAT "\n", name,
+                             counters[c]);
+    }
+  }
+  g_string_append(text, "\n");
+
+  MemorySnapshot memory;
+  Memory_snapshot(&memory);
+  for (int t = 0; t < MEMORY_TAG_COUNT; t++) {
+    append_memory(text, Memory_tag_name(t), memory.current[t],
+                  memory.peak[t]);
+  }
+  append_memory(text, "rss", memory.rss, memory.peak_rss);
+
+  BudgetSnapshot budget;
+  Budget_snapshot(&budget);
+  gchar *in_flight = g_format_size(budget.in_flight);
+  gchar *cached = g_format_size(budget.cached);
+  gchar *limit = g_format_size(budget.limit);
+  g_string_append_printf(text, "%-20s %s in flight + %s cached of %s, %u "
+                               "waiting\n",
+                         "budget", in_flight, cached, limit,
+                         budget.waiting);
+  g_free(in_flight);
+  g_free(cached);
+  g_free(limit);
+
+  // Queued/running per class, interactive first
+  SchedulerSnapshot tasks;
+  Scheduler_snapshot(&tasks);
+  g_string_append_printf(text, "%-20s %u workers, %u/%u %u/%u %u/%u\n",
+                         "tasks", tasks.workers,
+                         tasks.queued[SCHEDULER_INTERACTIVE],
+                         tasks.running[SCHEDULER_INTERACTIVE],
+                         tasks.queued[SCHEDULER_USER_INITIATED],
+                         tasks.running[SCHEDULER_USER_INITIATED],
+                         tasks.queued[SCHEDULER_BACKGROUND],
+                         tasks.running[SCHEDULER_BACKGROUND]);
+
+  gtk_label_set_text(GTK_LABEL(mp->stats.label), text->str);
+  g_string_free(text, TRUE);
+  g_free(snapshot);
+}
+
+static gboolean on_stats_refresh(gpointer user_data) {
+  refresh_stats((MainPageWidget *)user_data);
+  return G_SOURCE_CONTINUE;
+}
+
+// Fresh numbers on opening, then every STATS_REFRESH_SECONDS until closed
+static void on_stats_shown(GtkWidget *popover, gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  refresh_stats(mp);
+  if (!mp->stats.refresh_source) {
+    mp->stats.refresh_source =
+        g_timeout_add_seconds(STATS_REFRESH_SECONDS, on_stats_refresh, mp);
+  }
+}
+
+static void on_stats_closed(GtkPopover *popover, gpointer user_data) {
+  MainPageWidget *mp = (MainPageWidget *)user_data;
+  g_clear_handle_id(&mp->stats.refresh_source, g_source_remove);
+}
+
+static void create_stats_panel(MainPageWidget *mp, GtkWidget *header) {
+  mp->stats.button = gtk_menu_button_new();
+  gtk_button_set_label(GTK_BUTTON(mp->stats.button), "Stats");
+  mp->stats.popover = gtk_popover_new(mp->stats.button);
+  gtk_menu_button_set_popover(GTK_MENU_BUTTON(mp->stats.button),
+                              mp->stats.popover);
+
+  // Monospace so the columns line up
+  mp->stats.label = gtk_label_new(NULL);
+  gtk_label_set_xalign(GTK_LABEL(mp->stats.label), 0);
+  gtk_label_set_selectable(GTK_LABEL(mp->stats.label), TRUE);
+  gtk_style_context_add_class(
+      gtk_widget_get_style_context(mp->stats.label), "monospace");
+  gtk_container_add(GTK_CONTAINER(mp->stats.popover), mp->stats.label);
+  gtk_widget_show(mp->stats.label);
+
+  g_signal_connect(mp->stats.popover, "show", G_CALLBACK(on_stats_shown),
+                   mp);
+  g_signal_connect(mp->stats.popover, "closed", G_CALLBACK(on_stats_closed),
+                   mp);
+  gtk_box_pack_end(GTK_BOX(header), mp->stats.button, FALSE, FALSE, 5);
+}
+
+// One line for the search that just finished; the tooltip keeps it whole
+// when the window is too narrow
+static void show_search_stats(MainPageWidget *mp, const char *kind,
+                              guint matches, const SearchStats *stats) {
+  gchar *breakdown = SearchStats_format(stats);
+  gchar *text = g_strdup_printf("%s: %u %s; %s", kind, matches,
+                                matches == 1 ? "match" : "matches",
+                                breakdown);
+  gtk_label_set_text(GTK_LABEL(mp->status_bar), text);
+  gtk_widget_set_tooltip_text(mp->status_bar, text);
+  gtk_widget_show(mp->status_bar);
+  g_free(text);
+  g_free(breakdown);
+}
@@ -5,15 +5,18 @@
 
 #define MAX_RECENT_DIRS 5
 #define RECENT_DIRS_FILE "recent_directories.conf"
+#define SECONDS_PER_DAY (24 * 60 * 60)
 
 typedef struct {
   char *path;
   int visit_count;
+  gint64 last_visit; // Wall-clock seconds, 0 if unknown
 } RecentDirInfo;
 
 static GtkWidget *create_sidebar_row(const char *label, const char *path);
 static void update_recent_section(SideBarWidget *side_bar);
 static gint compare_recent_dirs(gconstpointer a, gconstpointer b);
+static gint compare_frecency(gconstpointer a, gconstpointer b, gpointer now);
 static gchar *get_config_dir(void);
 static gboolean on_list_motion(GtkWidget *widget, GdkEventMotion *event,
                                gpointer user_data);
@@ -155,6 +158,7 @@ void SideBar_add_recent_directory(SideBarWidget *side_bar, const char *path) {
     info->visit_count = 1;
     g_hash_table_insert(side_bar->recent_paths, g_strdup(path), info);
   }
+  info->last_visit = g_get_real_time() / G_USEC_PER_SEC;
 
   update_recent_section(side_bar);
 }
@@ -175,7 +179,7 @@ gboolean SideBar_save_recent_directories(SideBarWidget *side_bar) {
   }
 
   fprintf(file, "# Recent Directories Configuration\n");
-  fprintf(file, "# Format: path|visit_count\n\n");
+  fprintf(file, "# Format: path|visit_count|last_visit\n\n");
 
   GHashTableIter iter;
   gpointer key, value;
@@ -183,7 +187,8 @@ gboolean SideBar_save_recent_directories(SideBarWidget *side_bar) {
 
   while (g_hash_table_iter_next(&iter, &key, &value)) {
     RecentDirInfo *info = (RecentDirInfo *)value;
-    fprintf(file, "%s|%d\n", info->path, info->visit_count);
+    fprintf(file, "%s|%d|%" G_GINT64_FORMAT "\n", info->path,
+            info->visit_count, info->last_visit);
   }
 
   fclose(file);
@@ -214,12 +219,18 @@ gboolean SideBar_load_recent_directories(SideBarWidget *side_bar) {
     char *path = line;
     int visit_count = atoi(separator + 1);
 
+    // Files written before last_visit was tracked have only two fields
+    char *time_separator = strchr(separator + 1, '|');
+    gint64 last_visit =
+        time_separator ? g_ascii_strtoll(time_separator + 1, NULL, 10) : 0;
+
     if (!g_file_test(path, G_FILE_TEST_IS_DIR))
       continue;
 
     RecentDirInfo *info = g_new(RecentDirInfo, 1);
     info->path = g_strdup(path);
     info->visit_count = visit_count;
+    info->last_visit = last_visit;
     g_hash_table_insert(side_bar->recent_paths, g_strdup(path), info);
   }
 
@@ -232,6 +243,32 @@ gboolean SideBar_load_recent_directories(SideBarWidget *side_bar) {
   return TRUE;
 }
 
+GPtrArray *SideBar_get_frecent_directories(SideBarWidget *side_bar,
+                                           int max_count) {
+  GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+  if (!side_bar || max_count <= 0)
+    return paths;
+
+  GPtrArray *infos = g_ptr_array_new();
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, side_bar->recent_paths);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    g_ptr_array_add(infos, value);
+  }
+
+  gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+  g_ptr_array_sort_with_data(infos, compare_frecency, &now);
+
+  for (guint i = 0; i < infos->len && (int)i < max_count; i++) {
+    RecentDirInfo *info = g_ptr_array_index(infos, i);
+    g_ptr_array_add(paths, g_strdup(info->path));
+  }
+
+  g_ptr_array_free(infos, TRUE);
+  return paths;
+}
+
 static GtkWidget *create_sidebar_row(const char *label, const char *path) {
   GtkWidget *row = gtk_list_box_row_new();
   GtkWidget *label_widget = gtk_label_new(label);
@@ -254,6 +291,37 @@ static gint compare_recent_dirs(gconstpointer a, gconstpointer b) {
   return info_b->visit_count - info_a->visit_count;
 }
 
+// Visits weighted by how long ago the last one was, in the spirit of
+// browser frecency: a folder used daily outranks one used a lot last year
+static double frecency_score(const RecentDirInfo *info, gint64 now) {
+  gint64 age_days = (now - info->last_visit) / SECONDS_PER_DAY;
+  double weight;
+
+  if (info->last_visit == 0) {
+    weight = 0.1;
+  } else if (age_days < 4) {
+    weight = 1.0;
+  } else if (age_days < 14) {
+    weight = 0.7;
+  } else if (age_days < 31) {
+    weight = 0.5;
+  } else if (age_days < 90) {
+    weight = 0.3;
+  } else {
+    weight = 0.1;
+  }
+
+  return info->visit_count * weight;
+}
+
+static gint compare_frecency(gconstpointer a, gconstpointer b, gpointer now) {
+  const RecentDirInfo *info_a = *(const RecentDirInfo **)a;
+  const RecentDirInfo *info_b = *(const RecentDirInfo **)b;
+  double score_a = frecency_score(info_a, *(gint64 *)now);
+  double score_b = frecency_score(info_b, *(gint64 *)now);
+  return (score_b > score_a) - (score_b < score_a);
+}
+
 static void update_recent_section(SideBarWidget *side_bar) {
   if (!side_bar)
     return;
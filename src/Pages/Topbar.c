@@ -1,6 +1,8 @@
 #include "Pages/Topbar.h"
 #include <string.h>
 
+#define SEARCH_DEBOUNCE_MS 150 // Typing pause before the search runs
+
 // Signal indices
 enum { SIGNAL_ADDRESS_CHANGED, SIGNAL_SEARCH_TRIGGERED, LAST_SIGNAL };
 
@@ -60,10 +62,19 @@ static void on_address_entry_activate(GtkEntry *entry, gpointer user_data) {
   }
 }
 
-// Callback when the search entry is activated
-static void on_search_entry_activate(GtkEntry *entry, gpointer user_data) {
-  TopBarWidget *top_bar = (TopBarWidget *)user_data;
-  const char *search_text = gtk_entry_get_text(entry);
+// Send the search text now, dropping any debounced send still pending
+static void emit_search(TopBarWidget *top_bar) {
+  const char *search_text =
+      gtk_entry_get_text(GTK_ENTRY(top_bar->search_entry));
+
+  g_clear_handle_id(&top_bar->search_debounce, g_source_remove);
+
+  // Typing and erasing back to the same text changes nothing
+  if (g_strcmp0(top_bar->current_search, search_text) == 0)
+    return;
+
+  g_free(top_bar->current_search);
+  top_bar->current_search = g_strdup(search_text);
 
   // Emit the search-triggered signal
   g_signal_emit(top_bar->m_TopBar,                        // instance
@@ -72,6 +83,35 @@ static void on_search_entry_activate(GtkEntry *entry, gpointer user_data) {
                 search_text);                             // ...
 }
 
+static gboolean on_search_debounce_elapsed(gpointer user_data) {
+  TopBarWidget *top_bar = (TopBarWidget *)user_data;
+
+  top_bar->search_debounce = 0;
+  emit_search(top_bar);
+  return G_SOURCE_REMOVE;
+}
+
+// Callback on every edit of the search entry: restart the debounce so a
+// burst of keystrokes runs one search, for the text it ends with
+static void on_search_entry_changed(GtkEditable *editable,
+                                    gpointer user_data) {
+  TopBarWidget *top_bar = (TopBarWidget *)user_data;
+
+  g_clear_handle_id(&top_bar->search_debounce, g_source_remove);
+  top_bar->search_debounce = g_timeout_add(SEARCH_DEBOUNCE_MS,         // ms
+                                           on_search_debounce_elapsed, // func
+                                           top_bar);                   // data
+}
+
+// Callback when the search entry is activated: always search, even for
+// unchanged text (e.g. after navigation reset the filter)
+static void on_search_entry_activate(GtkEntry *entry, gpointer user_data) {
+  TopBarWidget *top_bar = (TopBarWidget *)user_data;
+
+  TopBar_forget_search(top_bar);
+  emit_search(top_bar);
+}
+
 TopBarWidget *TopBar_new(const char *initial_address) {
   // Allocate the struct
   TopBarWidget *top_bar = g_new0(TopBarWidget, 1);
@@ -117,6 +157,10 @@ TopBarWidget *TopBar_new(const char *initial_address) {
                    "activate",                            // detailed_signal
                    G_CALLBACK(on_search_entry_activate),  // c_handler
                    top_bar);                              // data
+  g_signal_connect(top_bar->search_entry,                 // instance
+                   "changed",                             // detailed_signal
+                   G_CALLBACK(on_search_entry_changed),   // c_handler
+                   top_bar);                              // data
 
   // Store TopBarWidget pointer in the GtkWidget for cleanup
   g_object_set_data_full(G_OBJECT(top_bar->m_TopBar), // object
@@ -129,7 +173,9 @@ TopBarWidget *TopBar_new(const char *initial_address) {
 
 void TopBar_destroy(TopBarWidget *top_bar) {
   if (top_bar) {
+    g_clear_handle_id(&top_bar->search_debounce, g_source_remove);
     g_free(top_bar->current_address);
+    g_free(top_bar->current_search);
     // Widget will be destroyed by GTK when parent is destroyed
     g_free(top_bar);
   }
@@ -162,6 +208,14 @@ const char *TopBar_get_address(const TopBarWidget *top_bar) {
                                                : NULL;
 }
 
+void TopBar_forget_search(TopBarWidget *top_bar) {
+  if (!top_bar)
+    return;
+
+  g_free(top_bar->current_search);
+  top_bar->current_search = NULL;
+}
+
 void TopBar_connect_address_changed(TopBarWidget *top_bar, GCallback callback,
                                     gpointer user_data) {
   if (top_bar && top_bar->m_TopBar) {
@@ -0,0 +1,206 @@
+#include "Prefetch.h"
+#include "Listing.h"
+#include "Sort.h"
+
+#include <stdlib.h>
+
+typedef struct {
+  gchar *path;
+  PrefetchPriority priority;
+  guint generation;       // hover_generation when a high priority was queued
+  Prefetcher *prefetcher; // Owner, gone once its group is cancelled
+  DirListing *listing;    // Filled in by the task, NULL if it failed
+} PrefetchRequest;
+
+static void pump(Prefetcher *prefetcher);
+static void load_request(gpointer data);
+static void deliver_request(gpointer data, gboolean cancelled);
+static void free_request(PrefetchRequest *request);
+
+Prefetcher *Prefetcher_new(DirCache *cache) {
+  Prefetcher *prefetcher = g_new0(Prefetcher, 1);
+  prefetcher->cache = cache;
+  prefetcher->group = SchedulerGroup_new(SCHEDULER_BACKGROUND, NULL);
+  g_queue_init(&prefetcher->requests);
+  prefetcher->in_flight =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  const char *env_rate = g_getenv("CILE_PREFETCH_ENTRIES_PER_SEC");
+  prefetcher->entries_per_second =
+      env_rate ? (guint)atoi(env_rate) : PREFETCH_DEFAULT_ENTRIES_PER_SEC;
+  if (prefetcher->entries_per_second == 0) {
+    prefetcher->entries_per_second = PREFETCH_DEFAULT_ENTRIES_PER_SEC;
+  }
+  return prefetcher;
+}
+
+void Prefetcher_destroy(Prefetcher *prefetcher) {
+  if (!prefetcher)
+    return;
+
+  // A read in progress finishes on its own; its done hook sees the
+  // cancellation and only frees the request
+  SchedulerGroup_cancel(prefetcher->group);
+  SchedulerGroup_unref(prefetcher->group);
+  if (prefetcher->resume_source) {
+    g_source_remove(prefetcher->resume_source);
+  }
+
+  PrefetchRequest *request;
+  while ((request = g_queue_pop_head(&prefetcher->requests))) {
+    free_request(request);
+  }
+
+  g_hash_table_destroy(prefetcher->in_flight);
+  g_free(prefetcher);
+}
+
+void Prefetcher_request(Prefetcher *prefetcher, const char *path,
+                        PrefetchPriority priority) {
+  if (!prefetcher || !path)
+    return;
+
+  if (DirCache_contains(prefetcher->cache, path) ||
+      g_hash_table_contains(prefetcher->in_flight, path))
+    return;
+
+  PrefetchRequest *request = g_new0(PrefetchRequest, 1);
+  request->path = g_strdup(path);
+  request->priority = priority;
+  request->prefetcher = prefetcher;
+  g_hash_table_add(prefetcher->in_flight, g_strdup(path));
+
+  if (priority == PREFETCH_PRIORITY_HIGH) {
+    // Earlier hover requests still queued become stale
+    request->generation = ++prefetcher->hover_generation;
+    g_queue_push_head(&prefetcher->requests, request);
+  } else {
+    g_queue_push_tail(&prefetcher->requests, request);
+  }
+
+  // Low priority requests arrive best first, so shed from the tail
+  if (g_queue_get_length(&prefetcher->requests) > PREFETCH_MAX_QUEUED) {
+    PrefetchRequest *dropped = g_queue_pop_tail(&prefetcher->requests);
+    g_hash_table_remove(prefetcher->in_flight, dropped->path);
+    free_request(dropped);
+  }
+
+  pump(prefetcher);
+}
+
+void Prefetcher_cancel_hover(Prefetcher *prefetcher) {
+  if (!prefetcher)
+    return;
+
+  prefetcher->hover_generation++;
+}
+
+void Prefetcher_note_foreground_io(Prefetcher *prefetcher) {
+  if (!prefetcher)
+    return;
+
+  prefetcher->quiet_until =
+      g_get_monotonic_time() + PREFETCH_QUIET_MS * (G_USEC_PER_SEC / 1000);
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static void free_request(PrefetchRequest *request) {
+  DirListing_unref(request->listing);
+  g_free(request->path);
+  g_free(request);
+}
+
+static gboolean resume_pump(gpointer user_data) {
+  Prefetcher *prefetcher = (Prefetcher *)user_data;
+  prefetcher->resume_source = 0;
+  pump(prefetcher);
+  return G_SOURCE_REMOVE;
+}
+
+// Start reading the next request, one at a time, once foreground loads
+// have left the disk alone for a while and the last listing's throttle has
+// passed; until then a timeout comes back
+static void pump(Prefetcher *prefetcher) {
+  if (prefetcher->loading || prefetcher->resume_source)
+    return;
+
+  PrefetchRequest *request;
+  while ((request = g_queue_pop_head(&prefetcher->requests))) {
+    gboolean stale = request->priority == PREFETCH_PRIORITY_HIGH &&
+                     request->generation != prefetcher->hover_generation;
+    if (!stale)
+      break;
+    g_hash_table_remove(prefetcher->in_flight, request->path);
+    free_request(request);
+  }
+  if (!request)
+    return;
+
+  gint64 now = g_get_monotonic_time();
+  gint64 ready_at = MAX(prefetcher->quiet_until, prefetcher->resume_at);
+  if (now < ready_at) {
+    guint wait_ms = (guint)((ready_at - now + 999) / 1000);
+    g_queue_push_head(&prefetcher->requests, request);
+    prefetcher->resume_source =
+        g_timeout_add_full(G_PRIORITY_LOW, // priority
+                           wait_ms,        // interval
+                           resume_pump,    // function
+                           prefetcher,     // data
+                           NULL);          // notify
+    return;
+  }
+
+  prefetcher->loading = TRUE;
+  Scheduler_push_full(prefetcher->group, load_request, deliver_request,
+                      request);
+}
+
+// A background task: the Scheduler runs it in the idle I/O class, and the
+// read yields to interactive work every quantum
+static void load_request(gpointer data) {
+  PrefetchRequest *request = (PrefetchRequest *)data;
+
+  // Reading the directory also pulls its blocks and dentries into the
+  // kernel caches, which helps even if the listing is not kept
+  request->listing = DirListing_load(request->path);
+
+  // Collate here too, while the listing is still private to this thread,
+  // so opening it costs the main thread no sorting setup
+  if (request->listing) {
+    Scheduler_yield();
+    DirListing_ensure_name_order(request->listing);
+  }
+}
+
+static void deliver_request(gpointer data, gboolean cancelled) {
+  PrefetchRequest *request = (PrefetchRequest *)data;
+  Prefetcher *prefetcher = request->prefetcher;
+
+  // Cancelled only by Prefetcher_destroy: the prefetcher is gone
+  if (cancelled) {
+    free_request(request);
+    return;
+  }
+
+  prefetcher->loading = FALSE;
+  g_hash_table_remove(prefetcher->in_flight, request->path);
+  if (request->listing) {
+    prefetcher->loaded++;
+
+    // Throttle: the listing costs as long as its entries are worth at the
+    // configured rate
+    prefetcher->resume_at =
+        g_get_monotonic_time() + (gint64)request->listing->count *
+                                     G_USEC_PER_SEC /
+                                     prefetcher->entries_per_second;
+
+    if (DirCache_insert_speculative(prefetcher->cache, request->listing)) {
+      prefetcher->inserted++;
+    }
+  }
+  free_request(request);
+  pump(prefetcher);
+}
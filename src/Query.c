@@ -0,0 +1,492 @@
+#define _GNU_SOURCE
+#include "Query.h"
+#include "ContentSearch.h"
+#include "Metrics.h"
+#include "Search.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *name;
+  QueryField field;
+} QueryFieldName;
+
+static const QueryFieldName field_names[] = {
+    {"type", QUERY_TYPE},
+    {"name", QUERY_NAME},
+    {"ext", QUERY_EXT},
+    {"path", QUERY_PATH},
+    {"size", QUERY_SIZE},
+    {"modified", QUERY_MODIFIED},
+    {"mtime", QUERY_MODIFIED},
+    {"content", QUERY_CONTENT},
+};
+
+static gsize read_operator(const char *p, QueryCompare *compare);
+static gboolean lookup_field(const char *key, gsize key_len,
+                             QueryField *field);
+static gchar *read_value(const char **p, gboolean *quoted);
+static gboolean parse_term(QueryTerm *term, QueryField field,
+                           QueryCompare compare, const char *value);
+static void set_text(QueryTerm *term, const char *text);
+static void plan_terms(Query *query, GArray *terms);
+static gboolean term_holds(const Query *query, const QueryTerm *term,
+                           QueryEntry *entry, gboolean first_content);
+
+Query *Query_parse(const char *text, QueryFlags flags) {
+  Query *query = g_new0(Query, 1);
+  GArray *terms = g_array_new(FALSE, TRUE, sizeof(QueryTerm));
+  QueryField word_field =
+      (flags & QUERY_WORDS_CONTENT) ? QUERY_CONTENT : QUERY_NAME;
+  gboolean syntax = FALSE;
+  const char *p = text;
+
+  query->now = g_get_real_time() / G_USEC_PER_SEC;
+
+  while (*p) {
+    while (g_ascii_isspace(*p)) {
+      p++;
+    }
+    if (!*p)
+      break;
+
+    // A leading '-' alone is no syntax: "-v2" stays a plain pattern unless
+    // a field or a quote elsewhere makes this a query
+    QueryTerm term = {0};
+    if (*p == '-' && p[1] && !g_ascii_isspace(p[1])) {
+      term.negate = TRUE;
+      p++;
+    }
+
+    // "field<op>value"; anything else, or a value that does not parse, is
+    // a bare word
+    const char *key = p;
+    while (g_ascii_isalpha(*p)) {
+      p++;
+    }
+    QueryCompare compare = QUERY_EQUAL;
+    gsize op_len = read_operator(p, &compare);
+    QueryField field;
+    gboolean quoted = FALSE;
+
+    if (op_len > 0 && lookup_field(key, p - key, &field)) {
+      const char *value_start = p + op_len;
+      gchar *value = read_value(&value_start, &quoted);
+      if (parse_term(&term, field, compare, value)) {
+        g_array_append_val(terms, term);
+        syntax = TRUE;
+        p = value_start;
+        g_free(value);
+        continue;
+      }
+      g_free(value);
+    }
+
+    p = key;
+    gchar *word = read_value(&p, &quoted);
+    syntax |= quoted;
+    if (*word) {
+      term.field = word_field;
+      set_text(&term, word);
+      g_array_append_val(terms, term);
+    }
+    g_free(word);
+  }
+
+  // Without syntax the whole text is one pattern, spaces included, so
+  // plain searches behave exactly as before
+  query->plain = !syntax;
+  if (query->plain) {
+    for (guint i = 0; i < terms->len; i++) {
+      g_free(g_array_index(terms, QueryTerm, i).text);
+    }
+    g_array_set_size(terms, 0);
+    if (*text) {
+      QueryTerm term = {0};
+      term.field = word_field;
+      set_text(&term, text);
+      g_array_append_val(terms, term);
+    }
+  }
+
+  plan_terms(query, terms);
+  return query;
+}
+
+void Query_free(Query *query) {
+  if (!query)
+    return;
+
+  for (guint i = 0; i < query->count; i++) {
+    g_free(query->terms[i].text);
+  }
+  g_free(query->terms);
+  g_free(query);
+}
+
+gboolean Query_has_content(const Query *query) {
+  return query->count > 0 &&
+         query->terms[query->count - 1].field == QUERY_CONTENT;
+}
+
+void QueryEntry_init(QueryEntry *entry, const char *dir_path,
+                     const char *name, unsigned char type, int dirfd) {
+  memset(entry, 0, sizeof(QueryEntry));
+  entry->dir_path = dir_path;
+  entry->name = name;
+  entry->type = type;
+  entry->dirfd = dirfd;
+}
+
+void QueryEntry_clear(QueryEntry *entry) {
+  g_free(entry->path);
+  entry->path = NULL;
+  FreeFileContents(entry->contents, entry->size);
+  entry->contents = NULL;
+}
+
+gboolean Query_matches(const Query *query, QueryEntry *entry) {
+  gboolean first_content = TRUE;
+
+  for (guint i = 0; i < query->count; i++) {
+    const QueryTerm *term = &query->terms[i];
+
+    // An entry whose size, age or contents cannot be known matches neither
+    // the term nor its negation
+    if (term->field == QUERY_SIZE || term->field == QUERY_MODIFIED) {
+      if (!entry->stat_done) {
+        gint64 start = g_get_monotonic_time();
+        entry->stat_done = TRUE;
+        entry->stat_ok =
+            DirReader_stat_at(entry->dirfd, entry->name, false, &entry->st);
+        entry->io_us += g_get_monotonic_time() - start;
+      }
+      if (!entry->stat_ok)
+        return FALSE;
+    } else if (term->field == QUERY_CONTENT) {
+      if (entry->type != DIR_TYPE_REG && entry->type != DIR_TYPE_LNK)
+        return FALSE;
+      if (!entry->read_done) {
+        gint64 start = g_get_monotonic_time();
+        entry->read_done = TRUE;
+        entry->contents = ReadFileAt(entry->dirfd, entry->name, &entry->size);
+        entry->io_us += g_get_monotonic_time() - start;
+        if (entry->contents) {
+          Metrics_add(METRIC_FILES_SCANNED, 1);
+          Metrics_add(METRIC_BYTES_SCANNED, entry->size);
+        } else {
+          Metrics_add(METRIC_FILES_SKIPPED, 1);
+        }
+      }
+      if (!entry->contents)
+        return FALSE;
+    }
+
+    gboolean holds = term_holds(query, term, entry, first_content);
+    if (term->field == QUERY_CONTENT && !term->negate) {
+      first_content = FALSE;
+    }
+    if (holds == term->negate)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+gboolean Query_text_contains(const char *text, const char *pattern_lower,
+                             gboolean ascii) {
+  // Lowercasing only changes ASCII letters an ASCII pattern can match
+  if (ascii)
+    return strcasestr(text, pattern_lower) != NULL;
+
+  gchar *text_lower = g_utf8_strdown(text, -1);
+  gboolean matches = strstr(text_lower, pattern_lower) != NULL;
+  g_free(text_lower);
+  return matches;
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static gsize read_operator(const char *p, QueryCompare *compare) {
+  if (p[0] == '<' && p[1] == '=') {
+    *compare = QUERY_LESS_EQUAL;
+    return 2;
+  }
+  if (p[0] == '>' && p[1] == '=') {
+    *compare = QUERY_GREATER_EQUAL;
+    return 2;
+  }
+  switch (p[0]) {
+  case ':':
+  case '=':
+    *compare = QUERY_EQUAL;
+    return 1;
+  case '<':
+    *compare = QUERY_LESS;
+    return 1;
+  case '>':
+    *compare = QUERY_GREATER;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static gboolean lookup_field(const char *key, gsize key_len,
+                             QueryField *field) {
+  for (gsize i = 0; i < G_N_ELEMENTS(field_names); i++) {
+    if (strlen(field_names[i].name) == key_len &&
+        g_ascii_strncasecmp(field_names[i].name, key, key_len) == 0) {
+      *field = field_names[i].field;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+// A "quoted string" (spaces allowed) or text up to the next space
+static gchar *read_value(const char **p, gboolean *quoted) {
+  const char *start = *p;
+
+  if (*start == '"') {
+    const char *end = strchr(start + 1, '"');
+    *quoted = TRUE;
+    if (!end) {
+      *p = start + strlen(start);
+      return g_strdup(start + 1);
+    }
+    *p = end + 1;
+    return g_strndup(start + 1, end - start - 1);
+  }
+
+  const char *end = start;
+  while (*end && !g_ascii_isspace(*end)) {
+    end++;
+  }
+  *p = end;
+  return g_strndup(start, end - start);
+}
+
+// "10M", "1.5g", "512": bytes, in powers of 1024
+static gboolean parse_size(const char *value, gint64 *bytes) {
+  char *end;
+  double number = g_ascii_strtod(value, &end);
+  if (end == value || number < 0)
+    return FALSE;
+
+  // K, M, G, T with optional "i" and "B": "10M", "10MiB", "10mb"
+  static const char units[] = "kmgt";
+  double scale = 1;
+  const char *unit = *end ? strchr(units, g_ascii_tolower(*end)) : NULL;
+  if (unit) {
+    for (const char *u = units; u <= unit; u++) {
+      scale *= 1024;
+    }
+    end++;
+    if (*end == 'i' || *end == 'I') {
+      end++;
+    }
+  }
+  if (*end == 'b' || *end == 'B') {
+    end++;
+  }
+  if (*end)
+    return FALSE;
+
+  *bytes = (gint64)(number * scale);
+  return TRUE;
+}
+
+// "30s", "15m", "2d": seconds; a bare number is days
+static gboolean parse_age(const char *value, gint64 *seconds) {
+  char *end;
+  double number = g_ascii_strtod(value, &end);
+  if (end == value || number < 0)
+    return FALSE;
+
+  double scale;
+  switch (*end) {
+  case 's':
+    scale = 1;
+    break;
+  case 'm':
+    scale = 60;
+    break;
+  case 'h':
+    scale = 60 * 60;
+    break;
+  case 'd':
+  case '\0':
+    scale = 24 * 60 * 60;
+    break;
+  case 'w':
+    scale = 7 * 24 * 60 * 60;
+    break;
+  case 'y':
+    scale = 365 * 24 * 60 * 60;
+    break;
+  default:
+    return FALSE;
+  }
+  if (*end && end[1])
+    return FALSE;
+
+  *seconds = (gint64)(number * scale);
+  return TRUE;
+}
+
+static gboolean parse_type(const char *value, gint64 *type) {
+  static const struct {
+    const char *name;
+    unsigned char type;
+  } types[] = {
+      {"f", DIR_TYPE_REG},      {"file", DIR_TYPE_REG},
+      {"d", DIR_TYPE_DIR},      {"dir", DIR_TYPE_DIR},
+      {"folder", DIR_TYPE_DIR}, {"l", DIR_TYPE_LNK},
+      {"link", DIR_TYPE_LNK},   {"symlink", DIR_TYPE_LNK},
+  };
+
+  for (gsize i = 0; i < G_N_ELEMENTS(types); i++) {
+    if (g_ascii_strcasecmp(value, types[i].name) == 0) {
+      *type = types[i].type;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+static gboolean parse_term(QueryTerm *term, QueryField field,
+                           QueryCompare compare, const char *value) {
+  term->field = field;
+  term->compare = compare;
+  if (!*value)
+    return FALSE;
+
+  switch (field) {
+  case QUERY_SIZE:
+    return parse_size(value, &term->value);
+  case QUERY_MODIFIED:
+    // "modified:2d" means within the last two days
+    if (compare == QUERY_EQUAL) {
+      term->compare = QUERY_LESS;
+    }
+    return parse_age(value, &term->value);
+  case QUERY_TYPE:
+    return compare == QUERY_EQUAL && parse_type(value, &term->value);
+  case QUERY_EXT:
+    while (*value == '.') {
+      value++;
+    }
+    if (compare != QUERY_EQUAL || !*value)
+      return FALSE;
+    set_text(term, value);
+    return TRUE;
+  default:
+    if (compare != QUERY_EQUAL)
+      return FALSE;
+    set_text(term, value);
+    return TRUE;
+  }
+}
+
+static void set_text(QueryTerm *term, const char *text) {
+  term->text = term->field == QUERY_CONTENT ? g_strdup(text)
+                                            : g_utf8_strdown(text, -1);
+  term->text_len = strlen(term->text);
+  term->ascii = g_str_is_ascii(term->text);
+}
+
+// Cheapest first: the fields are declared in cost order. Insertion sort
+// keeps terms of equal cost in the order they were typed.
+static void plan_terms(Query *query, GArray *terms) {
+  QueryTerm *items = (QueryTerm *)terms->data;
+
+  for (guint i = 1; i < terms->len; i++) {
+    QueryTerm term = items[i];
+    guint j = i;
+    while (j > 0 && items[j - 1].field > term.field) {
+      items[j] = items[j - 1];
+      j--;
+    }
+    items[j] = term;
+  }
+
+  for (guint i = 0; i < terms->len; i++) {
+    if (items[i].field == QUERY_SIZE || items[i].field == QUERY_MODIFIED) {
+      query->needs_stat = TRUE;
+    }
+  }
+  query->count = terms->len;
+  query->terms = (QueryTerm *)g_array_free(terms, FALSE);
+}
+
+static gboolean compare_value(QueryCompare compare, gint64 actual,
+                              gint64 wanted) {
+  switch (compare) {
+  case QUERY_LESS:
+    return actual < wanted;
+  case QUERY_LESS_EQUAL:
+    return actual <= wanted;
+  case QUERY_GREATER:
+    return actual > wanted;
+  case QUERY_GREATER_EQUAL:
+    return actual >= wanted;
+  default:
+    return actual == wanted;
+  }
+}
+
+// ext:c,h against the text after the name's last dot
+static gboolean ext_matches(const char *name, const char *exts) {
+  const char *dot = strrchr(name, '.');
+  if (!dot || dot == name)
+    return FALSE;
+
+  gchar *ext = g_utf8_strdown(dot + 1, -1);
+  gsize ext_len = strlen(ext);
+  gboolean matches = FALSE;
+  for (const char *alt = exts; alt && !matches;) {
+    const char *comma = strchr(alt, ',');
+    gsize alt_len = comma ? (gsize)(comma - alt) : strlen(alt);
+    matches = alt_len == ext_len && memcmp(alt, ext, ext_len) == 0;
+    alt = comma ? comma + 1 : NULL;
+  }
+  g_free(ext);
+  return matches;
+}
+
+static gboolean term_holds(const Query *query, const QueryTerm *term,
+                           QueryEntry *entry, gboolean first_content) {
+  switch (term->field) {
+  case QUERY_TYPE:
+    return entry->type == term->value;
+  case QUERY_NAME:
+    return Query_text_contains(entry->name, term->text, term->ascii);
+  case QUERY_EXT:
+    return ext_matches(entry->name, term->text);
+  case QUERY_PATH:
+    if (!entry->path) {
+      entry->path = *entry->dir_path
+                        ? g_strconcat(entry->dir_path, "/", entry->name, NULL)
+                        : g_strdup(entry->name);
+    }
+    return Query_text_contains(entry->path, term->text, term->ascii);
+  case QUERY_SIZE:
+    return compare_value(term->compare, (gint64)entry->st.size, term->value);
+  case QUERY_MODIFIED:
+    return compare_value(term->compare, query->now - entry->st.mtime_sec,
+                         term->value);
+  case QUERY_CONTENT:
+    // Only the first term's hits are counted; the others just need one
+    if (first_content && !term->negate) {
+      entry->hits = ContentSearch_count(entry->contents, entry->size,
+                                        term->text, term->text_len);
+      return entry->hits > 0;
+    }
+    return memmem(entry->contents, entry->size, term->text,
+                  term->text_len) != NULL;
+  }
+  return FALSE;
+}
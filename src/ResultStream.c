@@ -0,0 +1,148 @@
+#include "ResultStream.h"
+#include "Memory.h"
+
+static gboolean deliver_results(gpointer user_data);
+static void free_node(ResultNode *node);
+
+// Dispatch-only source woken from any thread with g_source_set_ready_time()
+static gboolean dispatch_when_ready(GSource *source, GSourceFunc callback,
+                                    gpointer user_data) {
+  g_source_set_ready_time(source, -1);
+  return callback(user_data);
+}
+
+static GSourceFuncs stream_source_funcs = {NULL, NULL, dispatch_when_ready,
+                                           NULL};
+
+ResultStream *ResultStream_new(guint batch, ResultStreamFunc func,
+                               gpointer user_data) {
+  ResultStream *stream = g_new0(ResultStream, 1);
+  stream->pending = 1;
+  stream->batch = MAX(batch, 1);
+  stream->func = func;
+  stream->user_data = user_data;
+  g_queue_init(&stream->ready);
+
+  stream->source = g_source_new(&stream_source_funcs, sizeof(GSource));
+  g_source_set_callback(stream->source,  // source
+                        deliver_results, // func
+                        stream,          // data
+                        NULL);           // notify
+  g_source_attach(stream->source, NULL);
+  return stream;
+}
+
+void ResultStream_add_work(ResultStream *stream, guint units) {
+  g_atomic_int_add(&stream->pending, (gint)units);
+}
+
+void ResultStream_work_done(ResultStream *stream) {
+  // Pushes made before this are visible to a consumer that sees finished
+  if (g_atomic_int_dec_and_test(&stream->pending)) {
+    g_atomic_int_set(&stream->finished, TRUE);
+    g_source_set_ready_time(stream->source, 0);
+  }
+}
+
+// Treiber push: any number of producers, no lock
+void ResultStream_push(ResultStream *stream, ResultNode *node,
+                       gsize size) {
+  node->size = size;
+  Memory_add(MEMORY_RESULTS, (gint64)size);
+
+  ResultNode *head;
+  do {
+    head = g_atomic_pointer_get(&stream->head);
+    node->next = head;
+  } while (!g_atomic_pointer_compare_and_exchange(&stream->head, head, node));
+
+  g_source_set_ready_time(stream->source, 0);
+}
+
+void ResultStream_close(ResultStream *stream) {
+  // A destroyed source is never dispatched, even if a worker wakes it
+  g_source_destroy(stream->source);
+}
+
+void ResultStream_free(ResultStream *stream) {
+  if (!stream)
+    return;
+
+  ResultNode *node = stream->head;
+  while (node) {
+    ResultNode *next = node->next;
+    free_node(node);
+    node = next;
+  }
+  while ((node = g_queue_pop_head(&stream->ready))) {
+    free_node(node);
+  }
+
+  g_source_unref(stream->source);
+  g_free(stream);
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static void free_node(ResultNode *node) {
+  Memory_add(MEMORY_RESULTS, -(gint64)node->size);
+  g_free(node);
+}
+
+// The single consumer takes the whole stack at once, so there is no ABA
+static ResultNode *take_all(ResultStream *stream) {
+  ResultNode *head;
+  do {
+    head = g_atomic_pointer_get(&stream->head);
+  } while (head &&
+           !g_atomic_pointer_compare_and_exchange(&stream->head, head, NULL));
+  return head;
+}
+
+static gboolean deliver_results(gpointer user_data) {
+  ResultStream *stream = (ResultStream *)user_data;
+  if (stream->done)
+    return G_SOURCE_CONTINUE;
+
+  // Read before draining: every push preceding finished is then drained
+  gboolean finished = g_atomic_int_get(&stream->finished);
+
+  // Restore arrival order: the stack is newest first
+  ResultNode *node = take_all(stream);
+  ResultNode *oldest = NULL;
+  while (node) {
+    ResultNode *next = node->next;
+    node->next = oldest;
+    oldest = node;
+    node = next;
+  }
+  for (; oldest; oldest = oldest->next) {
+    g_queue_push_tail(&stream->ready, oldest);
+  }
+
+  guint count = MIN(stream->batch, g_queue_get_length(&stream->ready));
+  ResultNode **items = g_new(ResultNode *, count + 1);
+  gint64 delivered = 0;
+  for (guint i = 0; i < count; i++) {
+    items[i] = g_queue_pop_head(&stream->ready);
+    delivered += items[i]->size;
+  }
+  // The callback owns them from here on
+  Memory_add(MEMORY_RESULTS, -delivered);
+
+  // Leave the rest for the next iteration so input and paint get a turn
+  gboolean last = finished && g_queue_is_empty(&stream->ready);
+  if (!g_queue_is_empty(&stream->ready)) {
+    g_source_set_ready_time(stream->source, 0);
+  }
+  stream->done = last;
+
+  // The callback may close and free the stream: nothing touches it after
+  if (count > 0 || last) {
+    stream->func(items, count, last, stream->user_data);
+  }
+  g_free(items);
+  return G_SOURCE_CONTINUE;
+}
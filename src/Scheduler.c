@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+
+#include "Scheduler.h"
+#include "Cgroup.h"
+#include "Metrics.h"
+#include "ResultStream.h"
+#include "Trace.h"
+
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+typedef struct {
+  ResultNode node;        // Carries tasks with a done hook to the main loop
+  SchedulerGroup *group;  // Holds a reference
+  SchedulerFunc func;     // Task
+  SchedulerDoneFunc done; // Completion hook, NULL if none
+  gpointer data;          // Passed to both
+  gint64 queued_at;       // Monotonic time of the push
+} Task;
+
+typedef struct {
+  GMutex lock;                             // Guards deques
+  GQueue deques[SCHEDULER_PRIORITY_COUNT]; // Task*, the owner's end first
+  SchedulerPriority running;               // Class of the innermost task
+                                           // run, PRIORITY_COUNT if idle
+  gint64 slice_start;                      // When it started or yielded
+  guint index;                             // Position in workers
+  pid_t tid;                               // Kernel id of its thread
+  long io_priority;                        // The thread's own I/O
+                                           // priority, -1 if unknown
+  gboolean io_idle;                        // In the idle I/O class
+} Worker;
+
+static Worker *workers;
+static guint worker_count;
+static GMutex shared_lock;                      // Guards shared
+static GQueue shared[SCHEDULER_PRIORITY_COUNT]; // Task* pushed from other
+                                                // threads, oldest first
+static gint queued[SCHEDULER_PRIORITY_COUNT];   // Tasks in any queue
+static gint running[SCHEDULER_PRIORITY_COUNT];  // Tasks being run
+static GMutex idle_lock;
+static GCond idle_cond;                         // Signalled on a push
+static gint sleeping;                           // Workers waiting on it
+static GPrivate current_worker;                 // Worker of this thread
+static ResultStream *completions;               // Tasks whose hook is due
+
+static void follow_parent(GCancellable *parent, gpointer user_data);
+static void start_workers(void);
+static guint pool_size(void);
+static gpointer worker_main(gpointer user_data);
+static Task *take_task(Worker *self, SchedulerPriority below);
+static void run_task(Worker *self, Task *task);
+static void set_io_idle(Worker *self, gboolean idle);
+static void run_done_hooks(ResultNode **items, guint count,
+                           gboolean finished, gpointer user_data);
+
+SchedulerGroup *SchedulerGroup_new(SchedulerPriority priority,
+                                   GCancellable *cancellable) {
+  SchedulerGroup *group = g_new0(SchedulerGroup, 1);
+  group->priority = priority;
+  group->cancellable = g_cancellable_new();
+  group->ref_count = 1;
+
+  // Called right away if the parent is cancelled already
+  if (cancellable) {
+    group->parent = g_object_ref(cancellable);
+    group->parent_handler =
+        g_cancellable_connect(cancellable,               // cancellable
+                              G_CALLBACK(follow_parent), // callback
+                              group->cancellable,        // data
+                              NULL);                     // data_destroy_func
+  }
+  return group;
+}
+
+void SchedulerGroup_unref(SchedulerGroup *group) {
+  if (!group || !g_atomic_int_dec_and_test(&group->ref_count))
+    return;
+
+  // Waits for a handler running on another thread, which still needs the
+  // group's token
+  if (group->parent) {
+    g_cancellable_disconnect(group->parent, group->parent_handler);
+    g_object_unref(group->parent);
+  }
+  g_object_unref(group->cancellable);
+  g_free(group);
+}
+
+void SchedulerGroup_cancel(SchedulerGroup *group) {
+  g_cancellable_cancel(group->cancellable);
+}
+
+void Scheduler_push(SchedulerGroup *group, SchedulerFunc func,
+                    gpointer data) {
+  Scheduler_push_full(group, func, NULL, data);
+}
+
+void Scheduler_push_full(SchedulerGroup *group, SchedulerFunc func,
+                         SchedulerDoneFunc done, gpointer data) {
+  start_workers();
+
+  Task *task = g_new(Task, 1);
+  task->group = group;
+  task->func = func;
+  task->done = done;
+  task->data = data;
+  task->queued_at = g_get_monotonic_time();
+  g_atomic_int_inc(&group->ref_count);
+
+  SchedulerPriority priority = group->priority;
+  Worker *self = g_private_get(&current_worker);
+  if (self) {
+    g_mutex_lock(&self->lock);
+    g_queue_push_head(&self->deques[priority], task);
+    g_mutex_unlock(&self->lock);
+  } else {
+    g_mutex_lock(&shared_lock);
+    g_queue_push_tail(&shared[priority], task);
+    g_mutex_unlock(&shared_lock);
+  }
+
+  // Counted once it can be taken. A worker going to sleep counts itself
+  // before it checks the queues, so one of the two sides sees the other.
+  g_atomic_int_inc(&queued[priority]);
+  if (g_atomic_int_get(&sleeping) > 0) {
+    g_mutex_lock(&idle_lock);
+    g_cond_signal(&idle_cond);
+    g_mutex_unlock(&idle_lock);
+  }
+}
+
+gboolean Scheduler_yield(void) {
+  Worker *self = g_private_get(&current_worker);
+  if (!self || self->running == SCHEDULER_INTERACTIVE)
+    return FALSE;
+
+  gboolean waiting = FALSE;
+  for (int p = 0; p < (int)self->running; p++) {
+    waiting = waiting || g_atomic_int_get(&queued[p]) > 0;
+  }
+  if (!waiting ||
+      g_get_monotonic_time() - self->slice_start < SCHEDULER_QUANTUM_US)
+    return FALSE;
+
+  TRACE_BEGIN(span);
+  guint ran = 0;
+  Task *task;
+  while ((task = take_task(self, self->running))) {
+    run_task(self, task);
+    ran++;
+  }
+  self->slice_start = g_get_monotonic_time();
+  Metrics_add(METRIC_TASKS_PREEMPTING, ran);
+  TRACE_END_COUNT(span, "scheduler_yield", ran);
+  return ran > 0;
+}
+
+guint Scheduler_workers(void) {
+  start_workers();
+  return worker_count;
+}
+
+void Scheduler_snapshot(SchedulerSnapshot *snapshot) {
+  snapshot->workers = Scheduler_workers();
+  for (int p = 0; p < SCHEDULER_PRIORITY_COUNT; p++) {
+    snapshot->queued[p] = (guint)MAX(g_atomic_int_get(&queued[p]), 0);
+    snapshot->running[p] = (guint)MAX(g_atomic_int_get(&running[p]), 0);
+  }
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static void follow_parent(GCancellable *parent, gpointer user_data) {
+  g_cancellable_cancel((GCancellable *)user_data);
+}
+
+// Workers live as long as the process, like GLib's shared thread pools
+static void start_workers(void) {
+  static gsize initialized = 0;
+
+  if (g_once_init_enter(&initialized)) {
+    // Behind input and drawing, like the idle work of the main loop
+    completions =
+        ResultStream_new(SCHEDULER_DONE_BATCH, run_done_hooks, NULL);
+    g_source_set_priority(completions->source, G_PRIORITY_DEFAULT_IDLE);
+    worker_count = pool_size();
+    workers = g_new0(Worker, worker_count);
+    for (guint i = 0; i < worker_count; i++) {
+      g_mutex_init(&workers[i].lock);
+      workers[i].running = SCHEDULER_PRIORITY_COUNT;
+      workers[i].index = i;
+    }
+    for (guint i = 0; i < worker_count; i++) {
+      gchar *name = g_strdup_printf("worker-%u", i);
+      g_thread_unref(g_thread_new(name, worker_main, &workers[i]));
+      g_free(name);
+    }
+    g_once_init_leave(&initialized, 1);
+  }
+}
+
+// More workers than the quota only take turns being throttled; a fraction
+// of a CPU still gets one
+static guint pool_size(void) {
+  const char *env_workers = g_getenv(SCHEDULER_ENV);
+  if (env_workers && atoi(env_workers) > 0)
+    return (guint)atoi(env_workers);
+
+  guint cpus = g_get_num_processors();
+  gdouble quota = Cgroup_cpu_quota();
+  if (quota > 0) {
+    cpus = MIN(cpus, (guint)(quota + 0.999));
+  }
+  return MAX(cpus, 1);
+}
+
+static gboolean anything_queued(void) {
+  for (int p = 0; p < SCHEDULER_PRIORITY_COUNT; p++) {
+    if (g_atomic_int_get(&queued[p]) > 0)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static gpointer worker_main(gpointer user_data) {
+  Worker *self = (Worker *)user_data;
+  g_private_set(&current_worker, self);
+  self->tid = (pid_t)syscall(SYS_gettid);
+  self->io_priority = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, self->tid);
+
+  for (;;) {
+    Task *task = take_task(self, SCHEDULER_PRIORITY_COUNT);
+    if (task) {
+      run_task(self, task);
+      continue;
+    }
+
+    g_mutex_lock(&idle_lock);
+    g_atomic_int_inc(&sleeping);
+    if (!anything_queued()) {
+      g_cond_wait(&idle_cond, &idle_lock);
+    }
+    g_atomic_int_add(&sleeping, -1);
+    g_mutex_unlock(&idle_lock);
+  }
+  return NULL;
+}
+
+static Task *pop(GMutex *lock, GQueue *queue, gboolean head) {
+  g_mutex_lock(lock);
+  Task *task = head ? g_queue_pop_head(queue) : g_queue_pop_tail(queue);
+  g_mutex_unlock(lock);
+  return task;
+}
+
+// Highest class first; within a class the worker's own newest task, then
+// the oldest pushed from outside, then the oldest of another worker
+static Task *take_task(Worker *self, SchedulerPriority below) {
+  for (int p = 0; p < (int)below; p++) {
+    if (g_atomic_int_get(&queued[p]) <= 0)
+      continue;
+
+    Task *task = pop(&self->lock, &self->deques[p], TRUE);
+    if (!task) {
+      task = pop(&shared_lock, &shared[p], TRUE);
+    }
+    for (guint i = 1; !task && i < worker_count; i++) {
+      Worker *victim = &workers[(self->index + i) % worker_count];
+      task = pop(&victim->lock, &victim->deques[p], FALSE);
+      if (task) {
+        Metrics_add(METRIC_TASKS_STOLEN, 1);
+      }
+    }
+    if (task) {
+      g_atomic_int_add(&queued[p], -1);
+      return task;
+    }
+  }
+  return NULL;
+}
+
+// Also runs nested, from Scheduler_yield: the outer task's class and slice
+// come back afterwards
+static void run_task(Worker *self, Task *task) {
+  SchedulerGroup *group = task->group;
+  SchedulerPriority outer = self->running;
+  gint64 outer_start = self->slice_start;
+  gint64 now = g_get_monotonic_time();
+
+  if (group->priority == SCHEDULER_INTERACTIVE) {
+    Metrics_record(METRIC_INTERACTIVE_WAIT_US, now - task->queued_at);
+  }
+  gboolean outer_idle = self->io_idle;
+  self->running = group->priority;
+  self->slice_start = now;
+  set_io_idle(self, group->priority == SCHEDULER_BACKGROUND);
+  g_atomic_int_inc(&running[group->priority]);
+
+  if (!task->done || !g_cancellable_is_cancelled(group->cancellable)) {
+    task->func(task->data);
+  }
+
+  g_atomic_int_add(&running[group->priority], -1);
+  self->running = outer;
+  self->slice_start = outer_start;
+  set_io_idle(self, outer_idle);
+
+  if (task->done) {
+    ResultStream_push(completions, &task->node, sizeof(Task));
+  } else {
+    SchedulerGroup_unref(group);
+    g_free(task);
+  }
+}
+
+// Linux applies I/O priority per thread, so a worker switches class with
+// the task it runs, nested ones included. A kernel that refuses to restore
+// the thread's own value gets the default, class none.
+static void set_io_idle(Worker *self, gboolean idle) {
+  if (idle == self->io_idle)
+    return;
+
+  self->io_idle = idle;
+  if (idle) {
+    syscall(SYS_ioprio_set,                           // number
+            IOPRIO_WHO_PROCESS,                       // which
+            self->tid,                                // who
+            IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT); // ioprio
+  } else if (self->io_priority < 0 ||
+             syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, self->tid,
+                     self->io_priority) != 0) {
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, self->tid, 0);
+  }
+}
+
+// Cancellation is read here, on the main thread: a group cancelled from
+// the main loop never sees a hook of its called as if it were not
+static void run_done_hooks(ResultNode **items, guint count,
+                           gboolean finished, gpointer user_data) {
+  for (guint i = 0; i < count; i++) {
+    Task *task = (Task *)items[i];
+    SchedulerGroup *group = task->group;
+    task->done(task->data, g_cancellable_is_cancelled(group->cancellable));
+    SchedulerGroup_unref(group);
+    g_free(task);
+  }
+}
@@ -1,129 +1,55 @@
 #define _DEFAULT_SOURCE
 #define STB_IMAGE_IMPLEMENTATION
 #define MAX_FILES 1024
-#define MAX_PATH_LENGTH 4096
 #define INITIAL_CAPACITY 64
 
 #include "Search.h"
+#include "Budget.h"
+#include "DirReader.h"
+#include "Listing.h"
+#include "Memory.h"
+#include "Metrics.h"
+#include "Sort.h"
+#include "Trace.h"
 #include "cuda/search_kernel.cuh"
 
 #include "stb_image.h"
 #include <gio/gio.h>
 
-#include <dirent.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-
-typedef struct {
-  char **filenames;
-  GIcon **icons;
-  int count;
-  int capacity;
-} FileEntryCache;
-
-static FileEntryCache *create_file_cache(int initial_capacity) {
-  FileEntryCache *cache = malloc(sizeof(FileEntryCache));
-  cache->filenames = malloc(initial_capacity * sizeof(char *)); // filenames
-  cache->icons = malloc(initial_capacity * sizeof(GIcon *));    // icons
-  cache->count = 0;
-  cache->capacity = initial_capacity;
-  return cache;
-}
-
-static void resize_file_cache(FileEntryCache *cache) {
-  cache->capacity *= 2;
-  cache->filenames = realloc(cache->filenames,                  // ptr
-                             cache->capacity * sizeof(char *)); // size
-  cache->icons = realloc(cache->icons,                          // ptr
-                         cache->capacity * sizeof(GIcon *));    // size
-}
-
-static void free_file_cache(FileEntryCache *cache) {
-  if (!cache)
-    return;
-
-  for (int i = 0; i < cache->count; i++) {
-    free(cache->filenames[i]);
-    if (cache->icons[i]) {
-      g_object_unref(cache->icons[i]);
-    }
-  }
-
-  free(cache->filenames);
-  free(cache->icons);
-  free(cache);
-}
+#include <unistd.h>
 
 FileEntry **ListFilesInDir(const char *dirpath, int *file_count) {
-  DIR *dir = opendir(dirpath);
-  if (!dir) {
-    perror("Error opening directory");
+  TRACE_BEGIN(span);
+  DirListing *listing = DirListing_load(dirpath);
+  if (!listing)
     return NULL;
-  }
-
-  FileEntryCache *cache = create_file_cache(INITIAL_CAPACITY);
-  struct dirent *entry;
-  char full_path[MAX_PATH_LENGTH];
-
-  // First pass: collect all filenames (hot loop, minimal work)
-  while ((entry = readdir(dir)) != NULL) {
-    if (strcmp(entry->d_name, "..") == 0 || strcmp(entry->d_name, ".") == 0) {
-      continue;
-    }
 
-    if (cache->count >= cache->capacity) {
-      resize_file_cache(cache);
-    }
-
-    cache->filenames[cache->count] = strdup(entry->d_name);
-    cache->icons[cache->count] = NULL; // Initialize to NULL
-    cache->count++;
-  }
-  closedir(dir);
-
-  // Second pass: load icons in batch
-  for (int i = 0; i < cache->count; i++) {
-    snprintf(full_path,            // str
-             MAX_PATH_LENGTH,      // size
-             "%s/%s",              // format
-             dirpath,              // ...
-             cache->filenames[i]); // ...
-
-    GFile *file = g_file_new_for_path(full_path);
-    GFileInfo *info = g_file_query_info(file,                   // file
-                                        "standard::icon",       // attributes
-                                        G_FILE_QUERY_INFO_NONE, // flags
-                                        NULL,                   // cancellable
-                                        NULL);                  // error
-
-    if (info) {
-      GIcon *gicon = g_file_info_get_icon(info);
-      if (gicon) {
-        cache->icons[i] = g_object_ref(gicon);
-      }
-      g_object_unref(info);
-    }
-    g_object_unref(file);
-  }
+  TRACE_BEGIN(sort_span);
+  SortSpec spec = {SORT_BY_NAME, FALSE, FALSE};
+  guint32 *order = DirListing_sort(listing, &spec);
+  TRACE_END_COUNT(sort_span, "sort", listing->count);
 
-  // Convert SoA back to AoS for compatibility with existing API
-  FileEntry **file_entries = malloc(cache->count * sizeof(FileEntry *));
-  for (int i = 0; i < cache->count; i++) {
+  // Convert the columnar listing to AoS for compatibility with existing API
+  FileEntry **file_entries = malloc(listing->count * sizeof(FileEntry *));
+  for (int i = 0; i < listing->count; i++) {
+    guint32 index = order[i];
     file_entries[i] = malloc(sizeof(FileEntry));
-    file_entries[i]->filename = cache->filenames[i];
-    file_entries[i]->icon_data = cache->icons[i];
+    file_entries[i]->filename = strdup(listing->names[index]);
+    file_entries[i]->icon_data =
+        listing->icons[index] ? g_object_ref(listing->icons[index]) : NULL;
   }
 
-  *file_count = cache->count;
-
-  // Free only the cache structure, not the data (transferred to file_entries)
-  free(cache->filenames);
-  free(cache->icons);
-  free(cache);
+  *file_count = listing->count;
 
+  g_free(order);
+  DirListing_unref(listing);
+  TRACE_END_COUNT(span, "ListFilesInDir", *file_count);
   return file_entries;
 }
 
@@ -147,6 +73,142 @@ bool DoesFileExist(const char *filepath) {
   return (stat(filepath, &path_stat) == 0);
 }
 
+// Open a non-empty regular file; its size comes from fstat on the open fd,
+// so there is no path building and no path stat. The type is only known
+// after the open, and names may be symlinks to anything: O_NONBLOCK keeps
+// a FIFO from blocking the open until a writer shows up.
+static int open_regular_at(int dirfd, const char *name, size_t *out_size) {
+  int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0)
+    return -1;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) ||
+      file_stat.st_size == 0) {
+    close(fd);
+    return -1;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+  *out_size = file_stat.st_size;
+  return fd;
+}
+
+// Read up to len bytes at offset, retrying short reads
+static size_t read_at(int fd, char *buf, size_t len, off_t offset) {
+  size_t bytes_read = 0;
+  while (bytes_read < len) {
+    ssize_t n = pread(fd,                          // fd
+                      buf + bytes_read,            // buf
+                      len - bytes_read,            // count
+                      offset + (off_t)bytes_read); // offset
+    if (n <= 0)
+      break;
+    bytes_read += (size_t)n;
+  }
+  return bytes_read;
+}
+
+// The buffer is drawn from the memory budget before it is allocated. With
+// wait unset a full budget fails the read and sets *over_budget instead.
+static char *read_file(int dirfd, const char *name, size_t *out_size,
+                       gboolean wait, gboolean *over_budget) {
+  TRACE_BEGIN(stat_span);
+  size_t file_size;
+  int fd = open_regular_at(dirfd, name, &file_size);
+  TRACE_END(stat_span, "stat");
+  if (fd < 0)
+    return NULL;
+
+  if (wait) {
+    Budget_acquire(file_size + 1);
+  } else if (!Budget_try_acquire(file_size + 1)) {
+    close(fd);
+    *over_budget = TRUE;
+    return NULL;
+  }
+
+  // Allocate exact size needed
+  char *contents = malloc(file_size + 1);
+  if (!contents) {
+    Budget_release(file_size + 1);
+    close(fd);
+    return NULL;
+  }
+
+  TRACE_BEGIN(read_span);
+  size_t bytes_read = read_at(fd, contents, file_size, 0);
+  close(fd);
+  TRACE_END_COUNT(read_span, "read", bytes_read);
+
+  // A file that shrank since fstat holds on to less
+  Budget_release(file_size - bytes_read);
+  contents[bytes_read] = '\0';
+  *out_size = bytes_read;
+  Memory_add(MEMORY_SEARCH_BUFFERS, bytes_read + 1);
+  return contents;
+}
+
+char *ReadFileAt(int dirfd, const char *name, size_t *out_size) {
+  return read_file(dirfd, name, out_size, TRUE, NULL);
+}
+
+void FreeFileContents(char *contents, size_t size) {
+  if (!contents)
+    return;
+
+  Memory_add(MEMORY_SEARCH_BUFFERS, -(gint64)(size + 1));
+  free(contents);
+  Budget_release(size + 1);
+}
+
+bool ReadFileEdgesAt(int dirfd, const char *name, size_t edge, char *buf,
+                     size_t *out_size, size_t *file_size) {
+  int fd = open_regular_at(dirfd, name, file_size);
+  if (fd < 0)
+    return false;
+
+  size_t bytes_read;
+  if (*file_size <= 2 * edge) {
+    bytes_read = read_at(fd, buf, *file_size, 0);
+  } else {
+    bytes_read = read_at(fd, buf, edge, 0);
+    bytes_read += read_at(fd, buf + bytes_read, edge,
+                          (off_t)(*file_size - edge));
+  }
+  close(fd);
+
+  *out_size = bytes_read;
+  return true;
+}
+
+bool ReadFileChunksAt(int dirfd, const char *name, char *buf,
+                      size_t buf_size, ReadChunkFunc func, void *user_data) {
+  size_t file_size;
+  int fd = open_regular_at(dirfd, name, &file_size);
+  if (fd < 0)
+    return false;
+
+  // Whole-file streaming: let the kernel read ahead aggressively
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  bool complete = true;
+  for (;;) {
+    ssize_t n = read(fd, buf, buf_size);
+    if (n < 0) {
+      complete = false;
+      break;
+    }
+    if (n == 0)
+      break;
+    if (!func(buf, (size_t)n, user_data)) {
+      complete = false;
+      break;
+    }
+  }
+  close(fd);
+  return complete;
+}
+
 // =============================
 // Cuda-Specific Operations
 // =============================
@@ -154,7 +216,7 @@ bool DoesFileExist(const char *filepath) {
 typedef struct {
   char **contents;
   size_t *sizes;
-  char **paths;
+  char **paths; // Entry names, relative to the searched directory
   int count;
   int capacity;
 } FileContentBatch;
@@ -179,85 +241,158 @@ static void resize_content_batch(FileContentBatch *batch) {
                          batch->capacity * sizeof(char *));    // size
 }
 
-static void free_content_batch(FileContentBatch *batch) {
-  if (!batch)
-    return;
-
+// Free the files but keep the arrays for the next batch
+static void clear_content_batch(FileContentBatch *batch) {
   for (int i = 0; i < batch->count; i++) {
-    free(batch->contents[i]);
+    FreeFileContents(batch->contents[i], batch->sizes[i]);
     free(batch->paths[i]);
   }
+  batch->count = 0;
+}
+
+static void free_content_batch(FileContentBatch *batch) {
+  if (!batch)
+    return;
 
+  clear_content_batch(batch);
   free(batch->contents);
   free(batch->sizes);
   free(batch->paths);
   free(batch);
 }
 
+// Run the batch kernel over the files read so far, then free them so the
+// next batch can draw from the budget again
+static bool search_content_batch(const char *pattern,
+                                 FileContentBatch *batch,
+                                 SearchStats *local) {
+  if (batch->count == 0)
+    return false;
+
+  guint64 scanned = 0;
+  for (int i = 0; i < batch->count; i++) {
+    scanned += batch->sizes[i];
+  }
+  Metrics_add(METRIC_FILES_SCANNED, batch->count);
+  Metrics_add(METRIC_BYTES_SCANNED, scanned);
+
+  TRACE_BEGIN(search_span);
+  gint64 match_start = g_get_monotonic_time();
+  bool found = cuda_batch_search(pattern,         // pattern
+                                 batch->contents, // file_contents
+                                 batch->count,    // file_count
+                                 batch->sizes);   // file_sizes
+  local->stage_us[SEARCH_STAGE_MATCH] += g_get_monotonic_time() - match_start;
+  local->bytes_scanned += scanned;
+  TRACE_END_COUNT(search_span, "search", batch->count);
+
+  clear_content_batch(batch);
+  return found;
+}
+
 bool cuda_search_files(const char *pattern, const char *directory) {
-  DIR *dir = opendir(directory);
-  if (!dir)
+  return cuda_search_files_cancellable(pattern, directory, NULL);
+}
+
+bool cuda_search_files_cancellable(const char *pattern, const char *directory,
+                                   GCancellable *cancellable) {
+  return cuda_search_files_stats(pattern, directory, cancellable, NULL);
+}
+
+bool cuda_search_files_stats(const char *pattern, const char *directory,
+                             GCancellable *cancellable, SearchStats *stats) {
+  TRACE_BEGIN(span);
+  gint64 start = g_get_monotonic_time();
+  SearchStats local = {0};
+  DirReader reader;
+  if (!DirReader_open(&reader, directory))
     return false;
 
   FileContentBatch *batch = create_content_batch(INITIAL_CAPACITY);
-  struct dirent *entry;
-  char full_path[MAX_PATH_LENGTH];
-  struct stat path_stat;
-
-  // Single pass with stat batching
-  while ((entry = readdir(dir)) != NULL) {
-    snprintf(full_path,       // str
-             MAX_PATH_LENGTH, // size
-             "%s/%s",         // format
-             directory,       // ...
-             entry->d_name);  // ...
+  DirReaderEntry entry;
+  bool found = false;
 
-    if (stat(full_path, &path_stat) != 0 || !S_ISREG(path_stat.st_mode)) {
-      continue;
+  // Single pass: d_type filters out non-files, fstat on the open fd sizes
+  // the buffer, so there is no per-entry path stat. Files are batched
+  // while the memory budget lets them stay; when the next one does not
+  // fit, the batch is searched and freed first. Time outside the reads
+  // and searches is the walk.
+  TRACE_BEGIN(walk_span);
+  gint64 io_us = 0;
+  int files = 0;
+  while (DirReader_next(&reader, &entry)) {
+    // A newer query replaced this one; stop reading files nobody will see
+    if (g_cancellable_is_cancelled(cancellable))
+      break;
+
+    local.entries++;
+    // Resolving costs a stat unless d_type settles it
+    if (entry.type == DIR_TYPE_UNKNOWN || entry.type == DIR_TYPE_LNK) {
+      local.stats++;
     }
-
-    // Pre-allocate based on file size
-    size_t file_size = path_stat.st_size;
-    if (file_size == 0)
+    if (DirReader_resolve_type(&reader, &entry) != DIR_TYPE_REG) {
+      Metrics_add(METRIC_FILES_SKIPPED, 1);
+      local.skipped_special++;
       continue;
+    }
 
-    FILE *file = fopen(full_path, "rb"); // Binary mode is faster
-    if (!file)
+    gint64 read_start = g_get_monotonic_time();
+    size_t file_size = 0;
+    gboolean over_budget = FALSE;
+    char *contents = read_file(reader.fd, entry.name, &file_size,
+                               batch->count == 0, &over_budget);
+    io_us += g_get_monotonic_time() - read_start;
+    local.stats++;
+    if (over_budget) {
+      found |= search_content_batch(pattern, batch, &local);
+
+      read_start = g_get_monotonic_time();
+      contents = ReadFileAt(reader.fd, entry.name, &file_size);
+      io_us += g_get_monotonic_time() - read_start;
+      local.stats++;
+    }
+    if (!contents) {
+      Metrics_add(METRIC_FILES_SKIPPED, 1);
+      local.skipped_unreadable++;
       continue;
+    }
+    local.files_read++;
+    local.bytes_read += file_size;
 
     if (batch->count >= batch->capacity) {
       resize_content_batch(batch);
     }
 
-    // Allocate exact size needed
-    batch->contents[batch->count] = malloc(file_size + 1); // size
-    if (!batch->contents[batch->count]) {
-      fclose(file);
-      continue;
-    }
-
-    size_t bytes_read = fread(batch->contents[batch->count], // ptr
-                              1,                             // size
-                              file_size,                     // nmemb
-                              file);                         // stream
-    batch->contents[batch->count][bytes_read] = '\0';
-    batch->sizes[batch->count] = bytes_read;
-    batch->paths[batch->count] = strdup(full_path);
-
-    fclose(file);
+    batch->contents[batch->count] = contents;
+    batch->sizes[batch->count] = file_size;
+    batch->paths[batch->count] = strdup(entry.name);
     batch->count++;
+    files++;
   }
-  closedir(dir);
+  DirReader_close(&reader);
+  TRACE_END_COUNT(walk_span, "walk", files);
 
-  // Perform CUDA batch search
-  bool found = false;
-  if (batch->count > 0) {
-    found = cuda_batch_search(pattern,         // pattern
-                              batch->contents, // file_contents
-                              batch->count,    // file_count
-                              batch->sizes);   // file_sizes
+  if (!g_cancellable_is_cancelled(cancellable)) {
+    found |= search_content_batch(pattern, batch, &local);
   }
+  local.stage_us[SEARCH_STAGE_IO] = io_us;
+  local.stage_us[SEARCH_STAGE_WALK] = g_get_monotonic_time() - start -
+                                      io_us -
+                                      local.stage_us[SEARCH_STAGE_MATCH];
 
   free_content_batch(batch);
+  TRACE_END(span, "cuda_search_files");
+
+  // Bytes per microsecond: MB/s
+  gint64 elapsed = g_get_monotonic_time() - start;
+  Metrics_record(METRIC_CONTENT_SEARCH_US, elapsed);
+  if (local.bytes_scanned > 0) {
+    Metrics_record(METRIC_SCAN_MBPS, local.bytes_scanned / MAX(elapsed, 1));
+  }
+
+  if (stats) {
+    local.total_us = elapsed;
+    SearchStats_merge(stats, &local);
+  }
   return found;
 }
@@ -0,0 +1,31 @@
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <string.h>
+
+#include "cuda/search_kernel.cuh"
+
+// Host implementation of search_kernel.cuh, linked instead of the CUDA
+// kernel when building with -Dcuda=false, so machines without a GPU still
+// run the application, the tests and the benchmarks
+
+int cuda_rabin_karp_search(const char *pattern, const char *text,
+                           unsigned long pattern_len,
+                           unsigned long text_len) {
+  if (pattern_len == 0 || pattern_len > text_len)
+    return 0;
+  return memmem(text, text_len, pattern, pattern_len) != NULL;
+}
+
+bool cuda_batch_search(const char *pattern, char **file_contents,
+                       int file_count, size_t *file_sizes) {
+  size_t pattern_len = strlen(pattern);
+
+  for (int i = 0; i < file_count; i++) {
+    if (cuda_rabin_karp_search(pattern,          // pattern
+                               file_contents[i], // text
+                               pattern_len,      // pattern_len
+                               file_sizes[i]))   // text_len
+      return true;
+  }
+  return false;
+}
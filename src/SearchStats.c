@@ -0,0 +1,121 @@
+#include "SearchStats.h"
+
+static const char *stage_names[SEARCH_STAGE_COUNT] = {
+    "walk",
+    "io",
+    "match",
+    "ui",
+};
+
+static void add(gint64 *slot, gint64 amount);
+static void append_skipped(GString *text, const char *reason, gint64 count,
+                           gboolean *first);
+
+void SearchStats_merge(SearchStats *into, const SearchStats *from) {
+  add(&into->entries, from->entries);
+  add(&into->stats, from->stats);
+  add(&into->files_read, from->files_read);
+  add(&into->bytes_read, from->bytes_read);
+  add(&into->bytes_scanned, from->bytes_scanned);
+  add(&into->skipped_special, from->skipped_special);
+  add(&into->skipped_unreadable, from->skipped_unreadable);
+  add(&into->skipped_ignored, from->skipped_ignored);
+  add(&into->skipped_cached, from->skipped_cached);
+  for (int s = 0; s < SEARCH_STAGE_COUNT; s++) {
+    add(&into->stage_us[s], from->stage_us[s]);
+  }
+  add(&into->total_us, from->total_us);
+}
+
+void SearchStats_add_time(SearchStats *stats, SearchStage stage, gint64 us) {
+  add(&stats->stage_us[stage], us);
+}
+
+const char *SearchStats_stage_name(SearchStage stage) {
+  return stage_names[stage];
+}
+
+gchar *SearchStats_format(const SearchStats *stats) {
+  gchar *read = g_format_size(stats->bytes_read);
+  gchar *scanned = g_format_size(stats->bytes_scanned);
+  GString *text = g_string_new(NULL);
+
+  g_string_append_printf(text,
+                         "%" G_GINT64_FORMAT " entries, %" G_GINT64_FORMAT
+                         " stats, %s read, %s scanned",
+                         stats->entries, stats->stats, read, scanned);
+
+  gint64 skipped = stats->skipped_special + stats->skipped_unreadable +
+                   stats->skipped_ignored + stats->skipped_cached;
+  if (skipped > 0) {
+    gboolean first = TRUE;
+    g_string_append_printf(text, ", %" G_GINT64_FORMAT " skipped (",
+                           skipped);
+    append_skipped(text, "special", stats->skipped_special, &first);
+    append_skipped(text, "unreadable", stats->skipped_unreadable, &first);
+    append_skipped(text, "ignored", stats->skipped_ignored, &first);
+    append_skipped(text, "cached", stats->skipped_cached, &first);
+    g_string_append_c(text, ')');
+  }
+
+  for (int s = 0; s < SEARCH_STAGE_COUNT; s++) {
+    g_string_append_printf(text, "%s%s %.1f ms", s ? ", " : "; ",
+                           stage_names[s], stats->stage_us[s] / 1000.0);
+  }
+  g_string_append_printf(text, "; %.1f ms total", stats->total_us / 1000.0);
+
+  g_free(read);
+  g_free(scanned);
+  return g_string_free(text, FALSE);
+}
+
+gchar *SearchStats_to_json(const SearchStats *stats) {
+  GString *json = g_string_new(NULL);
+
+  g_string_append_printf(
+      json,
+      "{\"entries\":%" G_GINT64_FORMAT ",\"stats\":%" G_GINT64_FORMAT
+      ",\"files_read\":%" G_GINT64_FORMAT ",\"bytes_read\":%" G_GINT64_FORMAT
+      ",\"bytes_scanned\":%" G_GINT64_FORMAT,
+      stats->entries, stats->stats, stats->files_read, // counts
+      stats->bytes_read, stats->bytes_scanned);        // bytes
+  g_string_append_printf(
+      json,
+      ",\"skipped\":{\"special\":%" G_GINT64_FORMAT
+      ",\"unreadable\":%" G_GINT64_FORMAT ",\"ignored\":%" G_GINT64_FORMAT
+      ",\"cached\":%" G_GINT64_FORMAT "}",
+      stats->skipped_special, stats->skipped_unreadable, // files
+      stats->skipped_ignored, stats->skipped_cached);    // entries, files
+
+  g_string_append(json, ",\"stage_us\":{");
+  for (int s = 0; s < SEARCH_STAGE_COUNT; s++) {
+    g_string_append_printf(json, "%s\"%s\":%" G_GINT64_FORMAT,
+                           s ? "," : "",        // separator
+                           stage_names[s],      // name
+                           stats->stage_us[s]); // value
+  }
+  g_string_append_printf(json, "},\"total_us\":%" G_GINT64_FORMAT "}",
+                         stats->total_us);
+
+  return g_string_free(json, FALSE);
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static void add(gint64 *slot, gint64 amount) {
+  if (amount != 0) {
+    __atomic_fetch_add(slot, amount, __ATOMIC_RELAXED);
+  }
+}
+
+static void append_skipped(GString *text, const char *reason, gint64 count,
+                           gboolean *first) {
+  if (count == 0)
+    return;
+
+  g_string_append_printf(text, "%s%" G_GINT64_FORMAT " %s",
+                         *first ? "" : ", ", count, reason);
+  *first = FALSE;
+}
@@ -0,0 +1,587 @@
+#define _DEFAULT_SOURCE
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES ((64 + RADIX_BITS - 1) / RADIX_BITS)
+#define INSERTION_SORT_THRESHOLD 16
+#define INITIAL_KEY_ARENA_SIZE 4096
+
+#include "Sort.h"
+#include "DirReader.h"
+#include "Memory.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+  DirListing *listing;       // Held until the callback has run
+  DirListing *source;        // Stat'ed listing to copy from, or NULL; held
+  GCancellable *cancellable; // The group's token, checked between entries
+  uint64_t *sizes;           // Columns being filled on the worker
+  int64_t *mtimes;           // Same
+  gboolean loaded;           // Every entry was stat'ed or copied
+  DirListingStatsFunc func;  // Completion callback
+  gpointer user_data;        // Callback data
+} StatsTask;
+
+static gboolean read_stats(const DirListing *listing, const DirListing *source,
+                           GCancellable *cancellable, uint64_t *sizes,
+                           int64_t *mtimes);
+static GHashTable *index_names(const DirListing *listing);
+static void install_stats(DirListing *listing, uint64_t *sizes,
+                          int64_t *mtimes);
+static void stats_task(gpointer data);
+static void stats_done(gpointer data, gboolean cancelled);
+static void build_collate_keys(DirListing *listing, const DirListing *source,
+                               const int *source_index, int kept_count);
+static void string_sort(guint32 *order, int count, char *const *keys,
+                        size_t depth);
+static void set_ranks_from_order(DirListing *listing, const guint32 *order);
+static gboolean fill_sort_keys(DirListing *listing, SortKey key,
+                               uint64_t *keys);
+static void radix_sort(guint32 *order, int count, const uint64_t *keys);
+static void partition_directories(const DirListing *listing, guint32 *order);
+
+guint32 *DirListing_sort(DirListing *listing, const SortSpec *spec) {
+  g_return_val_if_fail(listing != NULL && spec != NULL, NULL);
+
+  int count = listing->count;
+  guint32 *order = g_new(guint32, count + 1);
+
+  // Name order is the base every other key sorts stably on top of
+  DirListing_ensure_name_order(listing);
+  for (int i = 0; i < count; i++) {
+    order[listing->name_ranks[i]] = (guint32)i;
+  }
+
+  if (spec->key == SORT_BY_NAME) {
+    if (spec->descending) {
+      for (int i = 0, j = count - 1; i < j; i++, j--) {
+        guint32 tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+      }
+    }
+  } else {
+    uint64_t *keys = malloc(count * sizeof(uint64_t) + 1);
+
+    // Descending inverts the key, not the order, so ties stay A to Z
+    if (fill_sort_keys(listing, spec->key, keys)) {
+      if (spec->descending) {
+        for (int i = 0; i < count; i++) {
+          keys[i] = ~keys[i];
+        }
+      }
+      radix_sort(order, count, keys);
+    }
+    free(keys);
+  }
+
+  if (spec->directories_first) {
+    partition_directories(listing, order);
+  }
+
+  return order;
+}
+
+void DirListing_ensure_name_order(DirListing *listing) {
+  if (!listing || listing->name_ranks)
+    return;
+
+  if (!listing->collate_keys) {
+    build_collate_keys(listing, NULL, NULL, 0);
+  }
+
+  guint32 *order = malloc(listing->count * sizeof(guint32) + 1);
+  for (int i = 0; i < listing->count; i++) {
+    order[i] = (guint32)i;
+  }
+  string_sort(order, listing->count, listing->collate_keys, 0);
+
+  set_ranks_from_order(listing, order);
+  free(order);
+}
+
+gboolean DirListing_ensure_stats(DirListing *listing) {
+  if (!listing)
+    return FALSE;
+  if (listing->sizes)
+    return TRUE;
+
+  uint64_t *sizes = malloc(listing->count * sizeof(uint64_t) + 1);
+  int64_t *mtimes = malloc(listing->count * sizeof(int64_t) + 1);
+  if (!read_stats(listing, NULL, NULL, sizes, mtimes)) {
+    free(sizes);
+    free(mtimes);
+    return FALSE;
+  }
+  install_stats(listing, sizes, mtimes);
+  return TRUE;
+}
+
+void DirListing_load_stats(DirListing *listing, DirListing *source,
+                           SchedulerGroup *group, DirListingStatsFunc func,
+                           gpointer user_data) {
+  StatsTask *task = g_new0(StatsTask, 1);
+  task->listing = DirListing_ref(listing);
+  if (source && source->sizes && source != listing) {
+    task->source = DirListing_ref(source);
+  }
+  task->cancellable = g_object_ref(group->cancellable);
+  task->func = func;
+  task->user_data = user_data;
+
+  // Loaded already, e.g. by an earlier pass: only the callback is left
+  task->loaded = listing->sizes != NULL;
+  if (!task->loaded) {
+    task->sizes = malloc(listing->count * sizeof(uint64_t) + 1);
+    task->mtimes = malloc(listing->count * sizeof(int64_t) + 1);
+  }
+  Scheduler_push_full(group, stats_task, stats_done, task);
+}
+
+gboolean SortKey_needs_stats(SortKey key) {
+  return key == SORT_BY_SIZE || key == SORT_BY_MTIME;
+}
+
+void DirListing_inherit_name_order(DirListing *patched,
+                                   const DirListing *source,
+                                   const int *source_index, int kept_count) {
+  if (!patched || !source || !source->name_ranks || !source->collate_keys)
+    return;
+
+  build_collate_keys(patched, source, source_index, kept_count);
+
+  // Kept entries, in the order they had in the source
+  int *by_source_rank = malloc(source->count * sizeof(int) + 1);
+  for (int r = 0; r < source->count; r++) {
+    by_source_rank[r] = -1;
+  }
+  for (int i = 0; i < kept_count; i++) {
+    by_source_rank[source->name_ranks[source_index[i]]] = i;
+  }
+
+  guint32 *kept = malloc(kept_count * sizeof(guint32) + 1);
+  int kept_len = 0;
+  for (int r = 0; r < source->count; r++) {
+    if (by_source_rank[r] >= 0) {
+      kept[kept_len++] = (guint32)by_source_rank[r];
+    }
+  }
+  free(by_source_rank);
+
+  // New entries are few: sort just them, then merge the two runs
+  int added_count = patched->count - kept_count;
+  guint32 *added = malloc(added_count * sizeof(guint32) + 1);
+  for (int i = 0; i < added_count; i++) {
+    added[i] = (guint32)(kept_count + i);
+  }
+  string_sort(added, added_count, patched->collate_keys, 0);
+
+  guint32 *order = malloc(patched->count * sizeof(guint32) + 1);
+  int k = 0, a = 0, out = 0;
+  while (k < kept_len && a < added_count) {
+    if (strcmp(patched->collate_keys[added[a]],
+               patched->collate_keys[kept[k]]) < 0) {
+      order[out++] = added[a++];
+    } else {
+      order[out++] = kept[k++];
+    }
+  }
+  while (k < kept_len) {
+    order[out++] = kept[k++];
+  }
+  while (a < added_count) {
+    order[out++] = added[a++];
+  }
+
+  set_ranks_from_order(patched, order);
+  free(order);
+  free(added);
+  free(kept);
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+// Follow links, but a dangling one still reports itself. Entries the source
+// has under the same name and inode keep its values; a pass of a directory
+// that was only patched meanwhile thus stats just the new entries.
+static gboolean read_stats(const DirListing *listing, const DirListing *source,
+                           GCancellable *cancellable, uint64_t *sizes,
+                           int64_t *mtimes) {
+  int dirfd = open(listing->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirfd < 0)
+    return FALSE;
+
+  GHashTable *source_index = source ? index_names(source) : NULL;
+  gboolean completed = TRUE;
+  for (int i = 0; i < listing->count; i++) {
+    DirReaderStat st;
+
+    if (g_cancellable_is_cancelled(cancellable)) {
+      completed = FALSE;
+      break;
+    }
+    int j = -1;
+    if (source_index) {
+      gpointer found = g_hash_table_lookup(source_index, listing->names[i]);
+      j = GPOINTER_TO_INT(found) - 1;
+    }
+    if (j >= 0 && source->inodes[j] == listing->inodes[i]) {
+      sizes[i] = source->sizes[j];
+      mtimes[i] = source->mtimes[j];
+    } else if (DirReader_stat_at(dirfd, listing->names[i], true, &st) ||
+               DirReader_stat_at(dirfd, listing->names[i], false, &st)) {
+      sizes[i] = st.size;
+      mtimes[i] = st.mtime_sec;
+    } else {
+      sizes[i] = 0;
+      mtimes[i] = 0;
+    }
+  }
+  if (source_index) {
+    g_hash_table_destroy(source_index);
+  }
+  close(dirfd);
+  return completed;
+}
+
+// Name to index + 1, so that a miss reads as -1
+static GHashTable *index_names(const DirListing *listing) {
+  GHashTable *index = g_hash_table_new(g_str_hash, g_str_equal);
+  for (int i = 0; i < listing->count; i++) {
+    g_hash_table_insert(index, listing->names[i], GINT_TO_POINTER(i + 1));
+  }
+  return index;
+}
+
+static void install_stats(DirListing *listing, uint64_t *sizes,
+                          int64_t *mtimes) {
+  listing->sizes = sizes;
+  listing->mtimes = mtimes;
+
+  gsize column_bytes = listing->count * (sizeof(uint64_t) + sizeof(int64_t));
+  listing->memory_bytes += column_bytes;
+  Memory_add(MEMORY_LISTING, column_bytes);
+}
+
+// Worker thread: only the task's own columns are written
+static void stats_task(gpointer data) {
+  StatsTask *task = (StatsTask *)data;
+  if (task->sizes) {
+    task->loaded = read_stats(task->listing, task->source, task->cancellable,
+                              task->sizes, task->mtimes);
+  }
+}
+
+// Main loop. Another pass may have filled the listing in meanwhile.
+static void stats_done(gpointer data, gboolean cancelled) {
+  StatsTask *task = (StatsTask *)data;
+  DirListing *listing = task->listing;
+
+  if (task->sizes && task->loaded && !listing->sizes) {
+    install_stats(listing, task->sizes, task->mtimes);
+  } else {
+    free(task->sizes);
+    free(task->mtimes);
+  }
+  if (!cancelled) {
+    task->func(listing, task->user_data);
+  }
+  if (task->source) {
+    DirListing_unref(task->source);
+  }
+  g_object_unref(task->cancellable);
+  DirListing_unref(listing);
+  g_free(task);
+}
+
+// Keys are packed into one arena like the names; kept entries of a patched
+// listing copy theirs from the source instead of collating again
+static void build_collate_keys(DirListing *listing, const DirListing *source,
+                               const int *source_index, int kept_count) {
+  size_t capacity = INITIAL_KEY_ARENA_SIZE;
+  size_t len = 0;
+  char *arena = malloc(capacity);
+  size_t *offsets = malloc(listing->count * sizeof(size_t) + 1);
+
+  for (int i = 0; i < listing->count; i++) {
+    gchar *computed = NULL;
+    const char *key;
+
+    if (i < kept_count) {
+      key = source->collate_keys[source_index[i]];
+    } else {
+      // Collation needs UTF-8; undecodable bytes become U+FFFD
+      gchar *valid = g_utf8_make_valid(listing->names[i], -1);
+      key = computed = g_utf8_collate_key_for_filename(valid, -1);
+      g_free(valid);
+    }
+
+    size_t key_len = strlen(key) + 1;
+    while (len + key_len > capacity) {
+      capacity *= 2;
+      arena = realloc(arena, capacity);
+    }
+    memcpy(arena + len, key, key_len);
+    offsets[i] = len;
+    len += key_len;
+    g_free(computed);
+  }
+
+  listing->collate_keys = malloc(listing->count * sizeof(char *) + 1);
+  for (int i = 0; i < listing->count; i++) {
+    listing->collate_keys[i] = arena + offsets[i];
+  }
+  free(offsets);
+
+  listing->collate_arena = arena;
+  gsize key_bytes = capacity + listing->count * sizeof(char *);
+  listing->memory_bytes += key_bytes;
+  listing->index_bytes += key_bytes;
+  Memory_add(MEMORY_INDEXES, key_bytes);
+}
+
+static inline void swap_indices(guint32 *order, int i, int j) {
+  guint32 tmp = order[i];
+  order[i] = order[j];
+  order[j] = tmp;
+}
+
+#define KEY_CHAR(order, i, depth) ((unsigned char)keys[(order)[i]][depth])
+
+// Three-way radix quicksort (Bentley-Sedgewick) of indices by their
+// NUL-terminated keys: partitions on one byte at a time, so a shared prefix
+// is compared once instead of once per comparison
+static void string_sort(guint32 *order, int count, char *const *keys,
+                        size_t depth) {
+  while (count > INSERTION_SORT_THRESHOLD) {
+    // Median of three as the pivot, moved to the front
+    int mid = count / 2;
+    if (KEY_CHAR(order, mid, depth) < KEY_CHAR(order, 0, depth))
+      swap_indices(order, mid, 0);
+    if (KEY_CHAR(order, count - 1, depth) < KEY_CHAR(order, 0, depth))
+      swap_indices(order, count - 1, 0);
+    if (KEY_CHAR(order, count - 1, depth) < KEY_CHAR(order, mid, depth))
+      swap_indices(order, count - 1, mid);
+    swap_indices(order, 0, mid);
+
+    int pivot = KEY_CHAR(order, 0, depth);
+    int lt = 0, i = 1, gt = count - 1;
+    while (i <= gt) {
+      int c = KEY_CHAR(order, i, depth);
+      if (c < pivot) {
+        swap_indices(order, lt++, i++);
+      } else if (c > pivot) {
+        swap_indices(order, i, gt--);
+      } else {
+        i++;
+      }
+    }
+
+    // [0, lt) < pivot, [lt, gt] == pivot, (gt, count) > pivot
+    string_sort(order, lt, keys, depth);
+    if (pivot != 0) {
+      string_sort(order + lt, gt - lt + 1, keys, depth + 1);
+    }
+
+    order += gt + 1;
+    count -= gt + 1;
+  }
+
+  for (int i = 1; i < count; i++) {
+    guint32 current = order[i];
+    int j = i;
+    while (j > 0 &&
+           strcmp(keys[order[j - 1]] + depth, keys[current] + depth) > 0) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = current;
+  }
+}
+
+static void set_ranks_from_order(DirListing *listing, const guint32 *order) {
+  listing->name_ranks = malloc(listing->count * sizeof(guint32) + 1);
+  for (int r = 0; r < listing->count; r++) {
+    listing->name_ranks[order[r]] = (guint32)r;
+  }
+  gsize rank_bytes = listing->count * sizeof(guint32);
+  listing->memory_bytes += rank_bytes;
+  listing->index_bytes += rank_bytes;
+  Memory_add(MEMORY_INDEXES, rank_bytes);
+}
+
+// Text after the last '.', or "" for none (a leading dot does not count)
+static const char *extension_of(const char *name) {
+  const char *dot = strrchr(name, '.');
+  return (dot && dot != name) ? dot + 1 : "";
+}
+
+static guint extension_hash(gconstpointer key) {
+  guint hash = 5381;
+  for (const char *p = key; *p; p++) {
+    hash = hash * 33 + (guchar)g_ascii_tolower(*p);
+  }
+  return hash;
+}
+
+static gboolean extension_equal(gconstpointer a, gconstpointer b) {
+  return g_ascii_strcasecmp(a, b) == 0;
+}
+
+static gint compare_strings(gconstpointer a, gconstpointer b) {
+  return strcmp(*(const char **)a, *(const char **)b);
+}
+
+static gint compare_extensions(gconstpointer a, gconstpointer b) {
+  return g_ascii_strcasecmp(*(const char **)a, *(const char **)b);
+}
+
+// Turn a per-entry string column into dense ranks: distinct values are few
+// (content types, extensions), so only they are sorted
+static void rank_strings(const char **values, int count, GHashFunc hash,
+                         GEqualFunc equal, GCompareFunc compare,
+                         uint64_t *keys) {
+  GHashTable *ranks = g_hash_table_new(hash, equal);
+  GPtrArray *distinct = g_ptr_array_new();
+
+  for (int i = 0; i < count; i++) {
+    if (!g_hash_table_contains(ranks, values[i])) {
+      g_hash_table_add(ranks, (gpointer)values[i]);
+      g_ptr_array_add(distinct, (gpointer)values[i]);
+    }
+  }
+
+  g_ptr_array_sort(distinct, compare);
+  for (guint r = 0; r < distinct->len; r++) {
+    g_hash_table_insert(ranks, g_ptr_array_index(distinct, r),
+                        GUINT_TO_POINTER(r));
+  }
+
+  for (int i = 0; i < count; i++) {
+    keys[i] = GPOINTER_TO_UINT(g_hash_table_lookup(ranks, values[i]));
+  }
+
+  g_ptr_array_free(distinct, TRUE);
+  g_hash_table_destroy(ranks);
+}
+
+// Map the chosen key to unsigned integers whose order is the sort order
+static gboolean fill_sort_keys(DirListing *listing, SortKey key,
+                               uint64_t *keys) {
+  int count = listing->count;
+
+  switch (key) {
+  case SORT_BY_SIZE:
+    if (!DirListing_ensure_stats(listing))
+      return FALSE;
+    memcpy(keys, listing->sizes, count * sizeof(uint64_t));
+    return TRUE;
+
+  case SORT_BY_MTIME:
+    if (!DirListing_ensure_stats(listing))
+      return FALSE;
+    // Flip the sign bit so signed times order correctly as unsigned
+    for (int i = 0; i < count; i++) {
+      keys[i] = (uint64_t)listing->mtimes[i] ^ (UINT64_C(1) << 63);
+    }
+    return TRUE;
+
+  case SORT_BY_TYPE:
+    // Content types are interned, so pointers compare as strings do
+    rank_strings(listing->content_types, count, g_direct_hash, g_direct_equal,
+                 compare_strings, keys);
+    return TRUE;
+
+  case SORT_BY_EXTENSION: {
+    const char **extensions = malloc(count * sizeof(char *) + 1);
+    for (int i = 0; i < count; i++) {
+      extensions[i] = extension_of(listing->names[i]);
+    }
+    rank_strings(extensions, count, extension_hash, extension_equal,
+                 compare_extensions, keys);
+    free(extensions);
+    return TRUE;
+  }
+
+  default:
+    return FALSE;
+  }
+}
+
+// Stable LSD radix sort of indices by keys[index]. Digit histograms are
+// built in one pass up front, and digits every key shares are skipped, so
+// small values (type ranks, sizes) take only a pass or two
+static void radix_sort(guint32 *order, int count, const uint64_t *keys) {
+  if (count < 2)
+    return;
+
+  size_t(*histograms)[RADIX_BUCKETS] =
+      calloc(RADIX_PASSES, sizeof(*histograms));
+  for (int i = 0; i < count; i++) {
+    uint64_t key = keys[i];
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+      histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+  }
+
+  guint32 *scratch = malloc(count * sizeof(guint32));
+  guint32 *src = order;
+  guint32 *dst = scratch;
+
+  for (int pass = 0; pass < RADIX_PASSES; pass++) {
+    int shift = pass * RADIX_BITS;
+    size_t *offsets = histograms[pass];
+
+    if (offsets[(keys[src[0]] >> shift) & (RADIX_BUCKETS - 1)] ==
+        (size_t)count)
+      continue;
+
+    size_t total = 0;
+    for (int b = 0; b < RADIX_BUCKETS; b++) {
+      size_t bucket = offsets[b];
+      offsets[b] = total;
+      total += bucket;
+    }
+
+    for (int i = 0; i < count; i++) {
+      guint32 index = src[i];
+      dst[offsets[(keys[index] >> shift) & (RADIX_BUCKETS - 1)]++] = index;
+    }
+
+    guint32 *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != order) {
+    memcpy(order, src, count * sizeof(guint32));
+  }
+  free(scratch);
+  free(histograms);
+}
+
+// Stable partition: folders first, each group keeping its order
+static void partition_directories(const DirListing *listing, guint32 *order) {
+  int count = listing->count;
+  guint32 *scratch = malloc(count * sizeof(guint32) + 1);
+  int out = 0;
+
+  for (int i = 0; i < count; i++) {
+    if (listing->types[order[i]] == DIR_TYPE_DIR) {
+      scratch[out++] = order[i];
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    if (listing->types[order[i]] != DIR_TYPE_DIR) {
+      scratch[out++] = order[i];
+    }
+  }
+
+  memcpy(order, scratch, count * sizeof(guint32));
+  free(scratch);
+}
@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include "Trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  const char *name; // String literal
+  gint64 start;     // Trace_clock() at the start
+  gint64 duration;  // Nanoseconds
+  gint64 count;     // Items handled, -1 if none
+} TraceEvent;
+
+// Spans of one thread. Only that thread writes; Trace_stop reads.
+typedef struct {
+  TraceEvent events[TRACE_RING_EVENTS];
+  gint written;    // Spans ever recorded; wraps, the ring size divides 2^32
+  int tid;         // Kernel thread id
+  char thread[16]; // Thread name at its first span
+} TraceRing;
+
+gboolean Trace_recording = FALSE;
+
+static GMutex rings_lock;
+static GPtrArray *rings;   // Every thread's ring, kept for the process
+static GPrivate ring_key;  // Calling thread's ring
+static gchar *output_path; // Written by Trace_stop
+static gint64 epoch;       // Trace_clock() at Trace_start
+
+static TraceRing *thread_ring(void);
+static void begin_event(FILE *out, gboolean *first);
+static void write_thread_name(FILE *out, const TraceRing *ring, int pid,
+                              gboolean *first);
+static void write_events(FILE *out, TraceRing *ring, int pid,
+                         gboolean *first);
+
+gint64 Trace_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (gint64)now.tv_sec * G_GINT64_CONSTANT(1000000000) + now.tv_nsec;
+}
+
+void Trace_span(const char *name, gint64 start, gint64 count) {
+  if (!Trace_recording)
+    return;
+
+  gint64 end = Trace_clock();
+  TraceRing *ring = thread_ring();
+  guint slot = (guint)ring->written % TRACE_RING_EVENTS;
+
+  ring->events[slot].name = name;
+  ring->events[slot].start = start;
+  ring->events[slot].duration = end - start;
+  ring->events[slot].count = count;
+
+  // Publishes the slot to Trace_stop
+  g_atomic_int_inc(&ring->written);
+}
+
+void Trace_start(const char *path) {
+  g_mutex_lock(&rings_lock);
+  if (!rings) {
+    rings = g_ptr_array_new();
+  }
+  g_free(output_path);
+  output_path = g_strdup(path);
+  epoch = Trace_clock();
+  g_mutex_unlock(&rings_lock);
+
+  g_atomic_int_set(&Trace_recording, TRUE);
+}
+
+void Trace_setup(int *argc, char **argv) {
+  const char *path = g_getenv(TRACE_ENV);
+  int kept = 1;
+
+  for (int i = 1; i < *argc; i++) {
+    if (g_str_has_prefix(argv[i], "--trace=")) {
+      path = argv[i] + strlen("--trace=");
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < *argc) {
+      path = argv[++i];
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argv[kept] = NULL;
+  *argc = kept;
+
+  if (path && *path) {
+    Trace_start(path);
+  }
+}
+
+gboolean Trace_stop(void) {
+  if (!g_atomic_int_get(&Trace_recording))
+    return TRUE;
+  g_atomic_int_set(&Trace_recording, FALSE);
+
+  g_mutex_lock(&rings_lock);
+  FILE *out = fopen(output_path, "w");
+  if (!out) {
+    g_printerr("Cannot write trace %s\n", output_path);
+    g_mutex_unlock(&rings_lock);
+    return FALSE;
+  }
+
+  int pid = getpid();
+  gboolean first = TRUE;
+  fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (guint i = 0; i < rings->len; i++) {
+    write_thread_name(out, g_ptr_array_index(rings, i), pid, &first);
+  }
+  for (guint i = 0; i < rings->len; i++) {
+    write_events(out, g_ptr_array_index(rings, i), pid, &first);
+  }
+  fprintf(out, "\n]}\n");
+
+  gboolean written = fclose(out) == 0;
+  g_mutex_unlock(&rings_lock);
+  return written;
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+// The calling thread's ring, registered on its first span
+static TraceRing *thread_ring(void) {
+  TraceRing *ring = g_private_get(&ring_key);
+  if (ring)
+    return ring;
+
+  ring = g_new0(TraceRing, 1);
+  ring->tid = (int)syscall(SYS_gettid);
+  prctl(PR_GET_NAME, ring->thread, 0, 0, 0);
+  g_private_set(&ring_key, ring);
+
+  g_mutex_lock(&rings_lock);
+  g_ptr_array_add(rings, ring);
+  g_mutex_unlock(&rings_lock);
+  return ring;
+}
+
+static void begin_event(FILE *out, gboolean *first) {
+  fputs(*first ? "\n" : ",\n", out);
+  *first = FALSE;
+}
+
+static void write_thread_name(FILE *out, const TraceRing *ring, int pid,
+                              gboolean *first) {
+  char name[sizeof(ring->thread)];
+  memcpy(name, ring->thread, sizeof(name));
+  name[sizeof(name) - 1] = '\0';
+
+  // Names come from the kernel: keep them inside the JSON string
+  for (char *p = name; *p; p++) {
+    if (*p == '"' || *p == '\\' || (unsigned char)*p < 0x20)
+      *p = '_';
+  }
+  begin_event(out, first);
+  fprintf(out,
+          "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+          "\"args\":{\"name\":\"%s\"}}",
+          pid, ring->tid, name);
+}
+
+// The ring's spans, oldest first, then empty it for the next recording
+static void write_events(FILE *out, TraceRing *ring, int pid,
+                         gboolean *first) {
+  guint written = (guint)g_atomic_int_get(&ring->written);
+  guint oldest = written > TRACE_RING_EVENTS ? written - TRACE_RING_EVENTS : 0;
+
+  for (guint i = oldest; i < written; i++) {
+    const TraceEvent *event = &ring->events[i % TRACE_RING_EVENTS];
+    begin_event(out, first);
+    fprintf(out,
+            "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,"
+            "\"ts\":%.3f,\"dur\":%.3f",
+            event->name, pid, ring->tid,     // name, pid, tid
+            (event->start - epoch) / 1000.0, // ts
+            event->duration / 1000.0);       // dur
+    if (event->count >= 0) {
+      fprintf(out, ",\"args\":{\"count\":%" G_GINT64_FORMAT "}",
+              event->count);
+    }
+    fputc('}', out);
+  }
+  g_atomic_int_set(&ring->written, 0);
+}
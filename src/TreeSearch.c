@@ -0,0 +1,172 @@
+#define _GNU_SOURCE
+#include "TreeSearch.h"
+#include "DirReader.h"
+#include "Listing.h"
+
+#include <string.h>
+
+typedef struct {
+  ResultNode node;
+  GIcon *icon;
+  unsigned char type;
+  guint hits;
+  char path[]; // Relative path, NUL-terminated
+} TreeResult;
+
+static void visit_entry(const TreeWalkEntry *entry, gpointer user_data);
+static void account_io(TreeSearch *search, const QueryEntry *candidate);
+static void walk_done(const SearchStats *stats, gpointer user_data);
+static void deliver_matches(ResultNode **items, guint count,
+                            gboolean finished, gpointer user_data);
+static void unref_search(TreeSearch *search);
+
+TreeSearch *TreeSearch_start(const char *root, Query *query,
+                             TreeWalkFlags flags, const char *ignore,
+                             guint max_results, GCancellable *cancellable,
+                             TreeSearchFunc func, gpointer user_data) {
+  TreeSearch *search = g_new0(TreeSearch, 1);
+  search->query = query;
+  search->max_results = max_results;
+  search->group = SchedulerGroup_new(SCHEDULER_USER_INITIATED, cancellable);
+  search->func = func;
+  search->user_data = user_data;
+  search->started_at = g_get_monotonic_time();
+
+  // The stream's initial unit of work is the walk; the walk holds a
+  // reference until it is done
+  search->ref_count = 2;
+  search->stream =
+      ResultStream_new(TREE_SEARCH_BATCH, deliver_matches, search);
+  search->walk = TreeWalk_start(root,                       // root
+                                ignore,                     // ignore
+                                flags,                      // flags
+                                search->group->cancellable, // cancellable
+                                visit_entry,                // visit
+                                walk_done,                  // done
+                                search);                    // user_data
+  return search;
+}
+
+void TreeSearch_stop(TreeSearch *search) {
+  if (!search)
+    return;
+
+  if (!search->stream->done) {
+    SchedulerGroup_cancel(search->group);
+  }
+  ResultStream_close(search->stream);
+  unref_search(search);
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+static void unref_search(TreeSearch *search) {
+  if (!g_atomic_int_dec_and_test(&search->ref_count))
+    return;
+
+  TreeWalk_unref(search->walk);
+  ResultStream_free(search->stream);
+  SchedulerGroup_unref(search->group);
+  Query_free(search->query);
+  g_free(search);
+}
+
+// Worker threads: the query's cheap terms reject most entries before any
+// stat or read, and only matches build a path or look up an icon
+static void visit_entry(const TreeWalkEntry *entry, gpointer user_data) {
+  TreeSearch *search = (TreeSearch *)user_data;
+  QueryEntry candidate;
+
+  QueryEntry_init(&candidate, entry->dir_path, entry->name, entry->type,
+                  entry->dirfd);
+  gboolean matches = Query_matches(search->query, &candidate);
+  guint hits = candidate.hits;
+  if (candidate.stat_done || candidate.read_done) {
+    account_io(search, &candidate);
+  }
+  QueryEntry_clear(&candidate);
+  if (!matches)
+    return;
+
+  guint earlier = (guint)g_atomic_int_add(&search->match_count, 1);
+  if (search->max_results && earlier >= search->max_results) {
+    g_atomic_int_set(&search->truncated, TRUE);
+    SchedulerGroup_cancel(search->group);
+    return;
+  }
+
+  gchar *path = TreeWalk_join(entry->dir_path, entry->name);
+  gsize path_len = strlen(path);
+  TreeResult *result = g_malloc(sizeof(TreeResult) + path_len + 1);
+  memcpy(result->path, path, path_len + 1);
+  g_free(path);
+
+  const char *content_type;
+  result->type = entry->type;
+  result->hits = hits;
+  result->icon =
+      DirListing_type_for_entry(entry->name, entry->type, &content_type);
+  ResultStream_push(search->stream, &result->node,
+                    sizeof(TreeResult) + path_len + 1);
+}
+
+// Entries the name terms rejected cost nothing here: only stats and reads
+// are counted per entry
+static void account_io(TreeSearch *search, const QueryEntry *candidate) {
+  SearchStats local = {0};
+
+  local.stats = candidate->stat_done + candidate->read_done;
+  local.stage_us[SEARCH_STAGE_IO] = candidate->io_us;
+  if (candidate->read_done && candidate->contents) {
+    local.files_read = 1;
+    local.bytes_read = candidate->size;
+    local.bytes_scanned = candidate->size;
+  } else if (candidate->read_done) {
+    local.skipped_unreadable = 1;
+  }
+  SearchStats_merge(&search->stats, &local);
+}
+
+static void walk_done(const SearchStats *stats, gpointer user_data) {
+  TreeSearch *search = (TreeSearch *)user_data;
+
+  // The walk timed every visit as matching, stats and reads included
+  SearchStats_merge(&search->stats, stats);
+  search->stats.stage_us[SEARCH_STAGE_MATCH] -=
+      search->stats.stage_us[SEARCH_STAGE_IO];
+
+  ResultStream_work_done(search->stream);
+  unref_search(search);
+}
+
+static void deliver_matches(ResultNode **items, guint count,
+                            gboolean finished, gpointer user_data) {
+  TreeSearch *search = (TreeSearch *)user_data;
+  TreeMatch matches[TREE_SEARCH_BATCH];
+
+  for (guint i = 0; i < count; i++) {
+    TreeResult *result = (TreeResult *)items[i];
+    matches[i].path = result->path;
+    matches[i].icon = result->icon;
+    matches[i].type = result->type;
+    matches[i].hits = result->hits;
+  }
+
+  gint64 ui_start = g_get_monotonic_time();
+  if (finished) {
+    search->stats.total_us = ui_start - search->started_at;
+  }
+
+  // The callback may stop the search: hold it until the time is added.
+  // The results are ours to free.
+  g_atomic_int_inc(&search->ref_count);
+  search->func(matches, count, finished, search->user_data);
+  SearchStats_add_time(&search->stats, SEARCH_STAGE_UI,
+                       g_get_monotonic_time() - ui_start);
+  unref_search(search);
+  for (guint i = 0; i < count; i++) {
+    g_free(items[i]);
+  }
+}
@@ -0,0 +1,159 @@
+#define _GNU_SOURCE
+#include "TreeWalk.h"
+#include "DirReader.h"
+#include "Metrics.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef struct {
+  TreeWalk *walk;     // Holds a reference
+  gchar *path;        // Directory relative to the root, "" for the root
+  IgnoreRules *rules; // Rules of the parent directory, NULL if none
+} TreeWalkTask;
+
+static void walk_directory(gpointer data);
+static void queue_directory(TreeWalk *walk, gchar *path, IgnoreRules *rules);
+static void finish_directory(TreeWalk *walk);
+
+TreeWalk *TreeWalk_start(const char *root, const char *ignore,
+                         TreeWalkFlags flags, GCancellable *cancellable,
+                         TreeWalkVisitFunc visit, TreeWalkDoneFunc done,
+                         gpointer user_data) {
+  TreeWalk *walk = g_new0(TreeWalk, 1);
+  walk->root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  walk->flags = flags;
+  walk->group = SchedulerGroup_new(SCHEDULER_USER_INITIATED, cancellable);
+  walk->ref_count = 1;
+  walk->visit = visit;
+  walk->done = done;
+  walk->user_data = user_data;
+
+  walk->ignore = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  gchar **names = g_strsplit(ignore ? ignore : TREE_WALK_DEFAULT_IGNORE, ":",
+                             -1);
+  for (gchar **name = names; *name; name++) {
+    if (**name) {
+      g_hash_table_add(walk->ignore, g_strdup(*name));
+    }
+  }
+  g_strfreev(names);
+
+  if (walk->root_fd < 0) {
+    walk->root_failed = TRUE;
+    done(&walk->stats, user_data);
+    return walk;
+  }
+
+  walk->pending = 1;
+  queue_directory(walk, g_strdup(""), NULL);
+  return walk;
+}
+
+void TreeWalk_unref(TreeWalk *walk) {
+  if (!walk || !g_atomic_int_dec_and_test(&walk->ref_count))
+    return;
+
+  if (walk->root_fd >= 0) {
+    close(walk->root_fd);
+  }
+  g_hash_table_destroy(walk->ignore);
+  SchedulerGroup_unref(walk->group);
+  g_free(walk);
+}
+
+gchar *TreeWalk_join(const char *dir_path, const char *name) {
+  return *dir_path ? g_strconcat(dir_path, "/", name, NULL) : g_strdup(name);
+}
+
+// ==========================================
+// Internal Functions
+// ==========================================
+
+// Takes ownership of path; the caller has already counted it in pending
+static void queue_directory(TreeWalk *walk, gchar *path, IgnoreRules *rules) {
+  TreeWalkTask *task = g_new(TreeWalkTask, 1);
+  task->walk = walk;
+  task->path = path;
+  task->rules = IgnoreRules_ref(rules);
+  g_atomic_int_inc(&walk->ref_count);
+  Scheduler_push(walk->group, walk_directory, task);
+}
+
+static void finish_directory(TreeWalk *walk) {
+  if (g_atomic_int_dec_and_test(&walk->pending)) {
+    walk->done(&walk->stats, walk->user_data);
+  }
+}
+
+static void walk_directory(gpointer data) {
+  TreeWalkTask *task = (TreeWalkTask *)data;
+  TreeWalk *walk = task->walk;
+  const char *path = *task->path ? task->path : ".";
+  gint64 start = g_get_monotonic_time();
+  SearchStats local = {0};
+  DirReader reader;
+
+  if (!g_cancellable_is_cancelled(walk->group->cancellable) &&
+      DirReader_open_at(&reader, walk->root_fd, path)) {
+    // Compiled once here, shared by every subdirectory below
+    IgnoreRules *rules =
+        (walk->flags & TREE_WALK_IGNORE_FILES)
+            ? IgnoreRules_load(reader.fd, task->path, task->rules)
+            : NULL;
+    DirReaderEntry entry;
+    while (DirReader_next(&reader, &entry)) {
+      if (g_cancellable_is_cancelled(walk->group->cancellable))
+        break;
+      // No lock or budget memory is held here: a content search may run
+      Scheduler_yield();
+
+      // Never follow symlinks: a link back up the tree would loop
+      unsigned char type = entry.type;
+      local.entries++;
+      if (type == DIR_TYPE_UNKNOWN) {
+        DirReaderStat st;
+        local.stats++;
+        if (DirReader_stat(&reader, entry.name, false, &st)) {
+          type = DirReader_type_from_mode(st.mode);
+        }
+      }
+
+      // Pruned before it is opened, and not reported either
+      if ((type == DIR_TYPE_DIR &&
+           g_hash_table_contains(walk->ignore, entry.name)) ||
+          (rules && IgnoreRules_is_ignored(rules, task->path, entry.name,
+                                           type == DIR_TYPE_DIR))) {
+        Metrics_add(METRIC_ENTRIES_IGNORED, 1);
+        local.skipped_ignored++;
+        continue;
+      }
+
+      TreeWalkEntry visited = {task->path, entry.name, type, reader.fd};
+      gint64 visit_start = g_get_monotonic_time();
+      walk->visit(&visited, walk->user_data);
+      local.stage_us[SEARCH_STAGE_MATCH] +=
+          g_get_monotonic_time() - visit_start;
+
+      if (type == DIR_TYPE_DIR && !(walk->flags & TREE_WALK_ONE_LEVEL)) {
+        g_atomic_int_inc(&walk->pending);
+        queue_directory(walk, TreeWalk_join(task->path, entry.name), rules);
+      }
+    }
+    IgnoreRules_unref(rules);
+    DirReader_close(&reader);
+  } else if (!*task->path &&
+             !g_cancellable_is_cancelled(walk->group->cancellable)) {
+    walk->root_failed = TRUE;
+  }
+
+  // Before finishing: the done callback sees every directory's counts
+  local.stage_us[SEARCH_STAGE_WALK] = g_get_monotonic_time() - start -
+                                      local.stage_us[SEARCH_STAGE_MATCH];
+  SearchStats_merge(&walk->stats, &local);
+  finish_directory(walk);
+  TreeWalk_unref(walk);
+  IgnoreRules_unref(task->rules);
+  g_free(task->path);
+  g_free(task);
+}
@@ -0,0 +1,66 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("Budget.h");
+});
+
+fn acquireFromThread(done: *std.atomic.Value(bool)) void {
+    c.Budget_acquire(400);
+    done.store(true, .release);
+}
+
+test "Budget Readers Wait Until Others Release" {
+    c.Budget_set_limit(1000);
+    defer c.Budget_set_limit(0);
+
+    c.Budget_acquire(800);
+    var done = std.atomic.Value(bool).init(false);
+    const thread = try std.Thread.spawn(.{}, acquireFromThread, .{&done});
+
+    // 800 + 400 is over the limit: the second reader queues
+    std.time.sleep(50 * std.time.ns_per_ms);
+    try std.testing.expect(!done.load(.acquire));
+    var snapshot: c.BudgetSnapshot = undefined;
+    c.Budget_snapshot(&snapshot);
+    try std.testing.expectEqual(@as(c_uint, 1), snapshot.waiting);
+    try std.testing.expect(c.Budget_try_acquire(1) == 0);
+
+    c.Budget_release(800);
+    thread.join();
+    try std.testing.expect(done.load(.acquire));
+    c.Budget_release(400);
+
+    // A lone reader gets through even when it is larger than the budget
+    c.Budget_acquire(5000);
+    c.Budget_release(5000);
+}
+
+var cache_held: c.gsize = 0;
+
+fn reclaimAll(bytes: c.gsize, user_data: c.gpointer) callconv(.C) c.gsize {
+    _ = bytes;
+    _ = user_data;
+    const freed = cache_held;
+    c.Budget_charge_cache(-@as(i64, @intCast(freed)));
+    cache_held = 0;
+    return freed;
+}
+
+test "Budget Asks Caches To Evict Under Pressure" {
+    c.Budget_set_limit(1000);
+    defer c.Budget_set_limit(0);
+    c.Budget_add_reclaimer(reclaimAll, null);
+    defer c.Budget_remove_reclaimer(reclaimAll, null);
+
+    cache_held = 900;
+    c.Budget_charge_cache(900);
+    c.Budget_acquire(100);
+    defer c.Budget_release(100);
+
+    // Refused, and the caches are asked on the main loop
+    try std.testing.expect(c.Budget_try_acquire(200) == 0);
+    while (c.g_main_context_iteration(null, 0) != 0) {}
+    try std.testing.expectEqual(@as(c.gsize, 0), cache_held);
+
+    try std.testing.expect(c.Budget_try_acquire(200) != 0);
+    c.Budget_release(200);
+}
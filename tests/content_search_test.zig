@@ -0,0 +1,55 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("Listing.h");
+    @cInclude("ContentSearch.h");
+});
+
+const Results = struct {
+    total_hits: u32 = 0,
+    files: u32 = 0,
+    finished: bool = false,
+};
+
+fn onMatches(matches: [*c]const c.ContentMatch, count: c.guint, finished: c.gboolean, user_data: ?*anyopaque) callconv(.C) void {
+    const results: *Results = @ptrCast(@alignCast(user_data));
+    var i: usize = 0;
+    while (i < count) : (i += 1) {
+        results.total_hits += matches[i].hits;
+        results.files += 1;
+    }
+    if (finished != 0) results.finished = true;
+}
+
+test "ContentSearch Counts Non-Overlapping Hits" {
+    const text = "aaaa needle needleneedle";
+    try std.testing.expectEqual(@as(c.guint, 3), c.ContentSearch_count(text, text.len, "needle", 6));
+    try std.testing.expectEqual(@as(c.guint, 2), c.ContentSearch_count(text, text.len, "aa", 2));
+    try std.testing.expectEqual(@as(c.guint, 0), c.ContentSearch_count(text, text.len, "haystack", 8));
+}
+
+test "ContentSearch Streams Matches To The Main Loop" {
+    const fs = std.fs;
+
+    const test_dir = "content_search_files";
+    try fs.cwd().makeDir(test_dir);
+    defer fs.cwd().deleteTree(test_dir) catch {};
+
+    var dir = try fs.cwd().openDir(test_dir, .{});
+    defer dir.close();
+    try dir.writeFile(.{ .sub_path = "a.txt", .data = "needle and needle" });
+    try dir.writeFile(.{ .sub_path = "b.txt", .data = "only hay" });
+    try dir.writeFile(.{ .sub_path = "c.txt", .data = "one needle" });
+    try dir.makeDir("needle");
+
+    const listing = c.DirListing_load(test_dir);
+    try std.testing.expect(listing != null);
+    defer c.DirListing_unref(listing);
+
+    var results = Results{};
+    const search = c.ContentSearch_start(listing, null, 0, "needle", null, onMatches, &results);
+    while (!results.finished) _ = c.g_main_context_iteration(null, 1);
+    c.ContentSearch_stop(search);
+
+    try std.testing.expectEqual(@as(u32, 2), results.files);
+    try std.testing.expectEqual(@as(u32, 3), results.total_hits);
+}
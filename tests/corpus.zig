@@ -0,0 +1,315 @@
+//! Deterministic synthetic file trees for tests and benchmarks. The same
+//! options and seed always produce the same paths and bytes, and the
+//! returned manifest says where every needle was planted, so a search
+//! backend can be checked against exact expectations.
+//!
+//! Text files hold lowercase words, spaces and newlines; binary files hold
+//! only control bytes and bytes >= 0x80. A needle with any other character
+//! (an uppercase letter, a digit, punctuation) therefore occurs exactly
+//! where it was planted and nowhere else.
+
+const std = @import("std");
+
+pub const Layout = union(enum) {
+    /// Every file in the root directory
+    wide,
+    /// A single chain of this many nested directories, files spread over
+    /// every level
+    deep: usize,
+    /// fanout subdirectories per directory, depth levels below the root,
+    /// files spread over every directory
+    tree: struct { fanout: usize, depth: usize },
+};
+
+pub const Sizes = union(enum) {
+    /// Every file this many bytes
+    fixed: usize,
+    /// Log-normal around a median, the shape file sizes take on real disks
+    log_normal: struct { median: usize, sigma: f64 = 1.5, max: usize = 64 * 1024 * 1024 },
+};
+
+pub const Position = enum {
+    start,
+    middle,
+    end,
+    /// Anywhere, chosen by the seed
+    random,
+    /// Across the first 4 KB boundary, where chunked and edge readers split
+    page_boundary,
+};
+
+pub const Needle = struct {
+    text: []const u8,
+    /// Files it is planted in, once each
+    files: usize,
+    position: Position = .middle,
+};
+
+pub const Options = struct {
+    seed: u64 = 1,
+    files: usize,
+    layout: Layout = .wide,
+    sizes: Sizes = .{ .fixed = 1024 },
+    /// Share of files with binary contents (".bin" rather than ".txt")
+    binary_ratio: f64 = 0,
+    /// Symlinks to regular files, as a share of the file count
+    symlink_ratio: f64 = 0,
+    /// Extra hard links to regular files, as a share of the file count
+    hardlink_ratio: f64 = 0,
+    needles: []const Needle = &.{},
+};
+
+pub const Planted = struct {
+    /// Relative to the corpus root
+    path: []const u8,
+    offset: usize,
+    /// Index into Options.needles
+    needle: usize,
+};
+
+pub const Link = struct {
+    path: []const u8,
+    /// Regular file it points to, relative to the root
+    target: []const u8,
+    hard: bool,
+};
+
+pub const Corpus = struct {
+    allocator: std.mem.Allocator,
+    root: []const u8,
+    /// Regular files, relative to the root, in creation order
+    files: std.ArrayList([]const u8),
+    /// Directories below the root, relative to it
+    dirs: std.ArrayList([]const u8),
+    links: std.ArrayList(Link),
+    planted: std.ArrayList(Planted),
+    /// Sum of the regular files' sizes
+    bytes: u64 = 0,
+
+    /// Files holding a needle, relative to the root
+    pub fn filesWith(self: *const Corpus, needle: usize, out: *std.ArrayList([]const u8)) !void {
+        for (self.planted.items) |planted| {
+            if (planted.needle == needle) try out.append(planted.path);
+        }
+    }
+
+    /// Delete the tree from disk
+    pub fn remove(self: *const Corpus) void {
+        std.fs.cwd().deleteTree(self.root) catch {};
+    }
+
+    pub fn deinit(self: *Corpus) void {
+        for (self.files.items) |path| self.allocator.free(path);
+        for (self.dirs.items) |path| self.allocator.free(path);
+        for (self.links.items) |link| self.allocator.free(link.path);
+        self.files.deinit();
+        self.dirs.deinit();
+        self.links.deinit();
+        self.planted.deinit();
+        self.allocator.free(self.root);
+    }
+};
+
+/// Create a corpus under root (made if missing, expected empty)
+pub fn generate(allocator: std.mem.Allocator, root: []const u8, options: Options) !Corpus {
+    var corpus = Corpus{
+        .allocator = allocator,
+        .root = try allocator.dupe(u8, root),
+        .files = std.ArrayList([]const u8).init(allocator),
+        .dirs = std.ArrayList([]const u8).init(allocator),
+        .links = std.ArrayList(Link).init(allocator),
+        .planted = std.ArrayList(Planted).init(allocator),
+    };
+    errdefer corpus.deinit();
+
+    var prng = std.Random.DefaultPrng.init(options.seed);
+    const random = prng.random();
+
+    try std.fs.cwd().makePath(root);
+    var root_dir = try std.fs.cwd().openDir(root, .{});
+    defer root_dir.close();
+
+    try makeDirs(&corpus, root_dir, options.layout);
+
+    // Needle holders are drawn once, disjoint across needles
+    const holder = try allocator.alloc(?usize, options.files);
+    defer allocator.free(holder);
+    @memset(holder, null);
+    const order = try allocator.alloc(usize, options.files);
+    defer allocator.free(order);
+    for (order, 0..) |*slot, i| slot.* = i;
+    random.shuffle(usize, order);
+    var next: usize = 0;
+    for (options.needles, 0..) |needle, index| {
+        if (next + needle.files > options.files) return error.TooManyNeedles;
+        for (order[next..][0..needle.files]) |file| holder[file] = index;
+        next += needle.files;
+    }
+
+    var buf = std.ArrayList(u8).init(allocator);
+    defer buf.deinit();
+    var name_buf: [64]u8 = undefined;
+
+    for (0..options.files) |i| {
+        const binary = random.float(f64) < options.binary_ratio;
+        var size = drawSize(random, options.sizes);
+        if (holder[i]) |index| size = @max(size, options.needles[index].text.len);
+
+        try buf.resize(size);
+        if (binary) fillBinary(random, buf.items) else fillText(random, buf.items);
+
+        // Round robin over the root and every directory below it
+        const slot = i % (corpus.dirs.items.len + 1);
+        const dir: []const u8 = if (slot == 0) "" else corpus.dirs.items[slot - 1];
+        const name = try std.fmt.bufPrint(&name_buf, "f{d}.{s}", .{ i, if (binary) "bin" else "txt" });
+        const path = if (dir.len == 0)
+            try allocator.dupe(u8, name)
+        else
+            try std.fs.path.join(allocator, &.{ dir, name });
+        try corpus.files.append(path);
+
+        if (holder[i]) |index| {
+            const needle = options.needles[index];
+            const offset = placeNeedle(random, size, needle);
+            @memcpy(buf.items[offset..][0..needle.text.len], needle.text);
+            try corpus.planted.append(.{ .path = path, .offset = offset, .needle = index });
+        }
+
+        try root_dir.writeFile(.{ .sub_path = path, .data = buf.items });
+        corpus.bytes += size;
+    }
+
+    try makeLinks(&corpus, root_dir, random, options);
+    return corpus;
+}
+
+// ==========================================
+// Internals
+// ==========================================
+
+fn makeDirs(corpus: *Corpus, root_dir: std.fs.Dir, layout: Layout) !void {
+    const allocator = corpus.allocator;
+    switch (layout) {
+        .wide => {},
+        .deep => |depth| {
+            var path: []const u8 = "";
+            for (0..depth) |level| {
+                var name_buf: [32]u8 = undefined;
+                const name = try std.fmt.bufPrint(&name_buf, "d{d}", .{level});
+                const child = if (path.len == 0)
+                    try allocator.dupe(u8, name)
+                else
+                    try std.fs.path.join(allocator, &.{ path, name });
+                try corpus.dirs.append(child);
+                path = child;
+            }
+        },
+        .tree => |tree| {
+            // Breadth first: each level's parents are the previous level
+            var parents_start: usize = 0;
+            var parents_end: usize = 0;
+            for (0..tree.depth) |level| {
+                const level_start = corpus.dirs.items.len;
+                const parent_count = if (level == 0) 1 else parents_end - parents_start;
+                for (0..parent_count) |p| {
+                    const parent: []const u8 = if (level == 0) "" else corpus.dirs.items[parents_start + p];
+                    for (0..tree.fanout) |f| {
+                        var name_buf: [32]u8 = undefined;
+                        const name = try std.fmt.bufPrint(&name_buf, "d{d}", .{f});
+                        const child = if (parent.len == 0)
+                            try allocator.dupe(u8, name)
+                        else
+                            try std.fs.path.join(allocator, &.{ parent, name });
+                        try corpus.dirs.append(child);
+                    }
+                }
+                parents_start = level_start;
+                parents_end = corpus.dirs.items.len;
+            }
+        },
+    }
+
+    for (corpus.dirs.items) |dir| try root_dir.makePath(dir);
+}
+
+fn makeLinks(corpus: *Corpus, root_dir: std.fs.Dir, random: std.Random, options: Options) !void {
+    if (corpus.files.items.len == 0) return;
+
+    const count_f: f64 = @floatFromInt(options.files);
+    const symlinks: usize = @intFromFloat(@round(count_f * options.symlink_ratio));
+    const hardlinks: usize = @intFromFloat(@round(count_f * options.hardlink_ratio));
+    var name_buf: [64]u8 = undefined;
+
+    for (0..symlinks + hardlinks) |i| {
+        const hard = i >= symlinks;
+        const target = corpus.files.items[random.uintLessThan(usize, corpus.files.items.len)];
+        const name = try std.fmt.bufPrint(&name_buf, "{s}{d}", .{ if (hard) "h" else "s", i });
+        const path = try corpus.allocator.dupe(u8, name);
+        errdefer corpus.allocator.free(path);
+
+        // Links sit in the root, so a relative target resolves as is
+        if (hard) {
+            try std.posix.linkat(root_dir.fd, target, root_dir.fd, path, 0);
+        } else {
+            try root_dir.symLink(target, path, .{});
+        }
+        try corpus.links.append(.{ .path = path, .target = target, .hard = hard });
+    }
+}
+
+fn drawSize(random: std.Random, sizes: Sizes) usize {
+    return switch (sizes) {
+        .fixed => |size| size,
+        .log_normal => |shape| blk: {
+            const median: f64 = @floatFromInt(shape.median);
+            const size = median * @exp(shape.sigma * random.floatNorm(f64));
+            const max: f64 = @floatFromInt(shape.max);
+            break :blk @as(usize, @intFromFloat(@min(max, @max(1, size))));
+        },
+    };
+}
+
+fn placeNeedle(random: std.Random, size: usize, needle: Needle) usize {
+    const room = size - needle.text.len;
+    return switch (needle.position) {
+        .start => 0,
+        .middle => room / 2,
+        .end => room,
+        .random => random.uintAtMost(usize, room),
+        .page_boundary => if (room >= 4096) 4096 - needle.text.len / 2 else room / 2,
+    };
+}
+
+// Lowercase words and line breaks
+pub fn fillText(random: std.Random, buf: []u8) void {
+    const alphabet = "abcdefghijklmnopqrstuvwxyz      \n";
+    fillFrom(random, buf, alphabet);
+}
+
+// Control bytes and high bytes: never printable ASCII
+pub fn fillBinary(random: std.Random, buf: []u8) void {
+    var i: usize = 0;
+    while (i < buf.len) {
+        var bits = random.int(u64);
+        var n: usize = 0;
+        while (n < 8 and i < buf.len) : (n += 1) {
+            const byte: u8 = @truncate(bits);
+            buf[i] = if (byte & 0x80 != 0) byte else byte & 0x1F;
+            bits >>= 8;
+            i += 1;
+        }
+    }
+}
+
+fn fillFrom(random: std.Random, buf: []u8, alphabet: []const u8) void {
+    var i: usize = 0;
+    while (i < buf.len) {
+        var bits = random.int(u64);
+        var n: usize = 0;
+        while (n < 8 and i < buf.len) : (n += 1) {
+            buf[i] = alphabet[@as(usize, @as(u8, @truncate(bits))) % alphabet.len];
+            bits >>= 8;
+            i += 1;
+        }
+    }
+}
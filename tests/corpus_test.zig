@@ -0,0 +1,205 @@
+const std = @import("std");
+const corpus = @import("corpus");
+const c = @cImport({
+    @cInclude("Search.h");
+    @cInclude("ContentSearch.h");
+    @cInclude("TreeSearch.h");
+});
+
+const needles = [_]corpus.Needle{
+    .{ .text = "NEEDLE_42", .files = 7, .position = .random },
+    .{ .text = "Q", .files = 3, .position = .page_boundary },
+    .{ .text = "END!", .files = 2, .position = .end },
+};
+
+const Results = struct {
+    paths: std.ArrayList([]u8),
+    finished: bool = false,
+};
+
+fn onMatches(matches: [*c]const c.TreeMatch, count: c.guint, finished: c.gboolean, user_data: ?*anyopaque) callconv(.C) void {
+    const results: *Results = @ptrCast(@alignCast(user_data));
+    var i: usize = 0;
+    while (i < count) : (i += 1) {
+        const path = std.testing.allocator.dupe(u8, std.mem.span(matches[i].path)) catch unreachable;
+        results.paths.append(path) catch unreachable;
+    }
+    if (finished != 0) results.finished = true;
+}
+
+fn lessThan(_: void, a: []const u8, b: []const u8) bool {
+    return std.mem.lessThan(u8, a, b);
+}
+
+test "Corpus Is Reproducible From Its Seed" {
+    const allocator = std.testing.allocator;
+    const options = corpus.Options{
+        .seed = 7,
+        .files = 40,
+        .layout = .{ .tree = .{ .fanout = 3, .depth = 2 } },
+        .sizes = .{ .log_normal = .{ .median = 2048, .max = 64 * 1024 } },
+        .binary_ratio = 0.25,
+        .symlink_ratio = 0.1,
+        .hardlink_ratio = 0.1,
+        .needles = &needles,
+    };
+
+    var first = try corpus.generate(allocator, "corpus_first", options);
+    defer first.deinit();
+    defer first.remove();
+    var second = try corpus.generate(allocator, "corpus_second", options);
+    defer second.deinit();
+    defer second.remove();
+
+    try std.testing.expectEqual(@as(usize, 12), first.dirs.items.len);
+    try std.testing.expectEqual(@as(usize, 8), first.links.items.len);
+    try std.testing.expectEqual(first.bytes, second.bytes);
+    for (first.files.items, second.files.items) |a, b| {
+        try std.testing.expectEqualStrings(a, b);
+        const path_a = try std.fs.path.join(allocator, &.{ first.root, a });
+        defer allocator.free(path_a);
+        const path_b = try std.fs.path.join(allocator, &.{ second.root, b });
+        defer allocator.free(path_b);
+        const data_a = try std.fs.cwd().readFileAlloc(allocator, path_a, 1 << 20);
+        defer allocator.free(data_a);
+        const data_b = try std.fs.cwd().readFileAlloc(allocator, path_b, 1 << 20);
+        defer allocator.free(data_b);
+        try std.testing.expectEqualSlices(u8, data_a, data_b);
+    }
+}
+
+test "Search Backends Find Exactly The Planted Needles" {
+    const allocator = std.testing.allocator;
+
+    var files = try corpus.generate(allocator, "corpus_backends", .{
+        .seed = 42,
+        .files = 200,
+        .layout = .{ .deep = 4 },
+        .sizes = .{ .log_normal = .{ .median = 8 * 1024, .max = 256 * 1024 } },
+        .binary_ratio = 0.2,
+        .needles = &needles,
+    });
+    defer files.deinit();
+    defer files.remove();
+
+    for (needles, 0..) |needle, index| {
+        var expected = std.ArrayList([]const u8).init(allocator);
+        defer expected.deinit();
+        try files.filesWith(index, &expected);
+        std.mem.sort([]const u8, expected.items, {}, lessThan);
+
+        // Counting over the raw bytes
+        const pattern_z = try allocator.dupeZ(u8, needle.text);
+        defer allocator.free(pattern_z);
+        var total: usize = 0;
+        for (files.files.items) |path| {
+            const full = try std.fs.path.join(allocator, &.{ files.root, path });
+            defer allocator.free(full);
+            const data = try std.fs.cwd().readFileAlloc(allocator, full, 1 << 20);
+            defer allocator.free(data);
+            total += c.ContentSearch_count(data.ptr, data.len, pattern_z.ptr, needle.text.len);
+        }
+        try std.testing.expectEqual(needle.files, total);
+
+        // The recursive query search
+        const query = try std.fmt.allocPrintZ(allocator, "content:\"{s}\"", .{needle.text});
+        defer allocator.free(query);
+        var results = Results{ .paths = std.ArrayList([]u8).init(allocator) };
+        defer {
+            for (results.paths.items) |path| allocator.free(path);
+            results.paths.deinit();
+        }
+        const search = c.TreeSearch_start(files.root.ptr, c.Query_parse(query.ptr, c.QUERY_DEFAULT), c.TREE_WALK_DEFAULT, "", 0, null, onMatches, &results);
+        while (!results.finished) _ = c.g_main_context_iteration(null, 1);
+        c.TreeSearch_stop(search);
+
+        std.mem.sort([]u8, results.paths.items, {}, lessThan);
+        try std.testing.expectEqual(expected.items.len, results.paths.items.len);
+        for (expected.items, results.paths.items) |want, got| {
+            try std.testing.expectEqualStrings(want, got);
+        }
+    }
+
+    // The directory search path (GPU kernel or its host fallback) on the
+    // top level, which holds every fifth file
+    const root_z = try allocator.dupeZ(u8, files.root);
+    defer allocator.free(root_z);
+    for (needles, 0..) |needle, index| {
+        var expected = std.ArrayList([]const u8).init(allocator);
+        defer expected.deinit();
+        try files.filesWith(index, &expected);
+        var at_top = false;
+        for (expected.items) |path| {
+            if (std.mem.indexOfScalar(u8, path, '/') == null) at_top = true;
+        }
+        const pattern_z = try allocator.dupeZ(u8, needle.text);
+        defer allocator.free(pattern_z);
+        try std.testing.expectEqual(at_top, c.cuda_search_files(pattern_z.ptr, root_z.ptr));
+    }
+    try std.testing.expect(!c.cuda_search_files("ABSENT_NEEDLE", root_z.ptr));
+}
+
+fn onContent(matches: [*c]const c.ContentMatch, count: c.guint, finished: c.gboolean, user_data: ?*anyopaque) callconv(.C) void {
+    _ = matches;
+    _ = count;
+    const done: *bool = @ptrCast(@alignCast(user_data));
+    if (finished != 0) done.* = true;
+}
+
+test "Search Stats Account For Every Corpus File" {
+    const allocator = std.testing.allocator;
+
+    // The root holds every other file, the d0 folder and the symlinks
+    var files = try corpus.generate(allocator, "corpus_stats", .{
+        .seed = 3,
+        .files = 50,
+        .layout = .{ .deep = 1 },
+        .sizes = .{ .fixed = 1000 },
+        .symlink_ratio = 0.1,
+    });
+    defer files.deinit();
+    defer files.remove();
+    const root_z = try allocator.dupeZ(u8, files.root);
+    defer allocator.free(root_z);
+
+    // The directory search: links are read through, the folder is skipped
+    var stats = std.mem.zeroes(c.SearchStats);
+    _ = c.cuda_search_files_stats("NEEDLE", root_z.ptr, null, &stats);
+    try std.testing.expectEqual(@as(i64, 31), stats.entries);
+    try std.testing.expectEqual(@as(i64, 30), stats.files_read);
+    try std.testing.expectEqual(@as(i64, 30 * 1000), stats.bytes_read);
+    try std.testing.expectEqual(@as(i64, 30 * 1000), stats.bytes_scanned);
+    try std.testing.expectEqual(@as(i64, 1), stats.skipped_special);
+    try std.testing.expectEqual(@as(i64, 0), stats.skipped_unreadable);
+    try std.testing.expect(stats.total_us >= stats.stage_us[c.SEARCH_STAGE_MATCH]);
+
+    // The content search of the listing on screen
+    const listing = c.DirListing_load(root_z.ptr);
+    defer c.DirListing_unref(listing);
+    var done = false;
+    const content = c.ContentSearch_start(listing, null, 0, "NEEDLE", null, onContent, &done);
+    while (!done) _ = c.g_main_context_iteration(null, 1);
+    try std.testing.expectEqual(@as(i64, 31), content.*.stats.entries);
+    try std.testing.expectEqual(@as(i64, 30), content.*.stats.files_read);
+    try std.testing.expectEqual(@as(i64, 30 * 1000), content.*.stats.bytes_scanned);
+    try std.testing.expectEqual(@as(i64, 1), content.*.stats.skipped_special);
+    c.ContentSearch_stop(content);
+
+    // The recursive query search reads every file once, links included
+    var results = Results{ .paths = std.ArrayList([]u8).init(allocator) };
+    defer {
+        for (results.paths.items) |path| allocator.free(path);
+        results.paths.deinit();
+    }
+    const search = c.TreeSearch_start(root_z.ptr, c.Query_parse("content:NEEDLE", c.QUERY_DEFAULT), c.TREE_WALK_DEFAULT, "", 0, null, onMatches, &results);
+    while (!results.finished) _ = c.g_main_context_iteration(null, 1);
+    try std.testing.expectEqual(@as(usize, 0), results.paths.items.len);
+    try std.testing.expectEqual(@as(i64, 56), search.*.stats.entries);
+    try std.testing.expectEqual(@as(i64, 55), search.*.stats.files_read);
+    try std.testing.expectEqual(@as(i64, 55 * 1000), search.*.stats.bytes_read);
+    try std.testing.expect(search.*.stats.stage_us[c.SEARCH_STAGE_MATCH] >= 0);
+    const text = c.SearchStats_format(&search.*.stats);
+    defer c.g_free(text);
+    try std.testing.expect(std.mem.startsWith(u8, std.mem.span(text), "56 entries, "));
+    c.TreeSearch_stop(search);
+}
@@ -0,0 +1,116 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("DirCache.h");
+});
+
+const Updates = struct {
+    count: u32 = 0,
+    entries: c_int = -1, // Entries of the last patched listing, -1 if gone
+    changed: u32 = 0, // Names in the last batch, 0 after a full reload
+};
+
+fn onUpdate(update: [*c]const c.DirCacheUpdate, user_data: c.gpointer) callconv(.C) void {
+    const updates: *Updates = @ptrCast(@alignCast(user_data));
+    updates.count += 1;
+    updates.entries = if (update.*.listing != null) update.*.listing.*.count else -1;
+    updates.changed = if (update.*.changed != null) update.*.changed.*.len else 0;
+}
+
+fn waitForUpdate(updates: *const Updates, count: u32) void {
+    const end = c.g_get_monotonic_time() + 2 * std.time.us_per_s;
+    while (updates.count < count and c.g_get_monotonic_time() < end) {
+        _ = c.g_main_context_iteration(null, 0);
+        std.time.sleep(std.time.ns_per_ms);
+    }
+}
+
+fn cachedCount(cache: *c.DirCache, path: [*c]const u8) c_int {
+    const listing = c.DirCache_lookup(cache, path);
+    if (listing == null) return -1;
+    defer c.DirListing_unref(listing);
+    return listing.*.count;
+}
+
+test "DirCache Rereads A Directory That Changed Before It Was Watched" {
+    const fs = std.fs;
+
+    const test_dir = "dir_cache_files";
+    try fs.cwd().makeDir(test_dir);
+    defer fs.cwd().deleteTree(test_dir) catch {};
+    var dir = try fs.cwd().openDir(test_dir, .{});
+    defer dir.close();
+    try dir.writeFile(.{ .sub_path = "a", .data = "" });
+
+    const cache = c.DirCache_new(1 << 26);
+    defer c.DirCache_destroy(cache);
+    var updates = Updates{};
+    c.DirCache_set_update_func(cache, onUpdate, &updates);
+    c.DirCache_pin(cache, test_dir);
+
+    // Created after the read, before the watch: no event will tell
+    const listing = c.DirListing_load(test_dir);
+    defer c.DirListing_unref(listing);
+    try dir.writeFile(.{ .sub_path = "late", .data = "" });
+    c.DirCache_insert(cache, listing);
+
+    waitForUpdate(&updates, 1);
+    try std.testing.expectEqual(@as(u32, 1), updates.count);
+    try std.testing.expectEqual(@as(u32, 0), updates.changed);
+    try std.testing.expectEqual(@as(c_int, 2), cachedCount(cache, test_dir));
+
+    // A prefetch read before a change is refused outright
+    try dir.makeDir("sub");
+    const prefetched = c.DirListing_load(test_dir ++ "/sub");
+    defer c.DirListing_unref(prefetched);
+    try dir.writeFile(.{ .sub_path = "sub/late", .data = "" });
+    try std.testing.expect(c.DirCache_insert_speculative(cache, prefetched) == 0);
+}
+
+test "DirCache Coalesces Changes And Shares Watches Between Paths" {
+    const fs = std.fs;
+
+    const test_dir = "dir_cache_shared";
+    try fs.cwd().makePath(test_dir ++ "/real");
+    defer fs.cwd().deleteTree(test_dir) catch {};
+    var dir = try fs.cwd().openDir(test_dir, .{});
+    defer dir.close();
+    try dir.symLink("real", "alias", .{});
+
+    // Old enough that a change in the same timestamp tick cannot hide
+    std.time.sleep(30 * std.time.ns_per_ms);
+
+    const cache = c.DirCache_new(1 << 26);
+    defer c.DirCache_destroy(cache);
+    var updates = Updates{};
+    c.DirCache_set_update_func(cache, onUpdate, &updates);
+    c.DirCache_pin(cache, test_dir ++ "/real");
+
+    const real = c.DirListing_load(test_dir ++ "/real");
+    defer c.DirListing_unref(real);
+    c.DirCache_insert(cache, real);
+    const alias = c.DirListing_load(test_dir ++ "/alias");
+    defer c.DirListing_unref(alias);
+    c.DirCache_insert(cache, alias);
+    try std.testing.expect(c.DirCache_contains(cache, test_dir ++ "/alias") != 0);
+
+    // Three creates within the window arrive as one patch
+    try dir.writeFile(.{ .sub_path = "real/x", .data = "" });
+    try dir.writeFile(.{ .sub_path = "real/y", .data = "" });
+    try dir.writeFile(.{ .sub_path = "real/z", .data = "" });
+    waitForUpdate(&updates, 1);
+    try std.testing.expectEqual(@as(u32, 1), updates.count);
+    try std.testing.expectEqual(@as(u32, 3), updates.changed);
+    try std.testing.expectEqual(@as(c_int, 3), updates.entries);
+    try std.testing.expectEqual(@as(c_int, 3), cachedCount(cache, test_dir ++ "/alias"));
+
+    // Dropping one path keeps the watch for the other
+    c.DirCache_invalidate(cache, test_dir ++ "/alias");
+    try dir.writeFile(.{ .sub_path = "real/w", .data = "" });
+    waitForUpdate(&updates, 2);
+    try std.testing.expectEqual(@as(c_int, 4), cachedCount(cache, test_dir ++ "/real"));
+
+    try dir.deleteTree("real");
+    waitForUpdate(&updates, 3);
+    try std.testing.expectEqual(@as(c_int, -1), updates.entries);
+    try std.testing.expect(c.DirCache_contains(cache, test_dir ++ "/real") == 0);
+}
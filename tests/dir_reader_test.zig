@@ -0,0 +1,49 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("DirReader.h");
+});
+
+test "DirReader Lists Entries With Types" {
+    const fs = std.fs;
+
+    const test_dir = "dir_reader_files";
+    try fs.cwd().makeDir(test_dir);
+    defer fs.cwd().deleteTree(test_dir) catch {};
+
+    try fs.cwd().makeDir(test_dir ++ "/subdir");
+    const f = try fs.cwd().createFile(test_dir ++ "/file.txt", .{});
+    try f.writeAll("contents\n");
+    f.close();
+    try fs.cwd().symLink("file.txt", test_dir ++ "/link.txt", .{});
+
+    var reader: c.DirReader = undefined;
+    try std.testing.expect(c.DirReader_open(&reader, test_dir));
+    defer c.DirReader_close(&reader);
+
+    var entry: c.DirReaderEntry = undefined;
+    var total: usize = 0;
+    var files: usize = 0;
+    var dirs: usize = 0;
+
+    while (c.DirReader_next(&reader, &entry)) {
+        total += 1;
+        // Symlinks resolve to their target's type
+        const entry_type = c.DirReader_resolve_type(&reader, &entry);
+        if (entry_type == c.DIR_TYPE_REG) files += 1;
+        if (entry_type == c.DIR_TYPE_DIR) dirs += 1;
+    }
+
+    // "." and ".." are skipped
+    try std.testing.expectEqual(@as(usize, 3), total);
+    try std.testing.expectEqual(@as(usize, 2), files);
+    try std.testing.expectEqual(@as(usize, 1), dirs);
+
+    var st: c.DirReaderStat = undefined;
+    try std.testing.expect(c.DirReader_stat(&reader, "file.txt", true, &st));
+    try std.testing.expectEqual(@as(u64, 9), st.size);
+}
+
+test "DirReader Fails On Missing Directory" {
+    var reader: c.DirReader = undefined;
+    try std.testing.expect(!c.DirReader_open(&reader, "does_not_exist_dir"));
+}
@@ -0,0 +1,57 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("DiskUsage.h");
+});
+
+const Results = struct {
+    sizes: std.StringHashMap(u64),
+    finished: bool = false,
+};
+
+fn onSizes(sizes: [*c]const c.DiskUsageSize, count: c.guint, finished: c.gboolean, user_data: ?*anyopaque) callconv(.C) void {
+    const results: *Results = @ptrCast(@alignCast(user_data));
+    var i: usize = 0;
+    while (i < count) : (i += 1) {
+        const name = std.testing.allocator.dupe(u8, std.mem.span(sizes[i].name)) catch unreachable;
+        results.sizes.put(name, sizes[i].bytes) catch unreachable;
+    }
+    if (finished != 0) results.finished = true;
+}
+
+test "DiskUsage Rolls Up Folders And Counts Hard Links Once" {
+    const fs = std.fs;
+
+    const test_dir = "disk_usage_files";
+    try fs.cwd().makeDir(test_dir);
+    defer fs.cwd().deleteTree(test_dir) catch {};
+
+    var dir = try fs.cwd().openDir(test_dir, .{});
+    defer dir.close();
+    try dir.makePath("a/deep");
+    try dir.makePath("b");
+    const data = [_]u8{'x'} ** (64 * 1024);
+    try dir.writeFile(.{ .sub_path = "a/deep/big.bin", .data = &data });
+    try std.posix.linkat(dir.fd, "a/deep/big.bin", dir.fd, "b/same.bin", 0);
+
+    var results = Results{ .sizes = std.StringHashMap(u64).init(std.testing.allocator) };
+    defer {
+        var it = results.sizes.keyIterator();
+        while (it.next()) |key| std.testing.allocator.free(key.*);
+        results.sizes.deinit();
+    }
+
+    const usage = c.DiskUsage_start(test_dir, onSizes, &results);
+    while (!results.finished) _ = c.g_main_context_iteration(null, 1);
+
+    const a = results.sizes.get("a").?;
+    const b = results.sizes.get("b").?;
+    try std.testing.expect(a + b >= data.len);
+    try std.testing.expect(a + b < 2 * data.len);
+    try std.testing.expect(usage.*.total >= a + b);
+
+    var count: c.guint = 0;
+    const files = c.DiskUsage_largest(usage, 0, &count);
+    try std.testing.expect(count >= 1);
+    try std.testing.expect(files[0].bytes >= data.len);
+    c.DiskUsage_stop(usage);
+}
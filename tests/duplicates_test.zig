@@ -0,0 +1,56 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("Duplicates.h");
+    @cInclude("Hash64.h");
+});
+
+const Results = struct {
+    groups: usize = 0,
+    paths: usize = 0,
+    reclaimable: u64 = 0,
+    finished: bool = false,
+};
+
+fn onGroups(groups: [*c]const c.DuplicateGroup, count: c.guint, finished: c.gboolean, user_data: ?*anyopaque) callconv(.C) void {
+    const results: *Results = @ptrCast(@alignCast(user_data));
+    var i: usize = 0;
+    while (i < count) : (i += 1) {
+        results.groups += 1;
+        results.paths += groups[i].count;
+        results.reclaimable += groups[i].reclaimable;
+    }
+    if (finished != 0) results.finished = true;
+}
+
+test "Hash64 Matches XXH64 Reference Values" {
+    try std.testing.expectEqual(@as(u64, 0xEF46DB3751D8E999), c.Hash64_bytes("", 0, 0));
+    try std.testing.expectEqual(@as(u64, 0x44BC2CF5AD770999), c.Hash64_bytes("abc", 3, 0));
+}
+
+test "Duplicates Groups Identical Files And Skips Hard Links" {
+    const fs = std.fs;
+
+    const test_dir = "duplicates_files";
+    try fs.cwd().makeDir(test_dir);
+    defer fs.cwd().deleteTree(test_dir) catch {};
+
+    var dir = try fs.cwd().openDir(test_dir, .{});
+    defer dir.close();
+    try dir.makePath("a/b");
+    var data = [_]u8{'x'} ** (64 * 1024);
+    try dir.writeFile(.{ .sub_path = "a/b/one.bin", .data = &data });
+    try dir.writeFile(.{ .sub_path = "two.bin", .data = &data });
+    try std.posix.linkat(dir.fd, "two.bin", dir.fd, "a/link.bin", 0);
+    // Same size and same ends, different middle
+    data[data.len / 2] = 'y';
+    try dir.writeFile(.{ .sub_path = "middle.bin", .data = &data });
+
+    var results = Results{};
+    const dups = c.Duplicates_start(test_dir, "", onGroups, &results);
+    while (!results.finished) _ = c.g_main_context_iteration(null, 1);
+    c.Duplicates_stop(dups);
+
+    try std.testing.expectEqual(@as(usize, 1), results.groups);
+    try std.testing.expectEqual(@as(usize, 2), results.paths);
+    try std.testing.expectEqual(@as(u64, data.len), results.reclaimable);
+}
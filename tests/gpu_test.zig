@@ -1,4 +1,5 @@
 const std = @import("std");
+const corpus = @import("corpus");
 const c = @cImport({
     @cInclude("Search.h");
 });
@@ -80,53 +81,28 @@ fn cpuSearchFiles(pattern: []const u8, directory: []const u8, allocator: std.mem
 }
 
 test "CPU vs GPU Search Benchmark" {
-    const fs = std.fs;
     const allocator = std.testing.allocator;
     
     const test_dir = "benchmark_files";
     const num_files = 1000;
     const file_size = 10_000;  // 10KB per file
     const key = "SpecialBenchmarkKey";
-    const key_index = 523;
-    
-    // Create test directory
-    try fs.cwd().makeDir(test_dir);
-    defer fs.cwd().deleteTree(test_dir) catch {};
     
     std.debug.print("\n=== Benchmark Setup ===\n", .{});
     std.debug.print("Files: {d}\n", .{num_files});
     std.debug.print("File size: ~{d} bytes\n", .{file_size});
-    std.debug.print("Key location: file_{d}.txt\n", .{key_index});
-    
-    // Generate realistic file content
-    var prng = std.Random.DefaultPrng.init(@intCast(std.time.timestamp()));
-    const random = prng.random();
     
+    // Seeded, so every run searches the same bytes
     const setup_start = std.time.nanoTimestamp();
-    
-    for (0..num_files) |i| {
-        const file_name = try std.fmt.allocPrint(allocator, "{s}/file_{d}.txt", .{ test_dir, i });
-        defer allocator.free(file_name);
-        
-        const f = try fs.cwd().createFile(file_name, .{});
-        defer f.close();
-        
-        // Generate random content
-        var content = try allocator.alloc(u8, file_size);
-        defer allocator.free(content);
-        
-        for (content) |*byte| {
-            byte.* = random.intRangeAtMost(u8, 'a', 'z');
-        }
-        
-        // Insert key at specific location
-        if (i == key_index) {
-            const key_pos = file_size / 2;  // Middle of file
-            @memcpy(content[key_pos..][0..key.len], key);
-        }
-        
-        try f.writeAll(content);
-    }
+    var files = try corpus.generate(allocator, test_dir, .{
+        .seed = 523,
+        .files = num_files,
+        .sizes = .{ .fixed = file_size },
+        .needles = &.{.{ .text = key, .files = 1 }},
+    });
+    defer files.deinit();
+    defer files.remove();
+    std.debug.print("Key location: {s}\n", .{files.planted.items[0].path});
     
     const setup_end = std.time.nanoTimestamp();
     const setup_time: f64 = @floatFromInt(setup_end - setup_start);
@@ -221,23 +197,12 @@ test "Scalability Benchmark" {
         const test_dir = try std.fmt.allocPrint(allocator, "scale_{d}_{d}", .{ config.num_files, config.file_size });
         defer allocator.free(test_dir);
         
-        try std.fs.cwd().makeDir(test_dir);
-        defer std.fs.cwd().deleteTree(test_dir) catch {};
-        
-        // Create files
-        for (0..config.num_files) |i| {
-            const file_name = try std.fmt.allocPrint(allocator, "{s}/file_{d}.txt", .{ test_dir, i });
-            defer allocator.free(file_name);
-            
-            const f = try std.fs.cwd().createFile(file_name, .{});
-            defer f.close();
-            
-            const content = try allocator.alloc(u8, config.file_size);
-            defer allocator.free(content);
-            @memset(content, 'x');
-            
-            try f.writeAll(content);
-        }
+        var files = try corpus.generate(allocator, test_dir, .{
+            .files = config.num_files,
+            .sizes = .{ .fixed = config.file_size },
+        });
+        defer files.deinit();
+        defer files.remove();
         
         const pattern = "NonexistentPattern";
         const pattern_z = try allocator.dupeZ(u8, pattern);
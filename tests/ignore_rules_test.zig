@@ -0,0 +1,61 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("IgnoreRules.h");
+    @cInclude("sys/stat.h");
+});
+
+fn ignored(rules: [*c]const c.IgnoreRules, dir_path: [*c]const u8, name: [*c]const u8, is_dir: bool) bool {
+    return c.IgnoreRules_is_ignored(rules, dir_path, name, @intFromBool(is_dir)) != 0;
+}
+
+test "IgnoreRules Glob Matching" {
+    try std.testing.expect(c.IgnoreRules_glob_match("*.o", "main.o") != 0);
+    try std.testing.expect(c.IgnoreRules_glob_match("*.o", "src/main.o") == 0);
+    try std.testing.expect(c.IgnoreRules_glob_match("file?.[ch]", "file1.h") != 0);
+    try std.testing.expect(c.IgnoreRules_glob_match("file[!0-9]", "file1") == 0);
+    try std.testing.expect(c.IgnoreRules_glob_match("**/gen/*.c", "a/b/gen/x.c") != 0);
+    try std.testing.expect(c.IgnoreRules_glob_match("**/gen/*.c", "gen/x.c") != 0);
+    try std.testing.expect(c.IgnoreRules_glob_match("docs/**", "docs/a/b") != 0);
+    try std.testing.expect(c.IgnoreRules_glob_match("docs/**", "docs") == 0);
+}
+
+test "IgnoreRules Last Rule Wins And Deeper Files Override" {
+    const root_text = "# build outputs\n*.log\nbuild/\n/TODO\nsrc/gen/*.c\n!keep.log\n";
+    const root = c.IgnoreRules_parse(root_text, root_text.len, "", null);
+    defer c.IgnoreRules_unref(root);
+
+    try std.testing.expect(ignored(root, "", "debug.log", false));
+    try std.testing.expect(ignored(root, "a/b", "trace.log", false));
+    try std.testing.expect(!ignored(root, "", "keep.log", false));
+    try std.testing.expect(ignored(root, "lib", "build", true));
+    try std.testing.expect(!ignored(root, "lib", "build", false));
+    try std.testing.expect(ignored(root, "", "TODO", false));
+    try std.testing.expect(!ignored(root, "lib", "TODO", false));
+    try std.testing.expect(ignored(root, "src/gen", "parser.c", false));
+    try std.testing.expect(!ignored(root, "src", "parser.c", false));
+
+    const child_text = "!*.log\n";
+    const child = c.IgnoreRules_parse(child_text, child_text.len, "logs", root);
+    defer c.IgnoreRules_unref(child);
+
+    try std.testing.expect(!ignored(child, "logs", "today.log", false));
+    try std.testing.expect(ignored(child, "logs", "build", true));
+}
+
+test "IgnoreRules Skips FIFO Ignore Files Without Blocking" {
+    const fs = std.fs;
+
+    const test_dir = "ignore_fifo_files";
+    try fs.cwd().makeDir(test_dir);
+    defer fs.cwd().deleteTree(test_dir) catch {};
+
+    var dir = try fs.cwd().openDir(test_dir, .{});
+    defer dir.close();
+    try std.testing.expectEqual(@as(c_int, 0), c.mkfifo(test_dir ++ "/pipe", 0o644));
+    try dir.symLink("pipe", ".gitignore", .{});
+    try std.testing.expectEqual(@as(c_int, 0), c.mkfifo(test_dir ++ "/.ignore", 0o644));
+
+    // No writer ever opens either FIFO: a blocking open would hang here
+    const rules = c.IgnoreRules_load(dir.fd, "", null);
+    try std.testing.expect(rules == null);
+}
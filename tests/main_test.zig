@@ -2,4 +2,19 @@ const std = @import("std");
 
 test {
     _ = @import("gpu_test.zig"); // runs tests inside file
+    _ = @import("dir_reader_test.zig");
+    _ = @import("sort_test.zig");
+    _ = @import("dir_cache_test.zig");
+    _ = @import("content_search_test.zig");
+    _ = @import("tree_search_test.zig");
+    _ = @import("ignore_rules_test.zig");
+    _ = @import("query_test.zig");
+    _ = @import("disk_usage_test.zig");
+    _ = @import("duplicates_test.zig");
+    _ = @import("corpus_test.zig");
+    _ = @import("trace_test.zig");
+    _ = @import("metrics_test.zig");
+    _ = @import("memory_test.zig");
+    _ = @import("budget_test.zig");
+    _ = @import("scheduler_test.zig");
 }
@@ -0,0 +1,73 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("Memory.h");
+    @cInclude("Listing.h");
+    @cInclude("Sort.h");
+});
+
+fn allocateFromThread(rounds: usize) void {
+    for (0..rounds) |_| {
+        c.Memory_add(c.MEMORY_RESULTS, 64);
+        c.Memory_add(c.MEMORY_RESULTS, -64);
+    }
+}
+
+test "Memory Peaks Hold The Most Held At Once Across Threads" {
+    const allocator = std.testing.allocator;
+
+    c.Memory_reset_peaks();
+    const before = try allocator.create(c.MemorySnapshot);
+    defer allocator.destroy(before);
+    c.Memory_snapshot(before);
+
+    var threads: [4]std.Thread = undefined;
+    for (&threads) |*thread| thread.* = try std.Thread.spawn(.{}, allocateFromThread, .{1000});
+    for (threads) |thread| thread.join();
+
+    const after = try allocator.create(c.MemorySnapshot);
+    defer allocator.destroy(after);
+    c.Memory_snapshot(after);
+
+    // Every allocation was released; at most all four were live at once
+    try std.testing.expectEqual(before.current[c.MEMORY_RESULTS], after.current[c.MEMORY_RESULTS]);
+    const growth = after.peak[c.MEMORY_RESULTS] - before.current[c.MEMORY_RESULTS];
+    try std.testing.expect(growth >= 64 and growth <= 4 * 64);
+    try std.testing.expect(after.rss > 0 and after.peak_rss >= after.rss);
+
+    c.Memory_reset_peaks();
+    c.Memory_snapshot(after);
+    try std.testing.expectEqual(after.current[c.MEMORY_RESULTS], after.peak[c.MEMORY_RESULTS]);
+}
+
+test "Listings Account Their Columns And Indexes Until Released" {
+    const allocator = std.testing.allocator;
+    const test_dir = "memory_test_dir";
+    try std.fs.cwd().makePath(test_dir);
+    defer std.fs.cwd().deleteTree(test_dir) catch {};
+    for (0..50) |i| {
+        var name_buf: [32]u8 = undefined;
+        const name = try std.fmt.bufPrint(&name_buf, "{s}/f{d}", .{ test_dir, i });
+        try std.fs.cwd().writeFile(.{ .sub_path = name, .data = "" });
+    }
+
+    const before = try allocator.create(c.MemorySnapshot);
+    defer allocator.destroy(before);
+    c.Memory_snapshot(before);
+
+    const listing = c.DirListing_load(test_dir);
+    const spec = c.SortSpec{ .key = c.SORT_BY_NAME, .descending = 0, .directories_first = 0 };
+    c.g_free(c.DirListing_sort(listing, &spec));
+
+    const held = try allocator.create(c.MemorySnapshot);
+    defer allocator.destroy(held);
+    c.Memory_snapshot(held);
+    const listing_bytes = held.current[c.MEMORY_LISTING] - before.current[c.MEMORY_LISTING];
+    const index_bytes = held.current[c.MEMORY_INDEXES] - before.current[c.MEMORY_INDEXES];
+    try std.testing.expect(index_bytes > 0);
+    try std.testing.expectEqual(@as(i64, @intCast(listing.*.memory_bytes)), listing_bytes + index_bytes);
+
+    c.DirListing_unref(listing);
+    c.Memory_snapshot(held);
+    try std.testing.expectEqual(before.current[c.MEMORY_LISTING], held.current[c.MEMORY_LISTING]);
+    try std.testing.expectEqual(before.current[c.MEMORY_INDEXES], held.current[c.MEMORY_INDEXES]);
+}
@@ -0,0 +1,59 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("Metrics.h");
+});
+
+fn addFromThread(count: usize) void {
+    for (0..count) |i| {
+        c.Metrics_add(c.METRIC_ENTRIES_IGNORED, 1);
+        c.Metrics_record(c.METRIC_SCAN_MBPS, @intCast(i + 1));
+    }
+}
+
+test "Metrics Sum Every Thread And Keep Percentiles Within A Bucket" {
+    const allocator = std.testing.allocator;
+
+    // Other tests may have counted already: compare against a baseline
+    const before = try allocator.create(c.MetricsSnapshot);
+    defer allocator.destroy(before);
+    c.Metrics_snapshot(before);
+
+    var threads: [4]std.Thread = undefined;
+    for (&threads) |*thread| thread.* = try std.Thread.spawn(.{}, addFromThread, .{1000});
+    for (threads) |thread| thread.join();
+    c.Metrics_add(c.METRIC_DIR_CACHE_BYTES, 4096);
+    c.Metrics_add(c.METRIC_DIR_CACHE_BYTES, -4096);
+
+    const after = try allocator.create(c.MetricsSnapshot);
+    defer allocator.destroy(after);
+    c.Metrics_snapshot(after);
+
+    try std.testing.expectEqual(before.counters[c.METRIC_ENTRIES_IGNORED] + 4000, after.counters[c.METRIC_ENTRIES_IGNORED]);
+    try std.testing.expectEqual(before.counters[c.METRIC_DIR_CACHE_BYTES], after.counters[c.METRIC_DIR_CACHE_BYTES]);
+    try std.testing.expectEqual(before.totals[c.METRIC_SCAN_MBPS] + 4000, after.totals[c.METRIC_SCAN_MBPS]);
+
+    // Only this test's values: 1..1000 four times. Each percentile lands
+    // in the bucket holding the exact value, at most 1/16 of its power of
+    // two above it.
+    const delta = try allocator.create(c.MetricsSnapshot);
+    defer allocator.destroy(delta);
+    delta.* = after.*;
+    for (&delta.buckets[c.METRIC_SCAN_MBPS], before.buckets[c.METRIC_SCAN_MBPS]) |*bucket, old| bucket.* -= old;
+    delta.totals[c.METRIC_SCAN_MBPS] = 4000;
+
+    const p50 = c.Metrics_percentile(delta, c.METRIC_SCAN_MBPS, 50);
+    const p99 = c.Metrics_percentile(delta, c.METRIC_SCAN_MBPS, 99);
+    const max = c.Metrics_percentile(delta, c.METRIC_SCAN_MBPS, 100);
+    try std.testing.expect(p50 >= 500 and p50 < 500 + 32);
+    try std.testing.expect(p99 >= 990 and p99 < 990 + 64);
+    try std.testing.expect(max >= 1000 and max < 1000 + 64);
+
+    const json = c.Metrics_to_json(after);
+    defer c.g_free(json);
+    const parsed = try std.json.parseFromSlice(std.json.Value, allocator, std.mem.span(json), .{});
+    defer parsed.deinit();
+    const ignored = parsed.value.object.get("counters").?.object.get("entries_ignored").?.integer;
+    try std.testing.expectEqual(after.counters[c.METRIC_ENTRIES_IGNORED], ignored);
+    try std.testing.expect(parsed.value.object.get("histograms").?.object.get("scan_mbps") != null);
+    try std.testing.expect(parsed.value.object.get("memory").?.object.get("listing") != null);
+}
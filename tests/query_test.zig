@@ -0,0 +1,94 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("Query.h");
+    @cInclude("sys/stat.h");
+});
+
+test "Query Parses Fields And Plans Cheapest First" {
+    const query = c.Query_parse("content:\"OOM killer\" size>10M ext:log modified<2d", c.QUERY_DEFAULT);
+    defer c.Query_free(query);
+
+    try std.testing.expect(query.*.plain == 0);
+    try std.testing.expectEqual(@as(c.guint, 4), query.*.count);
+    try std.testing.expectEqual(@as(c_uint, c.QUERY_EXT), query.*.terms[0].field);
+    try std.testing.expectEqual(@as(c_uint, c.QUERY_SIZE), query.*.terms[1].field);
+    try std.testing.expectEqual(@as(i64, 10 * 1024 * 1024), query.*.terms[1].value);
+    try std.testing.expectEqual(@as(c_uint, c.QUERY_MODIFIED), query.*.terms[2].field);
+    try std.testing.expectEqual(@as(i64, 2 * 24 * 60 * 60), query.*.terms[2].value);
+    try std.testing.expectEqual(@as(c_uint, c.QUERY_CONTENT), query.*.terms[3].field);
+    try std.testing.expectEqualStrings("OOM killer", std.mem.span(query.*.terms[3].text));
+}
+
+test "Query Without Syntax Is One Plain Pattern" {
+    const query = c.Query_parse("My Notes", c.QUERY_DEFAULT);
+    defer c.Query_free(query);
+
+    try std.testing.expect(query.*.plain != 0);
+    try std.testing.expectEqual(@as(c.guint, 1), query.*.count);
+    try std.testing.expectEqualStrings("my notes", std.mem.span(query.*.terms[0].text));
+
+    // A leading dash is part of the name unless a field makes it a query
+    const dashed = c.Query_parse("-v2 backup", c.QUERY_DEFAULT);
+    defer c.Query_free(dashed);
+    try std.testing.expect(dashed.*.plain != 0);
+    try std.testing.expectEqualStrings("-v2 backup", std.mem.span(dashed.*.terms[0].text));
+
+    const negated = c.Query_parse("-backup ext:log", c.QUERY_DEFAULT);
+    defer c.Query_free(negated);
+    try std.testing.expect(negated.*.plain == 0);
+    try std.testing.expect(negated.*.terms[0].negate != 0);
+    try std.testing.expectEqualStrings("backup", std.mem.span(negated.*.terms[0].text));
+}
+
+test "Query Matches Entries Without Touching Disk For Name Terms" {
+    const query = c.Query_parse("ext:c,h -name:test type:file", c.QUERY_DEFAULT);
+    defer c.Query_free(query);
+
+    var entry: c.QueryEntry = undefined;
+    c.QueryEntry_init(&entry, "src", "main.c", c.DIR_TYPE_REG, -1);
+    try std.testing.expect(c.Query_matches(query, &entry) != 0);
+    c.QueryEntry_clear(&entry);
+
+    c.QueryEntry_init(&entry, "src", "test_main.c", c.DIR_TYPE_REG, -1);
+    try std.testing.expect(c.Query_matches(query, &entry) == 0);
+    c.QueryEntry_clear(&entry);
+
+    c.QueryEntry_init(&entry, "src", "include.h", c.DIR_TYPE_DIR, -1);
+    try std.testing.expect(c.Query_matches(query, &entry) == 0);
+    c.QueryEntry_clear(&entry);
+}
+
+test "Query Content Terms Skip FIFOs Behind Symlinks Without Blocking" {
+    const fs = std.fs;
+
+    const test_dir = "query_fifo_files";
+    try fs.cwd().makeDir(test_dir);
+    defer fs.cwd().deleteTree(test_dir) catch {};
+
+    var dir = try fs.cwd().openDir(test_dir, .{});
+    defer dir.close();
+    try std.testing.expectEqual(@as(c_int, 0), c.mkfifo(test_dir ++ "/pipe", 0o644));
+    try dir.symLink("pipe", "link", .{});
+    try dir.writeFile(.{ .sub_path = "notes.txt", .data = "needle" });
+    try dir.symLink("notes.txt", "notes", .{});
+
+    const query = c.Query_parse("content:needle", c.QUERY_DEFAULT);
+    defer c.Query_free(query);
+
+    // No writer ever opens the FIFO: a blocking open would hang here
+    var entry: c.QueryEntry = undefined;
+    c.QueryEntry_init(&entry, "", "link", c.DIR_TYPE_LNK, dir.fd);
+    try std.testing.expect(c.Query_matches(query, &entry) == 0);
+    c.QueryEntry_clear(&entry);
+
+    c.QueryEntry_init(&entry, "", "notes", c.DIR_TYPE_LNK, dir.fd);
+    try std.testing.expect(c.Query_matches(query, &entry) != 0);
+    c.QueryEntry_clear(&entry);
+
+    // Contents that cannot be read match the negation no more than the term
+    const negated = c.Query_parse("-content:needle", c.QUERY_DEFAULT);
+    defer c.Query_free(negated);
+    c.QueryEntry_init(&entry, "", "link", c.DIR_TYPE_LNK, dir.fd);
+    try std.testing.expect(c.Query_matches(negated, &entry) == 0);
+    c.QueryEntry_clear(&entry);
+}
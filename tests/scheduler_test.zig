@@ -0,0 +1,92 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("Scheduler.h");
+});
+
+var tasks_run = std.atomic.Value(u32).init(0);
+var hooks_run: u32 = 0;
+var hooks_cancelled: u32 = 0;
+
+fn countTask(data: c.gpointer) callconv(.C) void {
+    _ = data;
+    _ = tasks_run.fetchAdd(1, .monotonic);
+}
+
+fn countHook(data: c.gpointer, cancelled: c.gboolean) callconv(.C) void {
+    _ = data;
+    hooks_run += 1;
+    if (cancelled != 0) hooks_cancelled += 1;
+}
+
+test "Scheduler Runs Done Hooks On The Main Loop And Skips Cancelled Tasks" {
+    try std.testing.expect(c.Scheduler_workers() >= 1);
+    const group = c.SchedulerGroup_new(c.SCHEDULER_USER_INITIATED, null);
+    defer c.SchedulerGroup_unref(group);
+
+    for (0..50) |_| c.Scheduler_push_full(group, countTask, countHook, null);
+    while (hooks_run < 50) _ = c.g_main_context_iteration(null, 1);
+    try std.testing.expectEqual(@as(u32, 50), tasks_run.load(.monotonic));
+    try std.testing.expectEqual(@as(u32, 0), hooks_cancelled);
+
+    // Not started yet: the task is skipped, its hook still cleans up
+    c.SchedulerGroup_cancel(group);
+    for (0..10) |_| c.Scheduler_push_full(group, countTask, countHook, null);
+    while (hooks_run < 60) _ = c.g_main_context_iteration(null, 1);
+    try std.testing.expectEqual(@as(u32, 50), tasks_run.load(.monotonic));
+    try std.testing.expectEqual(@as(u32, 10), hooks_cancelled);
+}
+
+test "SchedulerGroup Follows Its Parent Token But Never Cancels It" {
+    const parent = c.g_cancellable_new();
+    defer c.g_object_unref(parent);
+
+    const stopped = c.SchedulerGroup_new(c.SCHEDULER_INTERACTIVE, parent);
+    c.SchedulerGroup_cancel(stopped);
+    try std.testing.expect(c.g_cancellable_is_cancelled(parent) == 0);
+    c.SchedulerGroup_unref(stopped);
+
+    const following = c.SchedulerGroup_new(c.SCHEDULER_USER_INITIATED, parent);
+    defer c.SchedulerGroup_unref(following);
+    c.g_cancellable_cancel(parent);
+    try std.testing.expect(c.g_cancellable_is_cancelled(following.*.cancellable) != 0);
+
+    // A parent cancelled already cancels new groups right away
+    const late = c.SchedulerGroup_new(c.SCHEDULER_BACKGROUND, parent);
+    defer c.SchedulerGroup_unref(late);
+    try std.testing.expect(c.g_cancellable_is_cancelled(late.*.cancellable) != 0);
+}
+
+var background_done = std.atomic.Value(i64).init(0);
+var interactive_started = std.atomic.Value(i64).init(0);
+
+fn crawl(data: c.gpointer) callconv(.C) void {
+    _ = data;
+    const end = c.g_get_monotonic_time() + 200 * std.time.us_per_ms;
+    while (c.g_get_monotonic_time() < end) _ = c.Scheduler_yield();
+    background_done.store(c.g_get_monotonic_time(), .release);
+}
+
+fn interact(data: c.gpointer) callconv(.C) void {
+    _ = data;
+    interactive_started.store(c.g_get_monotonic_time(), .release);
+}
+
+test "Scheduler Lets Interactive Work Preempt Background Tasks" {
+    const background = c.SchedulerGroup_new(c.SCHEDULER_BACKGROUND, null);
+    defer c.SchedulerGroup_unref(background);
+    const interactive = c.SchedulerGroup_new(c.SCHEDULER_INTERACTIVE, null);
+    defer c.SchedulerGroup_unref(interactive);
+
+    // One crawl per worker, so no worker is idle when the click comes
+    for (0..c.Scheduler_workers()) |_| c.Scheduler_push(background, crawl, null);
+    std.time.sleep(20 * std.time.ns_per_ms);
+    const pushed = c.g_get_monotonic_time();
+    c.Scheduler_push(interactive, interact, null);
+
+    while (background_done.load(.acquire) == 0) std.time.sleep(std.time.ns_per_ms);
+    const started = interactive_started.load(.acquire);
+    try std.testing.expect(started != 0);
+    try std.testing.expect(started < background_done.load(.acquire));
+    // A quantum, with room for a loaded test machine
+    try std.testing.expect(started - pushed < 50 * std.time.us_per_ms);
+}
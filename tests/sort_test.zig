@@ -0,0 +1,99 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("Listing.h");
+    @cInclude("Sort.h");
+});
+
+fn writeFile(dir: std.fs.Dir, name: []const u8, size: usize) !void {
+    const f = try dir.createFile(name, .{});
+    defer f.close();
+    var i: usize = 0;
+    while (i < size) : (i += 1) try f.writeAll("x");
+}
+
+test "DirListing Sorts By Name, Size And Folders First" {
+    const fs = std.fs;
+
+    const test_dir = "sort_files";
+    try fs.cwd().makeDir(test_dir);
+    defer fs.cwd().deleteTree(test_dir) catch {};
+
+    var dir = try fs.cwd().openDir(test_dir, .{});
+    defer dir.close();
+    try writeFile(dir, "file10.txt", 3);
+    try writeFile(dir, "file2.txt", 1);
+    try writeFile(dir, "file1.md", 2);
+    try dir.makeDir("folder");
+
+    const listing = c.DirListing_load(test_dir);
+    try std.testing.expect(listing != null);
+    defer c.DirListing_unref(listing);
+    const names = listing.*.names;
+
+    // Natural order: "file2" before "file10"
+    var spec = c.SortSpec{ .key = c.SORT_BY_NAME, .descending = 0, .directories_first = 0 };
+    const by_name = c.DirListing_sort(listing, &spec);
+    defer c.g_free(by_name);
+    try std.testing.expectEqualStrings("file1.md", std.mem.span(names[by_name[0]]));
+    try std.testing.expectEqualStrings("file2.txt", std.mem.span(names[by_name[1]]));
+    try std.testing.expectEqualStrings("file10.txt", std.mem.span(names[by_name[2]]));
+
+    // Largest first, with the folder kept ahead of the files
+    spec = c.SortSpec{ .key = c.SORT_BY_SIZE, .descending = 1, .directories_first = 1 };
+    const by_size = c.DirListing_sort(listing, &spec);
+    defer c.g_free(by_size);
+    try std.testing.expectEqualStrings("folder", std.mem.span(names[by_size[0]]));
+    try std.testing.expectEqualStrings("file10.txt", std.mem.span(names[by_size[1]]));
+    try std.testing.expectEqualStrings("file1.md", std.mem.span(names[by_size[2]]));
+    try std.testing.expectEqualStrings("file2.txt", std.mem.span(names[by_size[3]]));
+}
+
+fn onStats(listing: [*c]c.DirListing, user_data: c.gpointer) callconv(.C) void {
+    _ = listing;
+    const loaded: *bool = @ptrCast(@alignCast(user_data));
+    loaded.* = true;
+}
+
+test "DirListing Loads Stat Columns On A Worker" {
+    const fs = std.fs;
+
+    const test_dir = "sort_stats_files";
+    try fs.cwd().makeDir(test_dir);
+    defer fs.cwd().deleteTree(test_dir) catch {};
+
+    var dir = try fs.cwd().openDir(test_dir, .{});
+    defer dir.close();
+    try writeFile(dir, "small", 1);
+    try writeFile(dir, "large", 5);
+
+    const listing = c.DirListing_load(test_dir);
+    try std.testing.expect(listing != null);
+    defer c.DirListing_unref(listing);
+    const group = c.SchedulerGroup_new(c.SCHEDULER_INTERACTIVE, null);
+    defer c.SchedulerGroup_unref(group);
+
+    // The columns only appear on the main loop, with the callback
+    var loaded = false;
+    c.DirListing_load_stats(listing, null, group, onStats, &loaded);
+    try std.testing.expect(listing.*.sizes == null);
+    while (!loaded) _ = c.g_main_context_iteration(null, 1);
+    try std.testing.expect(listing.*.sizes != null);
+
+    var spec = c.SortSpec{ .key = c.SORT_BY_SIZE, .descending = 1, .directories_first = 0 };
+    const by_size = c.DirListing_sort(listing, &spec);
+    defer c.g_free(by_size);
+    try std.testing.expectEqualStrings("large", std.mem.span(listing.*.names[by_size[0]]));
+
+    // A newer listing of the directory reuses those values, stat'ing only
+    // the entry added since
+    try writeFile(dir, "medium", 3);
+    const newer = c.DirListing_load(test_dir);
+    try std.testing.expect(newer != null);
+    defer c.DirListing_unref(newer);
+    loaded = false;
+    c.DirListing_load_stats(newer, listing, group, onStats, &loaded);
+    while (!loaded) _ = c.g_main_context_iteration(null, 1);
+    const newer_by_size = c.DirListing_sort(newer, &spec);
+    defer c.g_free(newer_by_size);
+    try std.testing.expectEqualStrings("medium", std.mem.span(newer.*.names[newer_by_size[1]]));
+}
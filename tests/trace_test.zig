@@ -0,0 +1,58 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("Trace.h");
+});
+
+fn recordSpans(count: usize) void {
+    for (0..count) |i| {
+        const start = c.Trace_now();
+        c.Trace_span("test_span", start, @intCast(i));
+    }
+}
+
+test "Trace Writes Every Thread's Spans As Chrome Trace JSON" {
+    const allocator = std.testing.allocator;
+    const path = "trace_test.json";
+    defer std.fs.cwd().deleteFile(path) catch {};
+
+    // Nothing is recorded before a trace starts
+    try std.testing.expectEqual(@as(i64, 0), c.Trace_now());
+
+    c.Trace_start(path);
+    recordSpans(10);
+    const thread = try std.Thread.spawn(.{}, recordSpans, .{c.TRACE_RING_EVENTS + 5});
+    thread.join();
+    try std.testing.expect(c.Trace_stop() != 0);
+    try std.testing.expectEqual(@as(i64, 0), c.Trace_now());
+
+    const data = try std.fs.cwd().readFileAlloc(allocator, path, 64 << 20);
+    defer allocator.free(data);
+    const parsed = try std.json.parseFromSlice(std.json.Value, allocator, data, .{});
+    defer parsed.deinit();
+
+    // Spans and the smallest count seen, per thread
+    const Seen = struct { spans: usize = 0, oldest: i64 = std.math.maxInt(i64) };
+    var threads = std.AutoHashMap(i64, Seen).init(allocator);
+    defer threads.deinit();
+    for (parsed.value.object.get("traceEvents").?.array.items) |event| {
+        if (!std.mem.eql(u8, event.object.get("ph").?.string, "X")) continue;
+        try std.testing.expectEqualStrings("test_span", event.object.get("name").?.string);
+        const entry = try threads.getOrPut(event.object.get("tid").?.integer);
+        if (!entry.found_existing) entry.value_ptr.* = .{};
+        entry.value_ptr.spans += 1;
+        const count = event.object.get("args").?.object.get("count").?.integer;
+        entry.value_ptr.oldest = @min(entry.value_ptr.oldest, count);
+    }
+
+    // The worker's ring kept only its newest TRACE_RING_EVENTS spans
+    try std.testing.expectEqual(@as(u32, 2), threads.count());
+    var iterator = threads.valueIterator();
+    while (iterator.next()) |seen| {
+        if (seen.spans == 10) {
+            try std.testing.expectEqual(@as(i64, 0), seen.oldest);
+        } else {
+            try std.testing.expectEqual(@as(usize, c.TRACE_RING_EVENTS), seen.spans);
+            try std.testing.expectEqual(@as(i64, 5), seen.oldest);
+        }
+    }
+}
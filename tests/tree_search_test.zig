@@ -0,0 +1,63 @@
+const std = @import("std");
+const c = @cImport({
+    @cInclude("TreeSearch.h");
+});
+
+const Results = struct {
+    paths: std.ArrayList([]u8),
+    finished: bool = false,
+};
+
+fn onMatches(matches: [*c]const c.TreeMatch, count: c.guint, finished: c.gboolean, user_data: ?*anyopaque) callconv(.C) void {
+    const results: *Results = @ptrCast(@alignCast(user_data));
+    var i: usize = 0;
+    while (i < count) : (i += 1) {
+        const path = std.testing.allocator.dupe(u8, std.mem.span(matches[i].path)) catch unreachable;
+        results.paths.append(path) catch unreachable;
+    }
+    if (finished != 0) results.finished = true;
+}
+
+test "TreeSearch Finds Nested Names And Prunes Ignored Folders" {
+    const fs = std.fs;
+
+    const test_dir = "tree_search_files";
+    try fs.cwd().makeDir(test_dir);
+    defer fs.cwd().deleteTree(test_dir) catch {};
+
+    var dir = try fs.cwd().openDir(test_dir, .{});
+    defer dir.close();
+    try dir.makePath("src/deep");
+    try dir.makePath("node_modules/pkg");
+    try dir.makePath(".git");
+    try dir.writeFile(.{ .sub_path = "src/deep/Needle.txt", .data = "" });
+    try dir.writeFile(.{ .sub_path = "node_modules/pkg/needle.js", .data = "" });
+    try dir.writeFile(.{ .sub_path = ".git/needle", .data = "" });
+    try dir.writeFile(.{ .sub_path = "hay.txt", .data = "" });
+
+    var results = Results{ .paths = std.ArrayList([]u8).init(std.testing.allocator) };
+    defer {
+        for (results.paths.items) |path| std.testing.allocator.free(path);
+        results.paths.deinit();
+    }
+
+    const search = c.TreeSearch_start(test_dir, c.Query_parse("needle", c.QUERY_DEFAULT), c.TREE_WALK_IGNORE_FILES, null, 0, null, onMatches, &results);
+    while (!results.finished) _ = c.g_main_context_iteration(null, 1);
+    try std.testing.expect(search.*.walk.*.root_failed == 0);
+    c.TreeSearch_stop(search);
+
+    try std.testing.expectEqual(@as(usize, 1), results.paths.items.len);
+    try std.testing.expectEqualStrings("src/deep/Needle.txt", results.paths.items[0]);
+}
+
+test "TreeSearch Reports A Root It Cannot Open" {
+    var results = Results{ .paths = std.ArrayList([]u8).init(std.testing.allocator) };
+    defer results.paths.deinit();
+
+    const search = c.TreeSearch_start("tree_search_missing", c.Query_parse("needle", c.QUERY_DEFAULT), c.TREE_WALK_ONE_LEVEL, null, 0, null, onMatches, &results);
+    while (!results.finished) _ = c.g_main_context_iteration(null, 1);
+    try std.testing.expect(search.*.walk.*.root_failed != 0);
+    c.TreeSearch_stop(search);
+
+    try std.testing.expectEqual(@as(usize, 0), results.paths.items.len);
+}